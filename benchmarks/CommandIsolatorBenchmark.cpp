@@ -0,0 +1,49 @@
+#include "CommandIsolator.hpp"
+#include "benchmark_helpers.hpp"
+
+#include <benchmark/benchmark.h>
+#include <process/collect.hpp>
+
+using std::string;
+using std::vector;
+
+using namespace criteo::mesos;
+using ::mesos::ContainerID;
+using ::mesos::ResourceStatistics;
+using ::mesos::slave::ContainerConfig;
+
+// Time to get the statistics of every container, which is what the agent
+// does on each call to /monitor/statistics.
+static void BM_UsageFanOut(benchmark::State& state) {
+  CommandIsolator isolator(None(), None(), None(),
+                           Command(resourcesPath() + "usage.sh"));
+
+  vector<ContainerID> containerIds(state.range(0));
+  ContainerConfig containerConfig;
+  containerConfig.set_user("app_user");
+  for (size_t i = 0; i < containerIds.size(); ++i) {
+    containerIds[i].set_value("container_" + std::to_string(i));
+    isolator.prepare(containerIds[i], containerConfig).await();
+  }
+
+  for (auto _ : state) {
+    vector<process::Future<ResourceStatistics>> statistics;
+    for (const ContainerID& containerId : containerIds) {
+      statistics.push_back(isolator.usage(containerId));
+    }
+    process::collect(statistics).await();
+  }
+  state.SetItemsProcessed(state.iterations() * containerIds.size());
+
+  for (const ContainerID& containerId : containerIds) {
+    isolator.cleanup(containerId).await();
+  }
+}
+
+BENCHMARK(BM_UsageFanOut)
+    ->Arg(1)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
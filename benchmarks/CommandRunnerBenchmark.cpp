@@ -0,0 +1,86 @@
+#include "CommandRunner.hpp"
+#include "RunningContext.hpp"
+#include "benchmark_helpers.hpp"
+
+#include <benchmark/benchmark.h>
+
+using std::string;
+
+using namespace criteo::mesos;
+
+static const logging::Metadata METADATA = {"benchmark", "run"};
+
+// Input of a usage command, the size does not matter much.
+static const string INPUT =
+    "{\"container_id\":{\"value\":\"4c9e1f5e-3c1b-4f2e-9d3a-1a2b3c4d5e6f\"}}";
+
+static Command noop(CommandTransport transport) {
+  Command command(resourcesPath() + "noop.sh");
+  command.setTransport(transport);
+  return command;
+}
+
+static void BM_Run(benchmark::State& state, CommandTransport transport) {
+  Command command = noop(transport);
+  CommandRunner runner(false, METADATA);
+  for (auto _ : state) {
+    Try<string> output = runner.run(command, INPUT);
+    if (output.isError()) state.SkipWithError(output.error().c_str());
+  }
+}
+
+static void BM_AsyncRun(benchmark::State& state, CommandTransport transport) {
+  Command command = noop(transport);
+  CommandRunner runner(false, METADATA);
+  for (auto _ : state) {
+    process::Future<Try<string>> output = runner.asyncRun(command, INPUT);
+    output.await();
+    if (!output.isReady() || output->isError()) {
+      state.SkipWithError("Unable to run the command");
+    }
+  }
+}
+
+static void BM_RunSynchronously(benchmark::State& state,
+                                CommandTransport transport) {
+  Command command = noop(transport);
+  CommandRunner runner(false, METADATA);
+  for (auto _ : state) {
+    Try<string> output = runner.runSynchronously(command, INPUT);
+    if (output.isError()) state.SkipWithError(output.error().c_str());
+  }
+}
+
+static void BM_RunningContext(benchmark::State& state,
+                              CommandTransport transport) {
+  Command command = noop(transport);
+  for (auto _ : state) {
+    RunningContext context(false, METADATA, command, INPUT);
+    context.deleteContext();
+  }
+}
+
+// Commands are processes, the time spent in the benchmark thread is
+// meaningless hence the real time.
+BENCHMARK_CAPTURE(BM_Run, File, CommandTransport::FILE)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Run, Memfd, CommandTransport::MEMFD)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AsyncRun, File, CommandTransport::FILE)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AsyncRun, Memfd, CommandTransport::MEMFD)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_RunSynchronously, File, CommandTransport::FILE)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_RunSynchronously, Memfd, CommandTransport::MEMFD)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_RunningContext, File, CommandTransport::FILE)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_RunningContext, Memfd, CommandTransport::MEMFD)
+    ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,66 @@
+#include "Helpers.hpp"
+#include "JsonDecoder.hpp"
+#include "SampleOutputs.hpp"
+
+#include <benchmark/benchmark.h>
+
+using std::string;
+
+using namespace criteo::mesos;
+using ::mesos::Environment;
+using ::mesos::Labels;
+using ::mesos::ResourceStatistics;
+using ::mesos::slave::ContainerLaunchInfo;
+using ::mesos::slave::ContainerLimitation;
+
+template <class Proto>
+static void BM_GenericJsonToProtobuf(benchmark::State& state,
+                                     const string& json) {
+  for (auto _ : state) {
+    Try<JSON::Object> object = JSON::parse<JSON::Object>(json);
+    Try<Proto> proto = ::protobuf::parse<Proto>(object.get());
+    benchmark::DoNotOptimize(proto);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+template <class Proto>
+static void BM_FastJsonToProtobuf(benchmark::State& state,
+                                  const string& json) {
+  for (auto _ : state) {
+    Proto proto;
+    bool decoded = decodeJson(json, &proto);
+    benchmark::DoNotOptimize(decoded);
+    benchmark::DoNotOptimize(proto);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+BENCHMARK_CAPTURE(BM_GenericJsonToProtobuf<ResourceStatistics>,
+                  ResourceStatistics, USAGE_OUTPUT);
+BENCHMARK_CAPTURE(BM_FastJsonToProtobuf<ResourceStatistics>,
+                  ResourceStatistics, USAGE_OUTPUT);
+BENCHMARK_CAPTURE(BM_GenericJsonToProtobuf<ContainerLimitation>,
+                  ContainerLimitation, WATCH_OUTPUT);
+BENCHMARK_CAPTURE(BM_FastJsonToProtobuf<ContainerLimitation>,
+                  ContainerLimitation, WATCH_OUTPUT);
+
+// What the modules actually call, i.e., the fast path when there is one.
+template <class Proto>
+static void BM_JsonToProtobuf(benchmark::State& state, const string& json) {
+  for (auto _ : state) {
+    Result<Proto> proto = jsonToProtobuf<Proto>(json);
+    benchmark::DoNotOptimize(proto);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+BENCHMARK_CAPTURE(BM_JsonToProtobuf<ContainerLaunchInfo>, ContainerLaunchInfo,
+                  PREPARE_OUTPUT);
+BENCHMARK_CAPTURE(BM_JsonToProtobuf<ContainerLimitation>, ContainerLimitation,
+                  WATCH_OUTPUT);
+BENCHMARK_CAPTURE(BM_JsonToProtobuf<ResourceStatistics>, ResourceStatistics,
+                  USAGE_OUTPUT);
+BENCHMARK_CAPTURE(BM_JsonToProtobuf<Labels>, Labels, LABELS_OUTPUT);
+BENCHMARK_CAPTURE(BM_JsonToProtobuf<Environment>, Environment,
+                  ENVIRONMENT_OUTPUT);
@@ -0,0 +1,43 @@
+#ifndef __SAMPLE_OUTPUTS_HPP__
+#define __SAMPLE_OUTPUTS_HPP__
+
+#include <string>
+
+// Typical output of a usage command.
+static const std::string USAGE_OUTPUT =
+    "{\"timestamp\": 1571050000.123, \"processes\": 12, \"threads\": 48, "
+    "\"cpus_user_time_secs\": 1234.5, \"cpus_system_time_secs\": 321.25, "
+    "\"cpus_limit\": 4, \"cpus_nr_periods\": 100000, "
+    "\"cpus_nr_throttled\": 12, \"cpus_throttled_time_secs\": 1.5, "
+    "\"mem_total_bytes\": 2147483648, \"mem_rss_bytes\": 1073741824, "
+    "\"mem_limit_bytes\": 4294967296, \"mem_cache_bytes\": 536870912, "
+    "\"net_rx_packets\": 123456, \"net_rx_bytes\": 987654321, "
+    "\"net_tx_packets\": 654321, \"net_tx_bytes\": 123456789, "
+    "\"net_snmp_statistics\": {\"tcp_stats\": {\"CurrEstab\": 42, "
+    "\"ActiveOpens\": 1000, \"PassiveOpens\": 2000, \"RetransSegs\": 3}}}";
+
+// Typical output of a watch command.
+static const std::string WATCH_OUTPUT =
+    "{\"resources\": [{\"name\": \"mem\", \"type\": \"SCALAR\", "
+    "\"scalar\": {\"value\": 4096}}], "
+    "\"message\": \"Memory limit exceeded\", "
+    "\"reason\": \"REASON_CONTAINER_LIMITATION_MEMORY\"}";
+
+// Typical output of a prepare command.
+static const std::string PREPARE_OUTPUT =
+    "{\"rootfs\": \"/isolated_fs\", \"user\": \"app_user\", "
+    "\"environment\": {\"variables\": [{\"name\": \"ENV_1\", "
+    "\"value\": \"test1\", \"type\": \"VALUE\"}]}}";
+
+// Typical output of a slaveRunTaskLabelDecorator command.
+static const std::string LABELS_OUTPUT =
+    "{\"labels\": [{\"key\": \"LABEL_1\", \"value\": \"test1\"}, "
+    "{\"key\": \"LABEL_2\", \"value\": \"test2\"}]}";
+
+// Typical output of a slaveExecutorEnvironmentDecorator command.
+static const std::string ENVIRONMENT_OUTPUT =
+    "{\"variables\": [{\"name\": \"ENV_1\", \"value\": \"test1\", "
+    "\"type\": \"VALUE\"}, {\"name\": \"ENV_2\", \"value\": "
+    "\"test2\", \"type\": \"VALUE\"}]}";
+
+#endif  // __SAMPLE_OUTPUTS_HPP__
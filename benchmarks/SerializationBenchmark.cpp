@@ -0,0 +1,68 @@
+#include "SampleOutputs.hpp"
+#include "Serialization.hpp"
+
+#include <benchmark/benchmark.h>
+
+using std::string;
+
+using namespace criteo::mesos;
+using ::mesos::ContainerID;
+using ::mesos::ResourceStatistics;
+using ::mesos::slave::ContainerConfig;
+using ::mesos::slave::ContainerLimitation;
+
+// Output of a command in the given format, built from the JSON sample.
+template <class Proto>
+static string sampleOutput(CommandFormat format, const string& json) {
+  if (format == CommandFormat::JSON) return json;
+  return jsonToProtobuf<Proto>(json)->SerializeAsString();
+}
+
+template <class Proto>
+static void BM_ParseOutput(benchmark::State& state, CommandFormat format,
+                           const string& json) {
+  Command command("command");
+  command.setFormat(format);
+  string output = sampleOutput<Proto>(format, json);
+
+  for (auto _ : state) {
+    Result<Proto> proto = parseOutput<Proto>(command, output);
+    benchmark::DoNotOptimize(proto);
+  }
+  state.SetBytesProcessed(state.iterations() * output.size());
+  state.counters["payload_bytes"] = output.size();
+}
+
+static void BM_BuildInput(benchmark::State& state, CommandFormat format) {
+  ContainerID containerId;
+  containerId.set_value("4c9e1f5e-3c1b-4f2e-9d3a-1a2b3c4d5e6f");
+  ContainerConfig containerConfig;
+  containerConfig.set_directory(
+      "/var/lib/mesos/slaves/S0/frameworks/F0/executors/E0/runs/R0");
+  containerConfig.set_user("app_user");
+  containerConfig.set_rootfs("/isolated_fs");
+
+  size_t size = 0;
+  for (auto _ : state) {
+    string input = InputBuilder(format)
+                       .add(InputField::CONTAINER_ID, containerId)
+                       .add(InputField::CONTAINER_CONFIG, containerConfig)
+                       .str();
+    size = input.size();
+    benchmark::DoNotOptimize(input);
+  }
+  state.counters["payload_bytes"] = size;
+}
+
+BENCHMARK_CAPTURE(BM_ParseOutput<ResourceStatistics>, ResourceStatistics/JSON,
+                  CommandFormat::JSON, USAGE_OUTPUT);
+BENCHMARK_CAPTURE(BM_ParseOutput<ResourceStatistics>,
+                  ResourceStatistics/Protobuf, CommandFormat::PROTOBUF,
+                  USAGE_OUTPUT);
+BENCHMARK_CAPTURE(BM_ParseOutput<ContainerLimitation>,
+                  ContainerLimitation/JSON, CommandFormat::JSON, WATCH_OUTPUT);
+BENCHMARK_CAPTURE(BM_ParseOutput<ContainerLimitation>,
+                  ContainerLimitation/Protobuf, CommandFormat::PROTOBUF,
+                  WATCH_OUTPUT);
+BENCHMARK_CAPTURE(BM_BuildInput, JSON, CommandFormat::JSON);
+BENCHMARK_CAPTURE(BM_BuildInput, Protobuf, CommandFormat::PROTOBUF);
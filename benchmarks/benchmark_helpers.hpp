@@ -0,0 +1,14 @@
+#ifndef __BENCHMARK_HELPERS_HPP__
+#define __BENCHMARK_HELPERS_HPP__
+
+#include <cstdlib>
+#include <string>
+
+// Directory of the scripts run by the benchmarks, the same as
+// TEST_RESOURCES_PATH for the tests.
+inline std::string resourcesPath() {
+  const char* path = std::getenv("BENCHMARK_RESOURCES_PATH");
+  return path != nullptr ? path : "./benchmarks/scripts/";
+}
+
+#endif  // __BENCHMARK_HELPERS_HPP__
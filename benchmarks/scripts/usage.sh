@@ -0,0 +1,3 @@
+#!/bin/bash
+
+echo '{"timestamp": 12345, "processes": 1, "threads": 2, "cpus_limit": 1}' >$2
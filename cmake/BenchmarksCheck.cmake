@@ -0,0 +1,45 @@
+# Benchmarks are only built when Google Benchmark is installed.
+find_package(benchmark QUIET)
+
+if(NOT benchmark_FOUND)
+  message(STATUS "Google Benchmark not found, benchmarks are disabled")
+  return()
+endif()
+
+set(BENCHMARK_SOURCES
+  ${CMAKE_SOURCE_DIR}/benchmarks/CommandIsolatorBenchmark.cpp
+  ${CMAKE_SOURCE_DIR}/benchmarks/CommandRunnerBenchmark.cpp
+  ${CMAKE_SOURCE_DIR}/benchmarks/JsonDecoderBenchmark.cpp
+  ${CMAKE_SOURCE_DIR}/benchmarks/SerializationBenchmark.cpp
+)
+
+SET(BENCHMARK_BINARY_NAME benchmark_mesos_command_modules)
+add_executable(${BENCHMARK_BINARY_NAME}
+  ${BENCHMARK_SOURCES}
+)
+
+target_link_directories(
+  ${BENCHMARK_BINARY_NAME}
+
+  PRIVATE ${MESOS_BUILD_DIR}/3rdparty/libprocess/src/
+  PRIVATE ${MESOS_ROOT_DIR}/3rdparty/libprocess/.libs/
+  PRIVATE ${MESOS_BUILD_DIR}/src/
+  )
+
+target_link_libraries(${BENCHMARK_BINARY_NAME}
+  ${PROJECT_NAME}
+  ${GLOG_LIBRARY}
+  ${PROTOBUF_LIBRARY}
+  ${MESOS-PROTOBUFS_LIBRARY}
+  benchmark::benchmark_main
+  process
+  pthread
+  )
+# Results are also written in JSON to be compared between builds.
+add_custom_target(bench
+  COMMAND ${CMAKE_COMMAND} -E env
+          BENCHMARK_RESOURCES_PATH=${CMAKE_SOURCE_DIR}/benchmarks/scripts/
+          "${BENCHMARK_BINARY_NAME}"
+          --benchmark_out=benchmark_results.json
+          --benchmark_out_format=json
+  )
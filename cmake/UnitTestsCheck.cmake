@@ -1,9 +1,24 @@
 set(TEST_SOURCES
+  ${CMAKE_SOURCE_DIR}/tests/CircuitBreakerTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/CommandCgroupTest.cpp
   ${CMAKE_SOURCE_DIR}/tests/CommandHookTest.cpp
   ${CMAKE_SOURCE_DIR}/tests/CommandIsolatorTest.cpp
   ${CMAKE_SOURCE_DIR}/tests/CommandRunnerTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/CommandSchedulerTest.cpp
   ${CMAKE_SOURCE_DIR}/tests/ConfigurationParserTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/ConfigurationWatcherTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/ContainerCheckpointTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/ExecutionEngineTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/JsonDecoderTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/LruCacheTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/MetricsTest.cpp
   ${CMAKE_SOURCE_DIR}/tests/ModulesFactoryTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/SerializationTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/SpanTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/SpawnServerTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/StatsTableTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/TraceRecorderTest.cpp
+  ${CMAKE_SOURCE_DIR}/tests/WatchSchedulerTest.cpp
   ${CMAKE_SOURCE_DIR}/tests/gtest_helpers.cpp
   ${CMAKE_SOURCE_DIR}/tests/main.cpp
 )
@@ -13,6 +28,14 @@ add_executable(${TEST_BINARY_NAME}
   ${TEST_SOURCES}
 )
 
+# The spawn server tests run the helper built in this tree.
+add_dependencies(${TEST_BINARY_NAME} mesos-command-spawner)
+target_compile_definitions(
+  ${TEST_BINARY_NAME}
+
+  PRIVATE SPAWN_SERVER_PATH="$<TARGET_FILE:mesos-command-spawner>"
+  )
+
 target_include_directories(
   ${TEST_BINARY_NAME}
 
@@ -0,0 +1,108 @@
+#include "CircuitBreaker.hpp"
+
+#include <algorithm>
+#include <map>
+
+#include <glog/logging.h>
+
+#include <process/clock.hpp>
+
+namespace criteo {
+namespace mesos {
+
+using process::Clock;
+using std::string;
+
+CircuitBreaker::CircuitBreaker(const string& command) : m_command(command) {}
+
+CircuitBreaker::Admission CircuitBreaker::admit(
+    const BreakerOptions& options) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // The breaker may have been disabled by a reload of the configuration.
+  if (options.failures == 0) m_state = State::CLOSED;
+
+  switch (m_state) {
+    case State::CLOSED:
+      return Admission::ALLOWED;
+    case State::OPEN:
+      if (Clock::now() < m_retryAt) return Admission::REJECTED;
+      m_state = State::HALF_OPEN;
+      return Admission::PROBE;
+    case State::HALF_OPEN:
+      // A probe is already running.
+      return Admission::REJECTED;
+  }
+  return Admission::REJECTED;
+}
+
+void CircuitBreaker::open(const BreakerOptions& options,
+                          const Duration& backoff) {
+  Try<Duration> maxBackoff = Duration::create(options.maxBackoff);
+  m_backoff = maxBackoff.isSome() ? std::min(backoff, maxBackoff.get())
+                                  : backoff;
+  m_state = State::OPEN;
+  m_retryAt = Clock::now() + m_backoff;
+  LOG(WARNING) << "Short-circuiting command \"" << m_command << "\" for "
+               << m_backoff << " after " << m_failures
+               << " consecutive failures";
+}
+
+void CircuitBreaker::record(const BreakerOptions& options,
+                            Admission admission, bool succeeded) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (succeeded) {
+    if (admission == Admission::PROBE) {
+      LOG(INFO) << "Command \"" << m_command << "\" succeeded again";
+    }
+    // Calls admitted before the breaker opened do not close it.
+    if (admission == Admission::PROBE || m_state == State::CLOSED) {
+      m_state = State::CLOSED;
+      m_failures = 0;
+    }
+    return;
+  }
+
+  ++m_failures;
+  if (admission == Admission::PROBE) {
+    open(options, m_backoff * 2);
+  } else if (m_state == State::CLOSED && options.failures > 0 &&
+             m_failures >= options.failures) {
+    Try<Duration> backoff = Duration::create(options.backoff);
+    open(options, backoff.isSome() ? backoff.get() : Seconds(1));
+  }
+}
+
+void CircuitBreaker::release(Admission admission) {
+  if (admission != Admission::PROBE) return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_state != State::HALF_OPEN) return;
+  // The backoff already elapsed so that the next call probes right away.
+  m_state = State::OPEN;
+  m_retryAt = Clock::now();
+}
+
+bool CircuitBreaker::isOpen() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_state != State::CLOSED;
+}
+
+CircuitBreaker& CircuitBreaker::get(const Command& command) {
+  static std::mutex mutex;
+  // Intentionally leaked like the co-processes, the breakers being shared by
+  // all module instances.
+  static std::map<string, CircuitBreaker*>* breakers =
+      new std::map<string, CircuitBreaker*>();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = breakers->find(command.command());
+  if (it == breakers->end()) {
+    it = breakers
+             ->emplace(command.command(), new CircuitBreaker(command.command()))
+             .first;
+  }
+  return *it->second;
+}
+
+}  // namespace mesos
+}  // namespace criteo
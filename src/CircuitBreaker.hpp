@@ -0,0 +1,88 @@
+#ifndef __CIRCUIT_BREAKER_HPP__
+#define __CIRCUIT_BREAKER_HPP__
+
+#include <mutex>
+#include <string>
+
+#include <process/time.hpp>
+
+#include <stout/duration.hpp>
+
+#include "Command.hpp"
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * @brief The CircuitBreaker class stops running a command which keeps failing,
+ * e.g., because a dependency of the script is down, so that the agent does not
+ * spawn and kill hung processes until it is back.
+ *
+ * The breaker opens after a number of consecutive failures or timeouts of the
+ * command. The calls are then short-circuited until the backoff elapsed, when
+ * a single call is let through as a probe. The breaker closes if the probe
+ * succeeds and opens again for twice as long otherwise, up to the maximum
+ * backoff.
+ */
+class CircuitBreaker {
+ public:
+  // Whether a call can run the command, PROBE being the only call let through
+  // while the breaker is half open.
+  enum class Admission { REJECTED, ALLOWED, PROBE };
+
+  /**
+   * @param command The command line of the command, used in the logs.
+   */
+  explicit CircuitBreaker(const std::string& command);
+
+  /**
+   * Check whether a call can run the command now.
+   *
+   * @param options The settings of the breaker of the command.
+   */
+  Admission admit(const BreakerOptions& options);
+
+  /**
+   * Record the result of a call admitted by `admit`.
+   *
+   * @param succeeded true if the command succeeded, false if it failed or
+   *   timed out.
+   */
+  void record(const BreakerOptions& options, Admission admission,
+              bool succeeded);
+
+  /**
+   * Give back the admission of a call which did not run the command, e.g.,
+   * because it was rejected by the scheduler, so that the next call probes.
+   */
+  void release(Admission admission);
+
+  /**
+   * @return true if the breaker is open or half open.
+   */
+  bool isOpen() const;
+
+  /**
+   * Get the breaker of a command, creating it on first use. Breakers are
+   * shared by all the module instances running the same command line and
+   * live as long as the agent.
+   */
+  static CircuitBreaker& get(const Command& command);
+
+ private:
+  enum class State { CLOSED, OPEN, HALF_OPEN };
+
+  void open(const BreakerOptions& options, const Duration& backoff);
+
+  const std::string m_command;
+  State m_state = State::CLOSED;
+  size_t m_failures = 0;
+  Duration m_backoff = Duration::zero();
+  process::Time m_retryAt;
+  mutable std::mutex m_mutex;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __CIRCUIT_BREAKER_HPP__
@@ -0,0 +1,338 @@
+#include "CoProcess.hpp"
+#include "CommandCgroup.hpp"
+#include "CommandRunner.hpp"
+
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <process/defer.hpp>
+#include <process/dispatch.hpp>
+#include <process/id.hpp>
+#include <process/io.hpp>
+#include <process/owned.hpp>
+#include <process/process.hpp>
+#include <process/subprocess.hpp>
+
+#include <stout/foreach.hpp>
+#include <stout/numify.hpp>
+#include <stout/os.hpp>
+#include <stout/stringify.hpp>
+
+namespace criteo {
+namespace mesos {
+
+using std::string;
+using namespace process;
+
+// A response frame bigger than this is considered as garbage.
+const size_t MAX_FRAME_SIZE = 64 * 1024 * 1024;
+// The header is the decimal length of the payload, it cannot be bigger.
+const size_t MAX_FRAME_HEADER_SIZE = 20;
+const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+class CoProcessProcess : public Process<CoProcessProcess> {
+ public:
+  explicit CoProcessProcess(const string& command)
+      : ProcessBase(process::ID::generate("command-coprocess")),
+        m_command(command),
+        m_busy(false),
+        m_workerExited(false) {}
+
+  Future<Try<string>> send(const string& input, unsigned long timeout,
+                           size_t maxOutputBytes, bool debug,
+                           const logging::Metadata& loggingMetadata,
+                           CommandMetrics* metrics);
+
+ protected:
+  virtual void finalize();
+
+ private:
+  struct Request {
+    string input;
+    unsigned long timeout;
+    size_t maxOutputBytes;
+    bool debug;
+    logging::Metadata loggingMetadata;
+    CommandMetrics* metrics;
+    Owned<Promise<Try<string>>> promise;
+  };
+
+  void next();
+  void answered(const Future<string>& response);
+  void exited(pid_t pid);
+
+  Try<Nothing> start(CommandMetrics* metrics);
+  Future<Nothing> kill(const logging::Metadata& loggingMetadata,
+                       CommandMetrics* metrics);
+  Future<string> readFrame(size_t maxSize);
+
+  const string m_command;
+
+  // True while a request is being processed by the worker.
+  bool m_busy;
+  std::deque<Request> m_requests;
+
+  Option<Subprocess> m_worker;
+  bool m_workerExited;
+  // Bytes read from the worker but not consumed as a frame yet.
+  string m_buffer;
+};
+
+Future<Try<string>> CoProcessProcess::send(
+    const string& input, unsigned long timeout, size_t maxOutputBytes,
+    bool debug, const logging::Metadata& loggingMetadata,
+    CommandMetrics* metrics) {
+  Request request = {input,
+                     timeout,
+                     maxOutputBytes,
+                     debug,
+                     loggingMetadata,
+                     metrics,
+                     Owned<Promise<Try<string>>>(new Promise<Try<string>>())};
+  Future<Try<string>> future = request.promise->future();
+  m_requests.push_back(request);
+
+  if (!m_busy) next();
+  return future;
+}
+
+void CoProcessProcess::next() {
+  if (m_requests.empty()) {
+    m_busy = false;
+    return;
+  }
+  m_busy = true;
+
+  const Request& request = m_requests.front();
+
+  if (m_worker.isNone()) {
+    Try<Nothing> started = start(request.metrics);
+    if (started.isError()) {
+      string errorMessage = "Error launching external command \"" +
+                            m_command + "\": " + started.error();
+      TASK_LOG(ERROR, request.loggingMetadata) << errorMessage;
+      request.promise->set(Try<string>(Error(errorMessage)));
+      m_requests.pop_front();
+      next();
+      return;
+    }
+  }
+
+  if (request.debug) {
+    TASK_LOG(INFO, request.loggingMetadata)
+        << "Sending frame to persistent command \"" << m_command
+        << "\": " << request.input;
+  }
+
+  string frame = stringify(request.input.size()) + "\n" + request.input;
+  string command = m_command;
+  CommandMetrics* metrics = request.metrics;
+  size_t maxSize = request.maxOutputBytes != 0
+                       ? std::min(request.maxOutputBytes, MAX_FRAME_SIZE)
+                       : MAX_FRAME_SIZE;
+
+  Future<string> response =
+      io::write(m_worker->in().get(), frame)
+          .then(defer(self(), &Self::readFrame, maxSize))
+          .after(Seconds(request.timeout),
+                 [command, metrics](Future<string> future) -> Future<string> {
+                   future.discard();
+                   if (metrics != nullptr) ++metrics->timeouts;
+                   return Failure("Command \"" + command +
+                                  "\" took too long to execute.");
+                 });
+  if (metrics != nullptr) metrics->runTime.time(response);
+  response.onAny(defer(self(), &Self::answered, lambda::_1));
+}
+
+void CoProcessProcess::answered(const Future<string>& response) {
+  Request request = m_requests.front();
+  m_requests.pop_front();
+  CommandCgroup::instance().account(request.metrics);
+
+  if (response.isReady()) {
+    if (request.debug) {
+      TASK_LOG(INFO, request.loggingMetadata)
+          << "Received frame from persistent command \"" << m_command
+          << "\": " << response.get();
+    }
+    request.promise->set(Try<string>(response.get()));
+    next();
+    return;
+  }
+
+  string error = response.isFailed() ? response.failure() : "discarded";
+  TASK_LOG(ERROR, request.loggingMetadata)
+      << "Persistent command \"" << m_command << "\" failed: " << error;
+  request.promise->fail(error);
+
+  // The worker is now in an unknown state (hung, dead or in the middle of a
+  // frame) so we restart it before processing the next request.
+  kill(request.loggingMetadata, request.metrics)
+      .onAny(defer(self(), &Self::next));
+}
+
+void CoProcessProcess::exited(pid_t pid) {
+  if (m_worker.isNone() || m_worker->pid() != pid) return;
+
+  LOG(WARNING) << "Persistent command \"" << m_command << "\" (" << pid
+               << ") exited";
+  m_workerExited = true;
+
+  // A pending read will fail on EOF and restart the worker. Otherwise we can
+  // release it right away.
+  if (!m_busy) {
+    m_worker = None();
+    m_buffer.clear();
+  }
+}
+
+// The worker is accounted for in the cgroup of the method starting it.
+Try<Nothing> CoProcessProcess::start(CommandMetrics* metrics) {
+  std::vector<Subprocess::ParentHook> hooks;
+  if (CommandCgroup::instance().isEnabled()) {
+    hooks.push_back(Subprocess::ParentHook([metrics](pid_t pid) {
+      CommandCgroup::instance().confine(pid, metrics);
+      return Try<Nothing>(Nothing());
+    }));
+  }
+
+  Try<Subprocess> worker =
+      subprocess(m_command, std::vector<string>{m_command}, Subprocess::PIPE(),
+                 Subprocess::PIPE(), Subprocess::FD(STDERR_FILENO), nullptr,
+                 None(), None(), hooks);
+  if (worker.isError()) return Error(worker.error());
+
+  Try<Nothing> nonblock = os::nonblock(worker->out().get());
+  if (nonblock.isError()) {
+    os::killtree(worker->pid(), SIGKILL);
+    return Error("Failed to set output non-blocking: " + nonblock.error());
+  }
+
+  m_worker = worker.get();
+  m_workerExited = false;
+  m_buffer.clear();
+
+  pid_t pid = worker->pid();
+  worker->status().onAny(defer(
+      self(), [this, pid](const Future<Option<int>>&) { exited(pid); }));
+  return Nothing();
+}
+
+Future<Nothing> CoProcessProcess::kill(
+    const logging::Metadata& loggingMetadata, CommandMetrics* metrics) {
+  if (m_worker.isNone()) return Nothing();
+
+  Subprocess worker = m_worker.get();
+  bool exited = m_workerExited;
+  m_worker = None();
+  m_buffer.clear();
+
+  // The pid may already have been reused if the worker has been reaped.
+  if (exited) return Nothing();
+
+  // The copy of the subprocess keeps the pipes open until the worker is gone.
+  return terminateProcessTree(worker.pid(), loggingMetadata, metrics)
+      .then([worker](bool) { return Nothing(); });
+}
+
+Future<string> CoProcessProcess::readFrame(size_t maxSize) {
+  if (m_worker.isNone()) {
+    return Failure("Command \"" + m_command + "\" is not running");
+  }
+
+  size_t headerEnd = m_buffer.find('\n');
+  if (headerEnd != string::npos) {
+    Try<size_t> length = numify<size_t>(m_buffer.substr(0, headerEnd));
+    if (length.isError()) {
+      return Failure("Malformed frame header from command \"" + m_command +
+                     "\": " + length.error());
+    }
+    if (length.get() > maxSize) {
+      return Failure("Frame from command \"" + m_command + "\" is " +
+                     stringify(length.get()) +
+                     " bytes, more than the limit of " + stringify(maxSize));
+    }
+    if (m_buffer.size() - headerEnd - 1 >= length.get()) {
+      string payload = m_buffer.substr(headerEnd + 1, length.get());
+      m_buffer.erase(0, headerEnd + 1 + length.get());
+      return payload;
+    }
+  } else if (m_buffer.size() > MAX_FRAME_HEADER_SIZE) {
+    return Failure("Malformed frame header from command \"" + m_command +
+                   "\"");
+  }
+
+  std::shared_ptr<std::vector<char>> chunk(
+      new std::vector<char>(READ_CHUNK_SIZE));
+  return io::read(m_worker->out().get(), chunk->data(), chunk->size())
+      .then(defer(self(),
+                  [this, chunk, maxSize](size_t size) -> Future<string> {
+                    if (size == 0) {
+                      return Failure("Command \"" + m_command +
+                                     "\" closed its output");
+                    }
+                    m_buffer.append(chunk->data(), size);
+                    return readFrame(maxSize);
+                  }));
+}
+
+void CoProcessProcess::finalize() {
+  foreach (const Request& request, m_requests) {
+    request.promise->fail("Persistent command \"" + m_command +
+                          "\" is terminating");
+  }
+  m_requests.clear();
+
+  if (m_worker.isSome() && !m_workerExited) {
+    os::killtree(m_worker->pid(), SIGTERM);
+  }
+  m_worker = None();
+}
+
+CoProcess::CoProcess(const string& command)
+    : m_process(new CoProcessProcess(command)) {
+  spawn(m_process);
+}
+
+CoProcess::~CoProcess() {
+  terminate(m_process);
+  wait(m_process);
+  delete m_process;
+}
+
+Future<Try<string>> CoProcess::send(const string& input, unsigned long timeout,
+                                    size_t maxOutputBytes, bool debug,
+                                    const logging::Metadata& loggingMetadata,
+                                    CommandMetrics* metrics) {
+  return dispatch(m_process, &CoProcessProcess::send, input, timeout,
+                  maxOutputBytes, debug, loggingMetadata, metrics);
+}
+
+CoProcess& CoProcess::get(const Command& command) {
+  static std::mutex mutex;
+  // Intentionally leaked: co-processes are shared by all module instances and
+  // libprocess cannot be used safely while static objects are destroyed.
+  static std::map<string, CoProcess*>* coProcesses =
+      new std::map<string, CoProcess*>();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = coProcesses->find(command.command());
+  if (it == coProcesses->end()) {
+    it = coProcesses
+             ->emplace(command.command(), new CoProcess(command.command()))
+             .first;
+  }
+  return *it->second;
+}
+
+}  // namespace mesos
+}  // namespace criteo
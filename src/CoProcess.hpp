@@ -0,0 +1,73 @@
+#ifndef __CO_PROCESS_HPP__
+#define __CO_PROCESS_HPP__
+
+#include <string>
+
+#include <process/future.hpp>
+#include <stout/try.hpp>
+
+#include "Command.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+
+namespace criteo {
+namespace mesos {
+
+// Forward declaration
+class CoProcessProcess;
+
+/**
+ * Long-lived external command receiving its inputs and sending back its
+ * outputs as frames on stdin/stdout instead of being forked for each call.
+ *
+ * A frame is the decimal length of the payload in bytes, a newline and then
+ * the payload itself, e.g., "5\nHELLO". For each request frame, the command
+ * must write exactly one response frame containing what a oneshot command
+ * would have written in its output file.
+ *
+ * Requests are sent one at a time. If the command does not answer before the
+ * timeout, it receives a SIGTERM and then a SIGKILL like oneshot commands and
+ * it is restarted on the next request. It is also restarted if it crashes or
+ * writes a malformed frame.
+ */
+class CoProcess {
+ public:
+  /**
+   * @param command The path of the command to run.
+   */
+  explicit CoProcess(const std::string& command);
+  ~CoProcess();
+
+  /**
+   * Send one request to the co-process, starting it if not running.
+   *
+   * @param input The serialized input sent as request frame.
+   * @param timeout The time in seconds for the command to answer.
+   * @param maxOutputBytes The size above which the response fails the
+   *   request and restarts the co-process, 0 for the default limit.
+   * @param debug true to log the frames of this request, false otherwise.
+   * @param loggingMetadata The metadata like task id prepended to logs.
+   * @param metrics The metrics of the method sending the request, if any.
+   *
+   * @return Future on the payload of the response frame.
+   */
+  process::Future<Try<std::string>> send(
+      const std::string& input, unsigned long timeout, size_t maxOutputBytes,
+      bool debug, const logging::Metadata& loggingMetadata,
+      CommandMetrics* metrics = nullptr);
+
+  /**
+   * Get the co-process running the given command, creating it on first use.
+   * Co-processes are shared by all the module instances and live as long as
+   * the agent, the debug flag of each instance applying to its own requests.
+   */
+  static CoProcess& get(const Command& command);
+
+ private:
+  CoProcessProcess* m_process;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __CO_PROCESS_HPP__
@@ -1,7 +1,9 @@
 #ifndef COMMAND_HPP
 #define COMMAND_HPP
 
+#include <stddef.h>
 #include <string>
+#include <vector>
 
 namespace criteo {
 namespace mesos {
@@ -10,30 +12,148 @@ namespace mesos {
 // in configuration.
 const unsigned long DEFAULT_COMMAND_TIMEOUT = 30;
 const float DEFAULT_COMMAND_FREQUENCE = 30;
+// The error output is only used in logs and error messages.
+const size_t DEFAULT_MAX_ERROR_BYTES = 64 * 1024;
+
+/**
+ * @brief How the module talks to the external command.
+ *
+ * ONESHOT forks a new process for each call while PERSISTENT keeps a single
+ * long-lived process fed with length-prefixed frames on its stdin/stdout.
+ */
+enum class CommandMode { ONESHOT, PERSISTENT };
+
+/**
+ * @brief How inputs and outputs of a oneshot command are exchanged.
+ *
+ * FILE uses temporary files in /tmp while MEMFD uses anonymous in-memory files
+ * passed to the command as /dev/fd/N paths so that nothing touches the
+ * filesystem.
+ */
+enum class CommandTransport { FILE, MEMFD };
+
+/**
+ * @brief How inputs and outputs of a command are serialized.
+ *
+ * JSON is the historical format. PROTOBUF exchanges protobuf messages in
+ * their binary wire format, see proto/command_modules.proto.
+ */
+enum class CommandFormat { JSON, PROTOBUF };
+
+/**
+ * @brief The BreakerOptions struct contains the settings of the circuit
+ * breaker of a command (see CircuitBreaker).
+ */
+struct BreakerOptions {
+  // Consecutive failures or timeouts opening the breaker, 0 to disable it.
+  size_t failures = 0;
+
+  // Seconds before the first probe once the breaker is open, doubled after
+  // each failed probe up to the maximum.
+  double backoff = 1;
+  double maxBackoff = 60;
+
+  // Error of the calls short-circuited while the breaker is open, a default
+  // message if empty.
+  std::string error;
+
+  bool operator==(const BreakerOptions& that) const {
+    return failures == that.failures && backoff == that.backoff &&
+           maxBackoff == that.maxBackoff && error == that.error;
+  }
+};
 
 /**
  * @brief The Command class represents a command, i.e., a command to be run and
  * a timeout before the command is terminated.
+ *
+ * A command can fan out to parallel commands sharing its settings, which are
+ * run concurrently with it for the same input (see CommandRunner).
  */
 class Command {
  public:
   Command(const std::string& command)
-      : m_cmd(command), m_timeout(DEFAULT_COMMAND_TIMEOUT) {}
+      : m_cmd(command),
+        m_timeout(DEFAULT_COMMAND_TIMEOUT),
+        m_mode(CommandMode::ONESHOT),
+        m_transport(CommandTransport::FILE),
+        m_format(CommandFormat::JSON),
+        m_maxOutputBytes(0),
+        m_maxErrorBytes(DEFAULT_MAX_ERROR_BYTES) {}
   Command(const std::string& command, unsigned long timeout)
-      : m_cmd(command), m_timeout(timeout) {}
+      : m_cmd(command),
+        m_timeout(timeout),
+        m_mode(CommandMode::ONESHOT),
+        m_transport(CommandTransport::FILE),
+        m_format(CommandFormat::JSON),
+        m_maxOutputBytes(0),
+        m_maxErrorBytes(DEFAULT_MAX_ERROR_BYTES) {}
 
   bool operator==(const Command& that) const {
-    return m_cmd == that.m_cmd && m_timeout == that.m_timeout;
+    return m_cmd == that.m_cmd && m_timeout == that.m_timeout &&
+           m_mode == that.m_mode && m_transport == that.m_transport &&
+           m_format == that.m_format &&
+           m_maxOutputBytes == that.m_maxOutputBytes &&
+           m_maxErrorBytes == that.m_maxErrorBytes &&
+           m_breaker == that.m_breaker &&
+           m_parallelCommands == that.m_parallelCommands;
   }
 
   inline const std::string& command() const { return m_cmd; }
   inline unsigned long timeout() const { return m_timeout; }
+  inline CommandMode mode() const { return m_mode; }
+  inline bool isPersistent() const { return m_mode == CommandMode::PERSISTENT; }
+  inline CommandTransport transport() const { return m_transport; }
+  inline CommandFormat format() const { return m_format; }
+  // Size above which the output fails the command, 0 for no limit.
+  inline size_t maxOutputBytes() const { return m_maxOutputBytes; }
+  // Size above which the error output is truncated, 0 for no limit.
+  inline size_t maxErrorBytes() const { return m_maxErrorBytes; }
+  inline const BreakerOptions& breaker() const { return m_breaker; }
+  inline bool hasBreaker() const { return m_breaker.failures > 0; }
+  inline const std::vector<std::string>& parallelCommands() const {
+    return m_parallelCommands;
+  }
+  inline bool isFanOut() const { return !m_parallelCommands.empty(); }
+
+  /**
+   * @return This command and its parallel commands as single commands.
+   */
+  std::vector<Command> fanOut() const {
+    Command command(*this);
+    command.m_parallelCommands.clear();
+
+    std::vector<Command> commands(1, command);
+    for (const std::string& parallelCommand : m_parallelCommands) {
+      command.m_cmd = parallelCommand;
+      commands.push_back(command);
+    }
+    return commands;
+  }
 
   void setTimeout(const unsigned long timeout) { m_timeout = timeout; }
+  void setMode(const CommandMode mode) { m_mode = mode; }
+  void setTransport(const CommandTransport transport) {
+    m_transport = transport;
+  }
+  void setFormat(const CommandFormat format) { m_format = format; }
+  void setMaxOutputBytes(const size_t bytes) { m_maxOutputBytes = bytes; }
+  void setMaxErrorBytes(const size_t bytes) { m_maxErrorBytes = bytes; }
+  void setBreaker(const BreakerOptions& breaker) { m_breaker = breaker; }
+  void addParallelCommand(const std::string& command) {
+    m_parallelCommands.push_back(command);
+  }
 
  private:
   std::string m_cmd;
   unsigned long m_timeout;
+  CommandMode m_mode;
+  CommandTransport m_transport;
+  CommandFormat m_format;
+  size_t m_maxOutputBytes;
+  size_t m_maxErrorBytes;
+  BreakerOptions m_breaker;
+  std::vector<std::string> m_parallelCommands;
 };
 
 class RecurrentCommand : public Command {
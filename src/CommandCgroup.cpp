@@ -0,0 +1,186 @@
+#include "CommandCgroup.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include <stout/error.hpp>
+#include <stout/numify.hpp>
+#include <stout/os/exists.hpp>
+#include <stout/os/mkdir.hpp>
+#include <stout/os/read.hpp>
+#include <stout/os/write.hpp>
+#include <stout/path.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+namespace criteo {
+namespace mesos {
+
+using std::string;
+
+const size_t DEFAULT_CPU_SHARES = 1024;
+// Period of the CPU quota in microseconds, the default one of the kernel.
+const int64_t CFS_PERIOD_US = 100000;
+// Smallest quota accepted by the kernel.
+const int64_t MIN_CFS_QUOTA_US = 1000;
+
+static Try<Nothing> write(const string& directory, const string& file,
+                          const string& value) {
+  Try<Nothing> written = os::write(path::join(directory, file), value);
+  if (written.isError()) {
+    return Error("Unable to write \"" + value + "\" to " +
+                 path::join(directory, file) + ": " + written.error());
+  }
+  return Nothing();
+}
+
+// Copy a setting of the root of a controller.
+static Try<Nothing> inherit(const string& root, const string& directory,
+                            const string& file) {
+  Try<string> value = os::read(path::join(root, file));
+  if (value.isError()) return Error(value.error());
+  return write(directory, file, strings::trim(value.get()));
+}
+
+string CommandCgroup::path(const string& controller) const {
+  return path::join(m_options->hierarchy, controller, m_options->name);
+}
+
+Try<Nothing> CommandCgroup::configure(const CgroupOptions& options) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_options = options;
+  m_groups.clear();
+
+  // The limits are set at the same time as the cgroup since the cpu and
+  // cpuacct controllers are usually mounted together.
+  string cpu = path("cpu");
+  Try<Nothing> result = os::mkdir(cpu);
+  if (result.isSome()) result = os::mkdir(path("cpuacct"));
+  if (result.isSome()) {
+    result = write(cpu, "cpu.shares",
+                   stringify(options.cpuShares.getOrElse(DEFAULT_CPU_SHARES)));
+  }
+  if (result.isSome()) {
+    result = write(cpu, "cpu.cfs_period_us", stringify(CFS_PERIOD_US));
+  }
+  if (result.isSome()) {
+    string quota = "-1";
+    if (options.cpus.isSome()) {
+      int64_t us = llround(options.cpus.get() * CFS_PERIOD_US);
+      quota = stringify(std::max(us, MIN_CFS_QUOTA_US));
+    }
+    result = write(cpu, "cpu.cfs_quota_us", quota);
+  }
+
+  // The memory and cpuset controllers are only used once limited.
+  string memory = path("memory");
+  m_memory = options.memoryLimit.isSome() || os::exists(memory);
+  if (result.isSome() && m_memory) {
+    result = os::mkdir(memory);
+    if (result.isSome()) {
+      result = write(memory, "memory.limit_in_bytes",
+                     options.memoryLimit.isSome()
+                         ? stringify(options.memoryLimit.get())
+                         : "-1");
+    }
+  }
+
+  string cpuset = path("cpuset");
+  m_cpuset = options.cpuset.isSome() || os::exists(cpuset);
+  if (result.isSome() && m_cpuset) {
+    // A cpuset must have memory nodes before any process can join it.
+    string root = path::join(options.hierarchy, "cpuset");
+    result = os::mkdir(cpuset);
+    if (result.isSome()) result = inherit(root, cpuset, "cpuset.mems");
+    if (result.isSome()) {
+      result = options.cpuset.isSome()
+                   ? write(cpuset, "cpuset.cpus", options.cpuset.get())
+                   : inherit(root, cpuset, "cpuset.cpus");
+    }
+  }
+
+  if (result.isError()) {
+    m_options = None();
+    return Error("Unable to configure the cgroup \"" + options.name +
+                 "\" of the commands: " + result.error());
+  }
+  LOG(INFO) << "Running the commands in the cgroup \"" << options.name << "\"";
+  return Nothing();
+}
+
+bool CommandCgroup::isEnabled() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_options.isSome();
+}
+
+Try<Nothing> CommandCgroup::assign(pid_t pid, const Option<string>& group) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_options.isNone()) return Error("The cgroup is not configured");
+
+  string procs = stringify(pid);
+  // The cpu controller goes first since it may be the same as cpuacct.
+  Try<Nothing> result = write(path("cpu"), "cgroup.procs", procs);
+
+  string cpuacct = path("cpuacct");
+  if (group.isSome()) {
+    cpuacct = path::join(cpuacct, group.get());
+    if (result.isSome() && !m_groups.contains(group.get())) {
+      result = os::mkdir(cpuacct);
+      if (result.isSome()) m_groups.insert(group.get());
+    }
+  }
+  if (result.isSome()) result = write(cpuacct, "cgroup.procs", procs);
+  if (result.isSome() && m_memory) {
+    result = write(path("memory"), "cgroup.procs", procs);
+  }
+  if (result.isSome() && m_cpuset) {
+    result = write(path("cpuset"), "cgroup.procs", procs);
+  }
+  return result;
+}
+
+Try<Duration> CommandCgroup::cpuTime(const string& group) const {
+  string usage;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_options.isNone()) return Error("The cgroup is not configured");
+    usage = path::join(path("cpuacct"), group, "cpuacct.usage");
+  }
+
+  Try<string> content = os::read(usage);
+  if (content.isError()) return Error(content.error());
+  Try<uint64_t> nanoseconds = numify<uint64_t>(strings::trim(content.get()));
+  if (nanoseconds.isError()) return Error(nanoseconds.error());
+  return Nanoseconds(nanoseconds.get());
+}
+
+void CommandCgroup::confine(pid_t pid, CommandMetrics* metrics) {
+  if (!isEnabled()) return;
+
+  Option<string> group;
+  if (metrics != nullptr) group = metrics->name;
+  Try<Nothing> assigned = assign(pid, group);
+  if (assigned.isError()) {
+    LOG(WARNING) << "Unable to confine process " << pid << ": "
+                 << assigned.error();
+  }
+}
+
+void CommandCgroup::account(CommandMetrics* metrics) {
+  if (metrics == nullptr || !isEnabled()) return;
+
+  // The child cgroup does not exist if the commands could not be confined.
+  Try<Duration> time = cpuTime(metrics->name);
+  if (time.isSome()) metrics->cpuTime = time->secs();
+}
+
+CommandCgroup& CommandCgroup::instance() {
+  // Intentionally leaked so that it outlives every module instance.
+  static CommandCgroup* cgroup = new CommandCgroup();
+  return *cgroup;
+}
+
+}  // namespace mesos
+}  // namespace criteo
@@ -0,0 +1,92 @@
+#ifndef __COMMAND_CGROUP_HPP__
+#define __COMMAND_CGROUP_HPP__
+
+#include <sys/types.h>
+
+#include <mutex>
+#include <string>
+
+#include <stout/duration.hpp>
+#include <stout/hashset.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+#include "Metrics.hpp"
+#include "Options.hpp"
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * @brief The CommandCgroup class confines the commands in a dedicated cgroup
+ * so that a runaway command does not slow the agent down.
+ *
+ * The cgroup is created in the cpu, cpuacct, memory and cpuset controllers
+ * of a cgroup v1 hierarchy, the last two only if they are limited. The
+ * commands of each method are moved into a child cgroup of the cpuacct
+ * controller, `<name>/<module>/<method>`, from which their CPU time is
+ * reported. The spawn server runs in the cgroup itself so that the commands
+ * it forks are confined before being moved.
+ */
+class CommandCgroup {
+ public:
+  /**
+   * Create the cgroup or update its limits, a limit no longer set being
+   * reset.
+   */
+  Try<Nothing> configure(const CgroupOptions& options);
+
+  /**
+   * @return true if the commands are confined.
+   */
+  bool isEnabled() const;
+
+  /**
+   * Move a process into the cgroup of the commands of a method.
+   *
+   * @param group The child cgroup accounting for the CPU time of the process,
+   *   None to leave it in the cgroup itself.
+   */
+  Try<Nothing> assign(pid_t pid, const Option<std::string>& group);
+
+  /**
+   * @return The CPU time used by the processes of a child cgroup.
+   */
+  Try<Duration> cpuTime(const std::string& group) const;
+
+  /**
+   * Move a command into the cgroup of the method running it, logging a
+   * warning if it cannot be confined. Does nothing if not enabled.
+   *
+   * @param metrics The metrics of the method, nullptr to leave the command in
+   *   the cgroup itself.
+   */
+  void confine(pid_t pid, CommandMetrics* metrics);
+
+  /**
+   * Update the CPU time of the commands of a method in its metrics.
+   */
+  void account(CommandMetrics* metrics);
+
+  /**
+   * Get the cgroup shared by all the module instances.
+   */
+  static CommandCgroup& instance();
+
+ private:
+  // Path of the cgroup in a controller.
+  std::string path(const std::string& controller) const;
+
+  Option<CgroupOptions> m_options;
+  bool m_memory = false;
+  bool m_cpuset = false;
+  // Child cgroups created in the cpuacct controller.
+  hashset<std::string> m_groups;
+  mutable std::mutex m_mutex;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __COMMAND_CGROUP_HPP__
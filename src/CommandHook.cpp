@@ -2,85 +2,359 @@
 #include "CommandRunner.hpp"
 #include "Helpers.hpp"
 #include "Logger.hpp"
+#include "Serialization.hpp"
+#include "Span.hpp"
+
+#include <glog/logging.h>
+#include <process/clock.hpp>
+#include <stout/foreach.hpp>
+#include <stout/json.hpp>
+#include <stout/stringify.hpp>
 
 namespace criteo {
 namespace mesos {
 
+using process::Future;
 using std::string;
 
+const string DEFAULT_NAME = "hook";
+
+// Key of an input in the cache of a decorator: the values of the key fields.
+// They are kept whole, not hashed, since a collision would return the output
+// of another executor.
+static string cacheKey(const std::vector<string>& keyFields,
+                       const InputBuilder& input) {
+  JSON::Object json = input.json();
+  string values;
+  for (const string& field : keyFields) {
+    Result<JSON::Value> value = json.find<JSON::Value>(field);
+    values += value.isSome() ? stringify(value.get()) : "null";
+    values += '\n';
+  }
+  return values;
+}
+
+// Format of the input of a command, JSON if there is none since the input is
+// still recorded in the trace.
+static CommandFormat formatOf(const Option<Command>& command) {
+  return command.isSome() ? command->format() : CommandFormat::JSON;
+}
+
+// Key of an executor in the speculative runs.
+static string executorKey(const ::mesos::ExecutorInfo& executorInfo) {
+  return executorInfo.framework_id().value() + "/" +
+         executorInfo.executor_id().value();
+}
+
+// Run a decorator command, or use the output of the one already started for
+// the same input, reusing the output of a previous call with the same key if
+// the decorator has a cache.
+//
+// If the output is not ready by the deadline, the decorator leaves its target
+// unchanged: the output is only logged, and cached, once it arrives.
+template <class Proto>
+static Result<Proto> runDecorator(
+    const Command& command, const InputBuilder& input,
+    const Option<Future<Try<string>>>& started,
+    const std::shared_ptr<DecoratorCache<Proto>>& cache,
+    const Option<Duration>& deadline, bool isDebugMode,
+    const logging::Metadata& metadata, CommandMetrics* metrics) {
+  string key;
+  if (cache) {
+    key = cacheKey(cache->keyFields, input);
+    Option<Proto> cached = cache->outputs.get(key);
+    if (cached.isSome()) {
+      ++metrics->cacheHits;
+      if (isDebugMode) TASK_LOG(INFO, metadata) << "Reusing cached output";
+      return cached.get();
+    }
+    ++metrics->cacheMisses;
+  }
+
+  Future<Try<string>> output =
+      started.isSome()
+          ? started.get()
+          : CommandRunner(isDebugMode, metadata, metrics)
+                .asyncRun(command, input.str(), CommandPriority::HIGH);
+
+  auto parse = [command, cache, key, metrics,
+                metadata](const Try<string>& output) {
+    if (output.isError()) return Result<Proto>(Error(output.error()));
+
+    Span decoding("decode", metadata);
+    Result<Proto> result = timed(metrics->parseTime, [&command, &output]() {
+      return parseOutput<Proto>(command, output.get());
+    });
+    decoding.end();
+    if (cache && result.isSome()) cache->outputs.put(key, result.get());
+    return result;
+  };
+
+  if (deadline.isSome() && !output.await(deadline.get())) {
+    ++metrics->deadlineMisses;
+    TASK_LOG(WARNING, metadata) << "No output after " << deadline.get()
+                                << ", leaving it unchanged";
+    output.onAny([parse, metadata](const Future<Try<string>>& output) {
+      if (!output.isReady()) {
+        TASK_LOG(WARNING, metadata) << "Late command execution error";
+        return;
+      }
+      Result<Proto> result = parse(output.get());
+      if (result.isError()) {
+        TASK_LOG(WARNING, metadata) << "Late output error: " << result.error();
+      } else if (result.isSome()) {
+        TASK_LOG(INFO, metadata) << "Late output ignored: "
+                                 << stringify(JSON::protobuf(result.get()));
+      }
+    });
+    return None();
+  }
+
+  output.await();
+  if (!output.isReady()) {
+    return Error("Command execution error");
+  }
+  return parse(output.get());
+}
+
 CommandHook::CommandHook(const Option<Command>& runTaskLabelCommand,
                          const Option<Command>& executorEnvironmentCommand,
                          const Option<Command>& removeExecutorCommand,
-                         bool isDebugMode)
-    : m_runTaskLabelCommand(runTaskLabelCommand),
-      m_executorEnvironmentCommand(executorEnvironmentCommand),
-      m_removeExecutorCommand(removeExecutorCommand),
-      m_isDebugMode(isDebugMode) {}
+                         bool isDebugMode, const HookOptions& options)
+    : m_settings(std::make_shared<const Settings>(Settings{
+          runTaskLabelCommand, executorEnvironmentCommand,
+          removeExecutorCommand, isDebugMode, options.runTaskLabelDeadline,
+          options.executorEnvironmentDeadline})),
+      m_name(CommandMetrics::instanceName(options.name, DEFAULT_NAME)),
+      m_runTaskLabelMetrics(commandMetrics(runTaskLabelCommand, m_name,
+                                           "slaveRunTaskLabelDecorator")),
+      m_executorEnvironmentMetrics(
+          commandMetrics(executorEnvironmentCommand, m_name,
+                         "slaveExecutorEnvironmentDecorator")),
+      m_removeExecutorMetrics(commandMetrics(
+          removeExecutorCommand, m_name, "slaveRemoveExecutorHook")) {
+  if (options.runTaskLabelCache.isSome()) {
+    m_runTaskLabelCache.reset(new DecoratorCache<::mesos::Labels>(
+        options.runTaskLabelCache.get()));
+  }
+  if (options.executorEnvironmentCache.isSome()) {
+    m_executorEnvironmentCache.reset(new DecoratorCache<::mesos::Environment>(
+        options.executorEnvironmentCache.get()));
+  }
+
+  if (options.traceFile.isSome()) {
+    Try<std::shared_ptr<TraceRecorder>> recorder =
+        TraceRecorder::open(options.traceFile.get());
+    if (recorder.isError()) {
+      LOG(WARNING) << recorder.error();
+    } else {
+      m_traceRecorder = recorder.get();
+    }
+  }
+}
+
+CommandHook::~CommandHook() {
+  // The watcher may be reloading the hook.
+  m_configurationWatcher.reset();
+}
+
+void CommandHook::reload(const Option<Command>& runTaskLabelCommand,
+                         const Option<Command>& executorEnvironmentCommand,
+                         const Option<Command>& removeExecutorCommand,
+                         bool isDebugMode, const HookOptions& options) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Settings settings = *m_settings;
+  reloadOption(&settings.runTaskLabel, runTaskLabelCommand,
+               "hook_slave_run_task_label_decorator_command");
+  reloadOption(&settings.executorEnvironment, executorEnvironmentCommand,
+               "hook_slave_executor_environment_decorator_command");
+  reloadOption(&settings.removeExecutor, removeExecutorCommand,
+               "hook_slave_remove_executor_hook_command");
+  settings.isDebugMode = isDebugMode;
+  reloadOption(&settings.runTaskLabelDeadline, options.runTaskLabelDeadline,
+               "hook_slave_run_task_label_decorator_deadline");
+  reloadOption(&settings.executorEnvironmentDeadline,
+               options.executorEnvironmentDeadline,
+               "hook_slave_executor_environment_decorator_deadline");
+  m_settings = std::make_shared<const Settings>(settings);
+}
+
+void CommandHook::setConfigurationWatcher(
+    const process::Owned<ConfigurationWatcher>& watcher) {
+  m_configurationWatcher = watcher;
+}
+
+std::shared_ptr<const CommandHook::Settings> CommandHook::settings() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_settings;
+}
 
 Result<::mesos::Labels> CommandHook::slaveRunTaskLabelDecorator(
     const ::mesos::TaskInfo& taskInfo,
     const ::mesos::ExecutorInfo& executorInfo,
     const ::mesos::FrameworkInfo& frameworkInfo,
     const ::mesos::SlaveInfo& slaveInfo) {
-  if (m_runTaskLabelCommand.isNone()) {
-    return None();
-  }
+  std::shared_ptr<const Settings> settings = this->settings();
+  speculateExecutorEnvironment(*settings, executorInfo);
 
-  logging::Metadata metadata = {executorInfo.executor_id().value(),
-                                "slaveRunTaskLabelDecorator"};
-
-  JSON::Object inputsJson;
-  inputsJson.values["task_info"] = JSON::protobuf(taskInfo);
-  inputsJson.values["executor_info"] = JSON::protobuf(executorInfo);
-  inputsJson.values["framework_info"] = JSON::protobuf(frameworkInfo);
-  inputsJson.values["slave_info"] = JSON::protobuf(slaveInfo);
-  Try<string> output =
-      CommandRunner(m_isDebugMode, metadata)
-          .run(m_runTaskLabelCommand.get(), stringify(inputsJson));
+  InputBuilder input(formatOf(settings->runTaskLabel));
+  input.add(InputField::TASK_INFO, taskInfo)
+      .add(InputField::EXECUTOR_INFO, executorInfo)
+      .add(InputField::FRAMEWORK_INFO, frameworkInfo)
+      .add(InputField::SLAVE_INFO, slaveInfo);
+  if (m_traceRecorder) {
+    m_traceRecorder->record("slaveRunTaskLabelDecorator", input.json());
+  }
 
-  if (output.isError()) {
-    return Error(output.error());
+  if (settings->runTaskLabel.isNone()) {
+    return None();
   }
 
-  return jsonToProtobuf<::mesos::Labels>(output.get());
+  Span call = Span::trace("slaveRunTaskLabelDecorator",
+                          {executorInfo.executor_id().value(),
+                           "slaveRunTaskLabelDecorator"});
+
+  const Command& command = settings->runTaskLabel.get();
+  return runDecorator(command, input, None(), m_runTaskLabelCache,
+                      settings->runTaskLabelDeadline, settings->isDebugMode,
+                      call.metadata(), m_runTaskLabelMetrics);
 }
 
 Result<::mesos::Environment> CommandHook::slaveExecutorEnvironmentDecorator(
     const ::mesos::ExecutorInfo& executorInfo) {
-  if (m_executorEnvironmentCommand.isNone()) {
+  std::shared_ptr<const Settings> settings = this->settings();
+  InputBuilder input(formatOf(settings->executorEnvironment));
+  input.add(InputField::EXECUTOR_INFO, executorInfo);
+  if (m_traceRecorder) {
+    m_traceRecorder->record("slaveExecutorEnvironmentDecorator", input.json());
+  }
+
+  if (settings->executorEnvironment.isNone()) {
     return None();
   }
 
-  logging::Metadata metadata = {executorInfo.executor_id().value(),
-                                "slaveExecutorEnvironmentDecorator"};
+  Span call = Span::trace("slaveExecutorEnvironmentDecorator",
+                          {executorInfo.executor_id().value(),
+                           "slaveExecutorEnvironmentDecorator"});
 
-  JSON::Object inputsJson;
-  inputsJson.values["executor_info"] = JSON::protobuf(executorInfo);
-  Try<string> output =
-      CommandRunner(m_isDebugMode, metadata)
-          .run(m_executorEnvironmentCommand.get(), stringify(inputsJson));
+  const Command& command = settings->executorEnvironment.get();
 
-  if (output.isError()) {
-    return Error(output.error());
+  Option<Future<Try<string>>> started;
+  if (settings->executorEnvironmentDeadline.isSome()) {
+    string key = executorKey(executorInfo);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // The executor may have been modified since the task was seen.
+    if (m_speculativeEnvironments.contains(key) &&
+        m_speculativeEnvironments.at(key).input == input.str()) {
+      started = m_speculativeEnvironments.at(key).output;
+    }
+    m_speculativeEnvironments.erase(key);
+    m_launchedExecutors.insert(key);
   }
 
-  return jsonToProtobuf<::mesos::Environment>(output.get());
+  return runDecorator(command, input, started, m_executorEnvironmentCache,
+                      settings->executorEnvironmentDeadline,
+                      settings->isDebugMode, call.metadata(),
+                      m_executorEnvironmentMetrics);
+}
+
+void CommandHook::speculateExecutorEnvironment(
+    const Settings& settings, const ::mesos::ExecutorInfo& executorInfo) {
+  if (settings.executorEnvironment.isNone() ||
+      settings.executorEnvironmentDeadline.isNone()) {
+    return;
+  }
+
+  // Only the first task of an executor triggers its launch.
+  string key = executorKey(executorInfo);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_launchedExecutors.contains(key) ||
+        m_speculativeEnvironments.contains(key)) {
+      return;
+    }
+  }
+
+  const Command& command = settings.executorEnvironment.get();
+  InputBuilder input(command.format());
+  input.add(InputField::EXECUTOR_INFO, executorInfo);
+
+  if (m_executorEnvironmentCache &&
+      m_executorEnvironmentCache->outputs
+          .get(cacheKey(m_executorEnvironmentCache->keyFields, input))
+          .isSome()) {
+    return;
+  }
+
+  // The run is reserved along with the check so that the other tasks of the
+  // executor do not start it too. It is forgotten once its output can no
+  // longer be waited for, in case the executor never launches.
+  string serialized = input.str();
+  std::shared_ptr<process::Promise<Try<string>>> promise =
+      std::make_shared<process::Promise<Try<string>>>();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    process::Time now = process::Clock::now();
+    std::vector<string> expired;
+    foreachpair (const string& executor, const SpeculativeRun& run,
+                 m_speculativeEnvironments) {
+      if (run.expiresAt <= now) expired.push_back(executor);
+    }
+    for (const string& executor : expired) {
+      m_speculativeEnvironments.erase(executor);
+    }
+
+    if (m_launchedExecutors.contains(key) ||
+        m_speculativeEnvironments.contains(key)) {
+      return;
+    }
+    m_speculativeEnvironments[key] = SpeculativeRun{
+        serialized, promise->future(),
+        now + Seconds(command.timeout()) +
+            settings.executorEnvironmentDeadline.get()};
+  }
+
+  // The run started for the task is traced on its own.
+  Span call = Span::trace("speculateExecutorEnvironment",
+                          {executorInfo.executor_id().value(),
+                           "slaveExecutorEnvironmentDecorator"});
+  Future<Try<string>> output =
+      CommandRunner(settings.isDebugMode, call.metadata(),
+                    m_executorEnvironmentMetrics)
+          .asyncRun(command, serialized, CommandPriority::HIGH);
+  output.onAny([call]() { call.end(); });
+  promise->associate(output);
 }
 
 Try<Nothing> CommandHook::slaveRemoveExecutorHook(
     const ::mesos::FrameworkInfo& frameworkInfo,
     const ::mesos::ExecutorInfo& executorInfo) {
-  if (m_removeExecutorCommand.isNone()) return Nothing();
+  std::shared_ptr<const Settings> settings = this->settings();
+  if (settings->executorEnvironmentDeadline.isSome()) {
+    string key = executorKey(executorInfo);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_speculativeEnvironments.erase(key);
+    m_launchedExecutors.erase(key);
+  }
+
+  InputBuilder input(formatOf(settings->removeExecutor));
+  input.add(InputField::FRAMEWORK_INFO, frameworkInfo)
+      .add(InputField::EXECUTOR_INFO, executorInfo);
+  if (m_traceRecorder) {
+    m_traceRecorder->record("slaveRemoveExecutorHook", input.json());
+  }
+
+  if (settings->removeExecutor.isNone()) return Nothing();
 
-  logging::Metadata metadata = {executorInfo.executor_id().value(),
-                                "slaveExecutorEnvironmentDecorator"};
+  Span call = Span::trace(
+      "slaveRemoveExecutorHook",
+      {executorInfo.executor_id().value(), "slaveRemoveExecutorHook"});
 
-  JSON::Object inputsJson;
-  inputsJson.values["framework_info"] = JSON::protobuf(frameworkInfo);
-  inputsJson.values["executor_info"] = JSON::protobuf(executorInfo);
+  const Command& command = settings->removeExecutor.get();
   Try<string> output =
-      CommandRunner(m_isDebugMode, metadata)
-          .run(m_removeExecutorCommand.get(), stringify(inputsJson));
+      CommandRunner(settings->isDebugMode, call.metadata(),
+                    m_removeExecutorMetrics)
+          .run(command, input.str(), CommandPriority::HIGH);
 
   if (output.isError()) {
     return Error(output.error());
@@ -1,18 +1,51 @@
 #ifndef __COMMAND_HOOK_HPP__
 #define __COMMAND_HOOK_HPP__
 
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <Command.hpp>
+#include <ConfigurationWatcher.hpp>
+#include <LruCache.hpp>
+#include <Metrics.hpp>
+#include <Options.hpp>
+#include <TraceRecorder.hpp>
 
 #include <mesos/hook.hpp>
 #include <mesos/module/hook.hpp>
 
+#include <process/future.hpp>
+#include <process/owned.hpp>
+#include <process/time.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
 #include <stout/option.hpp>
+#include <stout/try.hpp>
 
 namespace criteo {
 namespace mesos {
 
+/**
+ * Outputs of a decorator command reused for the inputs with the same key,
+ * the executor info by default since the other fields, e.g., the task id,
+ * differ on every call.
+ */
+template <class Proto>
+struct DecoratorCache {
+  explicit DecoratorCache(const CacheOptions& options)
+      : keyFields(options.keyFields.empty()
+                      ? std::vector<std::string>({"executor_info"})
+                      : options.keyFields),
+        outputs(options.size, options.ttl) {}
+
+  std::vector<std::string> keyFields;
+  LruCache<Proto> outputs;
+};
+
 /**
  * Hook calling external commands to handle hook events.
  *
@@ -35,13 +68,15 @@ class CommandHook : public ::mesos::Hook {
    *   slaveRemoveExecutorHook if provided.
    * @param isDebugMode If true, logs inputs and outputs of the commands,
    *   otherwise logs nothing
+   * @param options The settings of the hook not bound to a command.
    */
   explicit CommandHook(const Option<Command> &runTaskLabelCommand,
                        const Option<Command> &executorEnvironmentCommand,
                        const Option<Command> &removeExecutorCommand,
-                       bool isDebugMode = false);
+                       bool isDebugMode = false,
+                       const HookOptions &options = HookOptions());
 
-  virtual ~CommandHook() {}
+  virtual ~CommandHook();
 
   /*
    * Run an external command computing a list of labels to add to the executor.
@@ -49,6 +84,9 @@ class CommandHook : public ::mesos::Hook {
    * information required to compute the list of labels. The output of the
    * command is a JSON that is parsed into mesos::Labels.
    *
+   * If the environment decorator has a deadline, its command is also started
+   * for the executor of the task unless it is already running.
+   *
    * @param taskInfo The information regarding the tasks.
    * @param executorInfo The information regarding the executor.
    * @param frameworkInfo The information regarding the framework.
@@ -68,6 +106,9 @@ class CommandHook : public ::mesos::Hook {
    * variables. The output of the command is a JSON that is parsed into
    * mesos::Evironment.
    *
+   * The output of the command started by slaveRunTaskLabelDecorator is used
+   * if its input is the same.
+   *
    * @param executorInfo The information regarding the executor.
    * @return The environment variables to add to the executor.
    */
@@ -86,23 +127,84 @@ class CommandHook : public ::mesos::Hook {
       const ::mesos::FrameworkInfo &frameworkInfo,
       const ::mesos::ExecutorInfo &executorInfo) override;
 
-  inline const Option<Command> &runTaskLabelCommand() const {
-    return m_runTaskLabelCommand;
-  }
+  /*
+   * Replace the commands and the deadlines, taking the same arguments as the
+   * constructor. The calls in progress complete with the previous ones.
+   *
+   * Adding or removing a command or a deadline requires a restart and is
+   * ignored with a warning, as well as the caches, the trace and the name.
+   */
+  void reload(const Option<Command> &runTaskLabelCommand,
+              const Option<Command> &executorEnvironmentCommand,
+              const Option<Command> &removeExecutorCommand, bool isDebugMode,
+              const HookOptions &options);
 
-  inline const Option<Command> &executorEnvironmentCommand() const {
-    return m_executorEnvironmentCommand;
+  /*
+   * Keep the watcher reloading the hook, stopping it first on destruction.
+   */
+  void setConfigurationWatcher(
+      const process::Owned<ConfigurationWatcher> &watcher);
+
+  Option<Command> runTaskLabelCommand() { return settings()->runTaskLabel; }
+
+  Option<Command> executorEnvironmentCommand() {
+    return settings()->executorEnvironment;
   }
 
-  inline const Option<Command> &removeExecutorCommand() const {
-    return m_removeExecutorCommand;
+  Option<Command> removeExecutorCommand() {
+    return settings()->removeExecutor;
   }
 
  private:
-  Option<Command> m_runTaskLabelCommand;
-  Option<Command> m_executorEnvironmentCommand;
-  Option<Command> m_removeExecutorCommand;
-  bool m_isDebugMode;
+  // What reload replaces. Each call reads it once so that it runs with a
+  // single configuration.
+  struct Settings {
+    Option<Command> runTaskLabel;
+    Option<Command> executorEnvironment;
+    Option<Command> removeExecutor;
+    bool isDebugMode;
+    Option<Duration> runTaskLabelDeadline;
+    Option<Duration> executorEnvironmentDeadline;
+  };
+
+  struct SpeculativeRun {
+    std::string input;
+    process::Future<Try<std::string>> output;
+    // After the timeout of the command and the deadline of the decorator.
+    process::Time expiresAt;
+  };
+
+  // Start the environment command of an executor ahead of its launch.
+  void speculateExecutorEnvironment(const Settings &settings,
+                                    const ::mesos::ExecutorInfo &executorInfo);
+
+  std::shared_ptr<const Settings> settings();
+
+  // Guarded by m_mutex.
+  std::shared_ptr<const Settings> m_settings;
+
+  // Name of the hook in its metrics.
+  const std::string m_name;
+  CommandMetrics *m_runTaskLabelMetrics;
+  CommandMetrics *m_executorEnvironmentMetrics;
+  CommandMetrics *m_removeExecutorMetrics;
+
+  // Only set if the cache of the decorator is enabled. They are shared with
+  // the outputs arriving after the deadline.
+  std::shared_ptr<DecoratorCache<::mesos::Labels>> m_runTaskLabelCache;
+  std::shared_ptr<DecoratorCache<::mesos::Environment>>
+      m_executorEnvironmentCache;
+
+  // Environment commands started ahead of the launch of their executor, and
+  // executors already launched, by framework and executor id.
+  hashmap<std::string, SpeculativeRun> m_speculativeEnvironments;
+  hashset<std::string> m_launchedExecutors;
+  std::mutex m_mutex;
+
+  // Only set if the events are recorded.
+  std::shared_ptr<TraceRecorder> m_traceRecorder;
+
+  process::Owned<ConfigurationWatcher> m_configurationWatcher;
 };
 }  // namespace mesos
 }  // namespace criteo
@@ -1,12 +1,29 @@
 #include "CommandIsolator.hpp"
 #include "CommandRunner.hpp"
+#include "ContainerCheckpoint.hpp"
+#include "ExecutionEngine.hpp"
 #include "Helpers.hpp"
 #include "Logger.hpp"
+#include "Metrics.hpp"
+#include "Serialization.hpp"
+#include "Span.hpp"
+#include "StatsTable.hpp"
+#include "TraceRecorder.hpp"
+#include "WatchScheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 #include <glog/logging.h>
-#include <process/after.hpp>
+#include <process/defer.hpp>
+#include <process/delay.hpp>
 #include <process/dispatch.hpp>
-#include <process/loop.hpp>
+#include <process/id.hpp>
+#include <process/metrics/counter.hpp>
+#include <process/metrics/metrics.hpp>
+#include <process/owned.hpp>
 #include <process/process.hpp>
 #include <process/time.hpp>
 
@@ -20,21 +37,185 @@ using ::mesos::ContainerID;
 using ::mesos::slave::ContainerConfig;
 using ::mesos::slave::ContainerLaunchInfo;
 using ::mesos::slave::ContainerLimitation;
+using ::mesos::slave::ContainerState;
 
-using process::Break;
-using process::Continue;
-using process::ControlFlow;
 using process::Failure;
 using process::Future;
-using process::loop;
-using process::after;
+
+// Name of the isolator in metrics if not configured.
+const string DEFAULT_NAME = "isolator";
+
+// Number of threads running the watch commands if not configured.
+const size_t DEFAULT_WATCH_THREADS = 4;
+
+// Number of retries of a batch of cleanups if not configured, and delay
+// before the first one, doubled on each retry.
+const size_t DEFAULT_CLEANUP_RETRIES = 3;
+const Duration CLEANUP_RETRY_DELAY = Seconds(1);
+
+// Window of a batch of cleanups if only its size is configured.
+const Duration DEFAULT_CLEANUP_BATCH_WINDOW = Seconds(1);
+
+// Number of containers in the stats table if not configured.
+const size_t DEFAULT_STATS_TABLE_CAPACITY = 1024;
+
+inline static Duration watchPeriod(const RecurrentCommand& command) {
+  return Milliseconds(static_cast<int64_t>(command.frequence() * 1000));
+}
+
+// Key of the job running the watch command in batch mode.
+const string WATCH_BATCH_JOB = "batch";
+
+// Maximum number of times the delay before the next check is doubled while
+// the command queue is saturated.
+const unsigned MAX_WATCH_BACKOFF = 3;
+
+typedef std::shared_ptr<process::Promise<ContainerLimitation>> WatchPromise;
+
+// Serialize the input of the commands of a container. The container config is
+// optional since it may be missing during cleanup.
+static string serializeInput(CommandFormat format,
+                             const ContainerID& containerId,
+                             const Option<ContainerConfig>& containerConfig) {
+  InputBuilder input(format);
+  input.add(InputField::CONTAINER_ID, containerId);
+  if (containerConfig.isSome()) {
+    input.add(InputField::CONTAINER_CONFIG, containerConfig.get());
+  }
+  return input.str();
+}
+
+static bool isProtobuf(const Option<Command>& command) {
+  return command.isSome() && command->format() == CommandFormat::PROTOBUF;
+}
+
+// Containers checked by the next invocation of the watch command in batch
+// mode. It is shared with the job running on the threads of the watch
+// scheduler, hence the mutex.
+struct WatchBatch {
+  std::mutex mutex;
+  hashmap<string, std::pair<string, WatchPromise>> containers;
+};
+
+// Pace of the watch command, shared by the jobs of every container. The
+// delay before the next check is the one suggested by the command, within
+// the bounds, doubled while commands wait for a slot in the CommandScheduler
+// so that all the checks back off together when the agent is loaded.
+struct WatchPacing {
+  WatchPacing(const RecurrentCommand& command, const IsolatorOptions& options)
+      : period(watchPeriod(command)),
+        minPeriod(options.watchMinPeriod.getOrElse(period / 10)),
+        maxPeriod(options.watchMaxPeriod.getOrElse(period * 10)),
+        backoff(0) {}
+
+  Duration next(const Option<Duration>& nextCheckIn) {
+    // On a concurrent update, the level set by the other job is kept.
+    unsigned level = backoff.load();
+    if (CommandScheduler::instance().queued() > 0) {
+      if (level < MAX_WATCH_BACKOFF &&
+          backoff.compare_exchange_strong(level, level + 1)) {
+        ++level;
+      }
+    } else if (level > 0 && backoff.compare_exchange_strong(level, level - 1)) {
+      --level;
+    }
+
+    Duration delay = std::max(
+        minPeriod, std::min(maxPeriod, nextCheckIn.getOrElse(period)));
+    return std::min(maxPeriod, delay * (1 << level));
+  }
+
+  const Duration period;
+  const Duration minPeriod;
+  const Duration maxPeriod;
+  std::atomic<unsigned> backoff;
+};
+
+// Run the watch command once for all the containers of the batch and
+// complete the futures of the containers which hit a limitation.
+static void runWatchBatch(const std::shared_ptr<WatchBatch>& batch,
+                          const RecurrentCommand& command, bool isDebugMode,
+                          CommandMetrics* metrics) {
+  // The promises are completed once the lock is released since their
+  // callbacks run synchronously.
+  string input;
+  std::vector<WatchPromise> discarded;
+  {
+    std::lock_guard<std::mutex> lock(batch->mutex);
+    std::vector<string> discardedIds;
+    std::vector<const string*> inputs;
+    foreachpair (const string& containerId,
+                 const std::pair<string, WatchPromise>& container,
+                 batch->containers) {
+      if (container.second->future().hasDiscard()) {
+        discarded.push_back(container.second);
+        discardedIds.push_back(containerId);
+      } else {
+        inputs.push_back(&container.first);
+      }
+    }
+    if (!inputs.empty()) input = joinInputs(command.format(), inputs);
+    for (const string& containerId : discardedIds) {
+      batch->containers.erase(containerId);
+    }
+  }
+  for (const WatchPromise& promise : discarded) promise->discard();
+  if (input.empty()) return;
+
+  Span call = Span::trace("watch", {"batch", "watch"});
+  const logging::Metadata& metadata = call.metadata();
+  Try<string> output =
+      CommandRunner(isDebugMode, metadata, metrics)
+          .runSynchronously(command, input, CommandPriority::NORMAL);
+  if (output.isError()) {
+    TASK_LOG(WARNING, metadata) << output.error();
+    return;
+  }
+
+  // Containers without limitation are omitted, so nothing to do.
+  if (output->empty()) return;
+
+  Span decoding("decode", metadata);
+  Try<hashmap<string, ContainerLimitation>> limitations =
+      timed(metrics->parseTime, [&command, &output]() {
+        return parseOutputMap<ContainerLimitation>(command, output.get());
+      });
+  decoding.end();
+  if (limitations.isError()) {
+    TASK_LOG(WARNING, metadata)
+        << "Unable to deserialize ContainerLimitation: "
+        << limitations.error();
+    return;
+  }
+
+  std::vector<std::pair<WatchPromise, ContainerLimitation>> limited;
+  {
+    std::lock_guard<std::mutex> lock(batch->mutex);
+    foreachpair (const string& containerId,
+                 const ContainerLimitation& limitation, limitations.get()) {
+      // The container may have been cleaned up while the command ran.
+      if (!batch->containers.contains(containerId)) continue;
+      limited.push_back(
+          std::make_pair(batch->containers[containerId].second, limitation));
+      batch->containers.erase(containerId);
+    }
+  }
+  for (const auto& container : limited) {
+    container.first->set(container.second);
+  }
+}
 
 class CommandIsolatorProcess : public process::Process<CommandIsolatorProcess> {
  public:
   CommandIsolatorProcess(const Option<Command>& prepareCommand,
                          const Option<RecurrentCommand>& watchCommand,
                          const Option<Command>& cleanupCommand,
-                         const Option<Command>& usageCommand, bool isDebugMode);
+                         const Option<Command>& usageCommand, bool isDebugMode,
+                         const IsolatorOptions& options);
+
+  virtual process::Future<Nothing> recover(
+      const std::vector<ContainerState>& states,
+      const hashset<ContainerID>& orphans);
 
   virtual process::Future<Option<ContainerLaunchInfo>> prepare(
       const ContainerID& containerId, const ContainerConfig& containerConfig);
@@ -47,6 +228,12 @@ class CommandIsolatorProcess : public process::Process<CommandIsolatorProcess> {
   virtual process::Future<::mesos::ResourceStatistics> usage(
       const ContainerID& containerId);
 
+  Nothing reload(const Option<Command>& prepareCommand,
+                 const Option<RecurrentCommand>& watchCommand,
+                 const Option<Command>& cleanupCommand,
+                 const Option<Command>& usageCommand, bool isDebugMode,
+                 const IsolatorOptions& options);
+
   inline const Option<Command>& prepareCommand() const {
     return m_prepareCommand;
   }
@@ -55,7 +242,73 @@ class CommandIsolatorProcess : public process::Process<CommandIsolatorProcess> {
     return m_cleanupCommand;
   }
 
+ protected:
+  virtual void finalize();
+
  private:
+  struct ContainerInfo {
+    // Input of the commands, serialized once for all the isolators since the
+    // config never changes (see ExecutionEngine).
+    std::shared_ptr<const string> input;
+    // Same in protobuf, only set if a command uses this format.
+    std::shared_ptr<const string> protobufInput;
+  };
+
+  struct CachedUsage {
+    process::Future<::mesos::ResourceStatistics> statistics;
+    // Time at which the statistics became ready, None while in flight.
+    Option<process::Time> readyAt;
+  };
+
+  // Usage calls waiting for an invocation of the usage command in batch.
+  typedef hashmap<ContainerID,
+                  std::vector<process::Owned<
+                      process::Promise<::mesos::ResourceStatistics>>>>
+      UsageBatch;
+
+  // Inputs of the containers cleaned up by an invocation of the cleanup
+  // command in batch.
+  typedef hashmap<ContainerID, std::shared_ptr<const string>> CleanupBatch;
+
+  process::Future<::mesos::ResourceStatistics> runUsage(
+      const ContainerID& containerId);
+  void usageReady(const ContainerID& containerId,
+                  const process::Future<::mesos::ResourceStatistics>& future);
+  void flushUsageBatch();
+  void applyUsageDelta(const UsageBatch& batch, const Span& call,
+                       const Future<Try<string>>& output);
+  void flushCleanupBatch();
+  void runCleanupBatch(const std::shared_ptr<CleanupBatch>& inputs,
+                       size_t attempt);
+  void cleanupBatchDone(const std::shared_ptr<CleanupBatch>& inputs,
+                        size_t attempt, const Future<Try<string>>& output);
+  void scheduleWatch(const ContainerID& containerId);
+  void scheduleWatchBatch();
+  void stopWatch(const ContainerID& containerId);
+  // Register a container in the stats table, if the table is enabled.
+  void addToStatsTable(const ContainerID& containerId);
+  // Record an event taking only the container id, if the trace is enabled.
+  void trace(const string& method, const ContainerID& containerId);
+
+  // Replace a command unless it requires a restart, i.e., it is added or
+  // removed, or it is the first one in protobuf (see ContainerInfo).
+  template <class C>
+  void reloadCommand(Option<C>* current, const Option<C>& next,
+                     const string& name) {
+    if (isProtobuf(next) && !m_hasProtobufCommand) {
+      LOG(WARNING) << "Ignoring " << name
+                   << " since switching it to protobuf requires a restart";
+      return;
+    }
+    reloadOption(current, next, name);
+  }
+
+  inline bool isCleanupBatched() const {
+    return m_cleanupCommand.isSome() &&
+           (m_options.cleanupBatchWindow.isSome() ||
+            m_options.cleanupBatchSize.isSome());
+  }
+
   inline static ::mesos::ResourceStatistics emptyStats(
       double timestamp = Clock::now().secs()) {
     ::mesos::ResourceStatistics stats;
@@ -63,229 +316,852 @@ class CommandIsolatorProcess : public process::Process<CommandIsolatorProcess> {
     return stats;
   }
 
+  // The agent gets empty statistics when the usage command failed, which
+  // are not cached.
+  static Future<::mesos::ResourceStatistics> orEmptyStats(
+      const Future<::mesos::ResourceStatistics>& statistics) {
+    return statistics.recover(
+        [](const Future<::mesos::ResourceStatistics>&)
+            -> Future<::mesos::ResourceStatistics> { return emptyStats(); });
+  }
+
+  inline static const string& inputOf(const ContainerInfo& info,
+                                      const Command& command) {
+    return command.format() == CommandFormat::PROTOBUF ? *info.protobufInput
+                                                       : *info.input;
+  }
+
   Option<Command> m_prepareCommand;
   Option<RecurrentCommand> m_watchCommand;
   Option<Command> m_cleanupCommand;
   Option<Command> m_usageCommand;
   bool m_isDebugMode;
-  hashmap<ContainerID, ContainerConfig> m_infos;
+  IsolatorOptions m_options;
+  // Whether the inputs have to be serialized in protobuf too.
+  bool m_hasProtobufCommand;
+  hashmap<ContainerID, ContainerInfo> m_infos;
+
+  // Usage calls waiting for the next batch invocation of the usage command.
+  UsageBatch m_pendingUsages;
+
+  // In delta mode, the last statistics of each container and the sequence
+  // number they correspond to.
+  hashmap<ContainerID, ::mesos::ResourceStatistics> m_usageSnapshots;
+  uint64_t m_usageSequence;
+
+  // Last usage of each container, shared by concurrent calls while in flight.
+  hashmap<ContainerID, CachedUsage> m_usageCache;
+
+  // Inputs of the cleanups waiting for the next batch, only in batch mode.
+  CleanupBatch m_pendingCleanups;
+  // Containers of the failed batches waiting for their retry.
+  size_t m_retryingCleanups;
+
+  // Name of the isolator in its metrics.
+  const string m_name;
+  CommandMetrics* m_prepareMetrics;
+  CommandMetrics* m_watchMetrics;
+  CommandMetrics* m_cleanupMetrics;
+  CommandMetrics* m_usageMetrics;
+
+  // Runs the watch command of every container, only set with a watch command.
+  process::Owned<WatchScheduler> m_watchScheduler;
+  std::shared_ptr<WatchPacing> m_watchPacing;
+  hashmap<ContainerID, WatchPromise> m_watches;
+  // Only set in batch mode.
+  std::shared_ptr<WatchBatch> m_watchBatch;
+
+  // Only set if the events are recorded.
+  std::shared_ptr<TraceRecorder> m_traceRecorder;
+
+  // Only set if the statistics are published by a collector.
+  process::Owned<StatsTable> m_statsTable;
+
+  // Only set if the containers are checkpointed.
+  process::Owned<ContainerCheckpoint> m_checkpoint;
 };
 
 CommandIsolatorProcess::CommandIsolatorProcess(
     const Option<Command>& prepareCommand,
     const Option<RecurrentCommand>& watchCommand,
     const Option<Command>& cleanupCommand, const Option<Command>& usageCommand,
-    bool isDebugMode)
-    : m_prepareCommand(prepareCommand),
+    bool isDebugMode, const IsolatorOptions& options)
+    : ProcessBase(process::ID::generate("command-isolator")),
+      m_prepareCommand(prepareCommand),
       m_watchCommand(watchCommand),
       m_cleanupCommand(cleanupCommand),
       m_usageCommand(usageCommand),
-      m_isDebugMode(isDebugMode) {}
+      m_isDebugMode(isDebugMode),
+      m_options(options),
+      m_hasProtobufCommand(isProtobuf(prepareCommand) ||
+                           isProtobuf(watchCommand) ||
+                           isProtobuf(cleanupCommand) ||
+                           isProtobuf(usageCommand)),
+      m_usageSequence(0),
+      m_retryingCleanups(0),
+      m_name(CommandMetrics::instanceName(options.name, DEFAULT_NAME)),
+      m_prepareMetrics(commandMetrics(prepareCommand, m_name, "prepare")),
+      m_watchMetrics(commandMetrics(watchCommand, m_name, "watch")),
+      m_cleanupMetrics(commandMetrics(cleanupCommand, m_name, "cleanup")),
+      m_usageMetrics(commandMetrics(usageCommand, m_name, "usage")) {
+  if (m_watchCommand.isSome()) {
+    m_watchScheduler.reset(new WatchScheduler(
+        options.watchThreads.getOrElse(DEFAULT_WATCH_THREADS)));
+    m_watchPacing = std::make_shared<WatchPacing>(m_watchCommand.get(),
+                                                  options);
+
+    if (options.watchBatch) {
+      m_watchBatch.reset(new WatchBatch());
+      scheduleWatchBatch();
+    }
+  }
+
+  if (options.usageStatsTable.isSome()) {
+    Try<process::Owned<StatsTable>> table = StatsTable::create(
+        options.usageStatsTable.get(),
+        options.usageStatsTableCapacity.getOrElse(
+            DEFAULT_STATS_TABLE_CAPACITY));
+    if (table.isError()) {
+      LOG(WARNING) << table.error();
+    } else {
+      m_statsTable = table.get();
+    }
+  }
+
+  if (options.checkpointFile.isSome()) {
+    Try<process::Owned<ContainerCheckpoint>> checkpoint =
+        ContainerCheckpoint::open(options.checkpointFile.get());
+    if (checkpoint.isError()) {
+      LOG(WARNING) << checkpoint.error();
+    } else {
+      m_checkpoint = checkpoint.get();
+    }
+  }
+
+  if (options.traceFile.isSome()) {
+    Try<std::shared_ptr<TraceRecorder>> recorder =
+        TraceRecorder::open(options.traceFile.get());
+    if (recorder.isError()) {
+      LOG(WARNING) << recorder.error();
+    } else {
+      m_traceRecorder = recorder.get();
+    }
+  }
+}
+
+
+void CommandIsolatorProcess::finalize() {
+  if (m_watchBatch.get() != nullptr) {
+    m_watchScheduler->remove(WATCH_BATCH_JOB);
+    std::lock_guard<std::mutex> lock(m_watchBatch->mutex);
+    m_watchBatch->containers.clear();
+  }
+  foreachpair (const ContainerID& containerId, const WatchPromise& promise,
+               m_watches) {
+    m_watchScheduler->remove(containerId.value());
+    promise->discard();
+  }
+  m_watches.clear();
+
+  hashmap<ContainerID, ContainerInfo> infos;
+  std::swap(infos, m_infos);
+  foreach (const ContainerID& containerId, infos.keys()) {
+    infos.erase(containerId);
+    ExecutionEngine::instance().forgetContainer(containerId);
+  }
+
+  if (isCleanupBatched()) {
+    // The pending containers are still cleaned up, without retries.
+    flushCleanupBatch();
+    if (m_retryingCleanups > 0) {
+      if (m_cleanupMetrics != nullptr) ++m_cleanupMetrics->abandoned;
+      LOG(WARNING) << "Abandoning the cleanup of " << m_retryingCleanups
+                   << " containers waiting for a retry since the isolator "
+                   << "is stopping";
+    }
+  }
+}
+
+process::Future<Nothing> CommandIsolatorProcess::recover(
+    const std::vector<ContainerState>& states,
+    const hashset<ContainerID>& orphans) {
+  if (m_checkpoint.get() == nullptr) return Nothing();
+
+  // The orphans are recovered too since the agent cleans them up.
+  hashset<ContainerID> containerIds = orphans;
+  foreach (const ContainerState& state, states) {
+    containerIds.insert(state.container_id());
+  }
+
+  ExecutionEngine& engine = ExecutionEngine::instance();
+  const hashmap<ContainerID, ContainerCheckpoint::Entry>& entries =
+      m_checkpoint->entries();
+  size_t restored = 0;
+  size_t missing = 0;
+  foreach (const ContainerID& containerId, containerIds) {
+    if (m_infos.contains(containerId)) continue;
+    if (!entries.contains(containerId)) {
+      ++missing;
+      continue;
+    }
+
+    const ContainerCheckpoint::Entry& entry = entries.at(containerId);
+    ContainerInfo info = {
+        engine.shareInput(CommandFormat::JSON, containerId, entry.input),
+        m_hasProtobufCommand ? engine.shareInput(CommandFormat::PROTOBUF,
+                                                 containerId,
+                                                 entry.protobufInput)
+                             : nullptr};
+    m_infos.put(containerId, info);
+    addToStatsTable(containerId);
+    ++restored;
+  }
+
+  LOG(INFO) << "Recovered " << restored << " containers from the checkpoint";
+  if (missing > 0) {
+    LOG(WARNING) << missing << " recovered containers were not checkpointed,"
+                 << " their commands fail until they are prepared again";
+  }
+
+  // The containers which are gone were cleaned up while the agent was down.
+  m_checkpoint->retain(containerIds);
+  return Nothing();
+}
+
+void CommandIsolatorProcess::addToStatsTable(const ContainerID& containerId) {
+  if (m_statsTable.get() == nullptr) return;
+  Try<Nothing> added = m_statsTable->add(containerId.value());
+  if (added.isError()) {
+    LOG(WARNING) << "Unable to register container " << containerId
+                 << " in the stats table: " << added.error();
+  }
+}
 
 process::Future<Option<ContainerLaunchInfo>> CommandIsolatorProcess::prepare(
     const ContainerID& containerId, const ContainerConfig& containerConfig) {
   if (m_infos.contains(containerId)) {
     return Failure("mesos-command-module already initialized for container");
   } else {
-    m_infos.put(containerId, containerConfig);
+    ExecutionEngine& engine = ExecutionEngine::instance();
+    ContainerInfo info = {
+        engine.containerInput(CommandFormat::JSON, containerId,
+                              containerConfig),
+        m_hasProtobufCommand
+            ? engine.containerInput(CommandFormat::PROTOBUF, containerId,
+                                    containerConfig)
+            : nullptr};
+    m_infos.put(containerId, info);
+    // The cleanup of the previous container with this id is not run anymore
+    // since it would clean up the new one.
+    m_pendingCleanups.erase(containerId);
+    if (m_traceRecorder) m_traceRecorder->record("prepare", *info.input);
+    addToStatsTable(containerId);
+    if (m_checkpoint.get() != nullptr) {
+      // The protobuf input is checkpointed even if no command uses it yet
+      // since one may switch to this format before the agent restarts.
+      m_checkpoint->add(
+          containerId,
+          {info.input, info.protobufInput
+                           ? info.protobufInput
+                           : engine.containerInput(CommandFormat::PROTOBUF,
+                                                   containerId,
+                                                   containerConfig)});
+    }
   }
   if (m_prepareCommand.isNone()) {
     return None();
   }
 
-  logging::Metadata metadata = {containerId.value(), "prepare"};
-
-  JSON::Object inputsJson;
-  inputsJson.values["container_id"] = JSON::protobuf(containerId);
-  inputsJson.values["container_config"] = JSON::protobuf(containerConfig);
+  // The span of the call ends once the continuation holding it is gone.
+  Span call = Span::trace("prepare", {containerId.value(), "prepare"});
 
-  Try<string> output = CommandRunner(m_isDebugMode, metadata)
-                           .run(m_prepareCommand.get(), stringify(inputsJson));
-
-  if (output.isError()) {
-    return Failure(output.error());
-  }
+  CommandMetrics* metrics = m_prepareMetrics;
+  Command command = m_prepareCommand.get();
+  return CommandRunner(m_isDebugMode, call.metadata(), metrics)
+      .asyncRun(command, inputOf(m_infos[containerId], command),
+                CommandPriority::HIGH)
+      .then([metrics, command, call](const Try<string>& output)
+                -> Future<Option<ContainerLaunchInfo>> {
+        if (output.isError()) {
+          return Failure(output.error());
+        }
 
-  if (output->empty()) {
-    return None();
-  }
+        if (output->empty()) {
+          return None();
+        }
 
-  Result<ContainerLaunchInfo> containerLaunchInfo =
-      jsonToProtobuf<ContainerLaunchInfo>(output.get());
+        Span decoding("decode", call.metadata());
+        Result<ContainerLaunchInfo> containerLaunchInfo =
+            timed(metrics->parseTime, [&command, &output]() {
+              return parseOutput<ContainerLaunchInfo>(command, output.get());
+            });
+        decoding.end();
 
-  if (containerLaunchInfo.isError()) {
-    return Failure("Unable to deserialize ContainerLaunchInfo: " +
-                   containerLaunchInfo.error());
-  }
-  return containerLaunchInfo.get();
+        if (containerLaunchInfo.isError()) {
+          return Failure("Unable to deserialize ContainerLaunchInfo: " +
+                         containerLaunchInfo.error());
+        }
+        return Option<ContainerLaunchInfo>(containerLaunchInfo.get());
+      });
 }
 
 process::Future<ContainerLimitation> CommandIsolatorProcess::watch(
     const ContainerID& containerId) {
+  trace("watch", containerId);
   if (m_watchCommand.isNone()) {
     return process::Future<ContainerLimitation>();
   }
 
-  logging::Metadata metadata = {containerId.value(), "watch"};
-
-  JSON::Object inputsJson;
-  inputsJson.values["container_id"] = JSON::protobuf(containerId);
-  if (m_infos.contains(containerId)) {
-    inputsJson.values["container_config"] =
-        JSON::protobuf(m_infos[containerId]);
-  } else {
+  if (!m_infos.contains(containerId)) {
     return Failure(
         "mesos-command-module is not initialized for current container");
   }
 
-  std::string inputStringified = stringify(inputsJson);
+  // The promise is shared with the job which runs on the threads of the
+  // watch scheduler and completes it once the command reports a limitation.
+  WatchPromise promise(new process::Promise<ContainerLimitation>());
+  m_watches[containerId] = promise;
+
+  if (m_watchBatch.get() != nullptr) {
+    std::lock_guard<std::mutex> lock(m_watchBatch->mutex);
+    m_watchBatch->containers[containerId.value()] = std::make_pair(
+        inputOf(m_infos[containerId], m_watchCommand.get()), promise);
+    return promise->future();
+  }
+
+  scheduleWatch(containerId);
+  return promise->future();
+}
+
+// Run the watch command of a container with the current command, replacing
+// the job of the container if any.
+void CommandIsolatorProcess::scheduleWatch(const ContainerID& containerId) {
+  logging::Metadata metadata = {containerId.value(), "watch"};
+  string input = inputOf(m_infos[containerId], m_watchCommand.get());
+  WatchPromise promise = m_watches[containerId];
   RecurrentCommand command = m_watchCommand.get();
   bool isDebugMode = m_isDebugMode;
+  CommandMetrics* metrics = m_watchMetrics;
+  std::shared_ptr<WatchPacing> pacing = m_watchPacing;
 
-  process::UPID proc = spawn(new process::ProcessBase());
-
-  Future<ContainerLimitation> future = loop(
-      proc,
-      [isDebugMode, metadata, inputStringified, command]() {
-        Try<string> output = CommandRunner(isDebugMode, metadata)
-                                 .runWithoutTimeout(command, inputStringified);
-        return output;
-      },
-      [command, this, containerId](
-          Try<string> output) -> Future<ControlFlow<ContainerLimitation>> {
-        try {
-          if (!m_infos.contains(containerId)) {
-            LOG(WARNING) << "Terminating watch loop for containerId: "
-                         << containerId;
-            // Returning a discarded future stops the loop
-            Future<ControlFlow<ContainerLimitation>> ret;
-            ret.discard();
-            return ret;
-          }
-          if (output.isError())
-            throw std::runtime_error("Unable to parse output: " +
-                                     output.error());
+  WatchScheduler::AdaptiveJob job = [isDebugMode, metadata, input, command,
+                                     metrics, promise,
+                                     pacing](Duration* delay) {
+    if (promise->future().hasDiscard()) {
+      promise->discard();
+      return true;
+    }
+    // Completed by the job it replaced, which was still running.
+    if (!promise->future().isPending()) return true;
 
-          if (output->empty()) throw should_continue_exception();
+    // Pool threads are not libprocess workers, so blocking here is fine.
+    Span call = Span::trace("watch", metadata);
+    Try<string> output =
+        CommandRunner(isDebugMode, call.metadata(), metrics)
+            .runSynchronously(command, input, CommandPriority::NORMAL);
 
-          Result<ContainerLimitation> containerLimitation =
-              jsonToProtobuf<ContainerLimitation>(output.get());
+    Option<Duration> nextCheckIn = None();
+    if (output.isError()) {
+      TASK_LOG(WARNING, metadata) << output.error();
+    } else if (!output->empty()) {
+      Span decoding("decode", call.metadata());
+      Try<WatchOutput<ContainerLimitation>> watchOutput =
+          timed(metrics->parseTime, [&command, &output]() {
+            return parseWatchOutput<ContainerLimitation>(command,
+                                                         output.get());
+          });
+      decoding.end();
+      if (watchOutput.isError()) {
+        TASK_LOG(WARNING, metadata)
+            << "Unable to deserialize ContainerLimitation: "
+            << watchOutput.error();
+      } else if (watchOutput->limitation.isSome()) {
+        promise->set(watchOutput->limitation.get());
+        return true;
+      } else {
+        nextCheckIn = watchOutput->nextCheckIn;
+      }
+    }
 
-          if (containerLimitation.isError())
-            throw std::runtime_error(
-                "Unable to deserialize ContainerLimitation: " +
-                containerLimitation.error());
+    *delay = pacing->next(nextCheckIn);
+    return false;
+  };
 
-          return Break(containerLimitation.get());
-        } catch (const std::runtime_error& e) {
-          if (e.what()) LOG(WARNING) << e.what();
-        } catch (const should_continue_exception& e) {
-        }
-        return after(Seconds(command.frequence()))
-            .then([]() -> process::ControlFlow<ContainerLimitation> {
-              return process::Continue();
-            });
-      });
+  m_watchScheduler->add(containerId.value(), watchPeriod(command), job);
+}
 
-  future.onAny([proc]() {
-    LOG(WARNING) << "Terminating watch loop";
-    terminate(proc);
-    LOG(WARNING) << "Watch loop Terminated";
-  });
+// Run the watch command of the batch with the current command, replacing the
+// job of the batch if any.
+void CommandIsolatorProcess::scheduleWatchBatch() {
+  std::shared_ptr<WatchBatch> batch = m_watchBatch;
+  std::shared_ptr<WatchPacing> pacing = m_watchPacing;
+  RecurrentCommand command = m_watchCommand.get();
+  bool isDebugMode = m_isDebugMode;
+  CommandMetrics* metrics = m_watchMetrics;
+  WatchScheduler::AdaptiveJob job = [batch, pacing, command, isDebugMode,
+                                     metrics](Duration* delay) {
+    runWatchBatch(batch, command, isDebugMode, metrics);
+    // The containers share the invocation, so no hint applies.
+    *delay = pacing->next(None());
+    return false;
+  };
+  m_watchScheduler->add(WATCH_BATCH_JOB, watchPeriod(command), job);
+}
 
-  return future;
+// Stop the watch command of a container. The pending future is discarded
+// as the original loop did once the container was cleaned up.
+void CommandIsolatorProcess::stopWatch(const ContainerID& containerId) {
+  if (!m_watches.contains(containerId)) return;
+  if (m_watchBatch.get() != nullptr) {
+    std::lock_guard<std::mutex> lock(m_watchBatch->mutex);
+    m_watchBatch->containers.erase(containerId.value());
+  } else {
+    m_watchScheduler->remove(containerId.value());
+  }
+  m_watches[containerId]->discard();
+  m_watches.erase(containerId);
 }
 
-process::Future<::mesos::ResourceStatistics> CommandIsolatorProcess::usage(
-    const ContainerID& containerId) {
-  double now = Clock::now().secs();
+Nothing CommandIsolatorProcess::reload(
+    const Option<Command>& prepareCommand,
+    const Option<RecurrentCommand>& watchCommand,
+    const Option<Command>& cleanupCommand, const Option<Command>& usageCommand,
+    bool isDebugMode, const IsolatorOptions& options) {
+  // The commands in progress keep running with the previous configuration.
+  reloadCommand(&m_prepareCommand, prepareCommand, "isolator_prepare_command");
+  reloadCommand(&m_cleanupCommand, cleanupCommand, "isolator_cleanup_command");
+  reloadCommand(&m_usageCommand, usageCommand, "isolator_usage_command");
+  bool debugChanged = m_isDebugMode != isDebugMode;
+  m_isDebugMode = isDebugMode;
 
-  if (m_usageCommand.isNone()) return emptyStats(now);
+  reloadOption(&m_options.usageBatchWindow, options.usageBatchWindow,
+               "isolator_usage_batch_window");
+  reloadOption(&m_options.usageCacheTtl, options.usageCacheTtl,
+               "isolator_usage_cache_ttl");
+  reloadOption(&m_options.cleanupBatchWindow, options.cleanupBatchWindow,
+               "isolator_cleanup_batch_window");
+  reloadOption(&m_options.cleanupBatchSize, options.cleanupBatchSize,
+               "isolator_cleanup_batch_size");
+  m_options.cleanupRetries = options.cleanupRetries;
 
-  logging::Metadata metadata = {containerId.value(), "usage"};
+  Option<RecurrentCommand> previousWatchCommand = m_watchCommand;
+  reloadCommand(&m_watchCommand, watchCommand, "isolator_watch_command");
+  bool watchChanged = m_watchCommand != previousWatchCommand ||
+                      m_options.watchMinPeriod != options.watchMinPeriod ||
+                      m_options.watchMaxPeriod != options.watchMaxPeriod ||
+                      debugChanged;
+  m_options.watchMinPeriod = options.watchMinPeriod;
+  m_options.watchMaxPeriod = options.watchMaxPeriod;
+  if (m_watchCommand.isNone() || !watchChanged) return Nothing();
 
-  JSON::Object inputsJson;
-  inputsJson.values["container_id"] = JSON::protobuf(containerId);
-  if (m_infos.contains(containerId)) {
-    inputsJson.values["container_config"] =
-        JSON::protobuf(m_infos[containerId]);
+  // The jobs are replaced to run the new command at its period, the checks
+  // in progress completing with the previous one.
+  m_watchPacing =
+      std::make_shared<WatchPacing>(m_watchCommand.get(), m_options);
+  if (m_watchBatch.get() != nullptr) {
+    {
+      std::lock_guard<std::mutex> lock(m_watchBatch->mutex);
+      for (auto& container : m_watchBatch->containers) {
+        ContainerID containerId;
+        containerId.set_value(container.first);
+        if (!m_infos.contains(containerId)) continue;
+        container.second.first =
+            inputOf(m_infos[containerId], m_watchCommand.get());
+      }
+    }
+    scheduleWatchBatch();
   } else {
+    foreachkey (const ContainerID& containerId, m_watches) {
+      scheduleWatch(containerId);
+    }
+  }
+  return Nothing();
+}
+
+void CommandIsolatorProcess::trace(const string& method,
+                                   const ContainerID& containerId) {
+  if (!m_traceRecorder) return;
+  m_traceRecorder->record(
+      method, serializeInput(CommandFormat::JSON, containerId, None()));
+}
+
+process::Future<::mesos::ResourceStatistics> CommandIsolatorProcess::usage(
+    const ContainerID& containerId) {
+  trace("usage", containerId);
+  // The containers which did not fit in the table run the usage command.
+  if (m_statsTable.get() != nullptr &&
+      m_statsTable->contains(containerId.value())) {
+    return m_statsTable->read(containerId.value()).getOrElse(emptyStats());
+  }
+  if (m_usageCommand.isNone()) return emptyStats();
+
+  if (!m_infos.contains(containerId)) {
     return Failure(
         "mesos-command-module is not initialized for current container");
   }
 
-  return CommandRunner(m_isDebugMode, metadata)
-      .asyncRun(m_usageCommand.get(), stringify(inputsJson))
-      .then([now = now](Try<string> output)
+  if (m_options.usageCacheTtl.isNone()) {
+    return orEmptyStats(runUsage(containerId));
+  }
+
+  if (m_usageCache.contains(containerId)) {
+    const CachedUsage& cached = m_usageCache.at(containerId);
+    if (cached.statistics.isPending() ||
+        (cached.readyAt.isSome() &&
+         Clock::now() - cached.readyAt.get() < m_options.usageCacheTtl.get())) {
+      if (m_usageMetrics != nullptr) ++m_usageMetrics->cacheHits;
+      // A caller discarding its future must not discard it for the others.
+      return orEmptyStats(process::undiscardable(cached.statistics));
+    }
+  }
+
+  if (m_usageMetrics != nullptr) ++m_usageMetrics->cacheMisses;
+  Future<::mesos::ResourceStatistics> statistics = runUsage(containerId);
+  m_usageCache[containerId] = CachedUsage{statistics, None()};
+  statistics.onAny(
+      defer(self(), &Self::usageReady, containerId, lambda::_1));
+  return orEmptyStats(process::undiscardable(statistics));
+}
+
+void CommandIsolatorProcess::usageReady(
+    const ContainerID& containerId,
+    const Future<::mesos::ResourceStatistics>& future) {
+  // The container may have been cleaned up or its entry replaced meanwhile.
+  if (!m_usageCache.contains(containerId) ||
+      m_usageCache.at(containerId).statistics != future) {
+    return;
+  }
+  // The statistics of a failed command are not reused.
+  if (future.isReady()) {
+    m_usageCache.at(containerId).readyAt = Clock::now();
+  } else {
+    m_usageCache.erase(containerId);
+  }
+}
+
+process::Future<::mesos::ResourceStatistics> CommandIsolatorProcess::runUsage(
+    const ContainerID& containerId) {
+  if (m_options.usageBatchWindow.isSome() || m_options.usageDelta) {
+    process::Owned<process::Promise<::mesos::ResourceStatistics>> promise(
+        new process::Promise<::mesos::ResourceStatistics>());
+    if (m_pendingUsages.empty()) {
+      process::delay(m_options.usageBatchWindow.getOrElse(Duration::zero()),
+                     self(), &CommandIsolatorProcess::flushUsageBatch);
+    }
+    m_pendingUsages[containerId].push_back(promise);
+    return promise->future();
+  }
+
+  Span call = Span::trace("usage", {containerId.value(), "usage"});
+
+  CommandMetrics* metrics = m_usageMetrics;
+  Command command = m_usageCommand.get();
+  return CommandRunner(m_isDebugMode, call.metadata(), metrics)
+      .asyncRun(command, inputOf(m_infos[containerId], command),
+                CommandPriority::LOW)
+      .then([metrics, command, call](Try<string> output)
                 ->Future<::mesos::ResourceStatistics> {
                   if (output.isError()) {
-                    LOG(WARNING) << "Unable to parse output: "
-                                 << output.error();
-                    return emptyStats(now);
-                  }
-                  if (output->empty()) {
-                    LOG(WARNING) << "Output is empty";
-                    return emptyStats(now);
+                    return Failure("Unable to parse output: " +
+                                   output.error());
                   }
+                  if (output->empty()) return Failure("Output is empty");
+                  Span decoding("decode", call.metadata());
                   Result<::mesos::ResourceStatistics> resourceStatistics =
-                      jsonToProtobuf<::mesos::ResourceStatistics>(output.get());
+                      timed(metrics->parseTime, [&command, &output]() {
+                        return parseOutput<::mesos::ResourceStatistics>(
+                            command, output.get());
+                      });
+                  decoding.end();
 
                   if (resourceStatistics.isError()) {
-                    LOG(WARNING) << "Unable to deserialize ResourceStatistics: "
-                                 << resourceStatistics.error();
-                    return emptyStats(now);
+                    return Failure(
+                        "Unable to deserialize ResourceStatistics: " +
+                        resourceStatistics.error());
                   }
                   return resourceStatistics.get();
                 })
-      .recover([now = now](const Future<::mesos::ResourceStatistics>& result)
-                   ->Future<::mesos::ResourceStatistics> {
-                     LOG(WARNING) << "Failed to run usage command: " << result;
-                     return emptyStats(now);
-                   });
+      .onFailed([](const string& failure) {
+        LOG(WARNING) << "Failed to run usage command: " << failure;
+      });
+}
+
+void CommandIsolatorProcess::flushUsageBatch() {
+  UsageBatch batch;
+  std::swap(batch, m_pendingUsages);
+  if (batch.empty()) return;
+
+  std::vector<const string*> inputs;
+  foreachkey (const ContainerID& containerId, batch) {
+    // The container may have been cleaned up during the batch window.
+    if (!m_infos.contains(containerId)) continue;
+    inputs.push_back(&inputOf(m_infos[containerId], m_usageCommand.get()));
+  }
+  if (inputs.empty()) {
+    foreachvalue (const auto& promises, batch) {
+      foreach (const auto& promise, promises) {
+        promise->fail("The container was cleaned up");
+      }
+    }
+    return;
+  }
+
+  Span call = Span::trace("usage", {"batch", "usage"});
+  const logging::Metadata& metadata = call.metadata();
+  CommandMetrics* metrics = m_usageMetrics;
+  Command command = m_usageCommand.get();
+  if (m_options.usageDelta) {
+    CommandRunner(m_isDebugMode, metadata, metrics)
+        .asyncRun(command,
+                  joinDeltaInputs(command.format(), m_usageSequence, inputs),
+                  CommandPriority::LOW)
+        .onAny(defer(self(), &Self::applyUsageDelta, batch, call, lambda::_1));
+    return;
+  }
+
+  CommandRunner(m_isDebugMode, metadata, metrics)
+      .asyncRun(command, joinInputs(command.format(), inputs),
+                CommandPriority::LOW)
+      .onAny([batch, metrics, command,
+              call](const Future<Try<string>>& output) {
+        hashmap<string, ::mesos::ResourceStatistics> stats;
+        if (!output.isReady()) {
+          LOG(WARNING) << "Failed to run usage command: " << output;
+        } else if (output->isError()) {
+          LOG(WARNING) << "Unable to parse output: " << output->error();
+        } else {
+          Span decoding("decode", call.metadata());
+          Try<hashmap<string, ::mesos::ResourceStatistics>> parsed =
+              timed(metrics->parseTime, [&command, &output]() {
+                return parseOutputMap<::mesos::ResourceStatistics>(
+                    command, output->get());
+              });
+          decoding.end();
+          if (parsed.isError()) {
+            LOG(WARNING) << "Unable to deserialize ResourceStatistics: "
+                         << parsed.error();
+          } else {
+            stats = parsed.get();
+          }
+        }
+
+        // The containers without statistics get empty ones without caching
+        // them (see orEmptyStats).
+        foreachpair (const ContainerID& containerId,
+                     const std::vector<process::Owned<process::Promise<
+                         ::mesos::ResourceStatistics>>>& promises,
+                     batch) {
+          foreach (const auto& promise, promises) {
+            if (stats.contains(containerId.value())) {
+              promise->set(stats[containerId.value()]);
+            } else {
+              promise->fail("No statistics for the container");
+            }
+          }
+        }
+      });
+}
+
+void CommandIsolatorProcess::applyUsageDelta(
+    const UsageBatch& batch, const Span& call,
+    const Future<Try<string>>& output) {
+  // The last statistics are kept if the command failed, an empty output
+  // meaning that nothing changed.
+  if (!output.isReady()) {
+    LOG(WARNING) << "Failed to run usage command: " << output;
+  } else if (output->isError()) {
+    LOG(WARNING) << "Unable to parse output: " << output->error();
+  } else if (!output->get().empty()) {
+    const Command& command = m_usageCommand.get();
+    Span decoding("decode", call.metadata());
+    Try<DeltaOutput<::mesos::ResourceStatistics>> delta =
+        timed(m_usageMetrics->parseTime, [&command, &output]() {
+          return parseDeltaOutput<::mesos::ResourceStatistics>(
+              command, output->get());
+        });
+    decoding.end();
+    if (delta.isError()) {
+      LOG(WARNING) << "Unable to deserialize ResourceStatistics: "
+                   << delta.error();
+    } else if (!delta->header.full &&
+               delta->header.sequence < m_usageSequence) {
+      // Answer to an older input completed after a newer one.
+      LOG(WARNING) << "Ignoring the statistics of sequence number "
+                   << delta->header.sequence << " older than "
+                   << m_usageSequence;
+    } else {
+      if (delta->header.full) m_usageSnapshots.clear();
+      foreachpair (const string& id,
+                   const ::mesos::ResourceStatistics& statistics,
+                   delta->entries) {
+        ContainerID containerId;
+        containerId.set_value(id);
+        // The container may have been cleaned up while the command ran.
+        if (!m_infos.contains(containerId)) continue;
+        if (m_usageSnapshots.contains(containerId)) {
+          mergeDelta(statistics, &m_usageSnapshots.at(containerId));
+        } else {
+          m_usageSnapshots.put(containerId, statistics);
+        }
+      }
+      m_usageSequence = delta->header.sequence;
+    }
+  }
+
+  foreachpair (const ContainerID& containerId,
+               const std::vector<process::Owned<process::Promise<
+                   ::mesos::ResourceStatistics>>>& promises,
+               batch) {
+    foreach (const auto& promise, promises) {
+      if (m_usageSnapshots.contains(containerId)) {
+        promise->set(m_usageSnapshots.at(containerId));
+      } else {
+        promise->fail("No statistics for the container");
+      }
+    }
+  }
 }
 
 process::Future<Nothing> CommandIsolatorProcess::cleanup(
     const ContainerID& containerId) {
+  trace("cleanup", containerId);
+  m_usageCache.erase(containerId);
+  m_usageSnapshots.erase(containerId);
+  if (m_statsTable.get() != nullptr) m_statsTable->remove(containerId.value());
+  if (m_checkpoint.get() != nullptr) m_checkpoint->remove(containerId);
+  stopWatch(containerId);
+
   if (m_cleanupCommand.isNone()) {
     m_infos.erase(containerId);
+    ExecutionEngine::instance().forgetContainer(containerId);
     return Nothing();
   }
 
-  logging::Metadata metadata = {containerId.value(), "cleanup"};
-
-  JSON::Object inputsJson;
-  inputsJson.values["container_id"] = JSON::protobuf(containerId);
+  const Command& command = m_cleanupCommand.get();
+  std::shared_ptr<const string> input;
   if (m_infos.contains(containerId)) {
-    inputsJson.values["container_config"] =
-        JSON::protobuf(m_infos[containerId]);
+    const ContainerInfo& info = m_infos[containerId];
+    input = command.format() == CommandFormat::PROTOBUF ? info.protobufInput
+                                                        : info.input;
   } else {
     LOG(WARNING)
         << "Missing container info during cleanup of mesos-command-module.";
+    input = std::make_shared<const string>(
+        serializeInput(command.format(), containerId, None()));
   }
 
-  Try<string> output = CommandRunner(m_isDebugMode, metadata)
-                           .run(m_cleanupCommand.get(), stringify(inputsJson));
-
+  // The container is forgotten right away so that a new container with the
+  // same id can be prepared while the cleanup command is still running.
   m_infos.erase(containerId);
-  if (output.isError()) {
-    return Failure(output.error());
+  ExecutionEngine::instance().forgetContainer(containerId);
+
+  if (isCleanupBatched()) {
+    m_pendingCleanups[containerId] = input;
+    if (m_pendingCleanups.size() >=
+        m_options.cleanupBatchSize.getOrElse(SIZE_MAX)) {
+      flushCleanupBatch();
+    } else if (m_pendingCleanups.size() == 1) {
+      process::delay(
+          m_options.cleanupBatchWindow.getOrElse(DEFAULT_CLEANUP_BATCH_WINDOW),
+          self(), &CommandIsolatorProcess::flushCleanupBatch);
+    }
+    return Nothing();
   }
 
-  return Nothing();
+  Span call = Span::trace("cleanup", {containerId.value(), "cleanup"});
+  return CommandRunner(m_isDebugMode, call.metadata(), m_cleanupMetrics)
+      .asyncRun(command, *input, CommandPriority::HIGH)
+      .then([call](const Try<string>& output) -> Future<Nothing> {
+        call.end();
+        if (output.isError()) {
+          return Failure(output.error());
+        }
+        return Nothing();
+      });
+}
+
+void CommandIsolatorProcess::flushCleanupBatch() {
+  // The timer of a batch already flushed because of its size may fire.
+  if (m_pendingCleanups.empty()) return;
+
+  std::shared_ptr<CleanupBatch> inputs(new CleanupBatch());
+  std::swap(*inputs, m_pendingCleanups);
+  runCleanupBatch(inputs, 0);
+}
+
+void CommandIsolatorProcess::runCleanupBatch(
+    const std::shared_ptr<CleanupBatch>& inputs, size_t attempt) {
+  if (attempt > 0) {
+    m_retryingCleanups -= inputs->size();
+    // Like the pending cleanups, the containers prepared again meanwhile are
+    // not cleaned up anymore.
+    std::vector<ContainerID> prepared;
+    foreachkey (const ContainerID& containerId, *inputs) {
+      if (m_infos.contains(containerId)) prepared.push_back(containerId);
+    }
+    for (const ContainerID& containerId : prepared) {
+      inputs->erase(containerId);
+    }
+    if (inputs->empty()) return;
+  }
+
+  Span call = Span::trace("cleanup", {"batch", "cleanup"});
+
+  std::vector<const string*> joined;
+  foreachvalue (const std::shared_ptr<const string>& input, *inputs) {
+    joined.push_back(input.get());
+  }
+
+  // Launches are not delayed by the cleanups since they complete early.
+  const Command& command = m_cleanupCommand.get();
+  CommandRunner(m_isDebugMode, call.metadata(), m_cleanupMetrics)
+      .asyncRun(command, joinInputs(command.format(), joined),
+                CommandPriority::NORMAL)
+      .onAny([call]() { call.end(); })
+      .onAny(defer(self(), &Self::cleanupBatchDone, inputs, attempt,
+                   lambda::_1));
+}
+
+void CommandIsolatorProcess::cleanupBatchDone(
+    const std::shared_ptr<CleanupBatch>& inputs, size_t attempt,
+    const Future<Try<string>>& output) {
+  if (output.isReady() && output->isSome()) return;
+
+  string error = output.isReady()    ? output->error()
+                 : output.isFailed() ? output.failure()
+                                     : "Command discarded";
+  if (attempt >= m_options.cleanupRetries.getOrElse(DEFAULT_CLEANUP_RETRIES)) {
+    if (m_cleanupMetrics != nullptr) ++m_cleanupMetrics->abandoned;
+    LOG(WARNING) << "Giving up the cleanup of " << inputs->size()
+                 << " containers after " << attempt + 1
+                 << " attempts: " << error;
+    return;
+  }
+
+  Duration delay = CLEANUP_RETRY_DELAY * (1 << std::min<size_t>(attempt, 10));
+  if (m_cleanupMetrics != nullptr) ++m_cleanupMetrics->retries;
+  LOG(WARNING) << "Retrying the cleanup of " << inputs->size()
+               << " containers in " << delay << ": " << error;
+  m_retryingCleanups += inputs->size();
+  process::delay(delay, self(), &CommandIsolatorProcess::runCleanupBatch,
+                 inputs, attempt + 1);
 }
 
 CommandIsolator::CommandIsolator(const Option<Command>& prepareCommand,
                                  const Option<RecurrentCommand>& watchCommand,
                                  const Option<Command>& cleanupCommand,
                                  const Option<Command>& usageCommand,
-                                 bool isDebugMode)
+                                 bool isDebugMode,
+                                 const IsolatorOptions& options)
     : m_process(new CommandIsolatorProcess(prepareCommand, watchCommand,
                                            cleanupCommand, usageCommand,
-                                           isDebugMode)) {
+                                           isDebugMode, options)) {
   spawn(m_process);
 }
 
 CommandIsolator::~CommandIsolator() {
+  // The watcher may be reloading the isolator.
+  m_configurationWatcher.reset();
   if (m_process != nullptr) {
     terminate(m_process);
     wait(m_process);
@@ -293,6 +1169,13 @@ CommandIsolator::~CommandIsolator() {
   }
 }
 
+process::Future<Nothing> CommandIsolator::recover(
+    const std::vector<ContainerState>& states,
+    const hashset<ContainerID>& orphans) {
+  return dispatch(m_process, &CommandIsolatorProcess::recover, states,
+                  orphans);
+}
+
 process::Future<Option<ContainerLaunchInfo>> CommandIsolator::prepare(
     const ContainerID& containerId, const ContainerConfig& containerConfig) {
   return dispatch(m_process, &CommandIsolatorProcess::prepare, containerId,
@@ -314,6 +1197,21 @@ process::Future<::mesos::ResourceStatistics> CommandIsolator::usage(
   return dispatch(m_process, &CommandIsolatorProcess::usage, containerId);
 }
 
+process::Future<Nothing> CommandIsolator::reload(
+    const Option<Command>& prepareCommand,
+    const Option<RecurrentCommand>& watchCommand,
+    const Option<Command>& cleanupCommand, const Option<Command>& usageCommand,
+    bool isDebugMode, const IsolatorOptions& options) {
+  return dispatch(m_process, &CommandIsolatorProcess::reload, prepareCommand,
+                  watchCommand, cleanupCommand, usageCommand, isDebugMode,
+                  options);
+}
+
+void CommandIsolator::setConfigurationWatcher(
+    const process::Owned<ConfigurationWatcher>& watcher) {
+  m_configurationWatcher = watcher;
+}
+
 const Option<Command>& CommandIsolator::prepareCommand() const {
   CHECK_NOTNULL(m_process);
   return m_process->prepareCommand();
@@ -2,19 +2,25 @@
 #define __COMMAND_ISOLATOR_HPP__
 
 #include <string>
+#include <vector>
 
 #include "Command.hpp"
+#include "ConfigurationWatcher.hpp"
+#include "Options.hpp"
 
 #include <mesos/module/isolator.hpp>
 #include <mesos/slave/isolator.hpp>
 
+#include <process/future.hpp>
+#include <process/owned.hpp>
+
+#include <stout/hashset.hpp>
+#include <stout/nothing.hpp>
 #include <stout/option.hpp>
 
 namespace criteo {
 namespace mesos {
 
-class should_continue_exception : public std::exception {};
-
 // Forward declaration
 class CommandIsolatorProcess;
 
@@ -43,12 +49,14 @@ class CommandIsolator : public ::mesos::slave::Isolator {
    *   for a given container. This command will be frequently called
    * @param isDebugMode If true, logs inputs and outputs of the commands,
    *   otherwise logs nothing
+   * @param options The settings of the isolator not bound to a command.
    */
   explicit CommandIsolator(const Option<Command>& prepareCommand,
                            const Option<RecurrentCommand>& watchCommand,
                            const Option<Command>& cleanupCommand,
                            const Option<Command>& usageCommand,
-                           bool isDebugMode = false);
+                           bool isDebugMode = false,
+                           const IsolatorOptions& options = IsolatorOptions());
 
   /**
    * Destructor
@@ -61,6 +69,21 @@ class CommandIsolator : public ::mesos::slave::Isolator {
    */
   virtual bool supportsNesting() { return true; }
 
+  /**
+   * Reload the containers prepared before a restart of the agent from the
+   * checkpoint, if enabled, so that their commands get their input again
+   * without preparing them. The checkpointed containers which were not
+   * recovered are forgotten.
+   *
+   * @param states The containers recovered by the agent.
+   * @param orphans The containers the agent is about to clean up.
+   *
+   * @return A future resolving nothing once the containers are reloaded.
+   */
+  virtual process::Future<Nothing> recover(
+      const std::vector<::mesos::slave::ContainerState>& states,
+      const hashset<::mesos::ContainerID>& orphans);
+
   /**
    * Run an external command on prepare phase of a new container.
    * If any execution needs to be done in the containerized context, it can
@@ -105,7 +128,33 @@ class CommandIsolator : public ::mesos::slave::Isolator {
   virtual process::Future<::mesos::ResourceStatistics> usage(
       const ::mesos::ContainerID& containerId);
 
+  /**
+   * Replace the commands and the options which can change without a restart,
+   * taking the same arguments as the constructor. The calls in progress
+   * complete with the previous configuration and the watch commands are
+   * rescheduled at their new period.
+   *
+   * Adding or removing a command, or a batch window, requires a restart and
+   * is ignored with a warning, as well as the options of the table, the
+   * checkpoint, the trace, the names and the batch modes.
+   *
+   * @return A future resolving once the new configuration is used.
+   */
+  process::Future<Nothing> reload(
+      const Option<Command>& prepareCommand,
+      const Option<RecurrentCommand>& watchCommand,
+      const Option<Command>& cleanupCommand,
+      const Option<Command>& usageCommand, bool isDebugMode,
+      const IsolatorOptions& options);
+
+  /**
+   * Keep the watcher reloading the isolator, stopping it first on destruction.
+   */
+  void setConfigurationWatcher(
+      const process::Owned<ConfigurationWatcher>& watcher);
+
  private:
+  process::Owned<ConfigurationWatcher> m_configurationWatcher;
   CommandIsolatorProcess* m_process;
 };
 }  // namespace mesos
@@ -1,18 +1,29 @@
 #include "CommandRunner.hpp"
+#include "CircuitBreaker.hpp"
+#include "CoProcess.hpp"
+#include "CommandCgroup.hpp"
+#include "CommandScheduler.hpp"
 #include "RunningContext.hpp"
+#include "Serialization.hpp"
+#include "Span.hpp"
+#include "SpawnServer.hpp"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <thread>
 
@@ -21,7 +32,9 @@
 #include <stout/duration.hpp>
 #include <stout/nothing.hpp>
 #include <stout/os.hpp>
+#include <stout/os/raw/environment.hpp>
 #include <stout/proc.hpp>
+#include <stout/strings.hpp>
 #include <stout/try.hpp>
 
 #include <process/after.hpp>
@@ -41,107 +54,434 @@ using std::vector;
 using namespace std::chrono;
 using namespace process;
 
+// Interval at which the size of the output of a command is checked while it
+// runs, if it is limited.
+const Duration OUTPUT_SIZE_INTERVAL = Milliseconds(50);
+
 inline static bool processStillRunning(pid_t pid) {
   return proc::status(pid).isSome();
 }
 
+Future<bool> terminateProcessTree(pid_t pid,
+                                  const logging::Metadata& loggingMetadata,
+                                  CommandMetrics* metrics) {
+  TASK_LOG(WARNING, loggingMetadata)
+      << "External command took too long to exit. "
+      << "Sending SIGTERM to " << pid << "...";
+  Try<std::list<os::ProcessTree>> kill = os::killtree(pid, SIGTERM);
+  if (kill.isError()) {
+    TASK_LOG(ERROR, loggingMetadata) << "Failed to send SIGTERM: "
+                                     << kill.error();
+  }
+  return after(Seconds(1)).then([=]() -> bool {
+    if (processStillRunning(pid)) {
+      TASK_LOG(WARNING, loggingMetadata)
+          << "External command is still running. Sending SIGKILL...";
+      if (metrics != nullptr) ++metrics->sigkills;
+      Try<std::list<os::ProcessTree>> kill = os::killtree(pid, SIGKILL);
+      if (kill.isError()) {
+        TASK_LOG(ERROR, loggingMetadata) << "Failed to kill the command: "
+                                         << kill.error();
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+// End the span of a command, failed if the command did not succeed.
+static void endSpan(const Span& span, const Future<Try<string>>& output) {
+  if (!output.isReady()) {
+    span.fail(output.isFailed() ? output.failure() : "discarded");
+  } else if (output->isError()) {
+    span.fail(output->error());
+  }
+  span.end();
+}
+
+// Read the output of a command in a span.
+static Try<string> readOutput(const RunningContext& rc,
+                              const logging::Metadata& loggingMetadata) {
+  Span reading("read_output", loggingMetadata);
+  Try<string> output = rc.readOutput();
+  if (output.isError()) reading.fail(output.error());
+  return output;
+}
+
 /*
- * Fork the process to run command and kill the child if it does not
- * finish before the timeout deadline.
- *
- * TODO(clems4ever): split this method so that it becomes easier to read.
+ * Check the wait status of a command, logging and returning an error if it did
+ * not exit successfully.
+ */
+static Try<Nothing> checkStatus(const std::string& executable, int status,
+                                const logging::Metadata& loggingMetadata) {
+  if (status == 0) return Nothing();
+
+  if (WIFSIGNALED(status) && WTERMSIG(status) != 0) {
+    int signalCode = WTERMSIG(status);
+    TASK_LOG(ERROR, loggingMetadata)
+        << "Failed to successfully run the command \"" << executable
+        << "\", it exited with signal " << signalCode;
+    return Error("Command \"" + executable + "\" exited via signal " +
+                 std::to_string(signalCode) + ".");
+  }
+  int exitCode = WEXITSTATUS(status);
+  string error(os::strerror(exitCode));
+  TASK_LOG(ERROR, loggingMetadata)
+      << "Failed to successfully run the command \"" << executable
+      << "\", it failed with status " << exitCode << " (" << error << ")";
+  return Error("Command \"" + executable + "\" exited with return code " +
+               std::to_string(exitCode) + ".");
+}
+
+/*
+ * Start a command reading its standard input from a file, from the spawn
+ * server if it is enabled so that the agent is not forked. The command is
+ * moved into the cgroup of its method if the commands are confined.
  *
- * @param executable Absolute path to the executed of the command to execute in
- * the child process.
- * @param timeout The timeout deadline in seconds before killing the
- * child process.
+ * The spawn server is not used for commands inheriting in-memory files
+ * since it only passes the standard input, nor once it got the command:
+ * it is then the only one to start it.
  */
-Future<Try<bool>> runCommandWithTimeout(
-    const std::string& executable, const std::vector<std::string>& args,
-    unsigned long timeoutInSeconds, const logging::Metadata& loggingMetadata) {
-  vector<string> commandLine = {executable, args[0], args[1], args[2]};
+static Try<Future<SpawnServer::Child>> spawnCommand(
+    const std::string& executable, const std::vector<std::string>& commandLine,
+    const std::string& inputPath, const std::vector<int>& fds,
+    const logging::Metadata& loggingMetadata, CommandMetrics* metrics) {
+  SpawnServer& server = SpawnServer::instance();
+  if (server.isEnabled() && fds.empty()) {
+    Try<int> input = os::open(inputPath, O_RDONLY | O_CLOEXEC);
+    if (input.isError()) return Error(input.error());
+    Try<Future<SpawnServer::Child>> child =
+        server.spawn(commandLine, input.get());
+    os::close(input.get());
+    if (child.isSome()) {
+      // The child starts in the cgroup of the spawn server.
+      return child->onReady([metrics](const SpawnServer::Child& child) {
+        CommandCgroup::instance().confine(child.pid, metrics);
+      });
+    }
+    TASK_LOG(WARNING, loggingMetadata)
+        << "Unable to use the spawn server, forking the agent: "
+        << child.error();
+  }
 
-  Try<Subprocess> command =
-      subprocess(executable, commandLine, Subprocess::PATH(args[0]));
+  // The child is confined before executing the command.
+  std::vector<Subprocess::ParentHook> hooks;
+  if (CommandCgroup::instance().isEnabled()) {
+    hooks.push_back(Subprocess::ParentHook([metrics](pid_t pid) {
+      CommandCgroup::instance().confine(pid, metrics);
+      return Try<Nothing>(Nothing());
+    }));
+  }
 
-  if (command.isError()) {
-    string errorMessage = "Error launching external command \"" + executable +
-                          "\": " + command.error();
-    TASK_LOG(ERROR, loggingMetadata) << errorMessage;
-    return Error(errorMessage);
+  // The in-memory files are only inherited by this command.
+  std::vector<Subprocess::ChildHook> childHooks;
+  for (int fd : fds) {
+    childHooks.push_back(Subprocess::ChildHook::UNSET_CLOEXEC(fd));
+  }
+
+  Try<Subprocess> process =
+      subprocess(executable, commandLine, Subprocess::PATH(inputPath),
+                 Subprocess::FD(STDOUT_FILENO), Subprocess::FD(STDERR_FILENO),
+                 nullptr, None(), None(), hooks, childHooks);
+  if (process.isError()) return Error(process.error());
+  return Future<SpawnServer::Child>(
+      SpawnServer::Child{process->pid(), process->status()});
+}
+
+// Poll of the output size of a command, stopped once the command is over so
+// that it never checks the files of a deleted context nor kills a process
+// already reaped.
+struct OutputSizeWatch {
+  std::mutex mutex;
+  bool stopped = false;
+};
+
+static void stopWatchingOutputSize(
+    const std::shared_ptr<OutputSizeWatch>& watch) {
+  std::lock_guard<std::mutex> lock(watch->mutex);
+  watch->stopped = true;
+}
+
+/*
+ * Kill a command as soon as its output gets bigger than its limit, so that
+ * it does not fill the temporary or in-memory files first. The size is only
+ * polled until the watch is stopped.
+ */
+static void watchOutputSize(const RunningContext& rc, pid_t pid,
+                            const std::shared_ptr<OutputSizeWatch>& watch,
+                            const logging::Metadata& loggingMetadata) {
+  {
+    std::lock_guard<std::mutex> lock(watch->mutex);
+    if (watch->stopped) return;
+    Option<Error> tooBig = rc.checkOutputSize();
+    if (tooBig.isSome()) {
+      TASK_LOG(WARNING, loggingMetadata) << tooBig->message << ", killing it";
+      Try<std::list<os::ProcessTree>> kill = os::killtree(pid, SIGKILL);
+      if (kill.isError()) {
+        TASK_LOG(ERROR, loggingMetadata) << "Failed to kill the command: "
+                                         << kill.error();
+      }
+      watch->stopped = true;
+      return;
+    }
   }
-  Subprocess process = command.get();
-  return process.status()
+  after(OUTPUT_SIZE_INTERVAL).onAny([=]() {
+    watchOutputSize(rc, pid, watch, loggingMetadata);
+  });
+}
+
+/*
+ * Wait for a started command and kill its process tree if it does not
+ * finish before the timeout deadline.
+ */
+static Future<Try<bool>> waitForCommand(
+    const std::string& executable, const RunningContext& rc,
+    const SpawnServer::Child& command, unsigned long timeoutInSeconds,
+    const logging::Metadata& loggingMetadata, CommandMetrics* metrics) {
+  pid_t pid = command.pid;
+  Future<Option<int>> status = command.status;
+  std::shared_ptr<OutputSizeWatch> watch;
+  if (rc.limitsOutput()) {
+    watch = std::make_shared<OutputSizeWatch>();
+    watchOutputSize(rc, pid, watch, loggingMetadata);
+    status.onAny([watch]() { stopWatchingOutputSize(watch); });
+  }
+  if (metrics != nullptr) {
+    metrics->runTime.time(status);
+    status.onAny([metrics]() { CommandCgroup::instance().account(metrics); });
+  }
+  Span running("run", loggingMetadata);
+  status.onAny([running](const Future<Option<int>>& status) {
+    if (!status.isReady() || status->isNone() || status->get() != 0) {
+      running.fail("The command did not exit successfully");
+    }
+    running.end();
+  });
+
+  return status
       .then([=](Option<int> status) -> Future<Try<bool>> {
         if (status.isNone()) {
           string errorMessage = "Error getting status for external command \"" +
                                 executable + "\"";
           TASK_LOG(ERROR, loggingMetadata) << errorMessage;
           return Error(errorMessage);
-        } else if (status.get() != 0) {
-          if (WIFSIGNALED(status.get()) && WTERMSIG(status.get()) != 0) {
-            int signalCode = WTERMSIG(status.get());
-            TASK_LOG(ERROR, loggingMetadata)
-                << "Failed to successfully run the command \"" << executable
-                << "\", it exited with signal " << signalCode;
-            return Error("Command \"" + executable + "\" exited via signal " +
-                         std::to_string(signalCode) + ".");
-          }
-          int exitCode = WEXITSTATUS(status.get());
-          string error(os::strerror(exitCode));
-          TASK_LOG(ERROR, loggingMetadata)
-              << "Failed to successfully run the command \"" << executable
-              << "\", it failed with status " << exitCode << " (" << error
-              << ")";
-          return Error("Command \"" + executable +
-                       "\" exited with return code " +
-                       std::to_string(exitCode) + ".");
         }
+        // Killed for writing too much.
+        Option<Error> tooBig = rc.checkOutputSize();
+        if (tooBig.isSome()) return tooBig.get();
+        Try<Nothing> exited =
+            checkStatus(executable, status.get(), loggingMetadata);
+        if (exited.isError()) return Error(exited.error());
         return true;
       })
-      .after(
-          Seconds(timeoutInSeconds),
-          [=](Future<Try<bool>> future) -> Future<Try<bool>> {
-            TASK_LOG(WARNING, loggingMetadata)
-                << "External command took too long to exit. "
-                << "Sending SIGTERM to " << process.pid() << "...";
-            Try<std::list<os::ProcessTree>> kill =
-                os::killtree(process.pid(), SIGTERM);
-            if (kill.isError()) {
-              TASK_LOG(ERROR, loggingMetadata) << "Failed to send SIGTERM: "
-                                               << kill.error();
-            }
-            return after(Seconds(1)).then([=]() -> Future<Try<bool>> {
-              if (processStillRunning(process.pid())) {
-                TASK_LOG(WARNING, loggingMetadata)
-                    << "External command is still running. Sending SIGKILL...";
-                Try<std::list<os::ProcessTree>> kill =
-                    os::killtree(process.pid(), SIGKILL);
-                if (kill.isError()) {
-                  TASK_LOG(ERROR, loggingMetadata)
-                      << "Failed to kill the command: " << kill.error();
-                  return Failure(
-                      "Command \"" + executable +
-                      "\" took too long to execute and SIGKILL failed.");
-                }
-              }
-              return Failure("Command \"" + executable +
-                             "\" took too long to execute.");
-            });
-          });
+      .after(Seconds(timeoutInSeconds),
+             [=](Future<Try<bool>> future) -> Future<Try<bool>> {
+               if (metrics != nullptr) ++metrics->timeouts;
+               running.fail("The command took too long to execute");
+               return terminateProcessTree(pid, loggingMetadata, metrics)
+                   .then([=](bool terminated) -> Future<Try<bool>> {
+                     if (!terminated) {
+                       return Failure(
+                           "Command \"" + executable +
+                           "\" took too long to execute and SIGKILL failed.");
+                     }
+                     return Failure("Command \"" + executable +
+                                    "\" took too long to execute.");
+                   });
+             })
+      // The status may still be pending after a timeout, and the context is
+      // deleted by the callers once this future is completed.
+      .onAny([watch]() {
+        if (watch) stopWatchingOutputSize(watch);
+      });
+}
+
+/*
+ * Start the process to run command and kill the child if it does not
+ * finish before the timeout deadline or if it writes too much.
+ *
+ * @param executable Absolute path to the executed of the command to execute in
+ * the child process.
+ * @param rc The files of the command, whose descriptors the child process
+ * inherits.
+ * @param timeout The timeout deadline in seconds before killing the
+ * child process.
+ * @param metrics The metrics of the command, if any.
+ */
+Future<Try<bool>> runCommandWithTimeout(
+    const std::string& executable, const RunningContext& rc,
+    unsigned long timeoutInSeconds, const logging::Metadata& loggingMetadata,
+    CommandMetrics* metrics) {
+  const vector<string>& args = rc.get_args();
+  vector<string> commandLine = {executable, args[0], args[1], args[2]};
+
+  Span spawning("spawn", loggingMetadata);
+  spawning.set("command", executable);
+  auto failed = [executable, loggingMetadata, spawning](const string& error) {
+    string errorMessage =
+        "Error launching external command \"" + executable + "\": " + error;
+    TASK_LOG(ERROR, loggingMetadata) << errorMessage;
+    spawning.fail(errorMessage);
+    return Error(errorMessage);
+  };
+
+  Try<Future<SpawnServer::Child>> command = spawnCommand(
+      executable, commandLine, args[0], rc.fds(), loggingMetadata, metrics);
+  if (command.isError()) return failed(command.error());
+  if (metrics != nullptr) metrics->spawnLatency.time(command.get());
+
+  Future<SpawnServer::Child> started = command.get();
+  return started
+      .then([=](const SpawnServer::Child& child) {
+        spawning.end();
+        return waitForCommand(executable, rc, child, timeoutInSeconds,
+                              loggingMetadata, metrics);
+      })
+      .recover([=](const Future<Try<bool>>& result) -> Future<Try<bool>> {
+        // Only the failures to start the command are reported as errors.
+        if (!started.isFailed()) return result;
+        return failed(started.failure());
+      });
 }
 
 CommandRunner::CommandRunner(bool debug,
-                             const logging::Metadata& loggingMetadata)
-    : m_debug(debug), m_loggingMetadata(loggingMetadata) {}
+                             const logging::Metadata& loggingMetadata,
+                             CommandMetrics* metrics)
+    : m_debug(debug), m_loggingMetadata(loggingMetadata), m_metrics(metrics) {}
+
+void CommandRunner::recordResult(bool succeeded) const {
+  if (m_metrics == nullptr) return;
+  ++m_metrics->calls;
+  if (!succeeded) ++m_metrics->failures;
+}
+
+void CommandRunner::recordResult(const Command& command,
+                                 CircuitBreaker::Admission admission,
+                                 bool succeeded) const {
+  recordResult(succeeded);
+  if (command.hasBreaker()) {
+    CircuitBreaker::get(command).record(command.breaker(), admission,
+                                        succeeded);
+  }
+}
+
+CircuitBreaker::Admission CommandRunner::admit(const Command& command) const {
+  if (!command.hasBreaker()) return CircuitBreaker::Admission::ALLOWED;
+  return CircuitBreaker::get(command).admit(command.breaker());
+}
+
+void CommandRunner::release(const Command& command,
+                            CircuitBreaker::Admission admission) const {
+  if (command.hasBreaker()) CircuitBreaker::get(command).release(admission);
+}
+
+Error CommandRunner::shortCircuit(const Command& command) const {
+  if (m_metrics != nullptr) ++m_metrics->shortCircuits;
+  const string& error = command.breaker().error;
+  return Error(error.empty() ? "Command \"" + command.command() +
+                                   "\" is short-circuited after failing"
+                             : error);
+}
 
 Future<Try<string>> CommandRunner::asyncRun(const Command& command,
-                                            const std::string& input) {
+                                            const std::string& input,
+                                            CommandPriority priority) {
+  if (command.isFanOut()) return runFanOut(command, input, priority);
+
+  // The command is not run while its circuit breaker is open.
+  CircuitBreaker::Admission admission = admit(command);
+  if (admission == CircuitBreaker::Admission::REJECTED) {
+    return shortCircuit(command);
+  }
+
+  CommandRunner runner(*this);
+  auto record = [runner, command,
+                 admission](const Future<Try<string>>& output) {
+    runner.recordResult(command, admission,
+                        output.isReady() && output->isSome());
+  };
+
+  if (command.isPersistent()) {
+    // The wait for the co-process is part of the span.
+    Span sending("persistent", m_loggingMetadata);
+    sending.set("command", command.command());
+    return CoProcess::get(command)
+        .send(input, command.timeout(), command.maxOutputBytes(), m_debug,
+              sending.metadata(), m_metrics)
+        .onAny(record)
+        .onAny([sending](const Future<Try<string>>& output) {
+          endSpan(sending, output);
+        });
+  }
+
+  Span queue("queue", m_loggingMetadata);
+  Future<Nothing> slot = CommandScheduler::instance().acquire(priority);
+  if (slot.isFailed()) {
+    TASK_LOG(WARNING, m_loggingMetadata) << "Not running command \""
+                                         << command.command()
+                                         << "\": " << slot.failure();
+    queue.fail(slot.failure());
+    recordResult(false);
+    release(command, admission);
+    return Error(slot.failure());
+  }
+
+  // The slot may still fail if a command of higher priority takes it, or be
+  // discarded by the caller. The command did not run then, so the breaker is
+  // not told of a failure.
+  slot.onAny([runner, command, admission,
+              queue](const Future<Nothing>& acquired) {
+    if (acquired.isReady()) return;
+    if (acquired.isFailed()) queue.fail(acquired.failure());
+    queue.end();
+    runner.recordResult(false);
+    runner.release(command, admission);
+  });
+  return slot.then([runner, command, input, queue, record]() {
+    queue.end();
+    return runner.runOneshot(command, input)
+        .onAny([]() { CommandScheduler::instance().release(); })
+        .onAny(record);
+  });
+}
+
+Future<Try<string>> CommandRunner::runFanOut(const Command& command,
+                                             const std::string& input,
+                                             CommandPriority priority) {
+  std::vector<Future<Try<string>>> outputs;
+  for (const Command& single : command.fanOut()) {
+    outputs.push_back(asyncRun(single, input, priority));
+  }
+
+  CommandFormat format = command.format();
+  auto merge = [format](const std::vector<Future<Try<string>>>& outputs)
+      -> Try<string> {
+    std::vector<string> values;
+    std::vector<string> errors;
+    for (const Future<Try<string>>& output : outputs) {
+      if (!output.isReady()) {
+        errors.push_back("Command execution error");
+      } else if (output->isError()) {
+        errors.push_back(output->error());
+      } else {
+        values.push_back(output->get());
+      }
+    }
+    if (!errors.empty()) return Error(strings::join("; ", errors));
+    return mergeOutputs(format, values);
+  };
+  return process::await(outputs).then(merge);
+}
+
+Future<Try<string>> CommandRunner::runOneshot(const Command& command,
+                                              const std::string& input) const {
+  Span setup("setup", m_loggingMetadata);
   try {
     RunningContext rc{m_debug, m_loggingMetadata, command, input};
+    setup.end();
 
-    return runCommandWithTimeout(command.command(), rc.get_args(),
-                                 command.timeout(), m_loggingMetadata)
+    return runCommandWithTimeout(command.command(), rc, command.timeout(),
+                                 m_loggingMetadata, m_metrics)
         .then([=](Try<bool> status) -> Future<Try<string>> {
           if (status.isError()) {
             Try<string> stderr = rc.readError();
@@ -149,7 +489,7 @@ Future<Try<string>> CommandRunner::asyncRun(const Command& command,
               return Error(status.error());
             return Error(status.error() + " Cause: " + stderr.get());
           }
-          return rc.readOutput();
+          return readOutput(rc, m_loggingMetadata);
         })
         .onAny([ =, loggingMetadata =
                         m_loggingMetadata ](Future<Try<string>> output)
@@ -158,6 +498,7 @@ Future<Try<string>> CommandRunner::asyncRun(const Command& command,
                      return output;
                    });
   } catch (const std::runtime_error& e) {
+    setup.fail(e.what());
     if (m_debug) {
       return Error("[DEBUG] " + string(e.what()) + ". Input was \"" + input +
                    "\"");
@@ -166,44 +507,218 @@ Future<Try<string>> CommandRunner::asyncRun(const Command& command,
   }
 }
 
-Try<string> CommandRunner::runWithoutTimeout(const Command& command,
-                                             const std::string& input) {
-  RunningContext rc{m_debug, m_loggingMetadata, command, input};
+/*
+ * Spawn the command with posix_spawnp, which does not duplicate the page
+ * tables of the agent like fork does and looks the command up in the PATH
+ * like subprocess, and wait for it without libprocess. The child is polled
+ * with an increasing interval and its process tree is killed like in
+ * runCommandWithTimeout if it does not exit in time or writes too much.
+ *
+ * @return The wait status of the command.
+ */
+static Try<int> spawnAndWait(const std::string& executable,
+                             const RunningContext& rc,
+                             unsigned long timeoutInSeconds,
+                             const logging::Metadata& loggingMetadata,
+                             CommandMetrics* metrics) {
+  const vector<string>& args = rc.get_args();
+  const vector<int> fds = rc.fds();
+  vector<string> commandLine = {executable, args[0], args[1], args[2]};
+  vector<char*> argv;
+  for (string& arg : commandLine) argv.push_back(&arg[0]);
+  argv.push_back(nullptr);
 
-  std::stringstream cmdline;
-  cmdline << command.command() << " ";
-  for (auto i : rc.get_args()) cmdline << i << " ";
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  // dup2 clears the close-on-exec flag of the in-memory files in the child
+  // only, going through stdin which is opened last.
+  for (int fd : fds) {
+    posix_spawn_file_actions_adddup2(&actions, fd, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, fd);
+  }
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, args[0].c_str(),
+                                   O_RDONLY, 0);
 
-  auto start = std::chrono::system_clock::now();
-  int ret = system(cmdline.str().c_str());
-  if (ret < 0) {
-    string errorMessage = "Error launching external command \"" +
-                          command.command() + "\": " + strerror(errno);
-    TASK_LOG(ERROR, m_loggingMetadata) << errorMessage;
+  pid_t pid;
+  auto spawn = [&]() {
+    return posix_spawnp(&pid, executable.c_str(), &actions, nullptr,
+                        argv.data(), os::raw::environment());
+  };
+  Span spawning("spawn", loggingMetadata);
+  spawning.set("command", executable);
+  int error =
+      metrics != nullptr ? timed(metrics->spawnLatency, spawn) : spawn();
+  posix_spawn_file_actions_destroy(&actions);
+  if (error != 0) {
+    string errorMessage = "Error launching external command \"" + executable +
+                          "\": " + os::strerror(error);
+    TASK_LOG(ERROR, loggingMetadata) << errorMessage;
+    spawning.fail(errorMessage);
     return Error(errorMessage);
   }
-  if (ret) {
-    Try<string> stderr = rc.readError();
-    std::string errMsg =
-        "Command exited with exit code: " + std::to_string(WEXITSTATUS(ret));
-    if (stderr.isError() || stderr.get().empty()) return Error(errMsg);
-    return Error(errMsg + " Cause: " + stderr.get());
+  spawning.end();
+  // Ends once the command is reaped.
+  Span running("run", loggingMetadata);
+  // The command may already be running, it is confined as soon as possible.
+  CommandCgroup::instance().confine(pid, metrics);
+
+  // Poll the child until the deadline, returning true once it is reaped.
+  int status = 0;
+  auto waitUntil = [pid, &status, &rc, &loggingMetadata](
+                       steady_clock::time_point deadline) -> Try<bool> {
+    milliseconds interval(1);
+    while (true) {
+      pid_t ret = waitpid(pid, &status, WNOHANG);
+      if (ret == pid) return true;
+      if (ret == -1 && errno != EINTR) {
+        return ErrnoError("Failed to wait for the command");
+      }
+      Option<Error> tooBig = rc.checkOutputSize();
+      if (tooBig.isSome()) {
+        TASK_LOG(WARNING, loggingMetadata) << tooBig->message
+                                           << ", killing it";
+        os::killtree(pid, SIGKILL);
+        while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+        }
+        return tooBig.get();
+      }
+      if (steady_clock::now() >= deadline) return false;
+      std::this_thread::sleep_for(interval);
+      interval = std::min(interval * 2, milliseconds(10));
+    }
+  };
+
+  // Commands killed after the timeout are measured until the deadline.
+  Promise<Nothing> done;
+  if (metrics != nullptr) metrics->runTime.time(done.future());
+  Try<bool> exited =
+      waitUntil(steady_clock::now() + seconds(timeoutInSeconds));
+  done.set(Nothing());
+  if (exited.isError()) {
+    TASK_LOG(ERROR, loggingMetadata) << exited.error();
+    running.fail(exited.error());
+    return Error(exited.error());
+  }
+  if (exited.get()) {
+    CommandCgroup::instance().account(metrics);
+    return status;
+  }
+
+  if (metrics != nullptr) ++metrics->timeouts;
+  running.fail("The command took too long to execute");
+
+  TASK_LOG(WARNING, loggingMetadata)
+      << "External command took too long to exit. "
+      << "Sending SIGTERM to " << pid << "...";
+  Try<std::list<os::ProcessTree>> kill = os::killtree(pid, SIGTERM);
+  if (kill.isError()) {
+    TASK_LOG(ERROR, loggingMetadata) << "Failed to send SIGTERM: "
+                                     << kill.error();
+  }
+
+  exited = waitUntil(steady_clock::now() + seconds(1));
+  if (exited.isError()) {
+    TASK_LOG(ERROR, loggingMetadata) << exited.error();
+  } else if (!exited.get()) {
+    TASK_LOG(WARNING, loggingMetadata)
+        << "External command is still running. Sending SIGKILL...";
+    if (metrics != nullptr) ++metrics->sigkills;
+    kill = os::killtree(pid, SIGKILL);
+    if (kill.isError()) {
+      TASK_LOG(ERROR, loggingMetadata) << "Failed to kill the command: "
+                                       << kill.error();
+      // The command is reaped whenever it exits so that it does not stay a
+      // zombie, without holding the caller.
+      std::thread([pid]() {
+        while (waitpid(pid, nullptr, 0) == -1 && errno == EINTR) {
+        }
+      }).detach();
+      return Error("Command \"" + executable +
+                   "\" took too long to execute and SIGKILL failed.");
+    }
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+    }
+  }
+  return Error("Command \"" + executable + "\" took too long to execute.");
+}
+
+Try<string> CommandRunner::runSynchronously(const Command& command,
+                                            const std::string& input,
+                                            CommandPriority priority) {
+  if (command.isPersistent() || command.isFanOut()) {
+    return run(command, input, priority);
   }
-  auto end = std::chrono::system_clock::now();
 
-  if (m_debug) {
-    std::chrono::duration<double> elapsed_seconds = end - start;
-    LOG(WARNING) << "Finished Executing : " << cmdline.str().c_str() << " in "
-                 << elapsed_seconds.count() << " seconds";
+  CircuitBreaker::Admission admission = admit(command);
+  if (admission == CircuitBreaker::Admission::REJECTED) {
+    return shortCircuit(command);
   }
-  auto output = rc.readOutput();
-  rc.deleteContext();
+
+  Span queue("queue", m_loggingMetadata);
+  Future<Nothing> slot = CommandScheduler::instance().acquire(priority);
+  // Callers are not libprocess workers so they can block on the slot, which
+  // fails if a command of higher priority takes its place.
+  slot.await();
+  if (slot.isFailed()) {
+    TASK_LOG(WARNING, m_loggingMetadata) << "Not running command \""
+                                         << command.command()
+                                         << "\": " << slot.failure();
+    queue.fail(slot.failure());
+    recordResult(false);
+    release(command, admission);
+    return Error(slot.failure());
+  }
+  queue.end();
+
+  Try<string> output = runSpawned(command, input);
+  CommandScheduler::instance().release();
+  recordResult(command, admission, output.isSome());
   return output;
 }
 
+Try<string> CommandRunner::runSpawned(const Command& command,
+                                      const std::string& input) const {
+  Span setup("setup", m_loggingMetadata);
+  try {
+    RunningContext rc{m_debug, m_loggingMetadata, command, input};
+    setup.end();
+
+    auto start = steady_clock::now();
+    Try<int> status =
+        spawnAndWait(command.command(), rc, command.timeout(),
+                     m_loggingMetadata, m_metrics);
+    if (m_debug) {
+      duration<double> elapsed = steady_clock::now() - start;
+      TASK_LOG(INFO, m_loggingMetadata)
+          << "Finished executing \"" << command.command() << "\" in "
+          << elapsed.count() << " seconds";
+    }
+
+    Try<Nothing> exited =
+        status.isError()
+            ? Try<Nothing>(Error(status.error()))
+            : checkStatus(command.command(), status.get(), m_loggingMetadata);
+
+    Try<string> output = exited.isError() ? Error(exited.error())
+                                          : readOutput(rc, m_loggingMetadata);
+    if (exited.isError()) {
+      Try<string> stderr = rc.readError();
+      if (stderr.isSome() && !stderr->empty()) {
+        output = Error(exited.error() + " Cause: " + stderr.get());
+      }
+    }
+    rc.deleteContext();
+    return output;
+  } catch (const std::runtime_error& e) {
+    setup.fail(e.what());
+    return Error(e.what());
+  }
+}
+
 Try<string> CommandRunner::run(const Command& command,
-                               const std::string& input) {
-  Future<Try<string>> output = asyncRun(command, input);
+                               const std::string& input,
+                               CommandPriority priority) {
+  Future<Try<string>> output = asyncRun(command, input, priority);
   auto result = await(output);
   if (!result.await()) {
     return Error("Command timed out");
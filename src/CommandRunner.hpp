@@ -1,25 +1,45 @@
 #ifndef __COMMAND_RUNNER_HPP__
 #define __COMMAND_RUNNER_HPP__
 
+#include <sys/types.h>
 #include <string>
 
 #include <process/future.hpp>
 #include <stout/try.hpp>
 
+#include "CircuitBreaker.hpp"
 #include "Command.hpp"
+#include "CommandScheduler.hpp"
 #include "Logger.hpp"
+#include "Metrics.hpp"
 
 namespace criteo {
 namespace mesos {
 
+/**
+ * Send a SIGTERM to the process tree rooted at pid and a SIGKILL one second
+ * later if it is still running.
+ *
+ * @param pid The pid of the root of the process tree to terminate.
+ * @param loggingMetadata The metadata like task id prepended to logs.
+ * @param metrics The metrics counting SIGKILL escalations, if any.
+ *
+ * @return A future resolving to false if SIGKILL was needed but failed.
+ */
+process::Future<bool> terminateProcessTree(
+    pid_t pid, const logging::Metadata& loggingMetadata,
+    CommandMetrics* metrics = nullptr);
+
 class CommandRunner {
  public:
   /**
    * @brief CommandRunner
    * @param debug true to publish debug level information, false otherwise.
    * @param loggingMetadata The metadata like task id prepended to logs.
+   * @param metrics The metrics of the method running the commands, if any.
    */
-  CommandRunner(bool debug, const logging::Metadata& loggingMetadata);
+  CommandRunner(bool debug, const logging::Metadata& loggingMetadata,
+                CommandMetrics* metrics = nullptr);
 
   /**
    * Run command receiving two paths to temporary files as input. The first is
@@ -36,27 +56,48 @@ class CommandRunner {
    *   the temporary file.
    * @param timeout The time in seconds for the command to terminate before
    *   being killed.
-   * @param debug Flag enabling the debug mode logging all inputs and outputs.
+   * @param priority The priority of the command if it has to wait for other
+   *   commands to terminate (see CommandScheduler).
    *
    * @return The output of the command retrieved from the temporary file.
    */
-  /* Try<std::string> run(const Command& command, */
   Try<std::string> run(const Command& command,
-                       const std::string& serializedInput);
+                       const std::string& serializedInput,
+                       CommandPriority priority = CommandPriority::NORMAL);
 
   /**
-   * Run a command synchonously without timeout and without using libprocess.
-   * Using libprocess in the watch loop can generate some deadlocks in
-   * libprocess.
+   * Run a command synchronously, blocking the calling thread until it exits,
+   * without using libprocess to wait for it. It must not be called from a
+   * libprocess worker.
+   *
+   * The command is spawned directly with posix_spawn so that it costs neither
+   * a copy of the page tables of the agent nor a shell. The timeout is handled
+   * like in `run`. Persistent commands are sent to their co-process with
+   * `run` instead.
+   *
+   * @param command The command to run.
+   * @param input The serialized input passed to the command through the
+   *   temporary file.
+   * @param priority The priority of the command if it has to wait for other
+   *   commands to terminate (see CommandScheduler).
+   *
+   * @return The output of the command retrieved from the temporary file.
    */
-  Try<std::string> runWithoutTimeout(const Command& command,
-                                     const std::string& input);
+  Try<std::string> runSynchronously(
+      const Command& command, const std::string& input,
+      CommandPriority priority = CommandPriority::NORMAL);
 
   /**
    * Run a command asynchonously.
    * This method leverages libprocess primitives to avoid blocking unnecessarily
    * while waiting for the command's output.
    *
+   * Persistent commands are not forked for each call: the input is sent to a
+   * long-lived co-process instead (see CoProcess). The parallel commands of a
+   * command are run concurrently and their outputs merged (see mergeOutputs),
+   * the call failing if any of them does. The call fails right away while the
+   * circuit breaker of the command is open (see CircuitBreaker).
+   *
    * The command must exit in less than the timeout given as parameter,
    * otherwise the process receives a SIGTERM and then a SIGKILL if it still has
    * not exited. SIGKILL is sent one second after the end of the timeout if the
@@ -65,15 +106,38 @@ class CommandRunner {
    * @param command The command to run.
    * @param serializedInput The serialized input passed to the command through
    *   the temporary file.
+   * @param priority The priority of the command if it has to wait for other
+   *   commands to terminate. LOW priority commands fail right away if too many
+   *   commands are already waiting (see CommandScheduler).
    *
    * @return Future on the output of the command
    */
   process::Future<Try<std::string>> asyncRun(
-      const Command& command, const std::string& serializedInput);
+      const Command& command, const std::string& serializedInput,
+      CommandPriority priority = CommandPriority::NORMAL);
 
  private:
+  // Run the commands of a fan-out concurrently and merge their outputs.
+  process::Future<Try<std::string>> runFanOut(const Command& command,
+                                              const std::string& input,
+                                              CommandPriority priority);
+  process::Future<Try<std::string>> runOneshot(
+      const Command& command, const std::string& serializedInput) const;
+  Try<std::string> runSpawned(const Command& command,
+                              const std::string& input) const;
+  void recordResult(bool succeeded) const;
+  void recordResult(const Command& command,
+                    CircuitBreaker::Admission admission,
+                    bool succeeded) const;
+  // Check the circuit breaker of the command, if it has one.
+  CircuitBreaker::Admission admit(const Command& command) const;
+  void release(const Command& command,
+               CircuitBreaker::Admission admission) const;
+  Error shortCircuit(const Command& command) const;
+
   bool m_debug;
   logging::Metadata m_loggingMetadata;
+  CommandMetrics* m_metrics;
 };
 
 }  // namespace mesos
@@ -0,0 +1,124 @@
+#include "CommandScheduler.hpp"
+
+namespace criteo {
+namespace mesos {
+
+using process::Future;
+using process::Owned;
+using process::Promise;
+
+CommandScheduler::CommandScheduler(size_t maxConcurrency, size_t maxQueueDepth)
+    : m_maxConcurrency(maxConcurrency),
+      m_maxQueueDepth(maxQueueDepth),
+      m_running(0) {}
+
+void CommandScheduler::configure(size_t maxConcurrency, size_t maxQueueDepth) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxConcurrency = maxConcurrency;
+    m_maxQueueDepth = maxQueueDepth;
+  }
+  // Raising the limit may allow queued commands to start.
+  schedule();
+}
+
+Future<Nothing> CommandScheduler::acquire(CommandPriority priority) {
+  Owned<Promise<Nothing>> evicted;
+  Future<Nothing> slot;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_maxConcurrency == 0 || m_running < m_maxConcurrency) {
+      ++m_running;
+      return Nothing();
+    }
+
+    size_t depth = 0;
+    for (const auto& queue : m_queues) depth += queue.size();
+    if (m_maxQueueDepth != 0 && depth >= m_maxQueueDepth) {
+      // The last command queued with a lower priority makes room, if any.
+      for (size_t i = m_queues.size() - 1; i > static_cast<size_t>(priority);
+           --i) {
+        if (!m_queues[i].empty()) {
+          evicted = m_queues[i].back();
+          m_queues[i].pop_back();
+          break;
+        }
+      }
+      if (evicted.get() == nullptr) {
+        return process::Failure("Too many commands queued (" +
+                                std::to_string(depth) + ")");
+      }
+    }
+
+    Owned<Promise<Nothing>> promise(new Promise<Nothing>());
+    m_queues[static_cast<size_t>(priority)].push_back(promise);
+    slot = promise->future();
+  }
+
+  // Failed outside of the lock like in schedule().
+  if (evicted.get() != nullptr) {
+    evicted->fail("Too many commands queued, preempted by a higher priority");
+  }
+  return slot;
+}
+
+void CommandScheduler::release() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    --m_running;
+  }
+  schedule();
+}
+
+void CommandScheduler::schedule() {
+  while (true) {
+    Owned<Promise<Nothing>> next;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_maxConcurrency != 0 && m_running >= m_maxConcurrency) return;
+
+      for (auto& queue : m_queues) {
+        if (!queue.empty()) {
+          next = queue.front();
+          queue.pop_front();
+          break;
+        }
+      }
+      if (next.get() == nullptr) return;
+      ++m_running;
+    }
+
+    // The promise is completed outside of the lock since its callbacks are
+    // run synchronously and may start or terminate other commands.
+    if (next->future().hasDiscard()) {
+      // The caller gave up waiting, the slot goes to the next command.
+      next->discard();
+      std::lock_guard<std::mutex> lock(m_mutex);
+      --m_running;
+    } else {
+      next->set(Nothing());
+    }
+  }
+}
+
+size_t CommandScheduler::running() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_running;
+}
+
+size_t CommandScheduler::queued() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  size_t depth = 0;
+  for (const auto& queue : m_queues) depth += queue.size();
+  return depth;
+}
+
+CommandScheduler& CommandScheduler::instance() {
+  // Intentionally leaked so that it outlives every module instance.
+  static CommandScheduler* scheduler = new CommandScheduler();
+  return *scheduler;
+}
+
+}  // namespace mesos
+}  // namespace criteo
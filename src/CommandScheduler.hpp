@@ -0,0 +1,82 @@
+#ifndef __COMMAND_SCHEDULER_HPP__
+#define __COMMAND_SCHEDULER_HPP__
+
+#include <array>
+#include <deque>
+#include <mutex>
+
+#include <process/future.hpp>
+#include <process/owned.hpp>
+#include <stout/nothing.hpp>
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * @brief The priority of a command in the queue of the scheduler. Commands
+ * delaying a container start or stop go first, monitoring commands last.
+ */
+enum class CommandPriority { HIGH = 0, NORMAL = 1, LOW = 2 };
+
+/**
+ * @brief The CommandScheduler class limits the number of external commands
+ * running at the same time in the agent.
+ *
+ * Commands exceeding the limit wait in one queue per priority and are started
+ * as soon as a running command terminates, higher priorities first. Once the
+ * queue is full, commands are rejected right away instead of piling up and
+ * stalling their callers, unless a command of lower priority is queued, the
+ * last of which is rejected to make room.
+ *
+ * A limit of 0 means unlimited, which is the default.
+ */
+class CommandScheduler {
+ public:
+  CommandScheduler(size_t maxConcurrency = 0, size_t maxQueueDepth = 0);
+
+  /**
+   * Change the limits. Commands already running or queued are kept.
+   */
+  void configure(size_t maxConcurrency, size_t maxQueueDepth);
+
+  /**
+   * Reserve a slot to run a command.
+   *
+   * @param priority The priority of the command in the queue.
+   *
+   * @return A future resolving once the command can be started, or failed if
+   *   the queue is full or if a command of higher priority took its place.
+   *   Discarding it gives up the place in the queue.
+   */
+  process::Future<Nothing> acquire(CommandPriority priority);
+
+  /**
+   * Release the slot of a terminated command, starting the next queued one.
+   */
+  void release();
+
+  size_t running() const;
+  size_t queued() const;
+
+  /**
+   * Get the scheduler shared by all the module instances.
+   */
+  static CommandScheduler& instance();
+
+ private:
+  // Start queued commands while there are free slots.
+  void schedule();
+
+  size_t m_maxConcurrency;
+  size_t m_maxQueueDepth;
+  size_t m_running;
+
+  std::array<std::deque<process::Owned<process::Promise<Nothing>>>, 3>
+      m_queues;
+  mutable std::mutex m_mutex;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __COMMAND_SCHEDULER_HPP__
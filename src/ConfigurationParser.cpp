@@ -1,7 +1,11 @@
 #include "ConfigurationParser.hpp"
 
 #include <map>
+#include <stdexcept>
+#include <vector>
 #include <stout/foreach.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
 
 namespace criteo {
 namespace mesos {
@@ -23,8 +27,33 @@ const string WATCH_KEY = "isolator_watch";
 const string CLEANUP_KEY = "isolator_cleanup";
 const string USAGE_KEY = "isolator_usage";
 
+// Isolator options.
+const string USAGE_BATCH_WINDOW_KEY = "isolator_usage_batch_window";
+const string USAGE_CACHE_TTL_KEY = "isolator_usage_cache_ttl";
+const string USAGE_DELTA_KEY = "isolator_usage_delta";
+const string USAGE_STATS_TABLE_KEY = "isolator_usage_stats_table";
+const string CLEANUP_BATCH_WINDOW_KEY = "isolator_cleanup_batch_window";
+const string CLEANUP_BATCH_SIZE_KEY = "isolator_cleanup_batch_size";
+const string CLEANUP_RETRIES_KEY = "isolator_cleanup_retries";
+const string WATCH_THREADS_KEY = "isolator_watch_threads";
+const string WATCH_BATCH_KEY = "isolator_watch_batch";
+const string WATCH_MIN_PERIOD_KEY = "isolator_watch_min_period";
+const string WATCH_MAX_PERIOD_KEY = "isolator_watch_max_period";
+const string CHECKPOINT_FILE_KEY = "isolator_checkpoint_file";
+
+// Scheduler options.
+const string SCHEDULER_MAX_CONCURRENCY_KEY = "scheduler_max_concurrency";
+const string SCHEDULER_MAX_QUEUE_DEPTH_KEY = "scheduler_max_queue_depth";
+const string SCHEDULER_SPAWN_SERVER_KEY = "scheduler_spawn_server";
+const string SCHEDULER_CGROUP_KEY = "scheduler_cgroup";
+const string SCHEDULER_SPAN_FILE_KEY = "scheduler_span_file";
+const string SCHEDULER_SPAN_SAMPLE_RATE_KEY = "scheduler_span_sample_rate";
+
 // Additional parameters.
 const string DEBUG_KEY = "debug";  // enable debug mode.
+const string NAME_KEY = "name";    // name of the module in metrics.
+const string TRACE_FILE_KEY = "trace_file";  // file recording the events.
+const string CONFIG_FILE_KEY = "config_file";  // file reloaded when changed.
 
 string getOrEmpty(const map<string, string>& kv, const string& key) {
   string command;
@@ -43,16 +72,108 @@ map<string, string> toMap(const ::mesos::Parameters& parameters) {
   return kv;
 }
 
+// Sizes and counts are non-negative integers, which stoul alone does not
+// check: it accepts "-1" and wraps it around.
+size_t parseSize(const std::string& key, const std::string& value) {
+  if (value.empty() ||
+      value.find_first_not_of("0123456789") != string::npos) {
+    throw std::invalid_argument("Invalid value \"" + value + "\" for " + key +
+                                ", a non-negative integer is expected");
+  }
+  return stoul(value);
+}
+
+Option<size_t> extractSize(const map<string, string>& kv,
+                           const std::string& key) {
+  string sizeStr = getOrEmpty(kv, key);
+  if (sizeStr.empty()) return None();
+  return parseSize(key, sizeStr);
+}
+
+// Same as extractSize for the counts which cannot be zero, e.g., of threads.
+Option<size_t> extractPositiveSize(const map<string, string>& kv,
+                                   const std::string& key) {
+  Option<size_t> size = extractSize(kv, key);
+  if (size.isSome() && size.get() == 0) {
+    throw std::invalid_argument("Invalid value \"0\" for " + key +
+                                ", a positive integer is expected");
+  }
+  return size;
+}
+
+// Several commands can be run in parallel for the same event with numbered
+// keys, e.g., isolator_prepare_command_1, isolator_prepare_command_2, ...
+std::vector<string> extractCommandLines(const map<string, string>& kv,
+                                        const std::string& commandKey) {
+  std::vector<string> commandLines;
+  string cmd = getOrEmpty(kv, commandKey + "_command");
+  if (!cmd.empty()) commandLines.push_back(cmd);
+
+  for (size_t i = 1;; ++i) {
+    cmd = getOrEmpty(kv, commandKey + "_command_" + stringify(i));
+    if (cmd.empty()) break;
+    commandLines.push_back(cmd);
+  }
+  return commandLines;
+}
+
 Option<Command> extractCommand(const map<string, string>& kv,
                                const std::string& commandKey) {
-  string cmd = getOrEmpty(kv, commandKey + "_command");
-  if (!cmd.empty()) {
-    Command command = Command(cmd);
+  std::vector<string> commandLines = extractCommandLines(kv, commandKey);
+  if (!commandLines.empty()) {
+    Command command = Command(commandLines.front());
+    for (size_t i = 1; i < commandLines.size(); ++i) {
+      command.addParallelCommand(commandLines[i]);
+    }
+
+    Option<size_t> timeout = extractSize(kv, commandKey + "_timeout");
+    if (timeout.isSome()) command.setTimeout(timeout.get());
+
+    string modeStr = getOrEmpty(kv, commandKey + "_mode");
+    if (modeStr == "persistent") {
+      command.setMode(CommandMode::PERSISTENT);
+    } else if (!modeStr.empty() && modeStr != "oneshot") {
+      throw std::invalid_argument("Unknown mode \"" + modeStr + "\" for " +
+                                  commandKey);
+    }
+
+    string transportStr = getOrEmpty(kv, commandKey + "_transport");
+    if (transportStr == "memfd") {
+      command.setTransport(CommandTransport::MEMFD);
+    } else if (!transportStr.empty() && transportStr != "file") {
+      throw std::invalid_argument("Unknown transport \"" + transportStr +
+                                  "\" for " + commandKey);
+    }
 
-    string timeoutStr = getOrEmpty(kv, commandKey + "_timeout");
-    if (!timeoutStr.empty()) {
-      unsigned long timeout = stoul(timeoutStr);
-      command.setTimeout(timeout);
+    Option<size_t> maxOutputBytes =
+        extractSize(kv, commandKey + "_max_output_bytes");
+    if (maxOutputBytes.isSome()) {
+      command.setMaxOutputBytes(maxOutputBytes.get());
+    }
+    Option<size_t> maxErrorBytes =
+        extractSize(kv, commandKey + "_max_error_bytes");
+    if (maxErrorBytes.isSome()) command.setMaxErrorBytes(maxErrorBytes.get());
+
+    string formatStr = getOrEmpty(kv, commandKey + "_format");
+    if (formatStr == "protobuf") {
+      command.setFormat(CommandFormat::PROTOBUF);
+    } else if (!formatStr.empty() && formatStr != "json") {
+      throw std::invalid_argument("Unknown format \"" + formatStr + "\" for " +
+                                  commandKey);
+    }
+
+    // The circuit breaker is enabled by its number of failures.
+    Option<size_t> breakerFailures =
+        extractSize(kv, commandKey + "_breaker_failures");
+    if (breakerFailures.isSome()) {
+      BreakerOptions breaker;
+      breaker.failures = breakerFailures.get();
+      string backoff = getOrEmpty(kv, commandKey + "_breaker_backoff");
+      if (!backoff.empty()) breaker.backoff = std::stod(backoff);
+      string maxBackoff = getOrEmpty(kv, commandKey + "_breaker_max_backoff");
+      if (!maxBackoff.empty()) breaker.maxBackoff = std::stod(maxBackoff);
+      breaker.error = getOrEmpty(kv, commandKey + "_breaker_error");
+      command.setBreaker(breaker);
     }
 
     return Option<Command>(command);
@@ -60,19 +181,54 @@ Option<Command> extractCommand(const map<string, string>& kv,
   return Option<Command>();
 }
 
+// Durations are given in seconds and can be fractional, e.g., 0.05.
+Option<Duration> extractDuration(const map<string, string>& kv,
+                                 const std::string& key) {
+  string durationStr = getOrEmpty(kv, key);
+  if (durationStr.empty()) return None();
+
+  Try<Duration> duration = Duration::create(std::stod(durationStr));
+  if (duration.isError()) {
+    throw std::out_of_range("Invalid duration for " + key + ": " +
+                            duration.error());
+  }
+  return duration.get();
+}
+
+// The cache of a command is enabled by its size, the key is a comma-separated
+// list of fields of the input.
+Option<CacheOptions> extractCacheOptions(const map<string, string>& kv,
+                                         const std::string& commandKey) {
+  Option<size_t> size = extractSize(kv, commandKey + "_cache_size");
+  if (size.isNone()) return None();
+
+  CacheOptions options;
+  options.size = size.get();
+  options.ttl = extractDuration(kv, commandKey + "_cache_ttl");
+  foreach (const string& field,
+           strings::tokenize(getOrEmpty(kv, commandKey + "_cache_key"), ",")) {
+    string trimmed = strings::trim(field);
+    if (!trimmed.empty()) options.keyFields.push_back(trimmed);
+  }
+  return options;
+}
+
 Option<RecurrentCommand> extractRecurrentCommand(
     const map<string, string>& kv, const std::string& commandKey) {
   Option<Command> baseCmd = extractCommand(kv, commandKey);
 
   if (baseCmd.isNone()) return Option<RecurrentCommand>();
 
+  // Watch commands are run on threads of their own, one call at a time.
+  if (baseCmd->isPersistent()) {
+    throw std::invalid_argument("The persistent mode is not supported for " +
+                                commandKey);
+  }
+
   RecurrentCommand command = RecurrentCommand(baseCmd.get());
 
-  string frequenceStr = getOrEmpty(kv, commandKey + "_frequence");
-  if (!frequenceStr.empty()) {
-    unsigned long frequence = stoul(frequenceStr);
-    command.setFrequence(frequence);
-  }
+  Option<size_t> frequence = extractSize(kv, commandKey + "_frequence");
+  if (frequence.isSome()) command.setFrequence(frequence.get());
 
   return Option<RecurrentCommand>(command);
 }
@@ -88,11 +244,100 @@ Configuration ConfigurationParser::parse(
       extractCommand(p, SLAVE_REMOVE_EXECUTOR_KEY);
   configuration.slaveRunTaskLabelDecoratorCommand =
       extractCommand(p, SLAVE_RUN_TASK_LABEL_DECORATOR_KEY);
+  configuration.hookOptions.runTaskLabelCache =
+      extractCacheOptions(p, SLAVE_RUN_TASK_LABEL_DECORATOR_KEY);
+  configuration.hookOptions.executorEnvironmentCache =
+      extractCacheOptions(p, SLAVE_EXECUTOR_ENVIRONMENT_DECORATOR_KEY);
+  configuration.hookOptions.runTaskLabelDeadline =
+      extractDuration(p, SLAVE_RUN_TASK_LABEL_DECORATOR_KEY + "_deadline");
+  configuration.hookOptions.executorEnvironmentDeadline = extractDuration(
+      p, SLAVE_EXECUTOR_ENVIRONMENT_DECORATOR_KEY + "_deadline");
 
   configuration.prepareCommand = extractCommand(p, PREPARE_KEY);
   configuration.watchCommand = extractRecurrentCommand(p, WATCH_KEY);
   configuration.cleanupCommand = extractCommand(p, CLEANUP_KEY);
   configuration.usageCommand = extractCommand(p, USAGE_KEY);
+  configuration.isolatorOptions.usageBatchWindow =
+      extractDuration(p, USAGE_BATCH_WINDOW_KEY);
+  configuration.isolatorOptions.usageCacheTtl =
+      extractDuration(p, USAGE_CACHE_TTL_KEY);
+  configuration.isolatorOptions.usageDelta =
+      getOrEmpty(p, USAGE_DELTA_KEY) == "true";
+  string statsTable = getOrEmpty(p, USAGE_STATS_TABLE_KEY);
+  if (!statsTable.empty()) {
+    configuration.isolatorOptions.usageStatsTable = statsTable;
+  }
+  configuration.isolatorOptions.usageStatsTableCapacity =
+      extractSize(p, USAGE_STATS_TABLE_KEY + "_capacity");
+  configuration.isolatorOptions.cleanupBatchWindow =
+      extractDuration(p, CLEANUP_BATCH_WINDOW_KEY);
+  configuration.isolatorOptions.cleanupBatchSize =
+      extractSize(p, CLEANUP_BATCH_SIZE_KEY);
+  configuration.isolatorOptions.cleanupRetries =
+      extractSize(p, CLEANUP_RETRIES_KEY);
+  configuration.isolatorOptions.watchThreads =
+      extractPositiveSize(p, WATCH_THREADS_KEY);
+  configuration.isolatorOptions.watchBatch =
+      getOrEmpty(p, WATCH_BATCH_KEY) == "true";
+  configuration.isolatorOptions.watchMinPeriod =
+      extractDuration(p, WATCH_MIN_PERIOD_KEY);
+  configuration.isolatorOptions.watchMaxPeriod =
+      extractDuration(p, WATCH_MAX_PERIOD_KEY);
+  string checkpointFile = getOrEmpty(p, CHECKPOINT_FILE_KEY);
+  if (!checkpointFile.empty()) {
+    configuration.isolatorOptions.checkpointFile = checkpointFile;
+  }
+
+  configuration.schedulerOptions.maxConcurrency =
+      extractSize(p, SCHEDULER_MAX_CONCURRENCY_KEY);
+  configuration.schedulerOptions.maxQueueDepth =
+      extractSize(p, SCHEDULER_MAX_QUEUE_DEPTH_KEY);
+  string spawnServer = getOrEmpty(p, SCHEDULER_SPAWN_SERVER_KEY);
+  if (!spawnServer.empty()) {
+    configuration.schedulerOptions.spawnServer = spawnServer;
+  }
+  string cgroup = getOrEmpty(p, SCHEDULER_CGROUP_KEY);
+  if (!cgroup.empty()) {
+    CgroupOptions options;
+    options.name = cgroup;
+    string hierarchy = getOrEmpty(p, SCHEDULER_CGROUP_KEY + "_hierarchy");
+    if (!hierarchy.empty()) options.hierarchy = hierarchy;
+    options.cpuShares = extractSize(p, SCHEDULER_CGROUP_KEY + "_cpu_shares");
+    string cpus = getOrEmpty(p, SCHEDULER_CGROUP_KEY + "_cpus");
+    if (!cpus.empty()) options.cpus = std::stod(cpus);
+    options.memoryLimit =
+        extractSize(p, SCHEDULER_CGROUP_KEY + "_memory_limit");
+    string cpuset = getOrEmpty(p, SCHEDULER_CGROUP_KEY + "_cpuset");
+    if (!cpuset.empty()) options.cpuset = cpuset;
+    configuration.schedulerOptions.cgroup = options;
+  }
+  string spanFile = getOrEmpty(p, SCHEDULER_SPAN_FILE_KEY);
+  if (!spanFile.empty()) {
+    SpanOptions options;
+    options.file = spanFile;
+    string sampleRate = getOrEmpty(p, SCHEDULER_SPAN_SAMPLE_RATE_KEY);
+    if (!sampleRate.empty()) options.sampleRate = std::stod(sampleRate);
+    configuration.schedulerOptions.spans = options;
+  }
+
+  string name = getOrEmpty(p, NAME_KEY);
+  if (!name.empty()) {
+    configuration.isolatorOptions.name = name;
+    configuration.hookOptions.name = name;
+  }
+
+  string traceFile = getOrEmpty(p, TRACE_FILE_KEY);
+  if (!traceFile.empty()) {
+    configuration.isolatorOptions.traceFile = traceFile;
+    configuration.hookOptions.traceFile = traceFile;
+  }
+
+  string configFile = getOrEmpty(p, CONFIG_FILE_KEY);
+  if (!configFile.empty()) {
+    configuration.configFile = configFile;
+  }
+  configuration.configFileInterval =
+      extractDuration(p, CONFIG_FILE_KEY + "_interval");
 
   configuration.isDebugSet = getOrEmpty(p, DEBUG_KEY) == "true";
   return configuration;
@@ -1,10 +1,14 @@
 #ifndef CONFIGURATION_PARSER_HPP
 #define CONFIGURATION_PARSER_HPP
 
+#include <string>
+
 #include <mesos/mesos.pb.h>
+#include <stout/duration.hpp>
 #include <stout/option.hpp>
 
 #include "Command.hpp"
+#include "Options.hpp"
 
 namespace criteo {
 namespace mesos {
@@ -18,13 +22,22 @@ struct Configuration {
   Option<RecurrentCommand> watchCommand;
   Option<Command> cleanupCommand;
   Option<Command> usageCommand;
+  IsolatorOptions isolatorOptions;
 
   Option<Command> slaveRunTaskLabelDecoratorCommand;
   Option<Command> slaveExecutorEnvironmentDecoratorCommand;
   Option<Command> slaveRemoveExecutorHookCommand;
+  HookOptions hookOptions;
+
+  SchedulerOptions schedulerOptions;
 
   // this flag allows the user to enable debug mode.
   bool isDebugSet;
+
+  // If set, the file overriding the parameters, reloaded when it changes
+  // (see ConfigurationWatcher), and the time between two checks of the file.
+  Option<std::string> configFile;
+  Option<Duration> configFileInterval;
 };
 
 /**
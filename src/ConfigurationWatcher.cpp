@@ -0,0 +1,164 @@
+#include "ConfigurationWatcher.hpp"
+
+#include <process/delay.hpp>
+#include <process/dispatch.hpp>
+#include <process/id.hpp>
+#include <process/process.hpp>
+
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/json.hpp>
+#include <stout/os/read.hpp>
+#include <stout/result.hpp>
+#include <stout/stringify.hpp>
+
+namespace criteo {
+namespace mesos {
+
+using std::string;
+
+// Read the file and build the configuration, None if the file is unchanged.
+static Result<Configuration> load(const string& path,
+                                  const ::mesos::Parameters& parameters,
+                                  Option<string>* content) {
+  Try<string> read = os::read(path);
+  if (read.isError()) {
+    return Error("Unable to read the configuration file \"" + path +
+                 "\": " + read.error());
+  }
+  if (content->isSome() && content->get() == read.get()) return None();
+  *content = read.get();
+
+  Try<::mesos::Parameters> overlaid =
+      ConfigurationWatcher::overlay(parameters, read.get());
+  if (overlaid.isError()) {
+    return Error("Invalid configuration file \"" + path +
+                 "\": " + overlaid.error());
+  }
+  // The parser throws on a malformed value, which would otherwise stop the
+  // agent when the file is edited.
+  try {
+    return ConfigurationParser::parse(overlaid.get());
+  } catch (const std::exception& e) {
+    return Error("Invalid configuration file \"" + path + "\": " + e.what());
+  }
+}
+
+class ConfigurationWatcherProcess
+    : public process::Process<ConfigurationWatcherProcess> {
+ public:
+  ConfigurationWatcherProcess(const string& path,
+                              const ::mesos::Parameters& parameters,
+                              const Duration& interval,
+                              const Option<string>& content)
+      : ProcessBase(process::ID::generate("configuration-watcher")),
+        m_path(path),
+        m_parameters(parameters),
+        m_interval(interval),
+        m_content(content) {}
+
+  void start(const ConfigurationWatcher::Callback& callback) {
+    m_callback = callback;
+    process::delay(m_interval, self(), &Self::check);
+  }
+
+ private:
+  void check() {
+    Result<Configuration> configuration =
+        load(m_path, m_parameters, &m_content);
+    if (configuration.isError()) {
+      // A missing file is only reported once, not on every check.
+      if (m_error != configuration.error()) {
+        LOG(WARNING) << configuration.error();
+      }
+      m_error = configuration.error();
+    } else {
+      m_error = None();
+      if (configuration.isSome()) {
+        LOG(INFO) << "Reloading the configuration from \"" << m_path << "\"";
+        m_callback(configuration.get());
+      }
+    }
+    process::delay(m_interval, self(), &Self::check);
+  }
+
+  const string m_path;
+  const ::mesos::Parameters m_parameters;
+  const Duration m_interval;
+  // Content of the file when it was read last, None if it never was.
+  Option<string> m_content;
+  Option<string> m_error;
+  ConfigurationWatcher::Callback m_callback;
+};
+
+ConfigurationWatcher::ConfigurationWatcher(
+    const string& path, const ::mesos::Parameters& parameters,
+    const Duration& interval) {
+  Option<string> content;
+  Result<Configuration> configuration = load(path, parameters, &content);
+  if (configuration.isSome()) {
+    m_configuration = configuration.get();
+  } else {
+    // The module still starts, with its own parameters, already parsed
+    // successfully by the module factory.
+    LOG(WARNING) << configuration.error();
+    m_configuration = ConfigurationParser::parse(parameters);
+  }
+
+  m_process =
+      new ConfigurationWatcherProcess(path, parameters, interval, content);
+  spawn(m_process);
+}
+
+ConfigurationWatcher::~ConfigurationWatcher() {
+  terminate(m_process);
+  wait(m_process);
+  delete m_process;
+}
+
+void ConfigurationWatcher::start(const Callback& callback) {
+  dispatch(m_process, &ConfigurationWatcherProcess::start, callback);
+}
+
+Try<::mesos::Parameters> ConfigurationWatcher::overlay(
+    const ::mesos::Parameters& parameters, const string& content) {
+  Try<JSON::Object> json = JSON::parse<JSON::Object>(content);
+  if (json.isError()) return Error("Malformed JSON. " + json.error());
+
+  hashmap<string, Option<string>> values;
+  foreachpair (const string& key, const JSON::Value& value, json->values) {
+    if (value.is<JSON::Null>()) {
+      values[key] = None();
+    } else if (value.is<JSON::String>()) {
+      values[key] = value.as<JSON::String>().value;
+    } else if (value.is<JSON::Number>() || value.is<JSON::Boolean>()) {
+      values[key] = stringify(value);
+    } else {
+      return Error("The value of \"" + key + "\" must be a scalar");
+    }
+  }
+
+  // The parameters keep their order, the new ones coming last. The values
+  // used are reset so that only the new ones are left.
+  ::mesos::Parameters overlaid;
+  foreach (const ::mesos::Parameter& parameter, parameters.parameter()) {
+    if (!values.contains(parameter.key())) {
+      overlaid.add_parameter()->CopyFrom(parameter);
+    } else if (values.at(parameter.key()).isSome()) {
+      ::mesos::Parameter* added = overlaid.add_parameter();
+      added->set_key(parameter.key());
+      added->set_value(values.at(parameter.key()).get());
+      values[parameter.key()] = None();
+    }
+  }
+  foreachpair (const string& key, const Option<string>& value, values) {
+    if (value.isNone()) continue;
+    ::mesos::Parameter* added = overlaid.add_parameter();
+    added->set_key(key);
+    added->set_value(value.get());
+  }
+  return overlaid;
+}
+
+}  // namespace mesos
+}  // namespace criteo
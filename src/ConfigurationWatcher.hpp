@@ -0,0 +1,98 @@
+#ifndef __CONFIGURATION_WATCHER_HPP__
+#define __CONFIGURATION_WATCHER_HPP__
+
+#include <functional>
+#include <string>
+
+#include <glog/logging.h>
+#include <mesos/mesos.pb.h>
+
+#include <stout/duration.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+#include "ConfigurationParser.hpp"
+
+namespace criteo {
+namespace mesos {
+
+// Forward declaration
+class ConfigurationWatcherProcess;
+
+/**
+ * @brief The ConfigurationWatcher class reloads the configuration of a module
+ * from a file so that it can be tuned without restarting the agent.
+ *
+ * The file is a JSON object overriding the parameters of the module, a null
+ * value removing the parameter:
+ *
+ *   {"isolator_watch_frequence": 10, "scheduler_max_concurrency": 32}
+ *
+ * It is checked periodically and the configuration built from the parameters
+ * of the module and the file is passed to the callback whenever the content
+ * of the file changes.
+ */
+class ConfigurationWatcher {
+ public:
+  typedef std::function<void(const Configuration&)> Callback;
+
+  /**
+   * Read the file once, the configuration being reloaded after `start`.
+   *
+   * @param path The path of the file.
+   * @param parameters The parameters of the module.
+   * @param interval The time between two checks of the file.
+   */
+  ConfigurationWatcher(const std::string& path,
+                       const ::mesos::Parameters& parameters,
+                       const Duration& interval);
+
+  ~ConfigurationWatcher();
+
+  /**
+   * @return The configuration built from the file as it was read last.
+   */
+  const Configuration& configuration() const { return m_configuration; }
+
+  /**
+   * Start checking the file. The callback runs on the thread of the watcher.
+   */
+  void start(const Callback& callback);
+
+  /**
+   * Override parameters with the values of a JSON object.
+   */
+  static Try<::mesos::Parameters> overlay(const ::mesos::Parameters& parameters,
+                                          const std::string& content);
+
+ private:
+  ConfigurationWatcher(const ConfigurationWatcher&) = delete;
+  ConfigurationWatcher& operator=(const ConfigurationWatcher&) = delete;
+
+  Configuration m_configuration;
+  ConfigurationWatcherProcess* m_process;
+};
+
+/**
+ * Reload an option whose presence changes the structure of a module, e.g.,
+ * whether a command runs or whether calls are batched, which requires a
+ * restart. Its value is only replaced if it is still set, or still unset.
+ *
+ * @param name The parameter setting the option, in the warnings.
+ */
+template <class T>
+void reloadOption(Option<T>* current, const Option<T>& next,
+                  const std::string& name) {
+  if (current->isSome() != next.isSome()) {
+    LOG(WARNING) << "Ignoring " << name << " since "
+                 << (next.isSome() ? "setting" : "removing")
+                 << " it requires a restart";
+    return;
+  }
+  *current = next;
+}
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __CONFIGURATION_WATCHER_HPP__
@@ -0,0 +1,281 @@
+#include "ContainerCheckpoint.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/numify.hpp>
+#include <stout/os/read.hpp>
+#include <stout/os/strerror.hpp>
+#include <stout/os/write.hpp>
+#include <stout/path.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+namespace criteo {
+namespace mesos {
+
+using ::mesos::ContainerID;
+using std::string;
+
+const char PREPARED = 'P';
+const char CLEANED_UP = 'C';
+
+// The log is rewritten once it has this many records, and twice as many as
+// the containers prepared.
+const size_t MIN_COMPACTION_RECORDS = 256;
+
+static string preparedRecord(const ContainerID& containerId,
+                             const ContainerCheckpoint::Entry& entry) {
+  string id = containerId.SerializeAsString();
+  const string& input = *entry.input;
+  string protobufInput = entry.protobufInput ? *entry.protobufInput : "";
+  return string(1, PREPARED) + " " + stringify(id.size()) + " " +
+         stringify(input.size()) + " " + stringify(protobufInput.size()) +
+         "\n" + id + input + protobufInput;
+}
+
+static string cleanedUpRecord(const ContainerID& containerId) {
+  string id = containerId.SerializeAsString();
+  return string(1, CLEANED_UP) + " " + stringify(id.size()) + "\n" + id;
+}
+
+Try<process::Owned<ContainerCheckpoint>> ContainerCheckpoint::open(
+    const string& path) {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                  0600);
+  // The inputs hold the environment of the containers, so the log must not
+  // stay readable by others if it was created with a wider mode.
+  if (fd == -1 || fchmod(fd, 0600) == -1) {
+    Error error =
+        ErrnoError("Unable to open the checkpoint \"" + path + "\"");
+    if (fd != -1) close(fd);
+    return error;
+  }
+  process::Owned<ContainerCheckpoint> checkpoint(
+      new ContainerCheckpoint(path, fd));
+
+  Try<Nothing> loaded = checkpoint->load();
+  if (loaded.isError()) return Error(loaded.error());
+  checkpoint->m_writer =
+      std::thread(&ContainerCheckpoint::runWriter, checkpoint.get());
+  return checkpoint;
+}
+
+ContainerCheckpoint::ContainerCheckpoint(const string& path, int fd)
+    : m_path(path),
+      m_fd(fd),
+      m_records(0),
+      m_writing(false),
+      m_stopping(false) {}
+
+ContainerCheckpoint::~ContainerCheckpoint() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_scheduled.notify_all();
+  // The writer performs the writes left before exiting.
+  if (m_writer.joinable()) m_writer.join();
+  close(m_fd);
+}
+
+Try<Nothing> ContainerCheckpoint::load() {
+  Try<string> content = os::read(m_path);
+  if (content.isError()) {
+    return Error("Unable to read the checkpoint \"" + m_path +
+                 "\": " + content.error());
+  }
+
+  size_t offset = 0;
+  while (offset < content->size()) {
+    size_t end = content->find('\n', offset);
+    if (end == string::npos) break;
+
+    std::vector<string> fields =
+        strings::split(content->substr(offset, end - offset), " ");
+    bool prepared = fields.size() == 4 && fields[0] == string(1, PREPARED);
+    bool cleanedUp = fields.size() == 2 && fields[0] == string(1, CLEANED_UP);
+    if (!prepared && !cleanedUp) break;
+    std::vector<size_t> sizes;
+    for (size_t i = 1; i < fields.size(); ++i) {
+      Try<size_t> size = numify<size_t>(fields[i]);
+      if (size.isError()) break;
+      sizes.push_back(size.get());
+    }
+    if (sizes.size() != fields.size() - 1) break;
+
+    size_t total = 0;
+    for (size_t size : sizes) total += size;
+    if (content->size() - end - 1 < total) break;
+
+    const char* payload = content->data() + end + 1;
+    ContainerID containerId;
+    if (!containerId.ParseFromArray(payload, sizes[0])) break;
+    payload += sizes[0];
+
+    if (cleanedUp) {
+      m_entries.erase(containerId);
+    } else {
+      Entry entry;
+      entry.input = std::make_shared<const string>(payload, sizes[1]);
+      payload += sizes[1];
+      entry.protobufInput = std::make_shared<const string>(payload, sizes[2]);
+      m_entries[containerId] = entry;
+    }
+    ++m_records;
+    offset = end + 1 + total;
+  }
+
+  // The writer is not started yet, so the log is rewritten right away.
+  if (offset < content->size()) {
+    // Nothing is appended after a record cut short, so it is the last one.
+    LOG(WARNING) << "Ignoring the last " << content->size() - offset
+                 << " bytes of the checkpoint \"" << m_path
+                 << "\" which are incomplete";
+  } else if (m_records == m_entries.size()) {
+    return Nothing();
+  }
+  Try<Nothing> rewritten = rewrite(m_entries);
+  if (rewritten.isSome()) m_records = m_entries.size();
+  return rewritten;
+}
+
+void ContainerCheckpoint::append(const string& record) {
+  schedule({record, nullptr});
+  ++m_records;
+  if (m_records >= MIN_COMPACTION_RECORDS &&
+      m_records > 2 * m_entries.size()) {
+    compact();
+  }
+}
+
+void ContainerCheckpoint::compact() {
+  // The entries are copied since they keep changing while the log is
+  // rewritten, which only copies the pointers to the inputs.
+  schedule({"", std::make_shared<hashmap<ContainerID, Entry>>(m_entries)});
+  m_records = m_entries.size();
+}
+
+void ContainerCheckpoint::add(const ContainerID& containerId,
+                              const Entry& entry) {
+  m_entries[containerId] = entry;
+  append(preparedRecord(containerId, entry));
+}
+
+void ContainerCheckpoint::remove(const ContainerID& containerId) {
+  if (!m_entries.contains(containerId)) return;
+  m_entries.erase(containerId);
+  append(cleanedUpRecord(containerId));
+}
+
+void ContainerCheckpoint::retain(const hashset<ContainerID>& containerIds) {
+  foreach (const ContainerID& containerId, m_entries.keys()) {
+    if (!containerIds.contains(containerId)) m_entries.erase(containerId);
+  }
+  if (m_records > m_entries.size()) compact();
+}
+
+void ContainerCheckpoint::flush() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_written.wait(lock, [this]() { return m_writes.empty() && !m_writing; });
+}
+
+void ContainerCheckpoint::schedule(const Write& write) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // The records waiting are part of the entries the log is rewritten with.
+    if (write.entries) m_writes.clear();
+    m_writes.push_back(write);
+  }
+  m_scheduled.notify_one();
+}
+
+void ContainerCheckpoint::runWriter() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_scheduled.wait(lock,
+                     [this]() { return m_stopping || !m_writes.empty(); });
+    if (m_writes.empty()) return;
+    Write write = m_writes.front();
+    m_writes.pop_front();
+    m_writing = true;
+    lock.unlock();
+
+    Try<Nothing> written = Nothing();
+    if (write.entries) {
+      written = rewrite(*write.entries);
+    } else {
+      off_t size = lseek(m_fd, 0, SEEK_END);
+      written = os::write(m_fd, write.record);
+      if (written.isError()) {
+        // Drop the partial record so that the next ones do not follow it.
+        if (size != -1 && ftruncate(m_fd, size) == -1) {
+          PLOG(WARNING) << "Unable to truncate the checkpoint \"" << m_path
+                        << "\"";
+        }
+        written = Error("Unable to write to the checkpoint \"" + m_path +
+                        "\": " + written.error());
+      }
+    }
+    if (written.isError()) LOG(WARNING) << written.error();
+
+    lock.lock();
+    m_writing = false;
+    m_written.notify_all();
+  }
+}
+
+Try<Nothing> ContainerCheckpoint::rewrite(
+    const hashmap<ContainerID, Entry>& entries) {
+  // The log is replaced at once so that a crash leaves either of them.
+  string temporary = m_path + ".tmp";
+  int fd = ::open(temporary.c_str(),
+                  O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+  if (fd == -1) {
+    return ErrnoError("Unable to compact the checkpoint \"" + m_path + "\"");
+  }
+
+  string records;
+  foreachpair (const ContainerID& containerId, const Entry& entry, entries) {
+    records += preparedRecord(containerId, entry);
+  }
+  Try<Nothing> written = os::write(fd, records);
+  if (written.isSome() && fsync(fd) == -1) {
+    written = ErrnoError("fsync failed");
+  }
+  if (written.isSome() && ::rename(temporary.c_str(), m_path.c_str()) == -1) {
+    written = ErrnoError("rename failed");
+  }
+  if (written.isError()) {
+    close(fd);
+    ::unlink(temporary.c_str());
+    return Error("Unable to compact the checkpoint \"" + m_path +
+                 "\": " + written.error());
+  }
+
+  close(m_fd);
+  m_fd = fd;
+
+  // The rename is only durable once the directory is synced too.
+  string directory = Path(m_path).dirname();
+  int dir = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir == -1 || fsync(dir) == -1) {
+    Error error = ErrnoError("Unable to sync the directory of the checkpoint "
+                             "\"" + m_path + "\"");
+    if (dir != -1) close(dir);
+    return error;
+  }
+  close(dir);
+  return Nothing();
+}
+
+}  // namespace mesos
+}  // namespace criteo
@@ -0,0 +1,140 @@
+#ifndef __CONTAINER_CHECKPOINT_HPP__
+#define __CONTAINER_CHECKPOINT_HPP__
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <mesos/mesos.hpp>
+
+#include <process/owned.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/nothing.hpp>
+#include <stout/try.hpp>
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * @brief The ContainerCheckpoint class keeps the containers prepared by the
+ * isolator on disk so that they are known again after a restart of the agent
+ * without preparing them again.
+ *
+ * The file is an append-only log of records, each made of a header line and
+ * of the payloads whose sizes it gives:
+ *
+ *     P <id bytes> <input bytes> <protobuf input bytes>\n
+ *     <ContainerID><input><protobuf input>
+ *     C <id bytes>\n<ContainerID>
+ *
+ * for a container prepared and cleaned up, the ids being serialized protobuf
+ * messages. Only the inputs of the commands are kept, in a file readable by
+ * its owner alone since they hold the environment of the containers. The log
+ * is rewritten with only the containers still prepared, atomically, once most
+ * of its records are stale. A record cut short by a crash is ignored.
+ *
+ * The records are written by a dedicated thread so that the callers, e.g.,
+ * the isolator actor, do not wait for the disk, the write errors being
+ * logged. This class is not thread-safe otherwise.
+ */
+class ContainerCheckpoint {
+ public:
+  struct Entry {
+    // Inputs of the commands in JSON and protobuf as serialized on prepare
+    // (see ExecutionEngine).
+    std::shared_ptr<const std::string> input;
+    std::shared_ptr<const std::string> protobufInput;
+  };
+
+  /**
+   * Open the log, creating it if needed, and load the containers it holds.
+   *
+   * @param path The path of the file, e.g., in the work directory of the
+   *   agent.
+   */
+  static Try<process::Owned<ContainerCheckpoint>> open(
+      const std::string& path);
+
+  /**
+   * Wait for the records written so far to be on disk.
+   */
+  ~ContainerCheckpoint();
+
+  /**
+   * @return The containers prepared and not cleaned up.
+   */
+  const hashmap<::mesos::ContainerID, Entry>& entries() const {
+    return m_entries;
+  }
+
+  /**
+   * Record a container prepared, replacing its entry if any.
+   */
+  void add(const ::mesos::ContainerID& containerId, const Entry& entry);
+
+  /**
+   * Record a container cleaned up.
+   */
+  void remove(const ::mesos::ContainerID& containerId);
+
+  /**
+   * Forget the containers which are not in a set, e.g., the ones the agent
+   * did not recover, and rewrite the log.
+   */
+  void retain(const hashset<::mesos::ContainerID>& containerIds);
+
+  /**
+   * Wait for the records written so far to be on disk, e.g., before opening
+   * the log again.
+   */
+  void flush();
+
+  /**
+   * @return The number of records in the log, stale ones included.
+   */
+  size_t records() const { return m_records; }
+
+ private:
+  // A record to append, or the entries to rewrite the log with.
+  struct Write {
+    std::string record;
+    std::shared_ptr<hashmap<::mesos::ContainerID, Entry>> entries;
+  };
+
+  ContainerCheckpoint(const std::string& path, int fd);
+  ContainerCheckpoint(const ContainerCheckpoint&) = delete;
+  ContainerCheckpoint& operator=(const ContainerCheckpoint&) = delete;
+
+  Try<Nothing> load();
+  void append(const std::string& record);
+  void compact();
+  void schedule(const Write& write);
+  void runWriter();
+  Try<Nothing> rewrite(const hashmap<::mesos::ContainerID, Entry>& entries);
+
+  const std::string m_path;
+  // Only used by the writer once it is started.
+  int m_fd;
+  hashmap<::mesos::ContainerID, Entry> m_entries;
+  size_t m_records;
+
+  std::mutex m_mutex;
+  std::condition_variable m_scheduled;
+  std::condition_variable m_written;
+  std::deque<Write> m_writes;
+  // Whether the writer is performing a write taken off the queue.
+  bool m_writing;
+  bool m_stopping;
+  std::thread m_writer;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __CONTAINER_CHECKPOINT_HPP__
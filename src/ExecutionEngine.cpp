@@ -0,0 +1,99 @@
+#include "ExecutionEngine.hpp"
+#include "CommandCgroup.hpp"
+#include "CommandScheduler.hpp"
+#include "Serialization.hpp"
+#include "Span.hpp"
+#include "SpawnServer.hpp"
+
+#include <glog/logging.h>
+
+namespace criteo {
+namespace mesos {
+
+using std::string;
+
+void ExecutionEngine::configure(const SchedulerOptions& options) {
+  // The cgroup goes first so that the spawn server starts in it.
+  if (options.cgroup.isSome()) {
+    Try<Nothing> configured =
+        CommandCgroup::instance().configure(options.cgroup.get());
+    if (configured.isError()) {
+      // Commands run in the cgroup of the agent.
+      LOG(ERROR) << configured.error();
+    }
+  }
+
+  if (options.spans.isSome()) {
+    Try<Nothing> configured =
+        SpanExporter::instance().configure(options.spans.get());
+    if (configured.isError()) LOG(ERROR) << configured.error();
+  }
+
+  if (options.spawnServer.isSome()) {
+    Try<Nothing> started =
+        SpawnServer::instance().start(options.spawnServer.get());
+    if (started.isError()) {
+      // Commands fork the agent until the spawn server can be started.
+      LOG(ERROR) << started.error();
+    }
+  }
+
+  if (options.maxConcurrency.isNone() && options.maxQueueDepth.isNone()) {
+    return;
+  }
+  CommandScheduler::instance().configure(options.maxConcurrency.getOrElse(0),
+                                         options.maxQueueDepth.getOrElse(0));
+}
+
+std::shared_ptr<const string> ExecutionEngine::containerInput(
+    CommandFormat format, const ::mesos::ContainerID& containerId,
+    const ::mesos::slave::ContainerConfig& containerConfig) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ContainerInputs& inputs = m_containers[containerId.value()];
+  std::weak_ptr<const string>& input =
+      format == CommandFormat::PROTOBUF ? inputs.protobuf : inputs.json;
+
+  std::shared_ptr<const string> shared = input.lock();
+  if (shared) return shared;
+
+  shared = std::make_shared<const string>(
+      InputBuilder(format)
+          .add(InputField::CONTAINER_ID, containerId)
+          .add(InputField::CONTAINER_CONFIG, containerConfig)
+          .str());
+  input = shared;
+  return shared;
+}
+
+std::shared_ptr<const string> ExecutionEngine::shareInput(
+    CommandFormat format, const ::mesos::ContainerID& containerId,
+    const std::shared_ptr<const string>& input) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ContainerInputs& inputs = m_containers[containerId.value()];
+  std::weak_ptr<const string>& shared =
+      format == CommandFormat::PROTOBUF ? inputs.protobuf : inputs.json;
+
+  std::shared_ptr<const string> held = shared.lock();
+  if (held) return held;
+  shared = input;
+  return input;
+}
+
+void ExecutionEngine::forgetContainer(const ::mesos::ContainerID& containerId) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_containers.erase(containerId.value());
+}
+
+size_t ExecutionEngine::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_containers.size();
+}
+
+ExecutionEngine& ExecutionEngine::instance() {
+  // Intentionally leaked so that it outlives every module instance.
+  static ExecutionEngine* engine = new ExecutionEngine();
+  return *engine;
+}
+
+}  // namespace mesos
+}  // namespace criteo
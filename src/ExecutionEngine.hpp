@@ -0,0 +1,83 @@
+#ifndef __EXECUTION_ENGINE_HPP__
+#define __EXECUTION_ENGINE_HPP__
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <mesos/mesos.hpp>
+#include <mesos/slave/isolator.hpp>
+
+#include <stout/hashmap.hpp>
+
+#include "Command.hpp"
+#include "Options.hpp"
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * @brief The ExecutionEngine class holds what the module instances share to
+ * run their commands, whatever the number of hooks and isolators loaded.
+ *
+ * The oneshot commands of all the instances go through the same
+ * CommandScheduler and SpawnServer, and report to the same CommandMetrics for
+ * the same module and method. The inputs of a container are serialized once
+ * for all the isolators and kept as long as one of them uses them.
+ */
+class ExecutionEngine {
+ public:
+  /**
+   * Configure the scheduler and the spawn server. Since they are shared, the
+   * last instance providing a setting wins.
+   */
+  void configure(const SchedulerOptions& options);
+
+  /**
+   * Get the input of a container in a format, serializing it only if no
+   * other isolator holds it yet. Container ids are unique, so the config of
+   * a container is the same for all the isolators.
+   */
+  std::shared_ptr<const std::string> containerInput(
+      CommandFormat format, const ::mesos::ContainerID& containerId,
+      const ::mesos::slave::ContainerConfig& containerConfig);
+
+  /**
+   * Share an input of a container serialized beforehand, e.g., loaded from a
+   * checkpoint, unless another isolator already holds one in this format.
+   */
+  std::shared_ptr<const std::string> shareInput(
+      CommandFormat format, const ::mesos::ContainerID& containerId,
+      const std::shared_ptr<const std::string>& input);
+
+  /**
+   * Drop the inputs of a container, e.g., once cleaned up, so that a new
+   * container with the same id gets its own. The copies still used, e.g., by
+   * a cleanup in progress, stay valid.
+   */
+  void forgetContainer(const ::mesos::ContainerID& containerId);
+
+  /**
+   * @return The number of containers whose inputs are kept.
+   */
+  size_t size() const;
+
+  /**
+   * Get the engine shared by all the module instances.
+   */
+  static ExecutionEngine& instance();
+
+ private:
+  struct ContainerInputs {
+    std::weak_ptr<const std::string> json;
+    std::weak_ptr<const std::string> protobuf;
+  };
+
+  hashmap<std::string, ContainerInputs> m_containers;
+  mutable std::mutex m_mutex;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __EXECUTION_ENGINE_HPP__
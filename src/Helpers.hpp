@@ -1,9 +1,18 @@
 #ifndef __HELPERS_HPP__
 #define __HELPERS_HPP__
 
+#include <string>
+
+#include <glog/logging.h>
+
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
 #include <stout/json.hpp>
 #include <stout/protobuf.hpp>
 #include <stout/result.hpp>
+#include <stout/try.hpp>
+
+#include "JsonDecoder.hpp"
 
 namespace criteo {
 namespace mesos {
@@ -12,6 +21,13 @@ template <class Proto>
 Result<Proto> jsonToProtobuf(const std::string& output) {
   if (output.empty()) return Error("No content to parse");
 
+  // Hot message types first try the single-pass decoder, the generic path
+  // below handles whatever it rejects and reports the errors.
+  if (HasFastJsonDecoder<Proto>::value) {
+    Proto proto;
+    if (decodeJson(output, &proto)) return proto;
+  }
+
   auto outputJsonTry = JSON::parse(output);
   if (outputJsonTry.isError()) {
     return Error("Malformed JSON. " + outputJsonTry.error());
@@ -28,6 +44,46 @@ Result<Proto> jsonToProtobuf(const std::string& output) {
   }
   return proto;
 }
+
+/**
+ * Parse a JSON object mapping container ids to protobuf messages. A malformed
+ * message is skipped so that it does not fail the other containers.
+ */
+template <class Proto>
+Try<hashmap<std::string, Proto>> jsonToProtobufMap(const JSON::Object& object) {
+  hashmap<std::string, Proto> protos;
+  foreachpair (const std::string& containerId, const JSON::Value& value,
+               object.values) {
+    if (!value.is<JSON::Object>()) {
+      LOG(WARNING) << "Malformed Protobuf for container " << containerId
+                   << ". JSON object is expected.";
+      continue;
+    }
+    Try<Proto> proto = ::protobuf::parse<Proto>(value);
+    if (proto.isError()) {
+      LOG(WARNING) << "Error while converting JSON to protobuf for container "
+                   << containerId << ". " << proto.error();
+      continue;
+    }
+    protos.put(containerId, proto.get());
+  }
+  return protos;
+}
+
+/**
+ * Parse the output of a command handling several containers at once. The
+ * output is a JSON object mapping container ids to protobuf messages.
+ */
+template <class Proto>
+Try<hashmap<std::string, Proto>> jsonToProtobufMap(const std::string& output) {
+  if (output.empty()) return Error("No content to parse");
+
+  Try<JSON::Object> outputJson = JSON::parse<JSON::Object>(output);
+  if (outputJson.isError()) {
+    return Error("Malformed JSON. " + outputJson.error());
+  }
+  return jsonToProtobufMap<Proto>(outputJson.get());
+}
 }  // namespace mesos
 }  // namespace criteo
 
@@ -0,0 +1,322 @@
+#include "JsonDecoder.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/reflection.h>
+
+#include <rapidjson/reader.h>
+
+namespace criteo {
+namespace mesos {
+
+using google::protobuf::Descriptor;
+using google::protobuf::EnumValueDescriptor;
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
+using google::protobuf::Reflection;
+
+namespace {
+
+/**
+ * RapidJSON SAX handler setting the fields of the message as they are read.
+ * Each handler returns false to abort the parsing when the input cannot be
+ * decoded like the generic parser would.
+ */
+class MessageHandler {
+ public:
+  explicit MessageHandler(Message* message) : m_root(message), m_skipped(0) {}
+
+  bool Null() { return false; }
+
+  bool Bool(bool value) {
+    if (skipValue()) return true;
+    const FieldDescriptor* field = currentField();
+    if (field == nullptr || field->cpp_type() != FieldDescriptor::CPPTYPE_BOOL)
+      return false;
+    Message* message = m_frames.back().message;
+    if (field->is_repeated()) {
+      reflection(message)->AddBool(message, field, value);
+    } else {
+      reflection(message)->SetBool(message, field, value);
+    }
+    return true;
+  }
+
+  bool Int(int value) { return integer(value); }
+  bool Uint(unsigned value) { return integer(value); }
+  bool Int64(int64_t value) { return integer(value); }
+
+  bool Uint64(uint64_t value) {
+    // The generic parser reads such numbers as doubles, losing precision.
+    if (value > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+      return skipValue();
+    return integer(static_cast<int64_t>(value));
+  }
+
+  bool Double(double value) {
+    if (skipValue()) return true;
+    const FieldDescriptor* field = currentField();
+    if (field == nullptr) return false;
+    return setFloating(field, value);
+  }
+
+  bool RawNumber(const char*, rapidjson::SizeType, bool) { return false; }
+
+  bool String(const char* value, rapidjson::SizeType length, bool) {
+    if (skipValue()) return true;
+    const FieldDescriptor* field = currentField();
+    if (field == nullptr) return false;
+
+    Message* message = m_frames.back().message;
+    const Reflection* r = reflection(message);
+    if (field->type() == FieldDescriptor::TYPE_STRING) {
+      std::string string(value, length);
+      if (field->is_repeated()) {
+        r->AddString(message, field, string);
+      } else {
+        r->SetString(message, field, string);
+      }
+      return true;
+    }
+    if (field->cpp_type() == FieldDescriptor::CPPTYPE_ENUM) {
+      const EnumValueDescriptor* enumValue =
+          field->enum_type()->FindValueByName(std::string(value, length));
+      if (enumValue == nullptr) return false;
+      if (field->is_repeated()) {
+        r->AddEnum(message, field, enumValue);
+      } else {
+        r->SetEnum(message, field, enumValue);
+      }
+      return true;
+    }
+    // Bytes are base64 encoded and numbers may be given as strings, both are
+    // left to the generic parser.
+    return false;
+  }
+
+  bool StartObject() {
+    if (m_skipped > 0 || (!m_frames.empty() && m_frames.back().skipping)) {
+      ++m_skipped;
+      return true;
+    }
+
+    if (m_frames.empty()) {
+      m_frames.push_back(Frame(m_root));
+      return true;
+    }
+
+    const FieldDescriptor* field = currentField();
+    if (field == nullptr ||
+        field->cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE)
+      return false;
+
+    Message* parent = m_frames.back().message;
+    Message* message = field->is_repeated()
+                           ? reflection(parent)->AddMessage(parent, field)
+                           : reflection(parent)->MutableMessage(parent, field);
+    m_frames.push_back(Frame(message));
+    return true;
+  }
+
+  bool Key(const char* name, rapidjson::SizeType length, bool) {
+    if (m_skipped > 0) return true;
+    Frame& frame = m_frames.back();
+    frame.field = frame.message->GetDescriptor()->FindFieldByName(
+        std::string(name, length));
+    // The value of an unknown field is skipped.
+    frame.skipping = frame.field == nullptr;
+    frame.inArray = false;
+
+    // With duplicated keys the generic parser only keeps the last value.
+    if (frame.field != nullptr) {
+      const Reflection* r = reflection(frame.message);
+      if (frame.field->is_repeated()
+              ? r->FieldSize(*frame.message, frame.field) > 0
+              : r->HasField(*frame.message, frame.field))
+        return false;
+    }
+    return true;
+  }
+
+  bool EndObject(rapidjson::SizeType) {
+    if (m_skipped > 0) {
+      endSkipped();
+      return true;
+    }
+    m_frames.pop_back();
+    if (!m_frames.empty()) endValue();
+    return true;
+  }
+
+  bool StartArray() {
+    if (m_frames.empty()) return false;
+    if (m_skipped > 0 || m_frames.back().skipping) {
+      ++m_skipped;
+      return true;
+    }
+    Frame& frame = m_frames.back();
+    // Nested arrays have no protobuf equivalent.
+    if (frame.field == nullptr || !frame.field->is_repeated() || frame.inArray)
+      return false;
+    frame.inArray = true;
+    return true;
+  }
+
+  bool EndArray(rapidjson::SizeType) {
+    if (m_skipped > 0) {
+      endSkipped();
+      return true;
+    }
+    m_frames.back().inArray = false;
+    endValue();
+    return true;
+  }
+
+ private:
+  struct Frame {
+    explicit Frame(Message* message)
+        : message(message), field(nullptr), skipping(false), inArray(false) {}
+
+    Message* message;
+    // Field of the value being read, set by the key.
+    const FieldDescriptor* field;
+    // True while reading the value of an unknown field.
+    bool skipping;
+    // True while reading the elements of a repeated field.
+    bool inArray;
+  };
+
+  static const Reflection* reflection(Message* message) {
+    return message->GetReflection();
+  }
+
+  // Whether the current scalar belongs to an unknown field, in which case it
+  // is dropped. A scalar directly under an unknown key ends the skipping.
+  bool skipValue() {
+    if (m_skipped > 0) return true;
+    if (!m_frames.empty() && m_frames.back().skipping) {
+      endValue();
+      return true;
+    }
+    return false;
+  }
+
+  void endSkipped() {
+    if (--m_skipped == 0) endValue();
+  }
+
+  // Called once the value of a key is complete.
+  void endValue() {
+    Frame& frame = m_frames.back();
+    if (frame.inArray) return;
+    frame.field = nullptr;
+    frame.skipping = false;
+  }
+
+  // The field of the current value, checking that arrays are only used with
+  // repeated fields and the other way around.
+  const FieldDescriptor* currentField() const {
+    if (m_frames.empty()) return nullptr;
+    const Frame& frame = m_frames.back();
+    if (frame.field == nullptr) return nullptr;
+    if (frame.field->is_repeated() != frame.inArray) return nullptr;
+    return frame.field;
+  }
+
+  template <typename T>
+  bool integer(T value) {
+    if (skipValue()) return true;
+    const FieldDescriptor* field = currentField();
+    if (field == nullptr) return false;
+
+    Message* message = m_frames.back().message;
+    const Reflection* r = reflection(message);
+    bool repeated = field->is_repeated();
+    int64_t v = static_cast<int64_t>(value);
+
+    switch (field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_INT32:
+        if (v < std::numeric_limits<int32_t>::min() ||
+            v > std::numeric_limits<int32_t>::max())
+          return false;
+        repeated ? r->AddInt32(message, field, v)
+                 : r->SetInt32(message, field, v);
+        break;
+      case FieldDescriptor::CPPTYPE_INT64:
+        repeated ? r->AddInt64(message, field, v)
+                 : r->SetInt64(message, field, v);
+        break;
+      case FieldDescriptor::CPPTYPE_UINT32:
+        if (v < 0 || v > std::numeric_limits<uint32_t>::max()) return false;
+        repeated ? r->AddUInt32(message, field, v)
+                 : r->SetUInt32(message, field, v);
+        break;
+      case FieldDescriptor::CPPTYPE_UINT64:
+        if (v < 0) return false;
+        repeated ? r->AddUInt64(message, field, v)
+                 : r->SetUInt64(message, field, v);
+        break;
+      case FieldDescriptor::CPPTYPE_DOUBLE:
+      case FieldDescriptor::CPPTYPE_FLOAT:
+        return setFloating(field, static_cast<double>(v));
+      default:
+        return false;
+    }
+    endValue();
+    return true;
+  }
+
+  bool setFloating(const FieldDescriptor* field, double value) {
+    Message* message = m_frames.back().message;
+    const Reflection* r = reflection(message);
+    bool repeated = field->is_repeated();
+
+    switch (field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_DOUBLE:
+        repeated ? r->AddDouble(message, field, value)
+                 : r->SetDouble(message, field, value);
+        break;
+      case FieldDescriptor::CPPTYPE_FLOAT:
+        repeated ? r->AddFloat(message, field, static_cast<float>(value))
+                 : r->SetFloat(message, field, static_cast<float>(value));
+        break;
+      default:
+        // Truncating a decimal into an integer is left to the generic
+        // parser.
+        return false;
+    }
+    endValue();
+    return true;
+  }
+
+  Message* m_root;
+  std::vector<Frame> m_frames;
+  // Depth of the objects and arrays being skipped as values of unknown
+  // fields.
+  size_t m_skipped;
+};
+
+}  // namespace
+
+bool decodeJson(const std::string& json, Message* message) {
+  // RapidJSON would stop at a NUL character where the generic parser fails.
+  if (json.find('\0') != std::string::npos) return false;
+
+  MessageHandler handler(message);
+  rapidjson::Reader reader;
+  rapidjson::StringStream stream(json.c_str());
+
+  // kParseFullPrecisionFlag matches the strtod conversion of the generic
+  // parser for doubles.
+  if (reader.Parse<rapidjson::kParseFullPrecisionFlag>(stream, handler)
+          .IsError()) {
+    return false;
+  }
+  return message->IsInitialized();
+}
+
+}  // namespace mesos
+}  // namespace criteo
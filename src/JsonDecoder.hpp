@@ -0,0 +1,49 @@
+#ifndef __JSON_DECODER_HPP__
+#define __JSON_DECODER_HPP__
+
+#include <string>
+#include <type_traits>
+
+#include <google/protobuf/message.h>
+
+#include <mesos/mesos.hpp>
+#include <mesos/slave/isolator.hpp>
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * Fill a protobuf message from JSON text in a single pass, without building
+ * the intermediate JSON::Value tree used by the generic parser.
+ *
+ * The decoder is conservative: it returns false as soon as the input is not
+ * strictly equivalent to what ::protobuf::parse accepts, e.g., a malformed
+ * document, a type mismatch, a null, a bytes field or a missing required
+ * field. Callers then fall back on the generic parser, which also produces
+ * the error message. Unknown fields are ignored like in the generic parser.
+ *
+ * @param json The JSON text, which must be an object.
+ * @param message The message to fill, expected to be empty.
+ *
+ * @return true if the message has been filled successfully.
+ */
+bool decodeJson(const std::string& json, google::protobuf::Message* message);
+
+/**
+ * Messages decoded with decodeJson by jsonToProtobuf, i.e., the outputs of
+ * the commands called at high frequency.
+ */
+template <class Proto>
+struct HasFastJsonDecoder : std::false_type {};
+
+template <>
+struct HasFastJsonDecoder<::mesos::ResourceStatistics> : std::true_type {};
+
+template <>
+struct HasFastJsonDecoder<::mesos::slave::ContainerLimitation>
+    : std::true_type {};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __JSON_DECODER_HPP__
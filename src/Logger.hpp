@@ -13,6 +13,10 @@ namespace logging {
 struct Metadata {
   std::string taskId;
   std::string method;
+  // Trace of the call and span the spans of its commands belong to, empty
+  // if the call is not traced (see Span).
+  std::string traceId;
+  std::string spanId;
 };
 }  // namespace logging
 }  // namespace mesos
@@ -0,0 +1,94 @@
+#ifndef __LRU_CACHE_HPP__
+#define __LRU_CACHE_HPP__
+
+#include <list>
+#include <mutex>
+#include <string>
+
+#include <process/clock.hpp>
+#include <process/time.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/option.hpp>
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * @brief The LruCache class keeps the values most recently used, up to a
+ * number of entries and optionally for a limited time. It can be used from
+ * several threads.
+ */
+template <typename Value>
+class LruCache {
+ public:
+  /**
+   * @param capacity The maximum number of entries.
+   * @param ttl How long an entry is kept after being put, forever if None.
+   */
+  LruCache(size_t capacity, const Option<Duration>& ttl)
+      : m_capacity(capacity), m_ttl(ttl) {}
+
+  /**
+   * @return The value of the key, None if missing or expired.
+   */
+  Option<Value> get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_index.contains(key)) return None();
+
+    auto entry = m_index.at(key);
+    if (m_ttl.isSome() &&
+        process::Clock::now() - entry->insertedAt >= m_ttl.get()) {
+      m_entries.erase(entry);
+      m_index.erase(key);
+      return None();
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, entry);
+    return entry->value;
+  }
+
+  /**
+   * Put the value of a key, evicting the least recently used entry if the
+   * cache is full.
+   */
+  void put(const std::string& key, const Value& value) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_capacity == 0) return;
+
+    if (m_index.contains(key)) {
+      m_entries.erase(m_index.at(key));
+    } else if (m_entries.size() >= m_capacity) {
+      m_index.erase(m_entries.back().key);
+      m_entries.pop_back();
+    }
+    m_entries.push_front(Entry{key, value, process::Clock::now()});
+    m_index[key] = m_entries.begin();
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+  }
+
+ private:
+  struct Entry {
+    std::string key;
+    Value value;
+    process::Time insertedAt;
+  };
+
+  const size_t m_capacity;
+  const Option<Duration> m_ttl;
+
+  // Most recently used first.
+  std::list<Entry> m_entries;
+  hashmap<std::string, typename std::list<Entry>::iterator> m_index;
+  mutable std::mutex m_mutex;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __LRU_CACHE_HPP__
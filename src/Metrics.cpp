@@ -0,0 +1,95 @@
+#include "Metrics.hpp"
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include <process/metrics/metrics.hpp>
+
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+
+namespace criteo {
+namespace mesos {
+
+using std::string;
+
+// Window of the timers used to compute their percentiles.
+const Duration TIMER_WINDOW = Hours(1);
+
+CommandMetrics::CommandMetrics(const std::string& name,
+                               const std::string& prefix)
+    : name(name),
+      calls(prefix + "calls"),
+      failures(prefix + "failures"),
+      timeouts(prefix + "timeouts"),
+      sigkills(prefix + "sigkills"),
+      cacheHits(prefix + "cache_hits"),
+      cacheMisses(prefix + "cache_misses"),
+      retries(prefix + "retries"),
+      abandoned(prefix + "abandoned"),
+      deadlineMisses(prefix + "deadline_misses"),
+      shortCircuits(prefix + "short_circuits"),
+      spawnLatency(prefix + "spawn_latency", TIMER_WINDOW),
+      runTime(prefix + "run_time", TIMER_WINDOW),
+      parseTime(prefix + "parse_time", TIMER_WINDOW),
+      cpuTime(prefix + "cpu_time_secs") {
+  process::metrics::add(calls);
+  process::metrics::add(failures);
+  process::metrics::add(timeouts);
+  process::metrics::add(sigkills);
+  process::metrics::add(cacheHits);
+  process::metrics::add(cacheMisses);
+  process::metrics::add(retries);
+  process::metrics::add(abandoned);
+  process::metrics::add(deadlineMisses);
+  process::metrics::add(shortCircuits);
+  process::metrics::add(spawnLatency);
+  process::metrics::add(runTime);
+  process::metrics::add(parseTime);
+  process::metrics::add(cpuTime);
+}
+
+CommandMetrics& CommandMetrics::get(const std::string& module,
+                                    const std::string& method) {
+  typedef std::pair<std::string, std::string> Key;
+
+  static std::mutex mutex;
+  // Intentionally leaked so that commands still running when a module is
+  // destroyed can report their metrics.
+  static std::map<Key, CommandMetrics*>* metrics =
+      new std::map<Key, CommandMetrics*>();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  CommandMetrics*& entry = (*metrics)[Key(module, method)];
+  if (entry == nullptr) {
+    string name = module + "/" + method;
+    entry = new CommandMetrics(name, "command_modules/" + name + "/");
+  }
+  return *entry;
+}
+
+string CommandMetrics::instanceName(const Option<std::string>& name,
+                                    const std::string& module) {
+  static std::mutex mutex;
+  static hashset<string>* named = new hashset<string>();
+  static hashmap<string, size_t>* unnamed = new hashmap<string, size_t>();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (name.isSome()) {
+    if (named->contains(name.get())) {
+      LOG(WARNING) << "Several module instances are named \"" << name.get()
+                   << "\", their metrics are added together";
+    }
+    named->insert(name.get());
+    return name.get();
+  }
+
+  size_t instance = ++(*unnamed)[module];
+  return instance == 1 ? module : module + "_" + std::to_string(instance);
+}
+
+}  // namespace mesos
+}  // namespace criteo
@@ -0,0 +1,122 @@
+#ifndef __METRICS_HPP__
+#define __METRICS_HPP__
+
+#include <string>
+
+#include <process/future.hpp>
+#include <process/metrics/counter.hpp>
+#include <process/metrics/push_gauge.hpp>
+#include <process/metrics/timer.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * @brief The CommandMetrics class gathers the metrics of the commands run by
+ * one method of a module instance, e.g., the usage method of an isolator.
+ *
+ * They are published on /metrics/snapshot under
+ * `command_modules/<module>/<method>/`.
+ */
+class CommandMetrics {
+ public:
+  /**
+   * Get the metrics of a method, registering them on first use. They are
+   * shared by the module instances with the same name (see instanceName) and
+   * live as long as the agent.
+   *
+   * @param module The name of the module instance, e.g., "isolator".
+   * @param method The method running the commands, e.g., "usage".
+   */
+  static CommandMetrics& get(const std::string& module,
+                             const std::string& method);
+
+  /**
+   * Get the name of a new module instance in its metrics so that each
+   * instance has its own: the configured name if any, otherwise `module`
+   * for the first unnamed instance, then `module_2`, `module_3`, ...
+   *
+   * A configured name given to several instances is reported since their
+   * metrics are then added together.
+   *
+   * @param name The name configured for the instance, if any.
+   * @param module The default name of the module, e.g., "isolator".
+   */
+  static std::string instanceName(const Option<std::string>& name,
+                                  const std::string& module);
+
+  // "<module>/<method>", the cgroup of the commands of the method.
+  const std::string name;
+
+  // Commands run, failed for any reason, killed after their timeout and
+  // still running after SIGTERM.
+  process::metrics::Counter calls;
+  process::metrics::Counter failures;
+  process::metrics::Counter timeouts;
+  process::metrics::Counter sigkills;
+
+  // Outputs reused from the cache of the method and outputs computed since
+  // missing from it, if the method has a cache.
+  process::metrics::Counter cacheHits;
+  process::metrics::Counter cacheMisses;
+
+  // Failed batches run again and batches given up, if the method runs its
+  // command in batch with retries.
+  process::metrics::Counter retries;
+  process::metrics::Counter abandoned;
+
+  // Outputs which were not ready by the deadline of the method, if any.
+  process::metrics::Counter deadlineMisses;
+
+  // Calls failed right away since the circuit breaker of the command was
+  // open (see CircuitBreaker).
+  process::metrics::Counter shortCircuits;
+
+  // Time to start the command, time until it exits or answers and time to
+  // parse its output.
+  process::metrics::Timer<Milliseconds> spawnLatency;
+  process::metrics::Timer<Milliseconds> runTime;
+  process::metrics::Timer<Milliseconds> parseTime;
+
+  // CPU time used by the commands, if they run in a cgroup (see
+  // CommandCgroup).
+  process::metrics::PushGauge cpuTime;
+
+ private:
+  CommandMetrics(const std::string& name, const std::string& prefix);
+};
+
+/**
+ * Get the metrics of a method, or nullptr if the method runs no command so
+ * that no metric is published for it.
+ */
+template <typename C>
+CommandMetrics* commandMetrics(const Option<C>& command,
+                               const std::string& module,
+                               const std::string& method) {
+  return command.isSome() ? &CommandMetrics::get(module, method) : nullptr;
+}
+
+/**
+ * Measure the duration of a synchronous call with a timer.
+ *
+ * @return The result of the call.
+ */
+template <typename F>
+auto timed(process::metrics::Timer<Milliseconds>& timer, const F& f)
+    -> decltype(f()) {
+  process::Promise<Nothing> done;
+  timer.time(done.future());
+  auto result = f();
+  done.set(Nothing());
+  return result;
+}
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __METRICS_HPP__
@@ -3,6 +3,10 @@
 #include "CommandHook.hpp"
 #include "CommandIsolator.hpp"
 #include "ConfigurationParser.hpp"
+#include "ConfigurationWatcher.hpp"
+#include "ExecutionEngine.hpp"
+
+#include <process/owned.hpp>
 
 namespace criteo {
 namespace mesos {
@@ -10,19 +14,64 @@ namespace mesos {
 using std::map;
 using std::string;
 
-::mesos::Hook* createHook(const ::mesos::Parameters& parameters) {
+// Time between two checks of the configuration file if not configured.
+const Duration DEFAULT_CONFIG_FILE_INTERVAL = Seconds(10);
+
+// Parse the parameters of a module, overridden by its configuration file if
+// any, which is then watched.
+static Configuration configure(
+    const ::mesos::Parameters& parameters,
+    process::Owned<ConfigurationWatcher>* watcher) {
   Configuration cfg = ConfigurationParser::parse(parameters);
-  return new CommandHook(cfg.slaveRunTaskLabelDecoratorCommand,
-                         cfg.slaveExecutorEnvironmentDecoratorCommand,
-                         cfg.slaveRemoveExecutorHookCommand, cfg.isDebugSet);
+  if (cfg.configFile.isSome()) {
+    watcher->reset(new ConfigurationWatcher(
+        cfg.configFile.get(), parameters,
+        cfg.configFileInterval.getOrElse(DEFAULT_CONFIG_FILE_INTERVAL)));
+    cfg = (*watcher)->configuration();
+  }
+  ExecutionEngine::instance().configure(cfg.schedulerOptions);
+  return cfg;
+}
+
+::mesos::Hook* createHook(const ::mesos::Parameters& parameters) {
+  process::Owned<ConfigurationWatcher> watcher;
+  Configuration cfg = configure(parameters, &watcher);
+  CommandHook* hook = new CommandHook(
+      cfg.slaveRunTaskLabelDecoratorCommand,
+      cfg.slaveExecutorEnvironmentDecoratorCommand,
+      cfg.slaveRemoveExecutorHookCommand, cfg.isDebugSet, cfg.hookOptions);
+
+  if (watcher.get() != nullptr) {
+    watcher->start([hook](const Configuration& cfg) {
+      ExecutionEngine::instance().configure(cfg.schedulerOptions);
+      hook->reload(cfg.slaveRunTaskLabelDecoratorCommand,
+                   cfg.slaveExecutorEnvironmentDecoratorCommand,
+                   cfg.slaveRemoveExecutorHookCommand, cfg.isDebugSet,
+                   cfg.hookOptions);
+    });
+    hook->setConfigurationWatcher(watcher);
+  }
+  return hook;
 }
 
 ::mesos::slave::Isolator* createIsolator(
     const ::mesos::Parameters& parameters) {
-  Configuration cfg = ConfigurationParser::parse(parameters);
-  return new CommandIsolator(cfg.prepareCommand, cfg.watchCommand,
-                             cfg.cleanupCommand, cfg.usageCommand,
-                             cfg.isDebugSet);
+  process::Owned<ConfigurationWatcher> watcher;
+  Configuration cfg = configure(parameters, &watcher);
+  CommandIsolator* isolator = new CommandIsolator(
+      cfg.prepareCommand, cfg.watchCommand, cfg.cleanupCommand,
+      cfg.usageCommand, cfg.isDebugSet, cfg.isolatorOptions);
+
+  if (watcher.get() != nullptr) {
+    watcher->start([isolator](const Configuration& cfg) {
+      ExecutionEngine::instance().configure(cfg.schedulerOptions);
+      isolator->reload(cfg.prepareCommand, cfg.watchCommand,
+                       cfg.cleanupCommand, cfg.usageCommand, cfg.isDebugSet,
+                       cfg.isolatorOptions);
+    });
+    isolator->setConfigurationWatcher(watcher);
+  }
+  return isolator;
 }
 }  // namespace mesos
 }  // namespace criteo
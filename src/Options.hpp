@@ -0,0 +1,177 @@
+#ifndef __OPTIONS_HPP__
+#define __OPTIONS_HPP__
+
+#include <string>
+#include <vector>
+
+#include <stout/duration.hpp>
+#include <stout/option.hpp>
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * @brief The IsolatorOptions struct contains the settings of the isolator
+ * which are not bound to one command in particular.
+ */
+struct IsolatorOptions {
+  // Name of the isolator in its metrics, "isolator" if not set.
+  Option<std::string> name;
+
+  // If set, usage calls received within this window are merged into a single
+  // invocation of the usage command for all containers.
+  Option<Duration> usageBatchWindow;
+
+  // If true, the usage command only reports the containers whose statistics
+  // changed since the sequence number of its input, which are merged into
+  // the last statistics of each container. The usage calls are batched, with
+  // a window of zero if not set.
+  bool usageDelta = false;
+
+  // If set, the path of the table shared with a collector publishing the
+  // statistics of the containers, read by the usage calls instead of running
+  // the usage command (see StatsTable).
+  Option<std::string> usageStatsTable;
+
+  // Maximum number of containers in the stats table, 1024 if not set.
+  Option<size_t> usageStatsTableCapacity;
+
+  // If set, the statistics of a container are reused for this long instead
+  // of running the usage command again.
+  Option<Duration> usageCacheTtl;
+
+  // If one of them is set, cleanup calls complete right away and a single
+  // invocation of the cleanup command cleans up the containers received
+  // within the window, or as soon as there are this many of them.
+  Option<Duration> cleanupBatchWindow;
+  Option<size_t> cleanupBatchSize;
+
+  // Number of times a failed invocation of the cleanup command is retried in
+  // batch mode, 3 if not set.
+  Option<size_t> cleanupRetries;
+
+  // Number of threads running the watch commands, 4 if not set.
+  Option<size_t> watchThreads;
+
+  // If true, a single invocation of the watch command checks all the watched
+  // containers at once.
+  bool watchBatch = false;
+
+  // Bounds of the delay before the next check of a container suggested by
+  // the watch command, a tenth and ten times the period if not set. When the
+  // command queue is saturated, the delay is doubled up to the maximum.
+  Option<Duration> watchMinPeriod;
+  Option<Duration> watchMaxPeriod;
+
+  // If set, the containers prepared are kept in this file so that they are
+  // recovered after a restart of the agent (see ContainerCheckpoint).
+  Option<std::string> checkpointFile;
+
+  // If set, the events received by the isolator are appended to this file
+  // to be replayed with mesos-command-replay (see TraceRecorder).
+  Option<std::string> traceFile;
+};
+
+/**
+ * @brief The CacheOptions struct contains the settings of the cache of the
+ * outputs of a command whose output only depends on its input.
+ */
+struct CacheOptions {
+  // Maximum number of outputs kept.
+  size_t size = 0;
+
+  // How long an output is reused, forever if not set.
+  Option<Duration> ttl;
+
+  // Paths of the fields of the JSON input the output depends on, e.g.,
+  // "framework_info.name". The executor info is the key if empty.
+  std::vector<std::string> keyFields;
+};
+
+/**
+ * @brief The HookOptions struct contains the settings of the hook which are
+ * not bound to one command in particular.
+ */
+struct HookOptions {
+  // Name of the hook in its metrics, "hook" if not set.
+  Option<std::string> name;
+
+  // If set, the outputs of the decorators are reused for the same key.
+  Option<CacheOptions> runTaskLabelCache;
+  Option<CacheOptions> executorEnvironmentCache;
+
+  // If set, the decorators wait this long at most for their command and
+  // leave the task or the executor unchanged if it did not answer in time.
+  // The environment command is then started as soon as the task is seen.
+  Option<Duration> runTaskLabelDeadline;
+  Option<Duration> executorEnvironmentDeadline;
+
+  // If set, the events received by the hook are appended to this file (see
+  // TraceRecorder).
+  Option<std::string> traceFile;
+};
+
+/**
+ * @brief The CgroupOptions struct contains the limits of the cgroup confining
+ * the commands so that they do not compete with the agent (see CommandCgroup).
+ */
+struct CgroupOptions {
+  // Path of the cgroup in each controller, e.g., "mesos-command-modules".
+  std::string name;
+
+  // Directory where the cgroup controllers are mounted.
+  std::string hierarchy = "/sys/fs/cgroup";
+
+  // Weight of the commands against the other cgroups, 1024 if not set.
+  Option<size_t> cpuShares;
+
+  // Number of CPUs the commands can use at most, e.g., 0.5.
+  Option<double> cpus;
+
+  // Memory the commands can use at most, in bytes.
+  Option<size_t> memoryLimit;
+
+  // CPUs the commands are pinned to, e.g., "0-1", all of them if not set.
+  Option<std::string> cpuset;
+};
+
+/**
+ * @brief The SpanOptions struct contains the settings of the export of the
+ * spans of the calls and of their commands (see Span).
+ */
+struct SpanOptions {
+  // File the spans are appended to, in the OTLP JSON format.
+  std::string file;
+
+  // Fraction of the calls traced, all of them if not set.
+  Option<double> sampleRate;
+};
+
+/**
+ * @brief The SchedulerOptions struct contains the settings of the oneshot
+ * commands shared by all the module instances (see CommandScheduler and
+ * SpawnServer).
+ */
+struct SchedulerOptions {
+  // Maximum number of oneshot commands running at the same time.
+  Option<size_t> maxConcurrency;
+
+  // Maximum number of commands waiting for a slot before usage commands are
+  // rejected.
+  Option<size_t> maxQueueDepth;
+
+  // If set, the path of mesos-command-spawner which starts the commands
+  // instead of forking the agent.
+  Option<std::string> spawnServer;
+
+  // If set, the commands and the spawn server run in a dedicated cgroup.
+  Option<CgroupOptions> cgroup;
+
+  // If set, the spans of the calls are exported.
+  Option<SpanOptions> spans;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __OPTIONS_HPP__
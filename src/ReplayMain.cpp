@@ -0,0 +1,397 @@
+// Replays a trace recorded by the modules (see TraceRecorder) against the
+// module library, outside of the agent, to size the agents and compare the
+// versions of the commands. The modules are created through the symbols
+// loaded by the agent so that the library is exercised as in production.
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <mesos/hook.hpp>
+#include <mesos/module/hook.hpp>
+#include <mesos/module/isolator.hpp>
+#include <mesos/slave/isolator.hpp>
+
+#include <process/future.hpp>
+#include <stout/flags.hpp>
+#include <stout/foreach.hpp>
+#include <stout/json.hpp>
+#include <stout/numify.hpp>
+#include <stout/os/read.hpp>
+#include <stout/protobuf.hpp>
+#include <stout/strings.hpp>
+
+using process::Failure;
+using process::Future;
+using std::string;
+
+typedef std::chrono::steady_clock SteadyClock;
+
+class Flags : public virtual flags::FlagsBase {
+ public:
+  Flags() {
+    add(&Flags::library, "library",
+        "Path of the module library, e.g., libmesos_command_modules.so.");
+    add(&Flags::trace, "trace", "Path of the JSONL trace to replay.");
+    add(&Flags::parameters, "parameters",
+        "Path of a JSON file with the parameters of the modules, as in the\n"
+        "--modules flag of the agent, e.g.,\n"
+        "[{\"key\": \"isolator_usage_command\", \"value\": \"usage.sh\"}]");
+    add(&Flags::isolator, "isolator", "Symbol of the isolator module.",
+        "com_criteo_mesos_CommandIsolator");
+    add(&Flags::hook, "hook", "Symbol of the hook module.",
+        "com_criteo_mesos_CommandHook");
+    add(&Flags::rate, "rate",
+        "Calls started per second, 0 to keep the pace of the trace.", 0.0);
+    add(&Flags::concurrency, "concurrency",
+        "Maximum number of calls waiting for the modules.", 16);
+    add(&Flags::loops, "loops", "Number of times the trace is replayed.", 1);
+  }
+
+  Option<string> library;
+  Option<string> trace;
+  Option<string> parameters;
+  string isolator;
+  string hook;
+  double rate;
+  size_t concurrency;
+  size_t loops;
+};
+
+// An event of the trace with its input parsed according to its method.
+struct Event {
+  double timestamp;
+  string method;
+  ::mesos::ContainerID containerId;
+  ::mesos::slave::ContainerConfig containerConfig;
+  ::mesos::TaskInfo taskInfo;
+  ::mesos::ExecutorInfo executorInfo;
+  ::mesos::FrameworkInfo frameworkInfo;
+  ::mesos::SlaveInfo slaveInfo;
+};
+
+struct MethodStats {
+  size_t calls = 0;
+  size_t failures = 0;
+  // Only the calls which are waited for, i.e., not watch.
+  std::vector<double> latencies;
+};
+
+template <class Proto>
+static Try<Nothing> parseField(const JSON::Object& input, const string& name,
+                               Proto* proto) {
+  Result<JSON::Object> value = input.find<JSON::Object>(name);
+  if (value.isError()) return Error(value.error());
+  if (value.isNone()) return Error("Missing \"" + name + "\"");
+  Try<Proto> parsed = ::protobuf::parse<Proto>(value.get());
+  if (parsed.isError()) {
+    return Error("Invalid \"" + name + "\": " + parsed.error());
+  }
+  *proto = parsed.get();
+  return Nothing();
+}
+
+static Try<Nothing> parseInput(const JSON::Object& input, Event* event) {
+  const string& method = event->method;
+  if (method == "prepare") {
+    Try<Nothing> parsed =
+        parseField(input, "container_id", &event->containerId);
+    if (parsed.isError()) return parsed;
+    return parseField(input, "container_config", &event->containerConfig);
+  }
+  if (method == "watch" || method == "usage" || method == "cleanup") {
+    return parseField(input, "container_id", &event->containerId);
+  }
+  if (method == "slaveRunTaskLabelDecorator") {
+    Try<Nothing> parsed = parseField(input, "task_info", &event->taskInfo);
+    if (parsed.isSome()) {
+      parsed = parseField(input, "executor_info", &event->executorInfo);
+    }
+    if (parsed.isSome()) {
+      parsed = parseField(input, "framework_info", &event->frameworkInfo);
+    }
+    if (parsed.isSome()) {
+      parsed = parseField(input, "slave_info", &event->slaveInfo);
+    }
+    return parsed;
+  }
+  if (method == "slaveExecutorEnvironmentDecorator") {
+    return parseField(input, "executor_info", &event->executorInfo);
+  }
+  if (method == "slaveRemoveExecutorHook") {
+    Try<Nothing> parsed =
+        parseField(input, "framework_info", &event->frameworkInfo);
+    if (parsed.isError()) return parsed;
+    return parseField(input, "executor_info", &event->executorInfo);
+  }
+  return Error("Unknown method \"" + method + "\"");
+}
+
+static Try<std::vector<Event>> loadTrace(const string& path) {
+  Try<string> content = os::read(path);
+  if (content.isError()) return Error(content.error());
+
+  std::vector<Event> events;
+  std::vector<string> lines = strings::split(content.get(), "\n");
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (strings::trim(lines[i]).empty()) continue;
+    string location = path + ":" + stringify(i + 1) + ": ";
+
+    Try<JSON::Object> line = JSON::parse<JSON::Object>(lines[i]);
+    if (line.isError()) return Error(location + line.error());
+    Result<JSON::Number> timestamp = line->find<JSON::Number>("timestamp");
+    Result<JSON::String> method = line->find<JSON::String>("method");
+    Result<JSON::Object> input = line->find<JSON::Object>("input");
+    if (!timestamp.isSome() || !method.isSome() || !input.isSome()) {
+      return Error(location + "Expected a timestamp, a method and an input");
+    }
+
+    Event event;
+    event.timestamp = timestamp->as<double>();
+    event.method = method->value;
+    Try<Nothing> parsed = parseInput(input.get(), &event);
+    if (parsed.isError()) return Error(location + parsed.error());
+    events.push_back(event);
+  }
+  return events;
+}
+
+static Try<::mesos::Parameters> loadParameters(const Option<string>& path) {
+  if (path.isNone()) return ::mesos::Parameters();
+
+  Try<string> content = os::read(path.get());
+  if (content.isError()) return Error(content.error());
+  Try<JSON::Array> parameters = JSON::parse<JSON::Array>(content.get());
+  if (parameters.isError()) return Error(parameters.error());
+
+  JSON::Object object;
+  object.values["parameter"] = parameters.get();
+  return ::protobuf::parse<::mesos::Parameters>(object);
+}
+
+template <class Kind>
+static Try<Kind*> createModule(void* library, const string& symbol,
+                               const ::mesos::Parameters& parameters) {
+  void* module = dlsym(library, symbol.c_str());
+  if (module == nullptr) return Error(dlerror());
+  Kind* instance =
+      static_cast<mesos::modules::Module<Kind>*>(module)->create(parameters);
+  if (instance == nullptr) return Error("Unable to create " + symbol);
+  return instance;
+}
+
+// Number of processes and threads created on the host since boot.
+static Try<uint64_t> forks() {
+  Try<string> stat = os::read("/proc/stat");
+  if (stat.isError()) return Error(stat.error());
+  foreach (const string& line, strings::split(stat.get(), "\n")) {
+    if (strings::startsWith(line, "processes ")) {
+      return numify<uint64_t>(strings::trim(line.substr(10)));
+    }
+  }
+  return Error("No processes in /proc/stat");
+}
+
+// Start the call of an event. The future is ready once the call succeeded.
+static Future<Nothing> call(const Event& event,
+                            ::mesos::slave::Isolator* isolator,
+                            ::mesos::Hook* hook) {
+  const string& method = event.method;
+  if (method == "prepare") {
+    return isolator->prepare(event.containerId, event.containerConfig)
+        .then([](const Option<::mesos::slave::ContainerLaunchInfo>&) {
+          return Nothing();
+        });
+  }
+  if (method == "watch") {
+    // The future is only completed by a limitation.
+    isolator->watch(event.containerId);
+    return Nothing();
+  }
+  if (method == "usage") {
+    return isolator->usage(event.containerId)
+        .then([](const ::mesos::ResourceStatistics&) { return Nothing(); });
+  }
+  if (method == "cleanup") return isolator->cleanup(event.containerId);
+
+  if (method == "slaveRunTaskLabelDecorator") {
+    Result<::mesos::Labels> labels = hook->slaveRunTaskLabelDecorator(
+        event.taskInfo, event.executorInfo, event.frameworkInfo,
+        event.slaveInfo);
+    if (labels.isError()) return Failure(labels.error());
+  } else if (method == "slaveExecutorEnvironmentDecorator") {
+    Result<::mesos::Environment> environment =
+        hook->slaveExecutorEnvironmentDecorator(event.executorInfo);
+    if (environment.isError()) return Failure(environment.error());
+  } else {
+    Try<Nothing> removed =
+        hook->slaveRemoveExecutorHook(event.frameworkInfo, event.executorInfo);
+    if (removed.isError()) return Failure(removed.error());
+  }
+  return Nothing();
+}
+
+static double percentile(const std::vector<double>& sorted, double rank) {
+  if (sorted.empty()) return 0;
+  size_t index = static_cast<size_t>(rank * sorted.size());
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void report(const std::map<string, MethodStats>& stats, double elapsed,
+                   const Option<uint64_t>& forkCount) {
+  size_t calls = 0;
+  for (const auto& method : stats) calls += method.second.calls;
+
+  std::cout << std::fixed << std::setprecision(3) << "Replayed " << calls
+            << " calls in " << elapsed << "s: " << calls / elapsed
+            << " calls/s, "
+            << (forkCount.isSome() ? stringify(forkCount.get()) : "?")
+            << " forks" << std::endl;
+  std::cout << std::left << std::setw(36) << "method" << std::right
+            << std::setw(9) << "calls" << std::setw(9) << "failures"
+            << std::setw(10) << "p50 (ms)" << std::setw(10) << "p90 (ms)"
+            << std::setw(10) << "p99 (ms)" << std::setw(10) << "max (ms)"
+            << std::endl;
+  for (const auto& method : stats) {
+    std::vector<double> latencies = method.second.latencies;
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << std::left << std::setw(36) << method.first << std::right
+              << std::setw(9) << method.second.calls << std::setw(9)
+              << method.second.failures << std::setw(10)
+              << percentile(latencies, 0.5) << std::setw(10)
+              << percentile(latencies, 0.9) << std::setw(10)
+              << percentile(latencies, 0.99) << std::setw(10)
+              << (latencies.empty() ? 0 : latencies.back()) << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  Flags flags;
+  Try<flags::Warnings> load = flags.load(None(), argc, argv);
+  if (flags.help) {
+    std::cout << flags.usage() << std::endl;
+    return EXIT_SUCCESS;
+  }
+  if (load.isError()) {
+    std::cerr << flags.usage(load.error()) << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (flags.library.isNone() || flags.trace.isNone()) {
+    std::cerr << flags.usage("--library and --trace are required") << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (flags.concurrency == 0 || flags.rate < 0) {
+    std::cerr << flags.usage("Invalid --concurrency or --rate") << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Try<std::vector<Event>> events = loadTrace(flags.trace.get());
+  if (events.isError()) {
+    std::cerr << "Unable to load the trace: " << events.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (events->empty()) {
+    std::cerr << "The trace is empty" << std::endl;
+    return EXIT_FAILURE;
+  }
+  Try<::mesos::Parameters> parameters = loadParameters(flags.parameters);
+  if (parameters.isError()) {
+    std::cerr << "Unable to load the parameters: " << parameters.error()
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  void* library = dlopen(flags.library->c_str(), RTLD_NOW | RTLD_GLOBAL);
+  if (library == nullptr) {
+    std::cerr << "Unable to load the library: " << dlerror() << std::endl;
+    return EXIT_FAILURE;
+  }
+  Try<::mesos::slave::Isolator*> isolator =
+      createModule<::mesos::slave::Isolator>(library, flags.isolator,
+                                             parameters.get());
+  Try<::mesos::Hook*> hook =
+      createModule<::mesos::Hook>(library, flags.hook, parameters.get());
+  if (isolator.isError() || hook.isError()) {
+    std::cerr << "Unable to create the modules: "
+              << (isolator.isError() ? isolator.error() : hook.error())
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::vector<Event>& trace = events.get();
+  double span = trace.back().timestamp - trace.front().timestamp;
+  size_t total = trace.size() * flags.loops;
+
+  std::mutex mutex;
+  size_t next = 0;
+  std::map<string, MethodStats> stats;
+
+  Try<uint64_t> forksBefore = forks();
+  SteadyClock::time_point start = SteadyClock::now();
+
+  // Each worker waits for one call at a time, and the next call is started
+  // at its slot by the first worker available, so that the rate drops if the
+  // modules cannot keep up with the concurrency.
+  auto worker = [&]() {
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (next == total) return;
+      size_t index = next++;
+      const Event& event = trace[index % trace.size()];
+      double offset =
+          flags.rate > 0
+              ? index / flags.rate
+              : (index / trace.size()) * span +
+                    (event.timestamp - trace.front().timestamp);
+      std::this_thread::sleep_until(
+          start + std::chrono::duration_cast<SteadyClock::duration>(
+                      std::chrono::duration<double>(offset)));
+
+      // Isolator calls are started with the lock held to keep the order of
+      // the trace, e.g., a usage after the prepare of its container.
+      SteadyClock::time_point started = SteadyClock::now();
+      Future<Nothing> result;
+      if (strings::startsWith(event.method, "slave")) {
+        lock.unlock();
+        result = call(event, isolator.get(), hook.get());
+      } else {
+        result = call(event, isolator.get(), hook.get());
+        lock.unlock();
+      }
+      result.await();
+      std::chrono::duration<double, std::milli> latency =
+          SteadyClock::now() - started;
+
+      lock.lock();
+      MethodStats& method = stats[event.method];
+      ++method.calls;
+      if (!result.isReady()) ++method.failures;
+      if (event.method != "watch") method.latencies.push_back(latency.count());
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < flags.concurrency; ++i) workers.emplace_back(worker);
+  for (std::thread& thread : workers) thread.join();
+
+  std::chrono::duration<double> elapsed = SteadyClock::now() - start;
+  Try<uint64_t> forksAfter = forks();
+  Option<uint64_t> forkCount;
+  if (forksBefore.isSome() && forksAfter.isSome()) {
+    // The workers are threads counted by the kernel too.
+    forkCount = forksAfter.get() - forksBefore.get() - flags.concurrency;
+  }
+  report(stats, elapsed.count(), forkCount);
+
+  delete hook.get();
+  delete isolator.get();
+  return EXIT_SUCCESS;
+}
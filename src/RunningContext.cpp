@@ -1,12 +1,51 @@
 #include "RunningContext.hpp"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <fstream>
+#include <stout/error.hpp>
 #include <stout/os.hpp>
+#include <stout/stringify.hpp>
+
+#include <glog/logging.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
 
 namespace criteo {
 namespace mesos {
 
-RunningContext::TemporaryFile::TemporaryFile() {
+// Create an anonymous in-memory file which is only inherited by the command
+// it is created for (see fds()), not by the other processes spawned
+// meanwhile. memfd_create is called through syscall since older glibc do not
+// expose it.
+static int createMemoryFile() {
+#ifdef __NR_memfd_create
+  return syscall(__NR_memfd_create, "criteo-mesos", MFD_CLOEXEC);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+RunningContext::TemporaryFile::TemporaryFile(CommandTransport transport)
+    : m_fd(-1) {
+  if (transport == CommandTransport::MEMFD) {
+    m_fd = createMemoryFile();
+    if (m_fd != -1) {
+      m_filepath = "/dev/fd/" + std::to_string(m_fd);
+      return;
+    }
+    LOG_FIRST_N(WARNING, 1) << "Unable to create in-memory file ("
+                            << strerror(errno)
+                            << "), falling back on temporary files";
+  }
+
   char filepath[] = TEMP_FILE_TEMPLATE;
   int fd = mkstemp(filepath);
   if (fd == -1)
@@ -15,20 +54,75 @@ RunningContext::TemporaryFile::TemporaryFile() {
   m_filepath = std::string(filepath);
 }
 
-std::string RunningContext::TemporaryFile::readAll() const {
-  std::ifstream ifs(m_filepath);
-  std::string content((std::istreambuf_iterator<char>(ifs)),
-                      (std::istreambuf_iterator<char>()));
-  ifs.close();
+Try<std::string> RunningContext::TemporaryFile::read(size_t limit) const {
+  int fd = m_fd;
+  if (fd == -1) {
+    fd = ::open(m_filepath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return ErrnoError("Unable to open " + m_filepath);
+  }
+
+  struct stat s;
+  if (fstat(fd, &s) == -1) {
+    ErrnoError error("Unable to stat " + m_filepath);
+    if (fd != m_fd) close(fd);
+    return error;
+  }
+
+  size_t size = static_cast<size_t>(s.st_size);
+  std::string content(limit != 0 && limit < size ? limit : size, '\0');
+  size_t offset = 0;
+  while (offset < content.size()) {
+    ssize_t length =
+        pread(fd, &content[offset], content.size() - offset, offset);
+    if (length == -1 && errno == EINTR) continue;
+    if (length == -1) {
+      ErrnoError error("Unable to read " + m_filepath);
+      if (fd != m_fd) close(fd);
+      return error;
+    }
+    if (length == 0) break;
+    offset += length;
+  }
+  if (fd != m_fd) close(fd);
+  content.resize(offset);
   return content;
 }
 
+Try<size_t> RunningContext::TemporaryFile::size() const {
+  struct stat s;
+  int result = m_fd == -1 ? ::stat(m_filepath.c_str(), &s) : fstat(m_fd, &s);
+  if (result == -1) return ErrnoError("Unable to stat " + m_filepath);
+  return static_cast<size_t>(s.st_size);
+}
+
 void RunningContext::TemporaryFile::write(const std::string& content) const {
-  std::ofstream ofs;
-  ofs.open(m_filepath);
-  ofs << content;
-  std::flush(ofs);
-  ofs.close();
+  if (m_fd == -1) {
+    std::ofstream ofs;
+    ofs.open(m_filepath);
+    ofs << content;
+    std::flush(ofs);
+    ofs.close();
+    return;
+  }
+
+  size_t offset = 0;
+  while (offset < content.size()) {
+    ssize_t length =
+        pwrite(m_fd, content.data() + offset, content.size() - offset, offset);
+    if (length == -1 && errno == EINTR) continue;
+    if (length == -1)
+      throw std::runtime_error("Unable to write in-memory file: " +
+                               std::string(strerror(errno)));
+    offset += length;
+  }
+}
+
+void RunningContext::TemporaryFile::remove() const {
+  if (m_fd != -1) {
+    close(m_fd);
+  } else if (!m_filepath.empty()) {
+    os::rm(m_filepath);
+  }
 }
 
 inline const std::string& RunningContext::TemporaryFile::filepath() const {
@@ -38,8 +132,23 @@ inline const std::string& RunningContext::TemporaryFile::filepath() const {
 RunningContext::RunningContext(bool debug,
                                const logging::Metadata& loggingMetadata,
                                const Command& command, const std::string& input)
-    : debug(debug), loggingMetadata(loggingMetadata) {
-  inputFile.write(input);
+    : debug(debug),
+      loggingMetadata(loggingMetadata),
+      command(command.command()),
+      maxOutputBytes(command.maxOutputBytes()),
+      maxErrorBytes(command.maxErrorBytes()) {
+  try {
+    inputFile = TemporaryFile(command.transport());
+    outputFile = TemporaryFile(command.transport());
+    errorFile = TemporaryFile(command.transport());
+    inputFile.write(input);
+  } catch (const std::runtime_error&) {
+    // The files created before the failure are not released by the caller.
+    inputFile.remove();
+    outputFile.remove();
+    errorFile.remove();
+    throw;
+  }
   args = {inputFile.filepath(), outputFile.filepath(), errorFile.filepath()};
 
   if (debug) {
@@ -50,25 +159,55 @@ RunningContext::RunningContext(bool debug,
   }
 }
 
+std::vector<int> RunningContext::fds() const {
+  std::vector<int> fds;
+  for (const TemporaryFile* file : {&inputFile, &outputFile, &errorFile}) {
+    if (file->fd() != -1) fds.push_back(file->fd());
+  }
+  return fds;
+}
+
 void RunningContext::deleteContext() const {
   if (debug)
     TASK_LOG(INFO, loggingMetadata) << "Removing temp files " << inputFile
                                     << " " << outputFile << " " << errorFile;
-  os::rm(inputFile.filepath());
-  os::rm(outputFile.filepath());
-  os::rm(errorFile.filepath());
+  inputFile.remove();
+  outputFile.remove();
+  errorFile.remove();
+}
+
+Option<Error> RunningContext::checkOutputSize() const {
+  if (maxOutputBytes == 0) return None();
+  Try<size_t> size = outputFile.size();
+  if (size.isError()) return Error(size.error());
+  if (size.get() > maxOutputBytes) {
+    return Error("Output of command \"" + command + "\" is " +
+                 stringify(size.get()) + " bytes, more than the limit of " +
+                 stringify(maxOutputBytes));
+  }
+  return None();
 }
 
 Try<std::string> RunningContext::readOutput() const {
-  return readFile(outputFile);
+  Option<Error> tooBig = checkOutputSize();
+  if (tooBig.isSome()) return tooBig.get();
+  // Processes left behind by the command may still be writing.
+  return outputFile.read(maxOutputBytes);
 }
 
 Try<std::string> RunningContext::readError() const {
-  return readFile(errorFile);
-}
+  Try<std::string> error = errorFile.read(maxErrorBytes);
+  if (error.isError() || maxErrorBytes == 0 ||
+      error->size() < maxErrorBytes) {
+    return error;
+  }
 
-Try<std::string> RunningContext::readFile(const TemporaryFile& file) const {
-  return os::read(file.filepath());
+  Try<size_t> size = errorFile.size();
+  if (size.isSome() && size.get() > error->size()) {
+    error.get() += "... (" + stringify(size.get() - error->size()) +
+                   " more bytes)";
+  }
+  return error;
 }
 }  // namespace mesos
 }  // namespace criteo
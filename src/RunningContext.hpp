@@ -1,6 +1,11 @@
 #ifndef __RUNNING_CONTEXT_HPP__
 #define __RUNNING_CONTEXT_HPP__
 
+#include <string>
+#include <vector>
+
+#include <stout/error.hpp>
+#include <stout/option.hpp>
 #include <stout/try.hpp>
 
 #include "Command.hpp"
@@ -17,23 +22,64 @@ class RunningContext {
                  const Command& command, const std::string& input);
 
   void deleteContext() const;
+
+  /*
+   * Read the output of the command, failing without reading it if it is
+   * bigger than the limit of the command.
+   */
   Try<std::string> readOutput() const;
+
+  /*
+   * @return true if the command has a limit on its output, which is then
+   * checked while it runs.
+   */
+  bool limitsOutput() const { return maxOutputBytes != 0; }
+
+  /*
+   * @return An error if the output written so far is bigger than the limit
+   * of the command.
+   */
+  Option<Error> checkOutputSize() const;
+
+  /*
+   * Read the error output of the command, truncated to the limit of the
+   * command.
+   */
   Try<std::string> readError() const;
   const std::vector<std::string>& get_args() const { return args; };
 
+  /*
+   * @return The descriptors of the in-memory files, which are close-on-exec
+   * and must be inherited by the command only.
+   */
+  std::vector<int> fds() const;
+
  private:
   /*
    * Represent a temporary file that can be either written or read from.
+   *
+   * With the MEMFD transport, the file is an anonymous in-memory file whose
+   * descriptor is inherited by the command and reachable through its
+   * /dev/fd/N path. If memfd_create is not supported, it falls back on a
+   * regular temporary file.
    */
   class TemporaryFile {
    public:
-    TemporaryFile();
+    TemporaryFile() : m_fd(-1) {}
+    explicit TemporaryFile(CommandTransport transport);
 
     /*
-     * Read whole content of the temporary file.
+     * Read the beginning of the temporary file at once into a buffer of the
+     * right size.
+     * @param limit The maximum number of bytes to read, 0 for no limit.
      * @return The content of the file.
      */
-    std::string readAll() const;
+    Try<std::string> read(size_t limit = 0) const;
+
+    /*
+     * @return The size of the temporary file.
+     */
+    Try<size_t> size() const;
 
     /*
      * Write content to the temporary file and flush it.
@@ -41,8 +87,16 @@ class RunningContext {
      */
     void write(const std::string& content) const;
 
+    /*
+     * Release the temporary file.
+     */
+    void remove() const;
+
     inline const std::string& filepath() const;
 
+    // Descriptor of the in-memory file, -1 for a regular temporary file.
+    int fd() const { return m_fd; }
+
     friend std::ostream& operator<<(std::ostream& out,
                                     const TemporaryFile& temp_file) {
       out << temp_file.m_filepath;
@@ -51,12 +105,15 @@ class RunningContext {
 
    private:
     std::string m_filepath;
+    // Descriptor of the in-memory file, -1 for a regular temporary file.
+    int m_fd;
   };
 
-  Try<std::string> readFile(const TemporaryFile& file) const;
-
   bool debug;
   const logging::Metadata loggingMetadata;
+  const std::string command;
+  const size_t maxOutputBytes;
+  const size_t maxErrorBytes;
   std::vector<std::string> args;
 
   TemporaryFile inputFile;
@@ -0,0 +1,312 @@
+#include "Serialization.hpp"
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <stout/foreach.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+namespace criteo {
+namespace mesos {
+
+using google::protobuf::internal::WireFormatLite;
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::io::StringOutputStream;
+using std::string;
+
+// Keys of the fields in the JSON input, indexed by field number.
+static const char* const FIELD_NAMES[] = {
+    nullptr,         "container_id",   "container_config", "task_info",
+    "executor_info", "framework_info", "slave_info"};
+
+// Field numbers of BatchInput, BatchOutput and BatchOutput.Entry.
+const int BATCH_FIELD = 1;
+const int BATCH_SEQUENCE_FIELD = 2;
+const int BATCH_FULL_FIELD = 3;
+const int ENTRY_CONTAINER_ID_FIELD = 1;
+const int ENTRY_VALUE_FIELD = 2;
+
+// Field number of WatchHint, beyond the ones of ContainerLimitation.
+const int NEXT_CHECK_IN_FIELD = 100;
+
+static uint32_t lengthDelimitedTag(int field) {
+  return WireFormatLite::MakeTag(field,
+                                 WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+}
+
+static uint32_t varintTag(int field) {
+  return WireFormatLite::MakeTag(field, WireFormatLite::WIRETYPE_VARINT);
+}
+
+// Append a length-delimited field, i.e., an embedded message, to a message.
+static void appendField(string* buffer, int field, const string& payload) {
+  StringOutputStream stream(buffer);
+  CodedOutputStream output(&stream);
+  output.WriteTag(lengthDelimitedTag(field));
+  output.WriteVarint32(payload.size());
+  output.WriteRaw(payload.data(), payload.size());
+}
+
+InputBuilder::InputBuilder(CommandFormat format) : m_format(format) {}
+
+InputBuilder& InputBuilder::add(InputField field,
+                                const google::protobuf::Message& message) {
+  m_fields.push_back(std::make_pair(field, &message));
+  return *this;
+}
+
+string InputBuilder::str() const {
+  if (m_format == CommandFormat::JSON) return stringify(json());
+
+  string input;
+  for (const auto& field : m_fields) {
+    appendField(&input, static_cast<int>(field.first),
+                field.second->SerializeAsString());
+  }
+  return input;
+}
+
+JSON::Object InputBuilder::json() const {
+  JSON::Object input;
+  for (const auto& field : m_fields) {
+    input.values[FIELD_NAMES[static_cast<int>(field.first)]] =
+        JSON::protobuf(*field.second);
+  }
+  return input;
+}
+
+string joinInputs(CommandFormat format,
+                  const std::vector<const string*>& inputs) {
+  if (format == CommandFormat::PROTOBUF) {
+    string joined;
+    for (const string* input : inputs) {
+      appendField(&joined, BATCH_FIELD, *input);
+    }
+    return joined;
+  }
+
+  size_t size = 2 + inputs.size();
+  for (const string* input : inputs) size += input->size();
+
+  string joined;
+  joined.reserve(size);
+  joined += '[';
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    if (i > 0) joined += ',';
+    joined += *inputs[i];
+  }
+  joined += ']';
+  return joined;
+}
+
+string joinDeltaInputs(CommandFormat format, uint64_t sequence,
+                       const std::vector<const string*>& inputs) {
+  if (format == CommandFormat::PROTOBUF) {
+    string joined;
+    {
+      StringOutputStream stream(&joined);
+      CodedOutputStream output(&stream);
+      output.WriteTag(varintTag(BATCH_SEQUENCE_FIELD));
+      output.WriteVarint64(sequence);
+    }
+    return joined + joinInputs(format, inputs);
+  }
+
+  return "{\"sequence\":" + stringify(sequence) +
+         ",\"inputs\":" + joinInputs(format, inputs) + "}";
+}
+
+Try<hashmap<string, string>> splitBatchOutput(const string& output,
+                                              DeltaHeader* header) {
+  CodedInputStream input(reinterpret_cast<const uint8_t*>(output.data()),
+                         output.size());
+  hashmap<string, string> entries;
+
+  for (uint32_t tag = input.ReadTag(); tag != 0; tag = input.ReadTag()) {
+    if (header != nullptr && tag == varintTag(BATCH_SEQUENCE_FIELD)) {
+      if (!input.ReadVarint64(&header->sequence)) {
+        return Error("Malformed Protobuf. Invalid BatchOutput.");
+      }
+      continue;
+    }
+    if (header != nullptr && tag == varintTag(BATCH_FULL_FIELD)) {
+      uint32_t full;
+      if (!input.ReadVarint32(&full)) {
+        return Error("Malformed Protobuf. Invalid BatchOutput.");
+      }
+      header->full = full != 0;
+      continue;
+    }
+    if (tag != lengthDelimitedTag(BATCH_FIELD)) {
+      if (!WireFormatLite::SkipField(&input, tag)) {
+        return Error("Malformed Protobuf. Invalid BatchOutput.");
+      }
+      continue;
+    }
+
+    uint32_t length;
+    if (!input.ReadVarint32(&length)) {
+      return Error("Malformed Protobuf. Invalid BatchOutput.");
+    }
+    CodedInputStream::Limit limit = input.PushLimit(length);
+
+    string containerId;
+    string value;
+    for (uint32_t field = input.ReadTag(); field != 0;
+         field = input.ReadTag()) {
+      bool read;
+      if (field == lengthDelimitedTag(ENTRY_CONTAINER_ID_FIELD)) {
+        read = WireFormatLite::ReadString(&input, &containerId);
+      } else if (field == lengthDelimitedTag(ENTRY_VALUE_FIELD)) {
+        read = WireFormatLite::ReadBytes(&input, &value);
+      } else {
+        read = WireFormatLite::SkipField(&input, field);
+      }
+      if (!read) return Error("Malformed Protobuf. Invalid BatchOutput entry.");
+    }
+    if (!input.ConsumedEntireMessage()) {
+      return Error("Malformed Protobuf. Invalid BatchOutput entry.");
+    }
+    input.PopLimit(limit);
+
+    if (containerId.empty()) {
+      return Error("Malformed Protobuf. BatchOutput entry without container.");
+    }
+    // Like any repeated message field, entries of the same container merge.
+    entries[containerId] += value;
+  }
+
+  if (!input.ConsumedEntireMessage()) {
+    return Error("Malformed Protobuf. Invalid BatchOutput.");
+  }
+  return entries;
+}
+
+Try<Option<double>> extractNextCheckIn(string* output) {
+  CodedInputStream input(reinterpret_cast<const uint8_t*>(output->data()),
+                         output->size());
+  const uint32_t hintTag = WireFormatLite::MakeTag(
+      NEXT_CHECK_IN_FIELD, WireFormatLite::WIRETYPE_FIXED64);
+
+  // The other fields are copied as is, in their order.
+  Option<double> nextCheckIn;
+  string message;
+  message.reserve(output->size());
+  int start = input.CurrentPosition();
+  for (uint32_t tag = input.ReadTag(); tag != 0; tag = input.ReadTag()) {
+    if (tag == hintTag) {
+      uint64_t bits;
+      if (!input.ReadLittleEndian64(&bits)) {
+        return Error("Malformed Protobuf. Invalid WatchHint.");
+      }
+      // Like any optional field, the last one wins.
+      nextCheckIn = WireFormatLite::DecodeDouble(bits);
+    } else {
+      if (!WireFormatLite::SkipField(&input, tag)) {
+        return Error("Malformed Protobuf. Invalid wire format.");
+      }
+      message.append(*output, start, input.CurrentPosition() - start);
+    }
+    start = input.CurrentPosition();
+  }
+  if (!input.ConsumedEntireMessage()) {
+    return Error("Malformed Protobuf. Invalid wire format.");
+  }
+
+  if (nextCheckIn.isSome()) output->swap(message);
+  return nextCheckIn;
+}
+
+// Merge a JSON value into another, see mergeOutputs.
+static void mergeJson(JSON::Value* target, const JSON::Value& source) {
+  if (target->is<JSON::Object>() && source.is<JSON::Object>()) {
+    JSON::Object& object = target->as<JSON::Object>();
+    foreachpair (const string& key, const JSON::Value& value,
+                 source.as<JSON::Object>().values) {
+      if (object.values.count(key) == 0) {
+        object.values[key] = value;
+      } else {
+        mergeJson(&object.values[key], value);
+      }
+    }
+  } else if (target->is<JSON::Array>() && source.is<JSON::Array>()) {
+    std::vector<JSON::Value>& values = target->as<JSON::Array>().values;
+    const std::vector<JSON::Value>& added = source.as<JSON::Array>().values;
+    values.insert(values.end(), added.begin(), added.end());
+  } else if (!source.is<JSON::Null>()) {
+    *target = source;
+  }
+}
+
+Try<string> mergeOutputs(CommandFormat format,
+                         const std::vector<string>& outputs) {
+  std::vector<const string*> nonEmpty;
+  for (const string& output : outputs) {
+    if (!strings::trim(output).empty()) nonEmpty.push_back(&output);
+  }
+  if (nonEmpty.empty()) return string();
+  if (nonEmpty.size() == 1) return *nonEmpty.front();
+
+  // Concatenating serialized messages merges them.
+  if (format == CommandFormat::PROTOBUF) {
+    string merged;
+    for (const string* output : nonEmpty) merged += *output;
+    return merged;
+  }
+
+  Option<JSON::Value> merged;
+  for (const string* output : nonEmpty) {
+    Try<JSON::Value> json = JSON::parse(*output);
+    if (json.isError()) return Error("Malformed JSON: " + json.error());
+    if (merged.isNone()) {
+      merged = json.get();
+    } else {
+      mergeJson(&merged.get(), json.get());
+    }
+  }
+  return stringify(merged.get());
+}
+
+// Clear the repeated fields of a message which are set in the delta, in the
+// embedded messages too, so that MergeFrom replaces them.
+static void clearReplacedFields(const google::protobuf::Message& delta,
+                                google::protobuf::Message* message) {
+  const google::protobuf::Reflection* reflection = message->GetReflection();
+  std::vector<const google::protobuf::FieldDescriptor*> fields;
+  delta.GetReflection()->ListFields(delta, &fields);
+  for (const google::protobuf::FieldDescriptor* field : fields) {
+    if (field->is_repeated()) {
+      reflection->ClearField(message, field);
+    } else if (field->cpp_type() ==
+                   google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE &&
+               reflection->HasField(*message, field)) {
+      clearReplacedFields(delta.GetReflection()->GetMessage(delta, field),
+                          reflection->MutableMessage(message, field));
+    }
+  }
+}
+
+void mergeDelta(const google::protobuf::Message& delta,
+                google::protobuf::Message* message) {
+  clearReplacedFields(delta, message);
+  message->MergeFrom(delta);
+}
+
+Try<Nothing> parseMessage(const string& payload,
+                          google::protobuf::Message* message) {
+  if (!message->ParsePartialFromString(payload)) {
+    return Error("Malformed Protobuf. Invalid wire format.");
+  }
+  if (!message->IsInitialized()) {
+    return Error("Malformed Protobuf. Missing required fields: " +
+                 message->InitializationErrorString());
+  }
+  return Nothing();
+}
+
+}  // namespace mesos
+}  // namespace criteo
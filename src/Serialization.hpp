@@ -0,0 +1,320 @@
+#ifndef __SERIALIZATION_HPP__
+#define __SERIALIZATION_HPP__
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <google/protobuf/message.h>
+
+#include <stout/duration.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/json.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/result.hpp>
+#include <stout/stringify.hpp>
+#include <stout/try.hpp>
+
+#include "Command.hpp"
+#include "Helpers.hpp"
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * Fields of the input of the commands. In JSON they are the keys of the
+ * input object, in protobuf the field numbers of the CommandInput message
+ * described in proto/command_modules.proto.
+ */
+enum class InputField {
+  CONTAINER_ID = 1,
+  CONTAINER_CONFIG = 2,
+  TASK_INFO = 3,
+  EXECUTOR_INFO = 4,
+  FRAMEWORK_INFO = 5,
+  SLAVE_INFO = 6
+};
+
+/**
+ * @brief The InputBuilder class serializes the input of a command in the
+ * format of the command. The messages added must outlive the builder.
+ */
+class InputBuilder {
+ public:
+  explicit InputBuilder(CommandFormat format);
+
+  InputBuilder& add(InputField field, const google::protobuf::Message& message);
+
+  std::string str() const;
+
+  /**
+   * @return The input as JSON whatever the format of the command.
+   */
+  JSON::Object json() const;
+
+ private:
+  CommandFormat m_format;
+  std::vector<std::pair<InputField, const google::protobuf::Message*>>
+      m_fields;
+};
+
+/**
+ * Join serialized inputs into the input of a command handling several
+ * containers at once: a JSON array, or a BatchInput message in protobuf.
+ */
+std::string joinInputs(CommandFormat format,
+                       const std::vector<const std::string*>& inputs);
+
+/**
+ * Header of the output of the usage command in delta mode.
+ */
+struct DeltaHeader {
+  // Sequence number of the statistics, sent back in the next input.
+  uint64_t sequence = 0;
+  // Whether the output has the statistics of every container instead of the
+  // ones which changed since the sequence number of the input.
+  bool full = false;
+};
+
+/**
+ * Output of the usage command in delta mode, see parseDeltaOutput.
+ */
+template <class Proto>
+struct DeltaOutput {
+  DeltaHeader header;
+  hashmap<std::string, Proto> entries;
+};
+
+/**
+ * Output of the watch command, see parseWatchOutput.
+ */
+template <class Proto>
+struct WatchOutput {
+  // The limitation hit by the container, None if it is fine.
+  Option<Proto> limitation;
+  // The delay before the next check suggested by the command, if any.
+  Option<Duration> nextCheckIn;
+};
+
+/**
+ * Join serialized inputs into the input of the usage command in delta mode:
+ * a JSON object with the sequence number and the array of inputs, or a
+ * BatchInput message with its sequence number in protobuf.
+ */
+std::string joinDeltaInputs(CommandFormat format, uint64_t sequence,
+                            const std::vector<const std::string*>& inputs);
+
+/**
+ * Split a BatchOutput message into the serialized message of each container.
+ *
+ * @param header If set, filled with the sequence number of the message.
+ */
+Try<hashmap<std::string, std::string>> splitBatchOutput(
+    const std::string& output, DeltaHeader* header = nullptr);
+
+/**
+ * Remove the next_check_in field of the WatchHint message appended to a
+ * serialized message by the watch command.
+ *
+ * @return The value of the field in seconds, None if it is not set.
+ */
+Try<Option<double>> extractNextCheckIn(std::string* output);
+
+/**
+ * Merge a partial message into another like MergeFrom, except that the
+ * repeated fields set in the delta replace the ones of the message instead
+ * of being appended.
+ */
+void mergeDelta(const google::protobuf::Message& delta,
+                google::protobuf::Message* message);
+
+/**
+ * Merge the outputs of parallel commands like protobuf merges messages:
+ * repeated fields, i.e., JSON arrays, are concatenated, embedded messages are
+ * merged and the last output wins for the other fields. Empty outputs are
+ * ignored.
+ */
+Try<std::string> mergeOutputs(CommandFormat format,
+                              const std::vector<std::string>& outputs);
+
+/**
+ * Fill a message from its binary wire format. Unlike ParseFromString, the
+ * error tells whether the payload is malformed or incomplete.
+ */
+Try<Nothing> parseMessage(const std::string& payload,
+                          google::protobuf::Message* message);
+
+/**
+ * Parse the output of a command in the format of the command.
+ */
+template <class Proto>
+Result<Proto> parseOutput(const Command& command, const std::string& output) {
+  if (command.format() == CommandFormat::JSON) {
+    return jsonToProtobuf<Proto>(output);
+  }
+
+  if (output.empty()) return Error("No content to parse");
+
+  Proto proto;
+  Try<Nothing> parsed = parseMessage(output, &proto);
+  if (parsed.isError()) return Error(parsed.error());
+  return proto;
+}
+
+// Parse the entries of a BatchOutput message, skipping the malformed ones
+// like jsonToProtobufMap.
+template <class Proto>
+Try<hashmap<std::string, Proto>> parseBatchEntries(
+    const hashmap<std::string, std::string>& entries) {
+  hashmap<std::string, Proto> protos;
+  foreachpair (const std::string& containerId, const std::string& value,
+               entries) {
+    Proto proto;
+    Try<Nothing> parsed = parseMessage(value, &proto);
+    if (parsed.isError()) {
+      LOG(WARNING) << parsed.error() << " for container " << containerId;
+      continue;
+    }
+    protos.put(containerId, proto);
+  }
+  return protos;
+}
+
+/**
+ * Parse the output of a command handling several containers at once, see
+ * jsonToProtobufMap for the JSON format.
+ */
+template <class Proto>
+Try<hashmap<std::string, Proto>> parseOutputMap(const Command& command,
+                                                const std::string& output) {
+  if (command.format() == CommandFormat::JSON) {
+    return jsonToProtobufMap<Proto>(output);
+  }
+
+  if (output.empty()) return Error("No content to parse");
+
+  Try<hashmap<std::string, std::string>> entries = splitBatchOutput(output);
+  if (entries.isError()) return Error(entries.error());
+  return parseBatchEntries<Proto>(entries.get());
+}
+
+/**
+ * Parse the output of the watch command. In JSON, it is the limitation
+ * object, which may have a `next_check_in` key in seconds besides its own
+ * fields. An object with only this key means the container is fine:
+ *
+ *   {"next_check_in": 120}
+ *
+ * In protobuf, it is the serialized limitation, possibly empty, followed by
+ * a serialized WatchHint message with the same field.
+ */
+template <class Proto>
+Try<WatchOutput<Proto>> parseWatchOutput(const Command& command,
+                                         const std::string& output) {
+  WatchOutput<Proto> watch;
+  if (output.empty()) return watch;
+
+  Option<double> nextCheckIn;
+  if (command.format() == CommandFormat::PROTOBUF) {
+    std::string message = output;
+    Try<Option<double>> hint = extractNextCheckIn(&message);
+    if (hint.isError()) return Error(hint.error());
+    nextCheckIn = hint.get();
+
+    if (!message.empty()) {
+      Proto proto;
+      Try<Nothing> parsed = parseMessage(message, &proto);
+      if (parsed.isError()) return Error(parsed.error());
+      watch.limitation = proto;
+    }
+  } else {
+    Try<JSON::Object> json = JSON::parse<JSON::Object>(output);
+    if (json.isError()) return Error("Malformed JSON. " + json.error());
+
+    Result<JSON::Number> hint = json->find<JSON::Number>("next_check_in");
+    if (hint.isError()) return Error("Malformed JSON. " + hint.error());
+    if (hint.isSome()) {
+      nextCheckIn = hint->as<double>();
+      json->values.erase("next_check_in");
+    }
+
+    if (!json->values.empty()) {
+      Try<Proto> proto = ::protobuf::parse<Proto>(json.get());
+      if (proto.isError()) {
+        return Error("Error while converting JSON to protobuf. " +
+                     proto.error());
+      }
+      watch.limitation = proto.get();
+    }
+  }
+
+  if (nextCheckIn.isSome()) {
+    // Also rejects NaN.
+    if (!(nextCheckIn.get() >= 0)) {
+      return Error("Invalid next_check_in: " + stringify(nextCheckIn.get()));
+    }
+    // Capped before the conversion, the isolator bounding it anyway.
+    double seconds = std::min(nextCheckIn.get(), Weeks(52).secs());
+    watch.nextCheckIn = Milliseconds(static_cast<int64_t>(seconds * 1000));
+  }
+  return watch;
+}
+
+/**
+ * Parse the output of the usage command in delta mode. In JSON, it is an
+ * object with the sequence number, whether the output is full and the object
+ * mapping the container ids to their messages (see jsonToProtobufMap):
+ *
+ *   {"sequence": 42, "full": false, "entries": {"container_1": {...}}}
+ *
+ * In protobuf, it is a BatchOutput message with the same fields.
+ */
+template <class Proto>
+Try<DeltaOutput<Proto>> parseDeltaOutput(const Command& command,
+                                         const std::string& output) {
+  if (output.empty()) return Error("No content to parse");
+
+  DeltaOutput<Proto> delta;
+  if (command.format() == CommandFormat::PROTOBUF) {
+    Try<hashmap<std::string, std::string>> entries =
+        splitBatchOutput(output, &delta.header);
+    if (entries.isError()) return Error(entries.error());
+    Try<hashmap<std::string, Proto>> protos =
+        parseBatchEntries<Proto>(entries.get());
+    if (protos.isError()) return Error(protos.error());
+    delta.entries = protos.get();
+    return delta;
+  }
+
+  Try<JSON::Object> json = JSON::parse<JSON::Object>(output);
+  if (json.isError()) return Error("Malformed JSON. " + json.error());
+
+  Result<JSON::Number> sequence = json->find<JSON::Number>("sequence");
+  if (!sequence.isSome()) {
+    return Error("Malformed JSON. A sequence number is expected.");
+  }
+  delta.header.sequence = sequence->as<uint64_t>();
+
+  Result<JSON::Boolean> full = json->find<JSON::Boolean>("full");
+  if (full.isError()) return Error("Malformed JSON. " + full.error());
+  delta.header.full = full.isSome() && full->value;
+
+  Result<JSON::Object> entries = json->find<JSON::Object>("entries");
+  if (entries.isError()) return Error("Malformed JSON. " + entries.error());
+  if (entries.isSome()) {
+    Try<hashmap<std::string, Proto>> protos =
+        jsonToProtobufMap<Proto>(entries.get());
+    if (protos.isError()) return Error(protos.error());
+    delta.entries = protos.get();
+  }
+  return delta;
+}
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __SERIALIZATION_HPP__
@@ -0,0 +1,241 @@
+#include "Span.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <stout/error.hpp>
+#include <stout/json.hpp>
+#include <stout/option.hpp>
+#include <stout/os/strerror.hpp>
+#include <stout/stringify.hpp>
+
+namespace criteo {
+namespace mesos {
+
+using std::string;
+
+const char SERVICE_NAME[] = "mesos-command-modules";
+// Values of Span.SpanKind and Status.StatusCode in OTLP.
+const int SPAN_KIND_INTERNAL = 1;
+const int STATUS_CODE_ERROR = 2;
+
+static std::mt19937_64& generator() {
+  thread_local std::mt19937_64 generator(std::random_device{}());
+  return generator;
+}
+
+// Hexadecimal id of 8 bytes for a span or 16 bytes for a trace.
+static string randomId(size_t bytes) {
+  string id;
+  char buffer[17];
+  for (size_t i = 0; i < bytes; i += 8) {
+    snprintf(buffer, sizeof(buffer), "%016" PRIx64, generator()());
+    id += buffer;
+  }
+  return id;
+}
+
+static uint64_t unixNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+static JSON::Object attribute(const string& key, const string& value) {
+  JSON::Object stringValue;
+  stringValue.values["stringValue"] = value;
+  JSON::Object attribute;
+  attribute.values["key"] = key;
+  attribute.values["value"] = stringValue;
+  return attribute;
+}
+
+static JSON::Array arrayOf(const JSON::Value& value) {
+  JSON::Array array;
+  array.values.push_back(value);
+  return array;
+}
+
+struct Span::State {
+  ~State() { end(); }
+
+  void end();
+
+  string name;
+  logging::Metadata metadata;
+  string parentSpanId;
+  uint64_t start;
+
+  std::vector<std::pair<string, string>> attributes;
+  Option<string> error;
+  std::atomic<bool> ended{false};
+  std::mutex mutex;
+};
+
+void Span::State::end() {
+  if (ended.exchange(true)) return;
+  uint64_t finish = unixNanos();
+
+  JSON::Object span;
+  span.values["traceId"] = metadata.traceId;
+  span.values["spanId"] = metadata.spanId;
+  if (!parentSpanId.empty()) span.values["parentSpanId"] = parentSpanId;
+  span.values["name"] = name;
+  span.values["kind"] = SPAN_KIND_INTERNAL;
+  // 64-bit integers are strings in the JSON mapping of protobuf.
+  span.values["startTimeUnixNano"] = stringify(start);
+  span.values["endTimeUnixNano"] = stringify(finish);
+
+  JSON::Array spanAttributes;
+  spanAttributes.values.push_back(attribute("task_id", metadata.taskId));
+  spanAttributes.values.push_back(attribute("method", metadata.method));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::pair<string, string>& value : attributes) {
+      spanAttributes.values.push_back(attribute(value.first, value.second));
+    }
+    if (error.isSome()) {
+      JSON::Object status;
+      status.values["code"] = STATUS_CODE_ERROR;
+      status.values["message"] = error.get();
+      span.values["status"] = status;
+    }
+  }
+  span.values["attributes"] = spanAttributes;
+
+  JSON::Object scope;
+  scope.values["name"] = SERVICE_NAME;
+  JSON::Object scopeSpans;
+  scopeSpans.values["scope"] = scope;
+  scopeSpans.values["spans"] = arrayOf(span);
+
+  JSON::Object resource;
+  resource.values["attributes"] =
+      arrayOf(attribute("service.name", SERVICE_NAME));
+  JSON::Object resourceSpans;
+  resourceSpans.values["resource"] = resource;
+  resourceSpans.values["scopeSpans"] = arrayOf(scopeSpans);
+
+  JSON::Object request;
+  request.values["resourceSpans"] = arrayOf(resourceSpans);
+  SpanExporter::instance().record(stringify(request) + "\n");
+}
+
+Span::Span(const string& name, const logging::Metadata& metadata)
+    : m_metadata(metadata) {
+  if (metadata.traceId.empty()) return;
+
+  m_state = std::make_shared<State>();
+  m_state->name = name;
+  m_state->parentSpanId = metadata.spanId;
+  m_state->start = unixNanos();
+  m_metadata.spanId = randomId(8);
+  m_state->metadata = m_metadata;
+}
+
+Span Span::trace(const string& name, const logging::Metadata& metadata) {
+  // A call made on behalf of a traced call belongs to its trace.
+  if (!metadata.traceId.empty()) return Span(name, metadata);
+
+  if (!SpanExporter::instance().sample()) {
+    Span span;
+    span.m_metadata = metadata;
+    return span;
+  }
+  logging::Metadata traced = metadata;
+  traced.traceId = randomId(16);
+  traced.spanId.clear();
+  return Span(name, traced);
+}
+
+void Span::set(const string& key, const string& value) const {
+  if (!m_state) return;
+  std::lock_guard<std::mutex> lock(m_state->mutex);
+  m_state->attributes.emplace_back(key, value);
+}
+
+void Span::fail(const string& error) const {
+  if (!m_state) return;
+  std::lock_guard<std::mutex> lock(m_state->mutex);
+  m_state->error = error;
+}
+
+void Span::end() const {
+  if (m_state) m_state->end();
+}
+
+class SpanFile {
+ public:
+  SpanFile(const string& path, int fd) : path(path), fd(fd) {}
+  ~SpanFile() { close(fd); }
+
+  const string path;
+  const int fd;
+};
+
+Try<Nothing> SpanExporter::configure(const SpanOptions& options) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_sampleRate = options.sampleRate.getOrElse(1);
+  if (m_file && m_file->path == options.file) return Nothing();
+
+  int fd = ::open(options.file.c_str(),
+                  O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+  if (fd == -1) {
+    return ErrnoError("Unable to open the span file \"" + options.file + "\"");
+  }
+  // Spans being written keep the previous file open.
+  m_file = std::make_shared<SpanFile>(options.file, fd);
+  return Nothing();
+}
+
+bool SpanExporter::sample() const {
+  double sampleRate;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file) return false;
+    sampleRate = m_sampleRate;
+  }
+  if (sampleRate >= 1) return true;
+  if (sampleRate <= 0) return false;
+  return std::uniform_real_distribution<double>(0, 1)(generator()) <
+         sampleRate;
+}
+
+void SpanExporter::record(const string& line) const {
+  std::shared_ptr<SpanFile> file;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    file = m_file;
+  }
+  if (!file) return;
+
+  // A single write keeps the line whole with O_APPEND.
+  ssize_t written;
+  do {
+    written = write(file->fd, line.data(), line.size());
+  } while (written == -1 && errno == EINTR);
+  if (written != static_cast<ssize_t>(line.size())) {
+    LOG(WARNING) << "Unable to record a span in \"" << file->path << "\": "
+                 << (written == -1 ? os::strerror(errno) : "short write");
+  }
+}
+
+SpanExporter& SpanExporter::instance() {
+  // Intentionally leaked so that it outlives every module instance.
+  static SpanExporter* exporter = new SpanExporter();
+  return *exporter;
+}
+
+}  // namespace mesos
+}  // namespace criteo
@@ -0,0 +1,112 @@
+#ifndef __SPAN_HPP__
+#define __SPAN_HPP__
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <stout/nothing.hpp>
+#include <stout/try.hpp>
+
+#include "Logger.hpp"
+#include "Options.hpp"
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * @brief The Span class measures a step of a call of a module, e.g., the
+ * wait for a slot of the scheduler or the spawn of a command.
+ *
+ * A call is traced from the root span started by the module, whose metadata
+ * are passed down to the commands so that their steps are recorded as its
+ * children. A span is a handle shared by its copies and ends when `end` is
+ * called, or else when its last copy is destroyed. The spans of the calls
+ * which are not sampled record nothing.
+ */
+class Span {
+ public:
+  /**
+   * Start a span as a child of the span of the metadata, if it is traced.
+   *
+   * @param name The step measured, e.g., "spawn".
+   */
+  Span(const std::string& name, const logging::Metadata& metadata);
+
+  /**
+   * Start the root span of a call, traced if it is sampled.
+   *
+   * @param name The method called, e.g., "prepare".
+   */
+  static Span trace(const std::string& name,
+                    const logging::Metadata& metadata);
+
+  /**
+   * @return The metadata of the children of the span.
+   */
+  const logging::Metadata& metadata() const { return m_metadata; }
+
+  /**
+   * Add an attribute to the span.
+   */
+  void set(const std::string& key, const std::string& value) const;
+
+  /**
+   * Mark the span as failed.
+   */
+  void fail(const std::string& error) const;
+
+  /**
+   * Record the span, only the first call counts.
+   */
+  void end() const;
+
+ private:
+  struct State;
+
+  Span() = default;
+
+  std::shared_ptr<State> m_state;
+  logging::Metadata m_metadata;
+};
+
+// Forward declaration
+class SpanFile;
+
+/**
+ * @brief The SpanExporter class appends the spans of the sampled calls to a
+ * file in the OTLP JSON format, one export request per span and per line, as
+ * read by the file receiver of the OpenTelemetry collector.
+ */
+class SpanExporter {
+ public:
+  /**
+   * Open the file of the spans, or change the sample rate if it is the same.
+   */
+  Try<Nothing> configure(const SpanOptions& options);
+
+  /**
+   * @return true if a new call has to be traced.
+   */
+  bool sample() const;
+
+  /**
+   * Append a span, errors being logged.
+   */
+  void record(const std::string& line) const;
+
+  /**
+   * Get the exporter shared by all the module instances.
+   */
+  static SpanExporter& instance();
+
+ private:
+  std::shared_ptr<SpanFile> m_file;
+  double m_sampleRate = 1;
+  mutable std::mutex m_mutex;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __SPAN_HPP__
@@ -0,0 +1,44 @@
+#ifndef __SPAWN_PROTOCOL_HPP__
+#define __SPAWN_PROTOCOL_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace criteo {
+namespace mesos {
+namespace spawn {
+
+// Messages exchanged between the module and the spawn server over a
+// SOCK_SEQPACKET socket, so that each message is received at once.
+//
+// A request is the id of the request followed by the NUL-terminated
+// arguments of the command, the first one being the executable. The file
+// descriptor of the standard input of the command is passed along with
+// SCM_RIGHTS. The server answers with a STARTED or FAILED response right
+// away, then with an EXITED response once the command exits.
+
+// File descriptor of the socket in the spawn server.
+const int SERVER_FD = 3;
+
+const size_t MAX_REQUEST_SIZE = 64 * 1024;
+
+enum ResponseType : int32_t {
+  // The value is the pid of the command.
+  STARTED = 0,
+  // The value is the wait status of the command.
+  EXITED = 1,
+  // The value is the errno explaining why the command was not started.
+  FAILED = 2
+};
+
+struct Response {
+  uint64_t id;
+  int32_t type;
+  int32_t value;
+};
+
+}  // namespace spawn
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __SPAWN_PROTOCOL_HPP__
@@ -0,0 +1,283 @@
+#include "SpawnServer.hpp"
+#include "CommandCgroup.hpp"
+#include "SpawnProtocol.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#include <stout/duration.hpp>
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/os/killtree.hpp>
+#include <stout/os/raw/environment.hpp>
+#include <stout/os/strerror.hpp>
+
+namespace criteo {
+namespace mesos {
+
+using process::Future;
+using process::Promise;
+using std::string;
+
+// Time to wait for the helper to fork a command.
+const Duration SPAWN_TIMEOUT = Seconds(5);
+
+SpawnServer::SpawnServer() : m_socket(-1), m_pid(-1), m_nextId(0) {}
+
+SpawnServer::~SpawnServer() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  shutdown(lock);
+}
+
+Try<Nothing> SpawnServer::start(const string& path) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_path == path && m_socket != -1) return Nothing();
+
+  shutdown(lock);
+  m_path = path;
+  return launch(lock);
+}
+
+bool SpawnServer::isEnabled() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_path.isSome();
+}
+
+Option<pid_t> SpawnServer::pid() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_socket == -1) return None();
+  return m_pid;
+}
+
+Try<Nothing> SpawnServer::launch(std::unique_lock<std::mutex>& lock) {
+  // The reader of the previous helper is over since the socket is reset,
+  // unless the helper is restarted from one of its callbacks. It is joined
+  // without the lock since it takes it to fail its requests, whose callbacks
+  // may start other commands.
+  std::thread reader = std::move(m_reader);
+  if (reader.joinable()) {
+    if (reader.get_id() == std::this_thread::get_id()) {
+      reader.detach();
+    } else {
+      lock.unlock();
+      reader.join();
+      lock.lock();
+      // Another command may have restarted the helper in the meantime.
+      if (m_socket != -1) return Nothing();
+    }
+  }
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == -1) {
+    return ErrnoError("Unable to create the socket of the spawn server");
+  }
+  // dup2 would keep the close-on-exec flag if the fd is already the right one.
+  if (fds[1] == spawn::SERVER_FD) {
+    int fd = fcntl(fds[1], F_DUPFD_CLOEXEC, spawn::SERVER_FD + 1);
+    close(fds[1]);
+    fds[1] = fd;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], spawn::SERVER_FD);
+
+  const string& path = m_path.get();
+  char* argv[] = {const_cast<char*>(path.c_str()), nullptr};
+  pid_t pid;
+  int error = posix_spawn(&pid, path.c_str(), &actions, nullptr, argv,
+                          os::raw::environment());
+  posix_spawn_file_actions_destroy(&actions);
+  close(fds[1]);
+  if (error != 0) {
+    close(fds[0]);
+    return Error("Unable to start the spawn server \"" + path +
+                 "\": " + os::strerror(error));
+  }
+
+  LOG(INFO) << "Started the spawn server \"" << path << "\" (" << pid << ")";
+  // The commands it forks start in the cgroup of the commands.
+  CommandCgroup::instance().confine(pid, nullptr);
+  m_socket = fds[0];
+  m_pid = pid;
+  m_reader = std::thread(&SpawnServer::readResponses, this, fds[0], pid);
+  return Nothing();
+}
+
+void SpawnServer::shutdown(std::unique_lock<std::mutex>& lock) {
+  if (m_socket != -1) ::shutdown(m_socket, SHUT_RDWR);
+  std::thread reader = std::move(m_reader);
+  lock.unlock();
+  if (reader.joinable()) reader.join();
+  lock.lock();
+}
+
+Try<Future<SpawnServer::Child>> SpawnServer::spawn(
+    const std::vector<string>& argv, int stdinFd) {
+  uint64_t id;
+  string message(sizeof(id), '\0');
+  for (const string& arg : argv) {
+    message += arg;
+    message += '\0';
+  }
+  if (message.size() > spawn::MAX_REQUEST_SIZE) {
+    return Error("Command line too long for the spawn server");
+  }
+
+  Request request = {std::make_shared<Promise<pid_t>>(),
+                     std::make_shared<Promise<Option<int>>>()};
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_path.isNone()) return Error("The spawn server is not enabled");
+    if (m_socket == -1) {
+      Try<Nothing> launched = launch(lock);
+      if (launched.isError()) return Error(launched.error());
+    }
+
+    id = m_nextId++;
+    memcpy(&message[0], &id, sizeof(id));
+
+    iovec iov = {&message[0], message.size()};
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr header = {};
+    header.msg_iov = &iov;
+    header.msg_iovlen = 1;
+    if (stdinFd != -1) {
+      header.msg_control = control;
+      header.msg_controllen = sizeof(control);
+      cmsghdr* rights = CMSG_FIRSTHDR(&header);
+      rights->cmsg_level = SOL_SOCKET;
+      rights->cmsg_type = SCM_RIGHTS;
+      rights->cmsg_len = CMSG_LEN(sizeof(int));
+      memcpy(CMSG_DATA(rights), &stdinFd, sizeof(int));
+    }
+
+    // The request is registered first since the reader waits for the lock.
+    m_requests[id] = request;
+    ssize_t sent;
+    do {
+      sent = sendmsg(m_socket, &header, MSG_NOSIGNAL);
+    } while (sent == -1 && errno == EINTR);
+    if (sent == -1) {
+      m_requests.erase(id);
+      return ErrnoError("Unable to send the command to the spawn server");
+    }
+  }
+
+  // The caller is not blocked while the helper forks the command.
+  std::shared_ptr<Promise<pid_t>> started = request.started;
+  Future<Option<int>> status = request.status->future();
+  return started->future()
+      .after(SPAWN_TIMEOUT,
+             [this, id, started](const Future<pid_t>&) -> Future<pid_t> {
+               abandon(id, started);
+               return started->future();
+             })
+      .then([status](pid_t pid) { return Child{pid, status}; });
+}
+
+void SpawnServer::abandon(uint64_t id,
+                          const std::shared_ptr<Promise<pid_t>>& started) {
+  // Unless the command started in the meantime.
+  if (!started->fail("The spawn server did not start the command in time")) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_requests.contains(id)) {
+    m_requests.erase(id);
+    m_abandoned.insert(id);
+  }
+}
+
+// Kill a command which started after its caller gave up on it, so that it
+// does not run twice nor outside of its timeout. The helper reaps it.
+static void killAbandoned(pid_t pid) {
+  LOG(WARNING) << "Killing command " << pid
+               << " started too late by the spawn server";
+  Try<std::list<os::ProcessTree>> killed = os::killtree(pid, SIGKILL);
+  if (killed.isError()) {
+    LOG(ERROR) << "Failed to kill command " << pid << ": " << killed.error();
+  }
+}
+
+void SpawnServer::readResponses(int socket, pid_t pid) {
+  spawn::Response response;
+  while (true) {
+    ssize_t size = recv(socket, &response, sizeof(response), 0);
+    if (size == -1 && errno == EINTR) continue;
+    if (size != sizeof(response)) break;
+
+    Request request;
+    bool abandoned = false;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_abandoned.contains(response.id)) {
+        abandoned = response.type == spawn::STARTED;
+        m_abandoned.erase(response.id);
+      } else if (!m_requests.contains(response.id)) {
+        continue;
+      } else {
+        request = m_requests.at(response.id);
+        if (response.type != spawn::STARTED) m_requests.erase(response.id);
+      }
+    }
+
+    // Promises are completed outside of the lock since their callbacks run
+    // synchronously and may start other commands.
+    if (abandoned) {
+      killAbandoned(response.value);
+      continue;
+    }
+    switch (response.type) {
+      case spawn::STARTED:
+        // The caller may have given up waiting just before.
+        if (!request.started->set(response.value)) {
+          killAbandoned(response.value);
+        }
+        break;
+      case spawn::EXITED:
+        request.status->set(Option<int>(response.value));
+        break;
+      default:
+        request.started->fail("Unable to start the command: " +
+                              os::strerror(response.value));
+        break;
+    }
+  }
+
+  hashmap<uint64_t, Request> requests;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_socket = -1;
+    m_pid = -1;
+    std::swap(requests, m_requests);
+    m_abandoned.clear();
+  }
+  LOG(INFO) << "The spawn server (" << pid << ") exited";
+
+  foreachvalue (const Request& request, requests) {
+    request.started->fail("The spawn server exited");
+    request.status->fail("The spawn server exited");
+  }
+
+  close(socket);
+  while (waitpid(pid, nullptr, 0) == -1 && errno == EINTR) {
+  }
+}
+
+SpawnServer& SpawnServer::instance() {
+  // Intentionally leaked so that it outlives every module instance.
+  static SpawnServer* server = new SpawnServer();
+  return *server;
+}
+
+}  // namespace mesos
+}  // namespace criteo
@@ -0,0 +1,117 @@
+#ifndef __SPAWN_SERVER_HPP__
+#define __SPAWN_SERVER_HPP__
+
+#include <sys/types.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <process/future.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * @brief The SpawnServer class starts oneshot commands from a small helper
+ * process, mesos-command-spawner, instead of forking the agent.
+ *
+ * Forking the agent copies the page tables of several GB of memory on each
+ * command. The helper is started once with posix_spawn and forks the
+ * commands from its own tiny address space. Requests are sent over a UNIX
+ * socket along with the standard input of the command (see SpawnProtocol).
+ * No other descriptor of the agent is passed, so commands reading their
+ * input or writing their outputs through /dev/fd cannot use the helper.
+ *
+ * If the helper dies, it is started again on the next command.
+ */
+class SpawnServer {
+ public:
+  struct Child {
+    pid_t pid;
+    // Wait status of the command once it exits, like Subprocess::status.
+    process::Future<Option<int>> status;
+  };
+
+  SpawnServer();
+
+  /**
+   * Stop the helper. Commands started by it keep running.
+   */
+  ~SpawnServer();
+
+  /**
+   * Start the helper, or restart it if the path changed.
+   *
+   * @param path The path to the mesos-command-spawner executable.
+   */
+  Try<Nothing> start(const std::string& path);
+
+  /**
+   * @return true if the commands have to be started by the helper.
+   */
+  bool isEnabled() const;
+
+  /**
+   * Send a command to the helper. Once sent, the command is only started by
+   * the helper: if it is not started in time, the future fails and the
+   * command is killed as soon as the helper reports it started.
+   *
+   * @param argv The arguments of the command, the first being the executable
+   *   looked up in the PATH.
+   * @param stdinFd The file descriptor to use as standard input, -1 to
+   *   inherit the one of the helper.
+   * @return An error if the command could not be sent, so that it can be
+   *   started otherwise, or the command once the helper forked it.
+   */
+  Try<process::Future<Child>> spawn(const std::vector<std::string>& argv,
+                                    int stdinFd);
+
+  /**
+   * @return The pid of the helper, if running.
+   */
+  Option<pid_t> pid() const;
+
+  /**
+   * Get the spawn server shared by all the module instances.
+   */
+  static SpawnServer& instance();
+
+ private:
+  struct Request {
+    std::shared_ptr<process::Promise<pid_t>> started;
+    std::shared_ptr<process::Promise<Option<int>>> status;
+  };
+
+  // Start the helper, the lock is released while waiting for the reader of
+  // the previous one.
+  Try<Nothing> launch(std::unique_lock<std::mutex>& lock);
+  // Give up waiting for a command to start.
+  void abandon(uint64_t id,
+               const std::shared_ptr<process::Promise<pid_t>>& started);
+  // Stop the helper, the lock is released while waiting for the reader.
+  void shutdown(std::unique_lock<std::mutex>& lock);
+  void readResponses(int socket, pid_t pid);
+
+  Option<std::string> m_path;
+  int m_socket;
+  pid_t m_pid;
+  uint64_t m_nextId;
+  hashmap<uint64_t, Request> m_requests;
+  // Commands which did not start in time, killed if they start later on.
+  hashset<uint64_t> m_abandoned;
+  std::thread m_reader;
+  mutable std::mutex m_mutex;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __SPAWN_SERVER_HPP__
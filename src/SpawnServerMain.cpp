@@ -0,0 +1,135 @@
+// The spawn server started by the modules to fork the commands from a small
+// process instead of the agent, see SpawnServer. It has no dependency so
+// that its address space stays tiny.
+
+#include "SpawnProtocol.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <map>
+#include <vector>
+
+using namespace criteo::mesos::spawn;
+
+static bool respond(uint64_t id, ResponseType type, int32_t value) {
+  Response response = {id, type, value};
+  while (send(SERVER_FD, &response, sizeof(response), MSG_NOSIGNAL) == -1) {
+    if (errno != EINTR) return false;
+  }
+  return true;
+}
+
+// Fork and execute a command, returning its pid or -errno.
+static pid_t startCommand(char* args, size_t size, int stdinFd,
+                          const sigset_t& mask) {
+  std::vector<char*> argv;
+  for (size_t i = 0; i < size; i += strlen(args + i) + 1) {
+    argv.push_back(args + i);
+  }
+  argv.push_back(nullptr);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    // The socket and the signalfd are close-on-exec.
+    sigprocmask(SIG_SETMASK, &mask, nullptr);
+    if (stdinFd != -1 && dup2(stdinFd, STDIN_FILENO) == -1) _exit(127);
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+  return pid == -1 ? -errno : pid;
+}
+
+// Handle one request, returning false once the module is gone.
+static bool handleRequest(std::map<pid_t, uint64_t>* children,
+                          const sigset_t& mask) {
+  static char buffer[MAX_REQUEST_SIZE];
+  char control[CMSG_SPACE(sizeof(int))];
+  iovec iov = {buffer, sizeof(buffer)};
+  msghdr message = {};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  ssize_t size = recvmsg(SERVER_FD, &message, MSG_CMSG_CLOEXEC);
+  if (size == -1) return errno == EINTR || errno == EAGAIN;
+  if (size == 0) return false;
+
+  int stdinFd = -1;
+  for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr;
+       header = CMSG_NXTHDR(&message, header)) {
+    if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+      memcpy(&stdinFd, CMSG_DATA(header), sizeof(int));
+    }
+  }
+
+  uint64_t id = 0;
+  if (static_cast<size_t>(size) >= sizeof(id)) memcpy(&id, buffer, sizeof(id));
+
+  bool valid = static_cast<size_t>(size) > sizeof(id) &&
+               (message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) == 0 &&
+               buffer[size - 1] == '\0';
+  pid_t pid = valid ? startCommand(buffer + sizeof(id), size - sizeof(id),
+                                   stdinFd, mask)
+                    : -EINVAL;
+  if (stdinFd != -1) close(stdinFd);
+
+  if (pid < 0) return respond(id, FAILED, -pid);
+  (*children)[pid] = id;
+  return respond(id, STARTED, pid);
+}
+
+// Report the exit of the terminated commands.
+static bool reapChildren(int signalFd, std::map<pid_t, uint64_t>* children) {
+  signalfd_siginfo info;
+  while (read(signalFd, &info, sizeof(info)) > 0) {
+  }
+
+  int status;
+  pid_t pid;
+  while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    auto child = children->find(pid);
+    if (child == children->end()) continue;
+    uint64_t id = child->second;
+    children->erase(child);
+    if (!respond(id, EXITED, status)) return false;
+  }
+  return true;
+}
+
+int main() {
+  // The socket must not leak into the commands.
+  if (fcntl(SERVER_FD, F_SETFD, FD_CLOEXEC) == -1) return 1;
+
+  // SIGCHLD is received through a signalfd polled with the socket.
+  sigset_t mask;
+  sigset_t childMask;
+  sigemptyset(&childMask);
+  sigaddset(&childMask, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &childMask, &mask);
+  int signalFd = signalfd(-1, &childMask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (signalFd == -1) return 1;
+
+  std::map<pid_t, uint64_t> children;
+  pollfd fds[] = {{SERVER_FD, POLLIN, 0}, {signalFd, POLLIN, 0}};
+  while (true) {
+    if (poll(fds, 2, -1) == -1) {
+      if (errno == EINTR) continue;
+      return 1;
+    }
+    if (fds[1].revents & POLLIN) {
+      if (!reapChildren(signalFd, &children)) return 0;
+    }
+    if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+      // The commands still running are left alone when the module is gone.
+      if (!handleRequest(&children, mask)) return 0;
+    }
+  }
+}
@@ -0,0 +1,189 @@
+#include "StatsTable.hpp"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <stout/error.hpp>
+
+namespace criteo {
+namespace mesos {
+
+using std::string;
+
+// Attempts to read a record being written before giving up.
+const int MAX_READ_ATTEMPTS = 64;
+
+#define CRITEO_STATS_TABLE_FIELD_INDEX(TYPE, NAME) FIELD_##NAME,
+enum FieldIndex { CRITEO_STATS_TABLE_FIELDS(CRITEO_STATS_TABLE_FIELD_INDEX) };
+#undef CRITEO_STATS_TABLE_FIELD_INDEX
+
+#define CRITEO_STATS_TABLE_FIELD_COUNT(TYPE, NAME) +1
+const uint32_t FIELD_COUNT =
+    0 CRITEO_STATS_TABLE_FIELDS(CRITEO_STATS_TABLE_FIELD_COUNT);
+#undef CRITEO_STATS_TABLE_FIELD_COUNT
+
+static_assert(FIELD_COUNT <= 64, "The mask of the records is 64 bits");
+
+Try<process::Owned<StatsTable>> StatsTable::create(const string& path,
+                                                   size_t capacity) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    return ErrnoError("Unable to open the stats table \"" + path + "\"");
+  }
+
+  // The file is locked as long as the table is open so that another isolator,
+  // in this agent or another one, does not reset it.
+  if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+    ErrnoError error("Unable to lock the stats table \"" + path +
+                     "\", is it used by another isolator?");
+    close(fd);
+    return error;
+  }
+
+  size_t size = sizeof(stats::Header) + capacity * sizeof(stats::Record);
+  if (ftruncate(fd, size) == -1) {
+    ErrnoError error("Unable to resize the stats table \"" + path + "\"");
+    close(fd);
+    return error;
+  }
+
+  void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    ErrnoError error("Unable to map the stats table \"" + path + "\"");
+    close(fd);
+    return error;
+  }
+
+  // The records of a previous table are reset in place since a collector
+  // may still have the file mapped.
+  stats::Header* header = static_cast<stats::Header*>(data);
+  __atomic_store_n(&header->magic, 0, __ATOMIC_RELEASE);
+  memset(static_cast<char*>(data) + sizeof(stats::Header), 0,
+         size - sizeof(stats::Header));
+  header->version = stats::VERSION;
+  header->capacity = capacity;
+  header->recordSize = sizeof(stats::Record);
+  header->fieldCount = FIELD_COUNT;
+  __atomic_store_n(&header->magic, stats::MAGIC, __ATOMIC_RELEASE);
+
+  return process::Owned<StatsTable>(new StatsTable(fd, data, size, capacity));
+}
+
+StatsTable::StatsTable(int fd, void* data, size_t size, size_t capacity)
+    : m_fd(fd), m_data(data), m_size(size) {
+  // The lowest slots are used first so that collectors scan less.
+  for (size_t slot = capacity; slot > 0; --slot) {
+    m_freeSlots.push_back(slot - 1);
+  }
+}
+
+StatsTable::~StatsTable() {
+  munmap(m_data, m_size);
+  close(m_fd);
+}
+
+stats::Record* StatsTable::recordAt(void* table, size_t index) {
+  return reinterpret_cast<stats::Record*>(static_cast<char*>(table) +
+                                          sizeof(stats::Header)) +
+         index;
+}
+
+Try<Nothing> StatsTable::add(const string& containerId) {
+  if (m_slots.contains(containerId)) return Nothing();
+  if (containerId.size() >= stats::MAX_CONTAINER_ID_SIZE) {
+    return Error("Container id too long for the stats table");
+  }
+  if (m_freeSlots.empty()) return Error("The stats table is full");
+
+  size_t slot = m_freeSlots.back();
+  m_freeSlots.pop_back();
+  m_slots[containerId] = slot;
+
+  stats::Record* record = recordAt(m_data, slot);
+  memset(record->containerId, 0, sizeof(record->containerId));
+  memcpy(record->containerId, containerId.data(), containerId.size());
+  // The collector reads the generation before the id.
+  __atomic_store_n(&record->generation, record->generation + 1,
+                   __ATOMIC_RELEASE);
+  __atomic_store_n(&record->state, stats::REGISTERED, __ATOMIC_RELEASE);
+  return Nothing();
+}
+
+bool StatsTable::contains(const string& containerId) const {
+  return m_slots.contains(containerId);
+}
+
+void StatsTable::remove(const string& containerId) {
+  if (!m_slots.contains(containerId)) return;
+  size_t slot = m_slots.at(containerId);
+  m_slots.erase(containerId);
+  m_freeSlots.push_back(slot);
+
+  __atomic_store_n(&recordAt(m_data, slot)->state, stats::FREE,
+                   __ATOMIC_RELEASE);
+}
+
+Option<::mesos::ResourceStatistics> StatsTable::read(
+    const string& containerId) const {
+  if (!m_slots.contains(containerId)) return None();
+  const stats::Record* record = recordAt(m_data, m_slots.at(containerId));
+
+  for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt) {
+    uint32_t sequence = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+    if (sequence % 2 == 1) continue;
+
+    stats::Record copy;
+    memcpy(&copy, record, sizeof(copy));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&record->sequence, __ATOMIC_RELAXED) != sequence) {
+      continue;
+    }
+
+    // Statistics of a previous container of the slot, or none yet.
+    if (copy.statsGeneration != copy.generation || copy.timestamp == 0) {
+      return None();
+    }
+
+    ::mesos::ResourceStatistics statistics;
+    statistics.set_timestamp(copy.timestamp);
+#define CRITEO_STATS_TABLE_READ_FIELD(TYPE, NAME) \
+  if (copy.mask & (1ULL << FIELD_##NAME)) statistics.set_##NAME(copy.NAME);
+    CRITEO_STATS_TABLE_FIELDS(CRITEO_STATS_TABLE_READ_FIELD)
+#undef CRITEO_STATS_TABLE_READ_FIELD
+    return statistics;
+  }
+  return None();
+}
+
+bool StatsTable::publish(stats::Record* record, uint32_t generation,
+                         const ::mesos::ResourceStatistics& statistics) {
+  // A reuse after this check leaves the statistics with a stale generation,
+  // which the isolator ignores.
+  if (__atomic_load_n(&record->generation, __ATOMIC_ACQUIRE) != generation) {
+    return false;
+  }
+
+  uint32_t sequence = __atomic_load_n(&record->sequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&record->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  record->statsGeneration = generation;
+  record->timestamp = statistics.timestamp();
+  record->mask = 0;
+#define CRITEO_STATS_TABLE_WRITE_FIELD(TYPE, NAME) \
+  if (statistics.has_##NAME()) {                   \
+    record->NAME = statistics.NAME();              \
+    record->mask |= 1ULL << FIELD_##NAME;          \
+  }
+  CRITEO_STATS_TABLE_FIELDS(CRITEO_STATS_TABLE_WRITE_FIELD)
+#undef CRITEO_STATS_TABLE_WRITE_FIELD
+
+  __atomic_store_n(&record->sequence, sequence + 2, __ATOMIC_RELEASE);
+  return true;
+}
+
+}  // namespace mesos
+}  // namespace criteo
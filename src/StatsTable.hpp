@@ -0,0 +1,187 @@
+#ifndef __STATS_TABLE_HPP__
+#define __STATS_TABLE_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <mesos/mesos.hpp>
+
+#include <process/owned.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+namespace criteo {
+namespace mesos {
+
+// Scalar fields of ResourceStatistics published in the stats table, in the
+// order of the records. A field is set in the statistics if its bit, its
+// index in this list, is set in the mask of the record. All of them are
+// stored on 8 bytes, in the native byte order.
+#define CRITEO_STATS_TABLE_FIELDS(FIELD)    \
+  FIELD(uint64_t, processes)                \
+  FIELD(uint64_t, threads)                  \
+  FIELD(double, cpus_user_time_secs)        \
+  FIELD(double, cpus_system_time_secs)      \
+  FIELD(double, cpus_limit)                 \
+  FIELD(uint64_t, cpus_nr_periods)          \
+  FIELD(uint64_t, cpus_nr_throttled)        \
+  FIELD(double, cpus_throttled_time_secs)   \
+  FIELD(uint64_t, mem_total_bytes)          \
+  FIELD(uint64_t, mem_total_memsw_bytes)    \
+  FIELD(uint64_t, mem_limit_bytes)          \
+  FIELD(uint64_t, mem_soft_limit_bytes)     \
+  FIELD(uint64_t, mem_file_bytes)           \
+  FIELD(uint64_t, mem_anon_bytes)           \
+  FIELD(uint64_t, mem_cache_bytes)          \
+  FIELD(uint64_t, mem_rss_bytes)            \
+  FIELD(uint64_t, mem_mapped_file_bytes)    \
+  FIELD(uint64_t, mem_swap_bytes)           \
+  FIELD(uint64_t, mem_unevictable_bytes)    \
+  FIELD(uint64_t, disk_limit_bytes)         \
+  FIELD(uint64_t, disk_used_bytes)          \
+  FIELD(uint64_t, net_rx_packets)           \
+  FIELD(uint64_t, net_rx_bytes)             \
+  FIELD(uint64_t, net_rx_errors)            \
+  FIELD(uint64_t, net_rx_dropped)           \
+  FIELD(uint64_t, net_tx_packets)           \
+  FIELD(uint64_t, net_tx_bytes)             \
+  FIELD(uint64_t, net_tx_errors)            \
+  FIELD(uint64_t, net_tx_dropped)
+
+namespace stats {
+
+// "MCMSTATS" in little endian.
+const uint64_t MAGIC = 0x53544154534d434dULL;
+const uint32_t VERSION = 1;
+const size_t MAX_CONTAINER_ID_SIZE = 128;
+
+/**
+ * Header at the beginning of the file, written by the isolator once the
+ * records are initialized, the magic number last.
+ */
+struct Header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t recordSize;
+  uint32_t fieldCount;
+  uint8_t reserved[40];
+};
+
+enum State : uint32_t { FREE = 0, REGISTERED = 1 };
+
+/**
+ * A slot of the table, followed by the next one.
+ *
+ * The isolator registers a container by writing its id and a new generation
+ * before setting the state to REGISTERED. The collector reads the generation
+ * of a registered slot before its id, then publishes the statistics of the
+ * container with a seqlock: it increments the sequence, making it odd, writes
+ * the statistics along with the generation read, then increments the sequence
+ * again. The isolator only keeps the statistics read while the sequence was
+ * even and unchanged, and of the current generation of the slot, so the
+ * statistics of a container whose slot was reused meanwhile are ignored.
+ */
+struct Record {
+  // Written by the isolator.
+  uint32_t state;
+  uint32_t generation;
+  char containerId[MAX_CONTAINER_ID_SIZE];
+
+  // Written by the collector.
+  uint32_t sequence;
+  uint32_t statsGeneration;
+  uint64_t mask;
+  double timestamp;
+#define CRITEO_STATS_TABLE_RECORD_FIELD(TYPE, NAME) TYPE NAME;
+  CRITEO_STATS_TABLE_FIELDS(CRITEO_STATS_TABLE_RECORD_FIELD)
+#undef CRITEO_STATS_TABLE_RECORD_FIELD
+};
+
+static_assert(sizeof(Header) == 64, "The header layout is part of the ABI");
+static_assert(sizeof(Record) % 8 == 0, "Records must stay aligned");
+
+}  // namespace stats
+
+/**
+ * @brief The StatsTable class is a table of statistics shared with a
+ * collector through a memory-mapped file, so that the usage of a container is
+ * read without running any command nor parsing anything.
+ *
+ * The isolator creates the file, registers the containers from prepare and
+ * unregisters them from cleanup. The collector keeps the statistics of the
+ * registered containers up to date, see stats::Record. This class is not
+ * thread-safe but reading the statistics never waits for the collector.
+ */
+class StatsTable {
+ public:
+  /**
+   * Create the table, resetting the file if it exists. The file is locked
+   * while the table is open, so a path already used by another table fails.
+   *
+   * @param path The path of the file, e.g., in /dev/shm.
+   * @param capacity The maximum number of containers.
+   */
+  static Try<process::Owned<StatsTable>> create(const std::string& path,
+                                                size_t capacity);
+
+  /**
+   * Unmap the table. The file is left for the collector to see it is gone.
+   */
+  ~StatsTable();
+
+  /**
+   * Register a container, failing if the table is full.
+   */
+  Try<Nothing> add(const std::string& containerId);
+
+  void remove(const std::string& containerId);
+
+  /**
+   * @return true if the container is registered.
+   */
+  bool contains(const std::string& containerId) const;
+
+  /**
+   * @return The last statistics published for a container, None if it is
+   *   not registered, has no statistics yet or is being written for too long.
+   */
+  Option<::mesos::ResourceStatistics> read(
+      const std::string& containerId) const;
+
+  /**
+   * Publish the statistics of a record as a collector does.
+   *
+   * @param generation The generation of the record read along with the id of
+   *   the container of the statistics.
+   * @return false if the record was reused since, nothing being written.
+   */
+  static bool publish(stats::Record* record, uint32_t generation,
+                      const ::mesos::ResourceStatistics& statistics);
+
+  /**
+   * @return The record at an index of a table mapped by a collector.
+   */
+  static stats::Record* recordAt(void* table, size_t index);
+
+ private:
+  StatsTable(int fd, void* data, size_t size, size_t capacity);
+  StatsTable(const StatsTable&) = delete;
+  StatsTable& operator=(const StatsTable&) = delete;
+
+  int m_fd;
+  void* m_data;
+  size_t m_size;
+  hashmap<std::string, size_t> m_slots;
+  std::vector<size_t> m_freeSlots;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __STATS_TABLE_HPP__
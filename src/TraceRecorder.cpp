@@ -0,0 +1,59 @@
+#include "TraceRecorder.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+#include <process/clock.hpp>
+#include <stout/error.hpp>
+#include <stout/os/strerror.hpp>
+#include <stout/stringify.hpp>
+
+namespace criteo {
+namespace mesos {
+
+using std::string;
+
+Try<std::shared_ptr<TraceRecorder>> TraceRecorder::open(const string& path) {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                  0600);
+  // The prepare events hold the environment of the containers, so the trace
+  // must not stay readable by others if it was created with a wider mode.
+  if (fd == -1 || fchmod(fd, 0600) == -1) {
+    Error error = ErrnoError("Unable to open the trace \"" + path + "\"");
+    if (fd != -1) close(fd);
+    return error;
+  }
+  return std::shared_ptr<TraceRecorder>(new TraceRecorder(path, fd));
+}
+
+TraceRecorder::TraceRecorder(const string& path, int fd)
+    : m_path(path), m_fd(fd) {}
+
+TraceRecorder::~TraceRecorder() { close(m_fd); }
+
+void TraceRecorder::record(const string& method, const string& input) {
+  string line = "{\"timestamp\":" + stringify(process::Clock::now().secs()) +
+                ",\"method\":" + stringify(JSON::String(method)) +
+                ",\"input\":" + input + "}\n";
+
+  // A single write keeps the line whole with O_APPEND.
+  ssize_t written;
+  do {
+    written = write(m_fd, line.data(), line.size());
+  } while (written == -1 && errno == EINTR);
+  if (written != static_cast<ssize_t>(line.size())) {
+    LOG(WARNING) << "Unable to record the " << method << " event in \""
+                 << m_path << "\": "
+                 << (written == -1 ? os::strerror(errno) : "short write");
+  }
+}
+
+void TraceRecorder::record(const string& method, const JSON::Object& input) {
+  record(method, stringify(input));
+}
+
+}  // namespace mesos
+}  // namespace criteo
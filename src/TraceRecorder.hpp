@@ -0,0 +1,59 @@
+#ifndef __TRACE_RECORDER_HPP__
+#define __TRACE_RECORDER_HPP__
+
+#include <memory>
+#include <string>
+
+#include <stout/json.hpp>
+#include <stout/try.hpp>
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * @brief The TraceRecorder class appends the events received by the modules
+ * to a JSONL file so that they can be replayed outside of the agent with
+ * mesos-command-replay.
+ *
+ * Each line is an object with the time of the event in seconds, the method
+ * called, e.g., "prepare", and the JSON input of its command:
+ *
+ *   {"timestamp":1570000000.5,"method":"usage","input":{"container_id":...}}
+ *
+ * Lines are written at once on a file opened in append mode, so several
+ * recorders, even in several agents, can share the same file.
+ */
+class TraceRecorder {
+ public:
+  /**
+   * Open the trace, creating it if needed.
+   */
+  static Try<std::shared_ptr<TraceRecorder>> open(const std::string& path);
+
+  ~TraceRecorder();
+
+  /**
+   * Append an event to the trace. Errors are logged since they must not
+   * fail the event.
+   *
+   * @param method The method called on the module.
+   * @param input The JSON input of the command of the method.
+   */
+  void record(const std::string& method, const std::string& input);
+  void record(const std::string& method, const JSON::Object& input);
+
+  const std::string& path() const { return m_path; }
+
+ private:
+  TraceRecorder(const std::string& path, int fd);
+  TraceRecorder(const TraceRecorder&) = delete;
+  TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+  std::string m_path;
+  int m_fd;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __TRACE_RECORDER_HPP__
@@ -0,0 +1,182 @@
+#include "WatchScheduler.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <stout/hashmap.hpp>
+
+namespace criteo {
+namespace mesos {
+
+// Number of slots of the timer wheel. With the default tick, one revolution
+// takes 25.6 seconds and longer periods wait for several revolutions.
+const size_t WHEEL_SIZE = 512;
+
+// Bound of the jitter of the first run of a job, as a fraction of its period.
+const double MAX_JITTER = 0.1;
+
+struct WatchScheduler::State {
+  struct Entry {
+    std::string key;
+    uint64_t generation;
+    Duration period;
+    AdaptiveJob job;
+    // Number of revolutions of the wheel left before the entry fires.
+    size_t rounds;
+  };
+
+  explicit State(const Duration& tick)
+      : tick(tick),
+        wheel(WHEEL_SIZE),
+        cursor(0),
+        nextGeneration(0),
+        random(std::random_device()()),
+        stopping(false) {}
+
+  // Must be called with the lock held.
+  void schedule(Entry entry, const Duration& delay) {
+    size_t ticks =
+        std::max<int64_t>(1, (delay.ns() + tick.ns() - 1) / tick.ns());
+    entry.rounds = (ticks - 1) / WHEEL_SIZE;
+    wheel[(cursor + ticks) % WHEEL_SIZE].push_back(entry);
+  }
+
+  // Must be called with the lock held.
+  bool isActive(const Entry& entry) const {
+    return generations.contains(entry.key) &&
+           generations.at(entry.key) == entry.generation;
+  }
+
+  const Duration tick;
+
+  std::vector<std::list<Entry>> wheel;
+  size_t cursor;
+  // Entries which fired and are waiting for a free thread.
+  std::deque<Entry> ready;
+  // Generation of the current job of each key, used to drop the entries of
+  // removed or replaced jobs lazily.
+  hashmap<std::string, uint64_t> generations;
+  uint64_t nextGeneration;
+
+  std::mt19937 random;
+  bool stopping;
+  mutable std::mutex mutex;
+  std::condition_variable timerCondition;
+  std::condition_variable workerCondition;
+};
+
+WatchScheduler::WatchScheduler(size_t threads, const Duration& tick)
+    : m_state(std::make_shared<State>(tick)) {
+  CHECK_GT(threads, 0u);
+  m_timer = std::thread(&WatchScheduler::runTimer, m_state);
+  // The workers may be running a job for as long as the timeout of its
+  // command, so they are not joined and keep the state alive instead.
+  for (size_t i = 0; i < threads; ++i) {
+    std::thread(&WatchScheduler::runWorker, m_state).detach();
+  }
+}
+
+WatchScheduler::~WatchScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->stopping = true;
+    m_state->generations.clear();
+  }
+  m_state->timerCondition.notify_all();
+  m_state->workerCondition.notify_all();
+
+  m_timer.join();
+}
+
+void WatchScheduler::add(const std::string& key, const Duration& period,
+                         const Job& job) {
+  add(key, period, [job](Duration*) { return job(); });
+}
+
+void WatchScheduler::add(const std::string& key, const Duration& period,
+                         const AdaptiveJob& job) {
+  std::lock_guard<std::mutex> lock(m_state->mutex);
+
+  State::Entry entry = {key, m_state->nextGeneration++, period, job, 0};
+  m_state->generations[key] = entry.generation;
+
+  std::uniform_int_distribution<int64_t> jitter(
+      0, std::max<int64_t>(period.ns() * MAX_JITTER, 0));
+  m_state->schedule(entry, Nanoseconds(jitter(m_state->random)));
+}
+
+void WatchScheduler::remove(const std::string& key) {
+  std::lock_guard<std::mutex> lock(m_state->mutex);
+  m_state->generations.erase(key);
+}
+
+size_t WatchScheduler::size() const {
+  std::lock_guard<std::mutex> lock(m_state->mutex);
+  return m_state->generations.size();
+}
+
+void WatchScheduler::runTimer(const std::shared_ptr<State>& state) {
+  std::chrono::steady_clock::time_point next =
+      std::chrono::steady_clock::now();
+  std::chrono::nanoseconds tick(state->tick.ns());
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  while (!state->stopping) {
+    next += tick;
+    state->timerCondition.wait_until(lock, next,
+                                     [&state]() { return state->stopping; });
+    if (state->stopping) break;
+
+    state->cursor = (state->cursor + 1) % WHEEL_SIZE;
+    std::list<State::Entry>& slot = state->wheel[state->cursor];
+    bool fired = false;
+    for (auto it = slot.begin(); it != slot.end();) {
+      if (!state->isActive(*it)) {
+        it = slot.erase(it);
+      } else if (it->rounds > 0) {
+        --it->rounds;
+        ++it;
+      } else {
+        state->ready.push_back(*it);
+        it = slot.erase(it);
+        fired = true;
+      }
+    }
+    if (fired) state->workerCondition.notify_all();
+  }
+}
+
+void WatchScheduler::runWorker(const std::shared_ptr<State>& state) {
+  std::unique_lock<std::mutex> lock(state->mutex);
+  while (true) {
+    state->workerCondition.wait(
+        lock, [&state]() { return state->stopping || !state->ready.empty(); });
+    if (state->stopping) break;
+
+    State::Entry entry = state->ready.front();
+    state->ready.pop_front();
+    if (!state->isActive(entry)) continue;
+
+    Duration delay = entry.period;
+    lock.unlock();
+    bool over = entry.job(&delay);
+    lock.lock();
+
+    if (!state->isActive(entry)) continue;
+    if (over) {
+      state->generations.erase(entry.key);
+    } else {
+      state->schedule(entry, delay);
+    }
+  }
+}
+
+}  // namespace mesos
+}  // namespace criteo
@@ -0,0 +1,89 @@
+#ifndef __WATCH_SCHEDULER_HPP__
+#define __WATCH_SCHEDULER_HPP__
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <stout/duration.hpp>
+
+namespace criteo {
+namespace mesos {
+
+/**
+ * @brief The WatchScheduler class runs recurrent jobs, e.g., the watch
+ * command of each container, on a bounded pool of dedicated threads.
+ *
+ * Jobs are kept in a timer wheel ticking every `tick` so that scheduling and
+ * firing them is cheap whatever the number of jobs. The first run of a job is
+ * delayed by a random jitter within a tenth of its period so that jobs added
+ * at the same time, e.g., after an agent restart, do not all fire at the same
+ * moment.
+ *
+ * Since jobs run on their own threads, they can block (e.g., waiting for a
+ * command to exit) without starving libprocess workers.
+ */
+class WatchScheduler {
+ public:
+  /**
+   * A job returns true once it is over and must not be run again.
+   */
+  typedef std::function<bool()> Job;
+
+  /**
+   * Same as Job, except that the job may change the delay before its next
+   * run, set to its period before each run.
+   */
+  typedef std::function<bool(Duration* delay)> AdaptiveJob;
+
+  /**
+   * @param threads The number of threads running the jobs.
+   * @param tick The resolution of the timer wheel.
+   */
+  explicit WatchScheduler(size_t threads,
+                          const Duration& tick = Milliseconds(50));
+
+  /**
+   * Stop the scheduler. The running jobs are not waited for, their threads
+   * exiting once they return.
+   */
+  ~WatchScheduler();
+
+  /**
+   * Run a job every period until it returns true or it is removed. A job
+   * already registered with the same key is replaced.
+   *
+   * @param key The key identifying the job, e.g., the container id.
+   * @param period The time between the end of a run and the next one.
+   * @param job The job to run.
+   */
+  void add(const std::string& key, const Duration& period, const Job& job);
+  void add(const std::string& key, const Duration& period,
+           const AdaptiveJob& job);
+
+  /**
+   * Stop running a job. The job is not interrupted if it is running.
+   */
+  void remove(const std::string& key);
+
+  /**
+   * @return The number of jobs registered.
+   */
+  size_t size() const;
+
+ private:
+  // State shared with the threads, which may outlive the scheduler.
+  struct State;
+
+  static void runTimer(const std::shared_ptr<State>& state);
+  static void runWorker(const std::shared_ptr<State>& state);
+
+  std::shared_ptr<State> m_state;
+  std::thread m_timer;
+};
+
+}  // namespace mesos
+}  // namespace criteo
+
+#endif  // __WATCH_SCHEDULER_HPP__
@@ -0,0 +1,92 @@
+#include "CircuitBreaker.hpp"
+
+#include <gtest/gtest.h>
+
+#include <process/clock.hpp>
+
+using namespace criteo::mesos;
+using process::Clock;
+
+typedef CircuitBreaker::Admission Admission;
+
+class CircuitBreakerTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    Clock::pause();
+    options.failures = 2;
+    options.backoff = 10;
+    options.maxBackoff = 30;
+  }
+
+  void TearDown() { Clock::resume(); }
+
+  void fail(Admission admission = Admission::ALLOWED) {
+    breaker.record(options, admission, false);
+  }
+
+  BreakerOptions options;
+  CircuitBreaker breaker{"usage.sh"};
+};
+
+TEST_F(CircuitBreakerTest, should_open_after_consecutive_failures) {
+  fail();
+  breaker.record(options, Admission::ALLOWED, true);
+  fail();
+  EXPECT_EQ(Admission::ALLOWED, breaker.admit(options));
+
+  fail();
+  EXPECT_TRUE(breaker.isOpen());
+  EXPECT_EQ(Admission::REJECTED, breaker.admit(options));
+}
+
+TEST_F(CircuitBreakerTest, should_let_a_single_probe_through_after_backoff) {
+  fail();
+  fail();
+
+  Clock::advance(Seconds(9));
+  EXPECT_EQ(Admission::REJECTED, breaker.admit(options));
+  Clock::advance(Seconds(1));
+  EXPECT_EQ(Admission::PROBE, breaker.admit(options));
+  EXPECT_EQ(Admission::REJECTED, breaker.admit(options));
+
+  breaker.record(options, Admission::PROBE, true);
+  EXPECT_FALSE(breaker.isOpen());
+  EXPECT_EQ(Admission::ALLOWED, breaker.admit(options));
+}
+
+TEST_F(CircuitBreakerTest, should_double_the_backoff_after_failed_probes) {
+  fail();
+  fail();
+
+  Clock::advance(Seconds(10));
+  fail(breaker.admit(options));
+  Clock::advance(Seconds(19));
+  EXPECT_EQ(Admission::REJECTED, breaker.admit(options));
+  Clock::advance(Seconds(1));
+  fail(breaker.admit(options));
+
+  // The backoff does not grow beyond the maximum.
+  Clock::advance(Seconds(30));
+  EXPECT_EQ(Admission::PROBE, breaker.admit(options));
+}
+
+TEST_F(CircuitBreakerTest, should_probe_again_if_the_probe_did_not_run) {
+  fail();
+  fail();
+
+  Clock::advance(Seconds(10));
+  breaker.release(breaker.admit(options));
+  EXPECT_EQ(Admission::PROBE, breaker.admit(options));
+}
+
+TEST_F(CircuitBreakerTest, should_ignore_late_results_once_open) {
+  fail();
+  fail();
+  // Calls admitted before the breaker opened.
+  breaker.record(options, Admission::ALLOWED, true);
+  fail();
+
+  EXPECT_EQ(Admission::REJECTED, breaker.admit(options));
+  Clock::advance(Seconds(10));
+  EXPECT_EQ(Admission::PROBE, breaker.admit(options));
+}
@@ -0,0 +1,103 @@
+#include "CommandCgroup.hpp"
+
+#include <gtest/gtest.h>
+
+#include <stout/gtest.hpp>
+#include <stout/os/exists.hpp>
+#include <stout/os/mkdir.hpp>
+#include <stout/os/mkdtemp.hpp>
+#include <stout/os/read.hpp>
+#include <stout/os/rmdir.hpp>
+#include <stout/os/write.hpp>
+#include <stout/path.hpp>
+
+using std::string;
+
+using namespace criteo::mesos;
+
+// The controllers are plain directories so that no privilege is needed.
+class CommandCgroupTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    hierarchy = os::mkdtemp().get();
+    for (const string& controller : {"cpu", "cpuacct", "memory", "cpuset"}) {
+      os::mkdir(path::join(hierarchy, controller));
+    }
+    os::write(path::join(hierarchy, "cpuset", "cpuset.mems"), "0\n");
+    os::write(path::join(hierarchy, "cpuset", "cpuset.cpus"), "0-3\n");
+
+    options.name = "commands";
+    options.hierarchy = hierarchy;
+  }
+
+  void TearDown() { os::rmdir(hierarchy); }
+
+  string read(const string& controller, const string& file) {
+    Try<string> content =
+        os::read(path::join(hierarchy, controller, "commands", file));
+    return content.isSome() ? content.get() : "";
+  }
+
+  string hierarchy;
+  CgroupOptions options;
+  CommandCgroup cgroup;
+};
+
+TEST_F(CommandCgroupTest, should_set_the_limits) {
+  options.cpuShares = 512;
+  options.cpus = 0.5;
+  options.memoryLimit = 1024 * 1024 * 1024;
+  options.cpuset = "1";
+
+  ASSERT_SOME(cgroup.configure(options));
+  EXPECT_TRUE(cgroup.isEnabled());
+  EXPECT_EQ("512", read("cpu", "cpu.shares"));
+  EXPECT_EQ("100000", read("cpu", "cpu.cfs_period_us"));
+  EXPECT_EQ("50000", read("cpu", "cpu.cfs_quota_us"));
+  EXPECT_EQ("1073741824", read("memory", "memory.limit_in_bytes"));
+  EXPECT_EQ("0", read("cpuset", "cpuset.mems"));
+  EXPECT_EQ("1", read("cpuset", "cpuset.cpus"));
+}
+
+TEST_F(CommandCgroupTest, should_reset_the_limits_no_longer_set) {
+  options.cpuShares = 512;
+  options.cpus = 0.5;
+  options.memoryLimit = 1024 * 1024 * 1024;
+  options.cpuset = "1";
+  ASSERT_SOME(cgroup.configure(options));
+
+  CgroupOptions unlimited;
+  unlimited.name = "commands";
+  unlimited.hierarchy = hierarchy;
+  ASSERT_SOME(cgroup.configure(unlimited));
+  EXPECT_EQ("1024", read("cpu", "cpu.shares"));
+  EXPECT_EQ("-1", read("cpu", "cpu.cfs_quota_us"));
+  EXPECT_EQ("-1", read("memory", "memory.limit_in_bytes"));
+  EXPECT_EQ("0-3", read("cpuset", "cpuset.cpus"));
+}
+
+TEST_F(CommandCgroupTest, should_assign_processes_and_report_their_cpu_time) {
+  ASSERT_SOME(cgroup.configure(options));
+  ASSERT_SOME(cgroup.assign(42, string("isolator/usage")));
+
+  EXPECT_EQ("42", read("cpu", "cgroup.procs"));
+  EXPECT_EQ("42", read("cpuacct", "isolator/usage/cgroup.procs"));
+  // The memory and cpuset controllers are not used until limited.
+  EXPECT_FALSE(os::exists(path::join(hierarchy, "memory", "commands")));
+  EXPECT_FALSE(os::exists(path::join(hierarchy, "cpuset", "commands")));
+
+  os::write(path::join(hierarchy, "cpuacct", "commands", "isolator", "usage",
+                       "cpuacct.usage"),
+            "1500000000\n");
+  EXPECT_SOME_EQ(Milliseconds(1500), cgroup.cpuTime("isolator/usage"));
+  EXPECT_ERROR(cgroup.cpuTime("isolator/watch"));
+}
+
+TEST_F(CommandCgroupTest, should_fail_if_the_cgroup_cannot_be_created) {
+  options.hierarchy = path::join(hierarchy, "file");
+  os::write(options.hierarchy, "");
+
+  EXPECT_ERROR(cgroup.configure(options));
+  EXPECT_FALSE(cgroup.isEnabled());
+  EXPECT_ERROR(cgroup.assign(42, None()));
+}
@@ -2,6 +2,11 @@
 
 #include <gtest/gtest.h>
 
+#include <process/clock.hpp>
+
+#include <stout/os/rm.hpp>
+#include <stout/os/sleep.hpp>
+
 extern std::string g_resourcesPath;
 
 using namespace criteo::mesos;
@@ -75,6 +80,21 @@ TEST_F(CommandHookTest, should_run_slaveRemoveExecutorHook_command) {
   hook->slaveRemoveExecutorHook(frameworkInfo, executorInfo);
 }
 
+TEST_F(CommandHookTest, should_run_the_reloaded_commands) {
+  hook->reload(
+      Command(g_resourcesPath + "slaveRunTaskLabelDecorator_malformed.sh"),
+      Command(g_resourcesPath + "slaveExecutorEnvironmentDecorator.sh"),
+      None(), false, HookOptions());
+
+  auto result = hook->slaveRunTaskLabelDecorator(taskInfo, executorInfo,
+                                                 frameworkInfo, slaveInfo);
+  ASSERT_TRUE(result.isError());
+
+  // Removing a command requires a restart.
+  ASSERT_EQ(Command(g_resourcesPath + "slaveRemoveExecutorHook.sh"),
+            hook->removeExecutorCommand().get());
+}
+
 class UnexistingCommandHookTest : public CommandHookTest {
  public:
   void SetUp() {
@@ -177,3 +197,134 @@ TEST_F(
   auto result = hook->slaveExecutorEnvironmentDecorator(executorInfo);
   ASSERT_TRUE(result.isError());
 }
+
+class CachedCommandHookTest : public CommandHookTest {
+ public:
+  void SetUp() {
+    CommandHookTest::SetUp();
+    os::rm("/tmp/hook_counter");
+    CacheOptions cache;
+    cache.size = 10;
+    cache.keyFields = {"task_info.name"};
+    HookOptions options;
+    options.runTaskLabelCache = cache;
+    hook.reset(new CommandHook(
+        Command(g_resourcesPath + "slaveRunTaskLabelDecorator_counter.sh"),
+        None(), None(), false, options));
+  }
+
+  std::string count() {
+    auto result = hook->slaveRunTaskLabelDecorator(taskInfo, executorInfo,
+                                                   frameworkInfo, slaveInfo);
+    EXPECT_TRUE(result.isSome());
+    return result.isSome() ? result.get().labels(0).value() : "";
+  }
+
+  std::unique_ptr<CommandHook> hook;
+};
+
+TEST_F(CachedCommandHookTest, should_reuse_output_for_the_same_key) {
+  EXPECT_EQ("1", count());
+  taskInfo.mutable_task_id()->set_value("other");
+  EXPECT_EQ("1", count());
+}
+
+TEST_F(CachedCommandHookTest, should_run_command_for_another_key) {
+  EXPECT_EQ("1", count());
+  taskInfo.set_name("other_task");
+  EXPECT_EQ("2", count());
+  taskInfo.set_name("test_task");
+  EXPECT_EQ("1", count());
+}
+
+TEST_F(CachedCommandHookTest, should_key_on_the_executor_by_default) {
+  CacheOptions cache;
+  cache.size = 10;
+  HookOptions options;
+  options.runTaskLabelCache = cache;
+  hook.reset(new CommandHook(
+      Command(g_resourcesPath + "slaveRunTaskLabelDecorator_counter.sh"),
+      None(), None(), false, options));
+
+  EXPECT_EQ("1", count());
+  taskInfo.mutable_task_id()->set_value("other");
+  EXPECT_EQ("1", count());
+  executorInfo.mutable_executor_id()->set_value("other_executor");
+  EXPECT_EQ("2", count());
+}
+
+class DeadlineCommandHookTest : public CommandHookTest {
+ public:
+  void SetUp() {
+    CommandHookTest::SetUp();
+    os::rm("/tmp/hook_counter");
+    executorInfo.mutable_executor_id()->set_value("executor");
+    executorInfo.mutable_framework_id()->set_value("framework");
+    HookOptions options;
+    options.runTaskLabelDeadline = Milliseconds(100);
+    options.executorEnvironmentDeadline = Seconds(5);
+    hook.reset(new CommandHook(
+        Command(g_resourcesPath + "slaveRunTaskLabelDecorator_slow.sh"),
+        Command(g_resourcesPath +
+                "slaveExecutorEnvironmentDecorator_counter.sh"),
+        None(), false, options));
+  }
+  std::unique_ptr<CommandHook> hook;
+};
+
+TEST_F(DeadlineCommandHookTest,
+       should_leave_labels_unchanged_after_the_deadline) {
+  process::Time start = process::Clock::now();
+  auto result = hook->slaveRunTaskLabelDecorator(taskInfo, executorInfo,
+                                                 frameworkInfo, slaveInfo);
+  EXPECT_TRUE(result.isNone());
+  EXPECT_LT(process::Clock::now() - start, Seconds(1));
+}
+
+TEST_F(DeadlineCommandHookTest,
+       should_use_the_environment_started_when_the_task_was_seen) {
+  hook->slaveRunTaskLabelDecorator(taskInfo, executorInfo, frameworkInfo,
+                                   slaveInfo);
+  auto result = hook->slaveExecutorEnvironmentDecorator(executorInfo);
+  ASSERT_TRUE(result.isSome());
+  EXPECT_EQ("1", result.get().variables(0).value());
+
+  // A new command is run once the speculative output is used.
+  result = hook->slaveExecutorEnvironmentDecorator(executorInfo);
+  ASSERT_TRUE(result.isSome());
+  EXPECT_EQ("2", result.get().variables(0).value());
+}
+
+TEST_F(DeadlineCommandHookTest,
+       should_forget_the_environment_of_an_executor_never_launched) {
+  HookOptions options;
+  options.executorEnvironmentDeadline = Milliseconds(100);
+  hook.reset(new CommandHook(
+      None(),
+      Command(g_resourcesPath +
+                  "slaveExecutorEnvironmentDecorator_counter.sh",
+              1),
+      None(), false, options));
+
+  hook->slaveRunTaskLabelDecorator(taskInfo, executorInfo, frameworkInfo,
+                                   slaveInfo);
+  // Past the timeout of the command and the deadline of the decorator.
+  os::sleep(Milliseconds(1500));
+  hook->slaveRunTaskLabelDecorator(taskInfo, executorInfo, frameworkInfo,
+                                   slaveInfo);
+  auto result = hook->slaveExecutorEnvironmentDecorator(executorInfo);
+  ASSERT_TRUE(result.isSome());
+  EXPECT_EQ("2", result.get().variables(0).value());
+}
+
+TEST_F(DeadlineCommandHookTest,
+       should_not_use_the_environment_started_for_another_input) {
+  hook->slaveRunTaskLabelDecorator(taskInfo, executorInfo, frameworkInfo,
+                                   slaveInfo);
+  // Let the speculative command count its call.
+  os::sleep(Milliseconds(500));
+  executorInfo.set_name("modified_exec");
+  auto result = hook->slaveExecutorEnvironmentDecorator(executorInfo);
+  ASSERT_TRUE(result.isSome());
+  EXPECT_EQ("2", result.get().variables(0).value());
+}
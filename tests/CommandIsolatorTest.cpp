@@ -118,6 +118,22 @@ TEST_F(CommandIsolatorContinuousTest,
 
 }
 
+TEST_F(CommandIsolatorContinuousTest,
+       should_share_the_input_of_a_container_across_isolators) {
+  CommandIsolator other(Command(g_resourcesPath + "prepare.sh"), None(),
+                        Command(g_resourcesPath + "cleanup.sh"),
+                        Command(g_resourcesPath + "usage_continuous.sh"));
+  AWAIT_READY(other.prepare(containerId, containerConfig));
+
+  // The input is still held by the other isolator once this one forgets it.
+  AWAIT_READY(isolator->cleanup(containerId));
+  auto resourceStatistics = other.usage(containerId);
+  AWAIT_READY(resourceStatistics);
+  EXPECT_EQ(1, resourceStatistics->timestamp());
+
+  AWAIT_READY(other.cleanup(containerId));
+}
+
 class UnexistingCommandIsolatorTest : public CommandIsolatorTest {
  public:
   void SetUp() {
@@ -304,3 +320,515 @@ TEST_F(LongCommandIsolatorTest,
   future.discard();
   AWAIT_ASSERT_READY_FOR(future, Seconds(3));
 }
+
+class BatchUsageCommandIsolatorTest : public CommandIsolatorTest {
+ public:
+  void SetUp() {
+    CommandIsolatorTest::SetUp();
+    IsolatorOptions options;
+    options.usageBatchWindow = Milliseconds(100);
+    isolator.reset(new CommandIsolator(
+        None(), None(), None(), Command(g_resourcesPath + "usage_batch.sh"),
+        false, options));
+    CommandIsolatorTest::Prepare();
+
+    otherContainerId.set_value("other_container_id");
+    AWAIT_READY(isolator->prepare(otherContainerId, containerConfig));
+  }
+
+  ContainerID otherContainerId;
+};
+
+TEST_F(BatchUsageCommandIsolatorTest,
+       should_run_usage_command_once_for_all_containers) {
+  auto stats = isolator->usage(containerId);
+  auto otherStats = isolator->usage(otherContainerId);
+
+  AWAIT_READY(stats);
+  AWAIT_READY(otherStats);
+
+  EXPECT_EQ(2, stats.get().net_snmp_statistics().tcp_stats().currestab());
+  EXPECT_EQ(2, otherStats.get().net_snmp_statistics().tcp_stats().currestab());
+}
+
+TEST_F(BatchUsageCommandIsolatorTest,
+       should_only_batch_containers_known_by_the_isolator) {
+  ContainerID unknownContainerId;
+  unknownContainerId.set_value("unknown_container_id");
+  AWAIT_FAILED(isolator->usage(unknownContainerId));
+
+  auto stats = isolator->usage(containerId);
+  AWAIT_READY(stats);
+  EXPECT_EQ(1, stats.get().net_snmp_statistics().tcp_stats().currestab());
+}
+
+class DeltaUsageCommandIsolatorTest : public CommandIsolatorTest {
+ public:
+  void SetUp() {
+    CommandIsolatorTest::SetUp();
+    IsolatorOptions options;
+    options.usageDelta = true;
+    options.usageBatchWindow = Milliseconds(100);
+    isolator.reset(new CommandIsolator(
+        None(), None(), None(), Command(g_resourcesPath + "usage_delta.sh"),
+        false, options));
+    CommandIsolatorTest::Prepare();
+
+    otherContainerId.set_value("other_container_id");
+    AWAIT_READY(isolator->prepare(otherContainerId, containerConfig));
+  }
+
+  ContainerID otherContainerId;
+};
+
+TEST_F(DeltaUsageCommandIsolatorTest,
+       should_merge_the_changed_statistics_into_the_last_ones) {
+  auto stats = isolator->usage(containerId);
+  auto otherStats = isolator->usage(otherContainerId);
+  AWAIT_READY(stats);
+  AWAIT_READY(otherStats);
+  EXPECT_EQ(1u, stats->processes());
+  EXPECT_EQ(1u, otherStats->processes());
+
+  stats = isolator->usage(containerId);
+  otherStats = isolator->usage(otherContainerId);
+  AWAIT_READY(stats);
+  AWAIT_READY(otherStats);
+  EXPECT_EQ(1u, stats->processes());
+  EXPECT_EQ(1.0, stats->timestamp());
+  EXPECT_EQ(2u, otherStats->processes());
+  EXPECT_EQ(2.0, otherStats->timestamp());
+  EXPECT_EQ(7u, otherStats->threads());
+}
+
+TEST_F(DeltaUsageCommandIsolatorTest,
+       should_forget_the_statistics_of_a_container_cleaned_up) {
+  AWAIT_READY(isolator->usage(containerId));
+  AWAIT_READY(isolator->cleanup(containerId));
+  AWAIT_READY(isolator->prepare(containerId, containerConfig));
+
+  // Only other_container_id is reported after the first call.
+  auto stats = isolator->usage(containerId);
+  AWAIT_READY(stats);
+  EXPECT_FALSE(stats->has_processes());
+}
+
+class CachedUsageCommandIsolatorTest : public CommandIsolatorTest {
+ public:
+  void SetUp() {
+    CommandIsolatorTest::SetUp();
+    os::rm("/tmp/usage_counter");
+    isolator.reset(new CommandIsolator(
+        None(), None(), None(), Command(g_resourcesPath + "usage_counter.sh"),
+        false, options()));
+    CommandIsolatorTest::Prepare();
+  }
+
+  static IsolatorOptions options() {
+    IsolatorOptions options;
+    options.usageCacheTtl = Milliseconds(500);
+    return options;
+  }
+
+  static int64_t currestab(
+      const process::Future<::mesos::ResourceStatistics>& stats) {
+    return stats.get().net_snmp_statistics().tcp_stats().currestab();
+  }
+};
+
+TEST_F(CachedUsageCommandIsolatorTest,
+       should_share_in_flight_usage_between_concurrent_calls) {
+  auto stats = isolator->usage(containerId);
+  auto otherStats = isolator->usage(containerId);
+
+  AWAIT_READY(stats);
+  AWAIT_READY(otherStats);
+
+  EXPECT_EQ(1, currestab(stats));
+  EXPECT_EQ(1, currestab(otherStats));
+}
+
+TEST_F(CachedUsageCommandIsolatorTest,
+       should_reuse_usage_until_the_ttl_expires) {
+  auto stats = isolator->usage(containerId);
+  AWAIT_READY(stats);
+  EXPECT_EQ(1, currestab(stats));
+
+  stats = isolator->usage(containerId);
+  AWAIT_READY(stats);
+  EXPECT_EQ(1, currestab(stats));
+
+  os::sleep(Milliseconds(600));
+  stats = isolator->usage(containerId);
+  AWAIT_READY(stats);
+  EXPECT_EQ(2, currestab(stats));
+}
+
+TEST_F(CachedUsageCommandIsolatorTest, should_not_reuse_the_usage_of_a_failure) {
+  isolator.reset(new CommandIsolator(
+      None(), None(), None(),
+      Command(g_resourcesPath + "usage_counter_fail_once.sh"), false,
+      options()));
+  CommandIsolatorTest::Prepare();
+
+  // The failure is reported as empty statistics, and not reused.
+  auto stats = isolator->usage(containerId);
+  AWAIT_READY(stats);
+  EXPECT_FALSE(stats.get().has_net_snmp_statistics());
+
+  stats = isolator->usage(containerId);
+  AWAIT_READY(stats);
+  EXPECT_EQ(2, currestab(stats));
+}
+
+class SlowPrepareCommandIsolatorTest : public CommandIsolatorTest {
+ public:
+  void SetUp() {
+    CommandIsolatorTest::SetUp();
+    isolator.reset(new CommandIsolator(
+        Command(g_resourcesPath + "prepare_slow.sh"), None(),
+        Command(g_resourcesPath + "cleanup.sh"),
+        Command(g_resourcesPath + "usage.sh")));
+  }
+};
+
+TEST_F(SlowPrepareCommandIsolatorTest,
+       should_not_block_other_calls_while_prepare_command_runs) {
+  containerLaunchInfoFuture = isolator->prepare(containerId, containerConfig);
+
+  ContainerID otherContainerId;
+  otherContainerId.set_value("other_container_id");
+  auto otherContainerLaunchInfo =
+      isolator->prepare(otherContainerId, containerConfig);
+
+  auto stats = isolator->usage(containerId);
+  AWAIT_ASSERT_READY_FOR(stats, Milliseconds(800));
+  EXPECT_EQ(5, stats.get().net_snmp_statistics().tcp_stats().currestab());
+  EXPECT_TRUE(containerLaunchInfoFuture.isPending());
+
+  // Both prepare commands run concurrently.
+  AWAIT_ASSERT_READY_FOR(containerLaunchInfoFuture, Milliseconds(1800));
+  AWAIT_ASSERT_READY_FOR(otherContainerLaunchInfo, Milliseconds(200));
+  EXPECT_EQ("/isolated_fs", containerLaunchInfoFuture.get()->rootfs());
+
+  AWAIT_READY(isolator->cleanup(containerId));
+  AWAIT_READY(isolator->cleanup(otherContainerId));
+}
+
+class HangingWatchCommandIsolatorTest : public CommandIsolatorTest {
+ public:
+  void SetUp() {
+    CommandIsolatorTest::SetUp();
+    os::rm("/tmp/watch_hang_once");
+    isolator.reset(new CommandIsolator(
+        None(), RecurrentCommand(g_resourcesPath + "watch_hang_once.sh", 1, 0.1),
+        None(), None()));
+    CommandIsolatorTest::Prepare();
+  }
+};
+
+TEST_F(HangingWatchCommandIsolatorTest,
+       should_kill_hanging_watch_command_and_run_it_again) {
+  auto containerLimitation = isolator->watch(containerId);
+  AWAIT_EXPECT_PENDING_FOR(containerLimitation, Milliseconds(500));
+
+  // The first call is killed after 1 second, the next one reports.
+  AWAIT_READY_FOR(containerLimitation, Seconds(4));
+  EXPECT_EQ("too much toto", containerLimitation.get().message());
+}
+
+TEST_F(HangingWatchCommandIsolatorTest,
+       should_discard_watch_on_cleanup) {
+  auto containerLimitation = isolator->watch(containerId);
+  AWAIT_READY(isolator->cleanup(containerId));
+  AWAIT_DISCARDED(containerLimitation);
+}
+
+class BatchWatchCommandIsolatorTest : public CommandIsolatorTest {
+ public:
+  void SetUp() {
+    CommandIsolatorTest::SetUp();
+    IsolatorOptions options;
+    options.watchBatch = true;
+    isolator.reset(new CommandIsolator(
+        None(), RecurrentCommand(g_resourcesPath + "watch_batch.sh", 3, 0.1),
+        None(), None(), false, options));
+    CommandIsolatorTest::Prepare();
+
+    limitedContainerId.set_value("limited_container_id");
+    AWAIT_READY(isolator->prepare(limitedContainerId, containerConfig));
+  }
+
+  ContainerID limitedContainerId;
+};
+
+TEST_F(BatchWatchCommandIsolatorTest,
+       should_only_complete_watch_of_limited_containers) {
+  auto containerLimitation = isolator->watch(containerId);
+  auto limitedContainerLimitation = isolator->watch(limitedContainerId);
+
+  AWAIT_READY(limitedContainerLimitation);
+  EXPECT_EQ("batch of 2", limitedContainerLimitation.get().message());
+
+  AWAIT_EXPECT_PENDING_FOR(containerLimitation, Milliseconds(500));
+  AWAIT_READY(isolator->cleanup(containerId));
+  AWAIT_DISCARDED(containerLimitation);
+}
+
+class PacedWatchCommandIsolatorTest : public CommandIsolatorTest {
+ public:
+  void SetUp() {
+    CommandIsolatorTest::SetUp();
+    os::rm("/tmp/watch_next_check_in");
+  }
+
+  void TearDown() { os::rm("/tmp/watch_next_check_in"); }
+
+  void Create(const IsolatorOptions& options) {
+    isolator.reset(new CommandIsolator(
+        None(),
+        RecurrentCommand(g_resourcesPath + "watch_next_check_in.sh", 3, 0.1),
+        None(), None(), false, options));
+    CommandIsolatorTest::Prepare();
+  }
+
+  // Number of times the watch command ran.
+  size_t runs() {
+    Try<std::string> content = os::read("/tmp/watch_next_check_in");
+    return content.isSome() ? content->size() : 0;
+  }
+};
+
+TEST_F(PacedWatchCommandIsolatorTest,
+       should_check_container_again_when_suggested) {
+  IsolatorOptions options;
+  options.watchMaxPeriod = Seconds(10);
+  Create(options);
+
+  auto containerLimitation = isolator->watch(containerId);
+  AWAIT_EXPECT_PENDING_FOR(containerLimitation, Milliseconds(800));
+  EXPECT_EQ(1u, runs());
+
+  AWAIT_READY(isolator->cleanup(containerId));
+  AWAIT_DISCARDED(containerLimitation);
+}
+
+TEST_F(PacedWatchCommandIsolatorTest,
+       should_bound_the_suggested_delay) {
+  IsolatorOptions options;
+  options.watchMaxPeriod = Milliseconds(200);
+  Create(options);
+
+  auto containerLimitation = isolator->watch(containerId);
+  AWAIT_EXPECT_PENDING_FOR(containerLimitation, Milliseconds(800));
+  EXPECT_GE(runs(), 3u);
+
+  AWAIT_READY(isolator->cleanup(containerId));
+  AWAIT_DISCARDED(containerLimitation);
+}
+
+class ReloadCommandIsolatorTest : public CommandIsolatorTest {
+ public:
+  void SetUp() {
+    CommandIsolatorTest::SetUp();
+    isolator.reset(new CommandIsolator(
+        Command(g_resourcesPath + "prepare.sh"),
+        RecurrentCommand(g_resourcesPath + "watch_empty.sh", 3, 0.1), None(),
+        None()));
+    CommandIsolatorTest::Prepare();
+  }
+};
+
+TEST_F(ReloadCommandIsolatorTest, should_run_the_reloaded_commands) {
+  auto containerLimitation = isolator->watch(containerId);
+  AWAIT_EXPECT_PENDING_FOR(containerLimitation, Milliseconds(300));
+
+  AWAIT_READY(isolator->reload(
+      Command(g_resourcesPath + "prepare_malformed.sh"),
+      RecurrentCommand(g_resourcesPath + "watch.sh", 3, 0.1), None(), None(),
+      false, IsolatorOptions()));
+
+  // The pending watch picks up the new command.
+  AWAIT_READY(containerLimitation);
+  EXPECT_EQ("too much toto", containerLimitation->message());
+
+  ContainerID otherContainerId;
+  otherContainerId.set_value("other_container_id");
+  AWAIT_FAILED(isolator->prepare(otherContainerId, containerConfig));
+}
+
+TEST_F(ReloadCommandIsolatorTest, should_not_add_or_remove_commands) {
+  AWAIT_READY(isolator->reload(None(),
+                               RecurrentCommand(g_resourcesPath + "watch.sh",
+                                                3, 0.1),
+                               Command(g_resourcesPath + "cleanup.sh"), None(),
+                               false, IsolatorOptions()));
+
+  EXPECT_EQ(Command(g_resourcesPath + "prepare.sh"),
+            isolator->prepareCommand().get());
+  EXPECT_TRUE(isolator->cleanupCommand().isNone());
+}
+
+class ProtobufCommandIsolatorTest : public CommandIsolatorTest {
+ public:
+  void SetUp() {
+    CommandIsolatorTest::SetUp();
+    RecurrentCommand watchCommand(g_resourcesPath + "watch_protobuf.sh", 3,
+                                  0.1);
+    watchCommand.setFormat(CommandFormat::PROTOBUF);
+    isolator.reset(new CommandIsolator(Command(g_resourcesPath + "prepare.sh"),
+                                       watchCommand, None(), None()));
+    CommandIsolatorTest::Prepare();
+  }
+};
+
+TEST_F(ProtobufCommandIsolatorTest,
+       should_exchange_protobuf_with_watch_command) {
+  // The prepare command still receives and returns JSON.
+  EXPECT_EQ("/isolated_fs", containerLaunchInfoFuture.get()->rootfs());
+
+  auto containerLimitation = isolator->watch(containerId);
+  AWAIT_READY(containerLimitation);
+  EXPECT_EQ("protobuf input", containerLimitation.get().message());
+}
+
+class BatchCleanupCommandIsolatorTest : public CommandIsolatorTest {
+ public:
+  void SetUp() {
+    CommandIsolatorTest::SetUp();
+    os::rm("/tmp/cleanup_batches");
+    os::rm("/tmp/cleanup_batch_fail_once");
+    otherContainerId.set_value("other_container_id");
+  }
+
+  void TearDown() {
+    os::rm("/tmp/cleanup_batches");
+    os::rm("/tmp/cleanup_batch_fail_once");
+  }
+
+  void Create(const std::string& script, const IsolatorOptions& options) {
+    isolator.reset(new CommandIsolator(None(), None(),
+                                       Command(g_resourcesPath + script),
+                                       None(), false, options));
+    CommandIsolatorTest::Prepare();
+    AWAIT_READY(isolator->prepare(otherContainerId, containerConfig));
+  }
+
+  // Sizes of the batches cleaned up, waiting for the expected ones.
+  std::string batches(const std::string& expected) {
+    Try<std::string> content = Error("Not written");
+    for (int i = 0; i < 50; ++i) {
+      content = os::read("/tmp/cleanup_batches");
+      if (content.isSome() && content.get() == expected) break;
+      os::sleep(Milliseconds(100));
+    }
+    return content.isSome() ? content.get() : content.error();
+  }
+
+  ContainerID otherContainerId;
+};
+
+TEST_F(BatchCleanupCommandIsolatorTest,
+       should_clean_up_the_containers_at_once_in_the_background) {
+  IsolatorOptions options;
+  options.cleanupBatchSize = 2;
+  options.cleanupBatchWindow = Seconds(10);
+  Create("cleanup_batch.sh", options);
+
+  AWAIT_READY(isolator->cleanup(containerId));
+  AWAIT_READY(isolator->cleanup(otherContainerId));
+  EXPECT_EQ("2\n", batches("2\n"));
+}
+
+TEST_F(BatchCleanupCommandIsolatorTest,
+       should_clean_up_a_partial_batch_after_the_window) {
+  IsolatorOptions options;
+  options.cleanupBatchSize = 10;
+  options.cleanupBatchWindow = Milliseconds(200);
+  Create("cleanup_batch.sh", options);
+
+  AWAIT_READY(isolator->cleanup(containerId));
+  EXPECT_EQ("1\n", batches("1\n"));
+
+  // The container can be prepared again right away.
+  AWAIT_READY(isolator->prepare(containerId, containerConfig));
+}
+
+TEST_F(BatchCleanupCommandIsolatorTest,
+       should_not_clean_up_a_container_prepared_again) {
+  IsolatorOptions options;
+  options.cleanupBatchSize = 10;
+  options.cleanupBatchWindow = Milliseconds(200);
+  Create("cleanup_batch.sh", options);
+
+  AWAIT_READY(isolator->cleanup(containerId));
+  AWAIT_READY(isolator->prepare(containerId, containerConfig));
+  AWAIT_READY(isolator->cleanup(otherContainerId));
+  EXPECT_EQ("1\n", batches("1\n"));
+}
+
+TEST_F(BatchCleanupCommandIsolatorTest, should_retry_a_failed_batch) {
+  IsolatorOptions options;
+  options.cleanupBatchSize = 2;
+  Create("cleanup_batch_fail_once.sh", options);
+
+  AWAIT_READY(isolator->cleanup(containerId));
+  AWAIT_READY(isolator->cleanup(otherContainerId));
+  EXPECT_EQ("2\n", batches("2\n"));
+}
+
+class CheckpointCommandIsolatorTest : public CommandIsolatorTest {
+ public:
+  void SetUp() {
+    CommandIsolatorTest::SetUp();
+    os::rm(path);
+    Create();
+    CommandIsolatorTest::Prepare();
+  }
+
+  void TearDown() {
+    isolator.reset();
+    os::rm(path);
+  }
+
+  // Start the isolator again as after a restart of the agent, the previous
+  // one being stopped first so that its checkpoint is written out.
+  void Create() {
+    isolator.reset();
+    IsolatorOptions options;
+    options.checkpointFile = path;
+    isolator.reset(new CommandIsolator(None(), None(), None(),
+                                       Command(g_resourcesPath + "usage.sh"),
+                                       false, options));
+  }
+
+  std::vector<::mesos::slave::ContainerState> states() {
+    ::mesos::slave::ContainerState state;
+    state.mutable_container_id()->CopyFrom(containerId);
+    state.set_pid(1);
+    state.set_directory("/tmp");
+    return {state};
+  }
+
+  const std::string path = "/tmp/mesos_command_modules_isolator_checkpoint";
+};
+
+TEST_F(CheckpointCommandIsolatorTest,
+       should_recover_the_containers_prepared_before_a_restart) {
+  Create();
+  AWAIT_FAILED(isolator->usage(containerId));
+
+  AWAIT_READY(isolator->recover(states(), hashset<ContainerID>()));
+  auto resourceStatistics = isolator->usage(containerId);
+  AWAIT_READY(resourceStatistics);
+  EXPECT_EQ(5, resourceStatistics->net_snmp_statistics().tcp_stats().currestab());
+}
+
+TEST_F(CheckpointCommandIsolatorTest,
+       should_not_recover_the_containers_cleaned_up) {
+  AWAIT_READY(isolator->cleanup(containerId));
+  Create();
+
+  AWAIT_READY(isolator->recover(states(), hashset<ContainerID>()));
+  AWAIT_FAILED(isolator->usage(containerId));
+}
@@ -1,7 +1,14 @@
 #include "CommandRunner.hpp"
+#include "CommandScheduler.hpp"
+#include "RunningContext.hpp"
 #include "gtest_helpers.hpp"
 
+#include <fcntl.h>
+
+#include <process/clock.hpp>
 #include <stout/gtest.hpp>
+#include <stout/json.hpp>
+#include <chrono>
 #include <regex>
 #include <memory>
 
@@ -106,3 +113,268 @@ TEST_F(CommandRunnerTest,
   EXPECT_ERROR_MESSAGE(output,
                        std::regex("Command \".*stderr.sh\" exited with return code 1\\. Cause: This is the cause\\."));
 }
+
+class PersistentCommandRunnerTest : public CommandRunnerTest {
+ public:
+  static Command persistentCommand(const string& script,
+                                   unsigned long timeout) {
+    Command command(g_resourcesPath + script, timeout);
+    command.setMode(CommandMode::PERSISTENT);
+    return command;
+  }
+};
+
+TEST_F(PersistentCommandRunnerTest,
+       should_send_several_inputs_to_the_same_persistent_command) {
+  Command command = persistentCommand("pipe_input_persistent.sh", 10);
+
+  Try<string> output = m_commandRunner->run(command, "HELLO");
+  EXPECT_EQ(output.get(), "HELLO > output");
+
+  output = m_commandRunner->run(command, "{\"multi\":\nline}");
+  EXPECT_EQ(output.get(), "{\"multi\":\nline} > output");
+}
+
+TEST_F(PersistentCommandRunnerTest,
+       should_restart_persistent_command_when_it_exited) {
+  Command command = persistentCommand("pipe_input_persistent_once.sh", 10);
+
+  Try<string> output = m_commandRunner->run(command, "HELLO");
+  EXPECT_EQ(output.get(), "HELLO > output");
+  os::sleep(Milliseconds(100));
+
+  output = m_commandRunner->run(command, "WORLD");
+  EXPECT_EQ(output.get(), "WORLD > output");
+}
+
+TEST_F(PersistentCommandRunnerTest,
+       should_SIGTERM_persistent_command_not_answering_in_time) {
+  Future<Try<string>> output = m_commandRunner->asyncRun(
+      persistentCommand("persistent_hang.sh", 1), "HELLO");
+  AWAIT_ASSERT_FAILED_FOR(output, Seconds(4));
+  os::sleep(Milliseconds(1500));
+  EXPECT_PROCESS_EXITED("/tmp/persistent_hang.pid");
+}
+
+class MemfdCommandRunnerTest : public CommandRunnerTest {
+ public:
+  static Command memfdCommand(const string& script) {
+    Command command(g_resourcesPath + script, 10);
+    command.setTransport(CommandTransport::MEMFD);
+    return command;
+  }
+};
+
+TEST_F(MemfdCommandRunnerTest, should_pass_in_memory_files_to_the_command) {
+  Try<string> output =
+      m_commandRunner->run(memfdCommand("input_path.sh"), "HELLO");
+  EXPECT_TRUE(AssertRegexMatch(output.get(), std::regex("/dev/fd/[0-9]+")));
+}
+
+TEST_F(MemfdCommandRunnerTest,
+       should_run_a_simple_sh_command_and_get_the_output_from_memory) {
+  Try<string> output =
+      m_commandRunner->run(memfdCommand("pipe_input.sh"), "HELLO");
+  EXPECT_EQ(output.get(), "HELLO > output");
+
+  output = m_commandRunner->runSynchronously(memfdCommand("pipe_input.sh"),
+                                             "WORLD");
+  EXPECT_EQ(output.get(), "WORLD > output");
+}
+
+TEST_F(MemfdCommandRunnerTest,
+       should_return_an_error_with_cause_from_command_in_memory) {
+  Try<string> output = m_commandRunner->run(memfdCommand("stderr.sh"), "");
+  EXPECT_ERROR_MESSAGE(output,
+                       std::regex("Command \".*stderr.sh\" exited with return "
+                                  "code 1\\. Cause: This is the cause\\."));
+}
+
+TEST_F(MemfdCommandRunnerTest,
+       should_not_leak_in_memory_files_to_other_processes) {
+  RunningContext rc(false, m_metadata, memfdCommand("pipe_input.sh"), "HELLO");
+  for (int fd : rc.fds()) {
+    EXPECT_TRUE(fcntl(fd, F_GETFD) & FD_CLOEXEC);
+  }
+
+  // The files of a command are still inherited by itself.
+  Try<string> output =
+      m_commandRunner->run(memfdCommand("pipe_input.sh"), "HELLO");
+  EXPECT_EQ(output.get(), "HELLO > output");
+  rc.deleteContext();
+}
+
+TEST_F(CommandRunnerTest, should_run_a_command_synchronously) {
+  Try<string> output = m_commandRunner->runSynchronously(
+      Command(g_resourcesPath + "pipe_input.sh", 10), "HELLO");
+  EXPECT_EQ(output.get(), "HELLO > output");
+
+  output = m_commandRunner->runSynchronously(
+      Command(g_resourcesPath + "stderr.sh", 10), "");
+  EXPECT_ERROR_MESSAGE(output,
+                       std::regex("Command \".*stderr.sh\" exited with return "
+                                  "code 1\\. Cause: This is the cause\\."));
+}
+
+TEST_F(CommandRunnerTest, should_fail_synchronously_on_unexisting_command) {
+  EXPECT_ERROR(m_commandRunner->runSynchronously(Command("blablabla", 10), ""));
+}
+
+TEST_F(CommandRunnerTest, should_look_synchronous_command_up_in_path) {
+  EXPECT_SOME(m_commandRunner->runSynchronously(Command("true", 10), ""));
+}
+
+TEST_F(CommandRunnerTest, should_SIGKILL_synchronous_command_after_timeout) {
+  Try<string> output = m_commandRunner->runSynchronously(
+      Command(g_resourcesPath + "force_kill.sh", 1), "");
+  EXPECT_ERROR_MESSAGE(
+      output, std::regex("Command \".*force_kill.sh\" took too long to "
+                         "execute\\."));
+  EXPECT_PROCESS_EXITED("/tmp/force_kill.pid");
+}
+
+TEST_F(CommandRunnerTest, should_run_parallel_commands_concurrently) {
+  Command command(g_resourcesPath + "prepare_slow.sh", 10);
+  command.addParallelCommand(g_resourcesPath + "prepare_slow.sh");
+  command.addParallelCommand(g_resourcesPath + "prepare_slow.sh");
+
+  auto start = std::chrono::steady_clock::now();
+  Try<string> output = m_commandRunner->run(command, "");
+  ASSERT_SOME(output);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+  EXPECT_EQ(
+      JSON::parse("{\"rootfs\": \"/isolated_fs\", \"user\": \"app_user\"}")
+          .get(),
+      JSON::parse(output.get()).get());
+}
+
+TEST_F(CommandRunnerTest, should_merge_the_outputs_of_parallel_commands) {
+  Command command(g_resourcesPath + "slaveRunTaskLabelDecorator.sh", 10);
+  command.addParallelCommand(g_resourcesPath + "echo_stdout.sh");
+  command.addParallelCommand(g_resourcesPath +
+                             "slaveRunTaskLabelDecorator_counter.sh");
+
+  Try<string> output = m_commandRunner->runSynchronously(command, "");
+  ASSERT_SOME(output);
+  Try<JSON::Object> json = JSON::parse<JSON::Object>(output.get());
+  ASSERT_SOME(json);
+  EXPECT_EQ(3u, json->find<JSON::Array>("labels")->values.size());
+}
+
+TEST_F(CommandRunnerTest, should_fail_if_a_parallel_command_fails) {
+  Command command(g_resourcesPath + "pipe_input.sh", 10);
+  command.addParallelCommand(g_resourcesPath + "stderr.sh");
+
+  Try<string> output = m_commandRunner->run(command, "HELLO");
+  EXPECT_ERROR_MESSAGE(output,
+                       std::regex("Command \".*stderr.sh\" exited with return "
+                                  "code 1\\. Cause: This is the cause\\."));
+}
+
+TEST_F(CommandRunnerTest, should_fail_when_the_output_is_too_big) {
+  Command command(g_resourcesPath + "pipe_input.sh", 10);
+  command.setMaxOutputBytes(8);
+
+  Try<string> output = m_commandRunner->run(command, "HELLO");
+  EXPECT_ERROR_MESSAGE(output,
+                       std::regex("Output of command \".*pipe_input.sh\" is 14 "
+                                  "bytes, more than the limit of 8"));
+
+  output = m_commandRunner->runSynchronously(command, "HELLO");
+  EXPECT_ERROR(output);
+
+  command.setMaxOutputBytes(14);
+  output = m_commandRunner->run(command, "HELLO");
+  EXPECT_EQ(output.get(), "HELLO > output");
+}
+
+TEST_F(CommandRunnerTest, should_kill_the_command_writing_too_much) {
+  Command command(g_resourcesPath + "output_flood.sh", 10);
+  command.setMaxOutputBytes(100);
+
+  Try<string> output = m_commandRunner->run(command, "");
+  EXPECT_ERROR_MESSAGE(output, std::regex("Output of command "
+                                          "\".*output_flood.sh\" is .* "
+                                          "bytes, more than the limit of 100"));
+  EXPECT_PROCESS_EXITED("/tmp/output_flood.pid");
+
+  output = m_commandRunner->runSynchronously(command, "");
+  EXPECT_ERROR_MESSAGE(output, std::regex("Output of command "
+                                          "\".*output_flood.sh\" is .* "
+                                          "bytes, more than the limit of 100"));
+  EXPECT_PROCESS_EXITED("/tmp/output_flood.pid");
+}
+
+TEST_F(CommandRunnerTest, should_truncate_the_error_output) {
+  Command command(g_resourcesPath + "stderr.sh", 10);
+  command.setMaxErrorBytes(8);
+
+  Try<string> output = m_commandRunner->run(command, "");
+  EXPECT_ERROR_MESSAGE(output,
+                       std::regex("Command \".*stderr.sh\" exited with return "
+                                  "code 1\\. Cause: This is \\.\\.\\. \\(10 "
+                                  "more bytes\\)"));
+}
+
+TEST_F(PersistentCommandRunnerTest, should_fail_when_the_frame_is_too_big) {
+  Command command = persistentCommand("pipe_input_persistent.sh", 10);
+  command.setMaxOutputBytes(8);
+
+  Future<Try<string>> output = m_commandRunner->asyncRun(command, "HELLO");
+  AWAIT_ASSERT_FAILED_FOR(output, Seconds(4));
+}
+
+TEST_F(CommandRunnerTest, should_short_circuit_a_command_failing_repeatedly) {
+  Command command(g_resourcesPath + "stderr.sh", 10);
+  BreakerOptions breaker;
+  breaker.failures = 2;
+  breaker.backoff = 60;
+  breaker.error = "The dependency of the command is down";
+  command.setBreaker(breaker);
+
+  Try<string> output = m_commandRunner->run(command, "");
+  EXPECT_ERROR_MESSAGE(output, std::regex("Command \".*stderr.sh\" exited.*"));
+  output = m_commandRunner->runSynchronously(command, "");
+  EXPECT_ERROR_MESSAGE(output, std::regex("Command \".*stderr.sh\" exited.*"));
+  EXPECT_TRUE(CircuitBreaker::get(command).isOpen());
+
+  output = m_commandRunner->run(command, "");
+  EXPECT_ERROR_MESSAGE(output,
+                       std::regex("The dependency of the command is down"));
+  output = m_commandRunner->runSynchronously(command, "");
+  EXPECT_ERROR_MESSAGE(output,
+                       std::regex("The dependency of the command is down"));
+}
+
+TEST_F(CommandRunnerTest, should_probe_again_if_the_probe_was_evicted) {
+  Command command(g_resourcesPath + "evicted_probe.sh", 10);
+  BreakerOptions breaker;
+  breaker.failures = 1;
+  breaker.backoff = 60;
+  command.setBreaker(breaker);
+  CircuitBreaker::get(command).record(breaker,
+                                      CircuitBreaker::Admission::ALLOWED,
+                                      false);
+
+  CommandScheduler& scheduler = CommandScheduler::instance();
+  scheduler.configure(1, 1);
+  AWAIT_READY(scheduler.acquire(CommandPriority::NORMAL));
+
+  // The probe is queued once the backoff elapsed, then evicted.
+  Clock::pause();
+  Clock::advance(Seconds(60));
+  Future<Try<string>> output =
+      m_commandRunner->asyncRun(command, "", CommandPriority::LOW);
+  Clock::resume();
+  Future<Nothing> high = scheduler.acquire(CommandPriority::HIGH);
+  AWAIT_FAILED(output);
+
+  // The breaker is not opened again for twice as long.
+  EXPECT_EQ(CircuitBreaker::Admission::PROBE,
+            CircuitBreaker::get(command).admit(breaker));
+
+  scheduler.release();
+  AWAIT_READY(high);
+  scheduler.release();
+  scheduler.configure(0, 0);
+}
@@ -0,0 +1,102 @@
+#include "CommandScheduler.hpp"
+#include "gtest_helpers.hpp"
+
+#include <gtest/gtest.h>
+#include <process/gtest.hpp>
+
+using namespace criteo::mesos;
+using process::Future;
+
+TEST(CommandSchedulerTest, should_not_limit_commands_by_default) {
+  CommandScheduler scheduler;
+
+  for (int i = 0; i < 100; ++i) {
+    AWAIT_READY(scheduler.acquire(CommandPriority::LOW));
+  }
+  EXPECT_EQ(100u, scheduler.running());
+  EXPECT_EQ(0u, scheduler.queued());
+}
+
+TEST(CommandSchedulerTest, should_queue_commands_above_the_limit) {
+  CommandScheduler scheduler(1, 0);
+
+  AWAIT_READY(scheduler.acquire(CommandPriority::NORMAL));
+  Future<Nothing> queued = scheduler.acquire(CommandPriority::NORMAL);
+  EXPECT_TRUE(queued.isPending());
+  EXPECT_EQ(1u, scheduler.queued());
+
+  scheduler.release();
+  AWAIT_READY(queued);
+  EXPECT_EQ(1u, scheduler.running());
+  EXPECT_EQ(0u, scheduler.queued());
+}
+
+TEST(CommandSchedulerTest, should_start_higher_priorities_first) {
+  CommandScheduler scheduler(1, 0);
+
+  AWAIT_READY(scheduler.acquire(CommandPriority::NORMAL));
+  Future<Nothing> low = scheduler.acquire(CommandPriority::LOW);
+  Future<Nothing> high = scheduler.acquire(CommandPriority::HIGH);
+
+  scheduler.release();
+  AWAIT_READY(high);
+  EXPECT_TRUE(low.isPending());
+
+  scheduler.release();
+  AWAIT_READY(low);
+}
+
+TEST(CommandSchedulerTest, should_reject_commands_when_queue_is_full) {
+  CommandScheduler scheduler(1, 1);
+
+  AWAIT_READY(scheduler.acquire(CommandPriority::NORMAL));
+  Future<Nothing> queued = scheduler.acquire(CommandPriority::HIGH);
+  EXPECT_TRUE(queued.isPending());
+
+  AWAIT_FAILED(scheduler.acquire(CommandPriority::LOW));
+  AWAIT_FAILED(scheduler.acquire(CommandPriority::NORMAL));
+  AWAIT_FAILED(scheduler.acquire(CommandPriority::HIGH));
+  EXPECT_EQ(1u, scheduler.queued());
+}
+
+TEST(CommandSchedulerTest, should_preempt_lower_priorities_when_queue_is_full) {
+  CommandScheduler scheduler(1, 2);
+
+  AWAIT_READY(scheduler.acquire(CommandPriority::NORMAL));
+  Future<Nothing> first = scheduler.acquire(CommandPriority::LOW);
+  Future<Nothing> last = scheduler.acquire(CommandPriority::LOW);
+
+  Future<Nothing> high = scheduler.acquire(CommandPriority::HIGH);
+  EXPECT_TRUE(high.isPending());
+  AWAIT_FAILED(last);
+  EXPECT_TRUE(first.isPending());
+  EXPECT_EQ(2u, scheduler.queued());
+
+  scheduler.release();
+  AWAIT_READY(high);
+}
+
+TEST(CommandSchedulerTest, should_skip_discarded_commands) {
+  CommandScheduler scheduler(1, 0);
+
+  AWAIT_READY(scheduler.acquire(CommandPriority::NORMAL));
+  Future<Nothing> discarded = scheduler.acquire(CommandPriority::HIGH);
+  Future<Nothing> queued = scheduler.acquire(CommandPriority::LOW);
+  discarded.discard();
+
+  scheduler.release();
+  AWAIT_DISCARDED(discarded);
+  AWAIT_READY(queued);
+  EXPECT_EQ(1u, scheduler.running());
+}
+
+TEST(CommandSchedulerTest, should_start_queued_commands_when_limit_is_raised) {
+  CommandScheduler scheduler(1, 0);
+
+  AWAIT_READY(scheduler.acquire(CommandPriority::NORMAL));
+  Future<Nothing> queued = scheduler.acquire(CommandPriority::NORMAL);
+
+  scheduler.configure(2, 0);
+  AWAIT_READY(queued);
+  EXPECT_EQ(2u, scheduler.running());
+}
@@ -137,3 +137,460 @@ TEST(ConfigurationParserTest, should_throw_on_timeout_out_of_range) {
   }
 }
 
+
+TEST(ConfigurationParserTest, should_throw_on_negative_sizes) {
+  ::mesos::Parameters parameters;
+  auto var = parameters.add_parameter();
+  var->set_key("scheduler_max_queue_depth");
+  var->set_value("-1");
+  EXPECT_THROW(ConfigurationParser::parse(parameters), std::invalid_argument);
+
+  var->set_value("12 commands");
+  EXPECT_THROW(ConfigurationParser::parse(parameters), std::invalid_argument);
+
+  var->set_value("12");
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ(12u, cfg.schedulerOptions.maxQueueDepth.get());
+}
+
+TEST(ConfigurationParserTest, should_parse_mode_and_transport) {
+  ::mesos::Parameters parameters;
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_usage_command");
+  var->set_value("command_usage");
+  var = parameters.add_parameter();
+  var->set_key("isolator_usage_mode");
+  var->set_value("persistent");
+
+  var = parameters.add_parameter();
+  var->set_key("isolator_prepare_command");
+  var->set_value("command_prepare");
+  var = parameters.add_parameter();
+  var->set_key("isolator_prepare_transport");
+  var->set_value("memfd");
+
+  Configuration cfg = ConfigurationParser::parse(parameters);
+
+  EXPECT_TRUE(cfg.usageCommand->isPersistent());
+  EXPECT_EQ(CommandTransport::FILE, cfg.usageCommand->transport());
+  EXPECT_FALSE(cfg.prepareCommand->isPersistent());
+  EXPECT_EQ(CommandTransport::MEMFD, cfg.prepareCommand->transport());
+}
+
+TEST(ConfigurationParserTest, should_throw_on_unknown_mode) {
+  ::mesos::Parameters parameters;
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_usage_command");
+  var->set_value("command_usage");
+  var = parameters.add_parameter();
+  var->set_key("isolator_usage_mode");
+  var->set_value("forever");
+
+  EXPECT_THROW(ConfigurationParser::parse(parameters), std::invalid_argument);
+}
+
+TEST(ConfigurationParserTest, should_throw_on_persistent_watch) {
+  ::mesos::Parameters parameters;
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_watch_command");
+  var->set_value("command_watch");
+  var = parameters.add_parameter();
+  var->set_key("isolator_watch_mode");
+  var->set_value("persistent");
+
+  EXPECT_THROW(ConfigurationParser::parse(parameters), std::invalid_argument);
+}
+
+TEST(ConfigurationParserTest, should_parse_format) {
+  ::mesos::Parameters parameters;
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_usage_command");
+  var->set_value("command_usage");
+  var = parameters.add_parameter();
+  var->set_key("isolator_usage_format");
+  var->set_value("protobuf");
+  var = parameters.add_parameter();
+  var->set_key("isolator_prepare_command");
+  var->set_value("command_prepare");
+
+  Configuration cfg = ConfigurationParser::parse(parameters);
+
+  EXPECT_EQ(CommandFormat::PROTOBUF, cfg.usageCommand->format());
+  EXPECT_EQ(CommandFormat::JSON, cfg.prepareCommand->format());
+
+  var = parameters.add_parameter();
+  var->set_key("isolator_prepare_format");
+  var->set_value("xml");
+  EXPECT_THROW(ConfigurationParser::parse(parameters), std::invalid_argument);
+}
+
+TEST(ConfigurationParserTest, should_parse_usage_batch_window) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.isolatorOptions.usageBatchWindow.isNone());
+
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_usage_batch_window");
+  var->set_value("0.05");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ(Milliseconds(50), cfg.isolatorOptions.usageBatchWindow.get());
+}
+
+TEST(ConfigurationParserTest, should_parse_watch_period_bounds) {
+  ::mesos::Parameters parameters;
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_watch_min_period");
+  var->set_value("0.5");
+  var = parameters.add_parameter();
+  var->set_key("isolator_watch_max_period");
+  var->set_value("300");
+
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ(Milliseconds(500), cfg.isolatorOptions.watchMinPeriod.get());
+  EXPECT_EQ(Seconds(300), cfg.isolatorOptions.watchMaxPeriod.get());
+}
+
+TEST(ConfigurationParserTest, should_parse_cleanup_batch) {
+  ::mesos::Parameters parameters;
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_cleanup_command");
+  var->set_value("cleanup.sh");
+
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.isolatorOptions.cleanupBatchWindow.isNone());
+  EXPECT_TRUE(cfg.isolatorOptions.cleanupBatchSize.isNone());
+  EXPECT_TRUE(cfg.isolatorOptions.cleanupRetries.isNone());
+
+  var = parameters.add_parameter();
+  var->set_key("isolator_cleanup_batch_window");
+  var->set_value("0.5");
+  var = parameters.add_parameter();
+  var->set_key("isolator_cleanup_batch_size");
+  var->set_value("100");
+  var = parameters.add_parameter();
+  var->set_key("isolator_cleanup_retries");
+  var->set_value("5");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ(Command("cleanup.sh"), cfg.cleanupCommand.get());
+  EXPECT_EQ(Milliseconds(500), cfg.isolatorOptions.cleanupBatchWindow.get());
+  EXPECT_EQ(100u, cfg.isolatorOptions.cleanupBatchSize.get());
+  EXPECT_EQ(5u, cfg.isolatorOptions.cleanupRetries.get());
+}
+
+TEST(ConfigurationParserTest, should_parse_usage_delta) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_FALSE(cfg.isolatorOptions.usageDelta);
+
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_usage_delta");
+  var->set_value("true");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.isolatorOptions.usageDelta);
+}
+
+TEST(ConfigurationParserTest, should_parse_usage_stats_table) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.isolatorOptions.usageStatsTable.isNone());
+
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_usage_stats_table");
+  var->set_value("/dev/shm/mesos_stats");
+  var = parameters.add_parameter();
+  var->set_key("isolator_usage_stats_table_capacity");
+  var->set_value("256");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ("/dev/shm/mesos_stats", cfg.isolatorOptions.usageStatsTable.get());
+  EXPECT_EQ(256u, cfg.isolatorOptions.usageStatsTableCapacity.get());
+}
+
+TEST(ConfigurationParserTest, should_parse_checkpoint_file) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.isolatorOptions.checkpointFile.isNone());
+
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_checkpoint_file");
+  var->set_value("/var/lib/mesos/command_modules.checkpoint");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ("/var/lib/mesos/command_modules.checkpoint",
+            cfg.isolatorOptions.checkpointFile.get());
+}
+
+TEST(ConfigurationParserTest, should_parse_scheduler_options) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.schedulerOptions.maxConcurrency.isNone());
+  EXPECT_TRUE(cfg.schedulerOptions.maxQueueDepth.isNone());
+  EXPECT_TRUE(cfg.schedulerOptions.spawnServer.isNone());
+
+  auto var = parameters.add_parameter();
+  var->set_key("scheduler_max_concurrency");
+  var->set_value("16");
+  var = parameters.add_parameter();
+  var->set_key("scheduler_max_queue_depth");
+  var->set_value("64");
+  var = parameters.add_parameter();
+  var->set_key("scheduler_spawn_server");
+  var->set_value("/usr/lib/mesos/mesos-command-spawner");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ(16u, cfg.schedulerOptions.maxConcurrency.get());
+  EXPECT_EQ(64u, cfg.schedulerOptions.maxQueueDepth.get());
+  EXPECT_EQ("/usr/lib/mesos/mesos-command-spawner",
+            cfg.schedulerOptions.spawnServer.get());
+}
+
+TEST(ConfigurationParserTest, should_parse_cgroup_options) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.schedulerOptions.cgroup.isNone());
+
+  auto var = parameters.add_parameter();
+  var->set_key("scheduler_cgroup");
+  var->set_value("mesos-command-modules");
+  var = parameters.add_parameter();
+  var->set_key("scheduler_cgroup_cpus");
+  var->set_value("0.5");
+  var = parameters.add_parameter();
+  var->set_key("scheduler_cgroup_memory_limit");
+  var->set_value("268435456");
+
+  cfg = ConfigurationParser::parse(parameters);
+  ASSERT_TRUE(cfg.schedulerOptions.cgroup.isSome());
+  const CgroupOptions& cgroup = cfg.schedulerOptions.cgroup.get();
+  EXPECT_EQ("mesos-command-modules", cgroup.name);
+  EXPECT_EQ("/sys/fs/cgroup", cgroup.hierarchy);
+  EXPECT_TRUE(cgroup.cpuShares.isNone());
+  EXPECT_EQ(0.5, cgroup.cpus.get());
+  EXPECT_EQ(268435456u, cgroup.memoryLimit.get());
+  EXPECT_TRUE(cgroup.cpuset.isNone());
+}
+
+TEST(ConfigurationParserTest, should_parse_span_options) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.schedulerOptions.spans.isNone());
+
+  auto var = parameters.add_parameter();
+  var->set_key("scheduler_span_file");
+  var->set_value("/var/log/mesos/spans.json");
+  var = parameters.add_parameter();
+  var->set_key("scheduler_span_sample_rate");
+  var->set_value("0.1");
+
+  cfg = ConfigurationParser::parse(parameters);
+  ASSERT_TRUE(cfg.schedulerOptions.spans.isSome());
+  EXPECT_EQ("/var/log/mesos/spans.json", cfg.schedulerOptions.spans->file);
+  EXPECT_EQ(0.1, cfg.schedulerOptions.spans->sampleRate.get());
+}
+
+TEST(ConfigurationParserTest, should_parse_watch_threads) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.isolatorOptions.watchThreads.isNone());
+
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_watch_threads");
+  var->set_value("8");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ(8u, cfg.isolatorOptions.watchThreads.get());
+}
+
+TEST(ConfigurationParserTest, should_parse_watch_batch) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_FALSE(cfg.isolatorOptions.watchBatch);
+
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_watch_batch");
+  var->set_value("true");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.isolatorOptions.watchBatch);
+}
+
+TEST(ConfigurationParserTest, should_parse_module_name) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.isolatorOptions.name.isNone());
+  EXPECT_TRUE(cfg.hookOptions.name.isNone());
+
+  auto var = parameters.add_parameter();
+  var->set_key("name");
+  var->set_value("network");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ("network", cfg.isolatorOptions.name.get());
+  EXPECT_EQ("network", cfg.hookOptions.name.get());
+}
+
+TEST(ConfigurationParserTest, should_parse_decorator_cache) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.hookOptions.runTaskLabelCache.isNone());
+  EXPECT_TRUE(cfg.hookOptions.executorEnvironmentCache.isNone());
+
+  auto var = parameters.add_parameter();
+  var->set_key("hook_slave_run_task_label_decorator_cache_size");
+  var->set_value("100");
+  var = parameters.add_parameter();
+  var->set_key("hook_slave_run_task_label_decorator_cache_ttl");
+  var->set_value("60");
+  var = parameters.add_parameter();
+  var->set_key("hook_slave_run_task_label_decorator_cache_key");
+  var->set_value("task_info.name, framework_info.name");
+
+  cfg = ConfigurationParser::parse(parameters);
+  ASSERT_TRUE(cfg.hookOptions.runTaskLabelCache.isSome());
+  const CacheOptions& cache = cfg.hookOptions.runTaskLabelCache.get();
+  EXPECT_EQ(100u, cache.size);
+  EXPECT_EQ(Seconds(60), cache.ttl.get());
+  EXPECT_EQ(std::vector<std::string>({"task_info.name", "framework_info.name"}),
+            cache.keyFields);
+  EXPECT_TRUE(cfg.hookOptions.executorEnvironmentCache.isNone());
+}
+
+TEST(ConfigurationParserTest, should_parse_decorator_deadline) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.hookOptions.runTaskLabelDeadline.isNone());
+  EXPECT_TRUE(cfg.hookOptions.executorEnvironmentDeadline.isNone());
+
+  auto var = parameters.add_parameter();
+  var->set_key("hook_slave_executor_environment_decorator_deadline");
+  var->set_value("0.5");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.hookOptions.runTaskLabelDeadline.isNone());
+  EXPECT_EQ(Milliseconds(500),
+            cfg.hookOptions.executorEnvironmentDeadline.get());
+}
+
+TEST(ConfigurationParserTest, should_parse_parallel_commands) {
+  ::mesos::Parameters parameters;
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_prepare_command_1");
+  var->set_value("first.sh");
+  var = parameters.add_parameter();
+  var->set_key("isolator_prepare_command_2");
+  var->set_value("second.sh");
+  var = parameters.add_parameter();
+  var->set_key("isolator_prepare_command_4");
+  var->set_value("ignored.sh");
+  var = parameters.add_parameter();
+  var->set_key("isolator_prepare_timeout");
+  var->set_value("5");
+
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  Command expected("first.sh", 5);
+  expected.addParallelCommand("second.sh");
+  EXPECT_EQ(expected, cfg.prepareCommand.get());
+  EXPECT_EQ(2u, cfg.prepareCommand->fanOut().size());
+  EXPECT_EQ("second.sh", cfg.prepareCommand->fanOut()[1].command());
+  EXPECT_EQ(5u, cfg.prepareCommand->fanOut()[1].timeout());
+}
+
+TEST(ConfigurationParserTest, should_parse_output_limits) {
+  ::mesos::Parameters parameters;
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_usage_command");
+  var->set_value("usage.sh");
+
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ(0u, cfg.usageCommand->maxOutputBytes());
+  EXPECT_EQ(DEFAULT_MAX_ERROR_BYTES, cfg.usageCommand->maxErrorBytes());
+
+  var = parameters.add_parameter();
+  var->set_key("isolator_usage_max_output_bytes");
+  var->set_value("65536");
+  var = parameters.add_parameter();
+  var->set_key("isolator_usage_max_error_bytes");
+  var->set_value("0");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ(65536u, cfg.usageCommand->maxOutputBytes());
+  EXPECT_EQ(0u, cfg.usageCommand->maxErrorBytes());
+}
+
+TEST(ConfigurationParserTest, should_parse_breaker_options) {
+  ::mesos::Parameters parameters;
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_usage_command");
+  var->set_value("usage.sh");
+
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_FALSE(cfg.usageCommand->hasBreaker());
+
+  var = parameters.add_parameter();
+  var->set_key("isolator_usage_breaker_failures");
+  var->set_value("5");
+  var = parameters.add_parameter();
+  var->set_key("isolator_usage_breaker_backoff");
+  var->set_value("0.5");
+  var = parameters.add_parameter();
+  var->set_key("isolator_usage_breaker_error");
+  var->set_value("The metrics backend is down");
+
+  cfg = ConfigurationParser::parse(parameters);
+  ASSERT_TRUE(cfg.usageCommand->hasBreaker());
+  const BreakerOptions& breaker = cfg.usageCommand->breaker();
+  EXPECT_EQ(5u, breaker.failures);
+  EXPECT_EQ(0.5, breaker.backoff);
+  EXPECT_EQ(60, breaker.maxBackoff);
+  EXPECT_EQ("The metrics backend is down", breaker.error);
+}
+
+TEST(ConfigurationParserTest, should_parse_config_file) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.configFile.isNone());
+  EXPECT_TRUE(cfg.configFileInterval.isNone());
+
+  auto var = parameters.add_parameter();
+  var->set_key("config_file");
+  var->set_value("/etc/mesos/command_modules.json");
+  var = parameters.add_parameter();
+  var->set_key("config_file_interval");
+  var->set_value("2.5");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ("/etc/mesos/command_modules.json", cfg.configFile.get());
+  EXPECT_EQ(Milliseconds(2500), cfg.configFileInterval.get());
+}
+
+TEST(ConfigurationParserTest, should_parse_trace_file) {
+  ::mesos::Parameters parameters;
+  Configuration cfg = ConfigurationParser::parse(parameters);
+  EXPECT_TRUE(cfg.isolatorOptions.traceFile.isNone());
+  EXPECT_TRUE(cfg.hookOptions.traceFile.isNone());
+
+  auto var = parameters.add_parameter();
+  var->set_key("trace_file");
+  var->set_value("/var/log/mesos/command_modules.jsonl");
+
+  cfg = ConfigurationParser::parse(parameters);
+  EXPECT_EQ("/var/log/mesos/command_modules.jsonl",
+            cfg.isolatorOptions.traceFile.get());
+  EXPECT_EQ("/var/log/mesos/command_modules.jsonl",
+            cfg.hookOptions.traceFile.get());
+}
+
+TEST(ConfigurationParserTest, should_reject_zero_watch_threads) {
+  ::mesos::Parameters parameters;
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_watch_threads");
+  var->set_value("2");
+  EXPECT_EQ(2u, ConfigurationParser::parse(parameters)
+                    .isolatorOptions.watchThreads.get());
+
+  var->set_value("0");
+  EXPECT_THROW(ConfigurationParser::parse(parameters), std::invalid_argument);
+}
@@ -0,0 +1,102 @@
+#include "ConfigurationWatcher.hpp"
+
+#include <gtest/gtest.h>
+
+#include <process/future.hpp>
+#include <process/gtest.hpp>
+#include <stout/gtest.hpp>
+#include <stout/os/rm.hpp>
+#include <stout/os/write.hpp>
+
+using std::string;
+
+using namespace criteo::mesos;
+
+// Value of a parameter, None if it is missing.
+static Option<string> valueOf(const ::mesos::Parameters& parameters,
+                              const string& key) {
+  Option<string> value;
+  for (const ::mesos::Parameter& parameter : parameters.parameter()) {
+    if (parameter.key() == key) value = parameter.value();
+  }
+  return value;
+}
+
+class ConfigurationWatcherTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    os::rm(path);
+    auto var = parameters.add_parameter();
+    var->set_key("isolator_prepare_command");
+    var->set_value("prepare.sh");
+    var = parameters.add_parameter();
+    var->set_key("isolator_watch_command");
+    var->set_value("watch.sh");
+  }
+
+  void TearDown() { os::rm(path); }
+
+  const string path = "/tmp/configuration_watcher_test.json";
+  ::mesos::Parameters parameters;
+};
+
+TEST_F(ConfigurationWatcherTest, should_override_parameters) {
+  Try<::mesos::Parameters> overlaid = ConfigurationWatcher::overlay(
+      parameters,
+      "{\"isolator_prepare_command\": \"other.sh\",\"isolator_watch_command\": "
+      "null,\"isolator_watch_frequence\": 10,\"debug\": true}");
+  ASSERT_SOME(overlaid);
+
+  EXPECT_EQ(3, overlaid->parameter_size());
+  EXPECT_SOME_EQ("other.sh",
+                 valueOf(overlaid.get(), "isolator_prepare_command"));
+  EXPECT_NONE(valueOf(overlaid.get(), "isolator_watch_command"));
+  EXPECT_SOME_EQ("10", valueOf(overlaid.get(), "isolator_watch_frequence"));
+  EXPECT_SOME_EQ("true", valueOf(overlaid.get(), "debug"));
+}
+
+TEST_F(ConfigurationWatcherTest, should_reject_invalid_overrides) {
+  EXPECT_ERROR(ConfigurationWatcher::overlay(parameters, "not json"));
+  EXPECT_ERROR(ConfigurationWatcher::overlay(parameters, "[]"));
+  EXPECT_ERROR(ConfigurationWatcher::overlay(
+      parameters, "{\"isolator_prepare_command\": [\"other.sh\"]}"));
+}
+
+TEST_F(ConfigurationWatcherTest, should_use_the_parameters_without_file) {
+  ConfigurationWatcher watcher(path, parameters, Milliseconds(50));
+  EXPECT_EQ(Command("prepare.sh"),
+            watcher.configuration().prepareCommand.get());
+}
+
+TEST_F(ConfigurationWatcherTest, should_reload_once_the_file_changes) {
+  ASSERT_SOME(os::write(path, "{\"isolator_watch_frequence\": 10}"));
+  ConfigurationWatcher watcher(path, parameters, Milliseconds(50));
+  EXPECT_EQ(10, watcher.configuration().watchCommand->frequence());
+
+  process::Promise<Configuration> reloaded;
+  watcher.start([&reloaded](const Configuration& cfg) { reloaded.set(cfg); });
+
+  // Nothing is reloaded while the file is unchanged.
+  AWAIT_EXPECT_PENDING_FOR(reloaded.future(), Milliseconds(200));
+
+  ASSERT_SOME(os::write(path, "{\"isolator_watch_frequence\": 5}"));
+  AWAIT_READY(reloaded.future());
+  EXPECT_EQ(5, reloaded.future()->watchCommand->frequence());
+  EXPECT_EQ(Command("prepare.sh"), reloaded.future()->prepareCommand.get());
+}
+
+TEST_F(ConfigurationWatcherTest, should_keep_the_configuration_if_malformed) {
+  ASSERT_SOME(os::write(path, "{\"isolator_watch_frequence\": \"fast\"}"));
+  ConfigurationWatcher watcher(path, parameters, Milliseconds(50));
+  EXPECT_EQ(Command("watch.sh"), watcher.configuration().watchCommand.get());
+
+  process::Promise<Configuration> reloaded;
+  watcher.start([&reloaded](const Configuration& cfg) { reloaded.set(cfg); });
+
+  ASSERT_SOME(os::write(path, "{\"isolator_usage_timeout\": \"slow\"}"));
+  AWAIT_EXPECT_PENDING_FOR(reloaded.future(), Milliseconds(200));
+
+  ASSERT_SOME(os::write(path, "{\"isolator_watch_frequence\": 5}"));
+  AWAIT_READY(reloaded.future());
+  EXPECT_EQ(5, reloaded.future()->watchCommand->frequence());
+}
@@ -0,0 +1,117 @@
+#include "ContainerCheckpoint.hpp"
+
+#include <sys/stat.h>
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include <stout/gtest.hpp>
+#include <stout/os/read.hpp>
+#include <stout/os/rm.hpp>
+#include <stout/os/write.hpp>
+
+using std::string;
+
+using namespace criteo::mesos;
+using ::mesos::ContainerID;
+
+class ContainerCheckpointTest : public ::testing::Test {
+ protected:
+  void SetUp() { os::rm(path); }
+  void TearDown() { os::rm(path); }
+
+  static ContainerID containerId(const string& value) {
+    ContainerID containerId;
+    containerId.set_value(value);
+    return containerId;
+  }
+
+  static ContainerCheckpoint::Entry entry(const string& user) {
+    ContainerCheckpoint::Entry entry;
+    entry.input =
+        std::make_shared<const string>("{\"user\":\"" + user + "\"}");
+    entry.protobufInput = std::make_shared<const string>("\n\x01\0", 3);
+    return entry;
+  }
+
+  process::Owned<ContainerCheckpoint> open() {
+    Try<process::Owned<ContainerCheckpoint>> checkpoint =
+        ContainerCheckpoint::open(path);
+    EXPECT_SOME(checkpoint);
+    return checkpoint.get();
+  }
+
+  const string path = "/tmp/mesos_command_modules_checkpoint";
+};
+
+TEST_F(ContainerCheckpointTest, should_reload_the_containers_prepared) {
+  {
+    process::Owned<ContainerCheckpoint> checkpoint = open();
+    checkpoint->add(containerId("container_1"), entry("app_user"));
+    checkpoint->add(containerId("container_2"), entry("other"));
+    checkpoint->remove(containerId("container_2"));
+  }
+
+  process::Owned<ContainerCheckpoint> checkpoint = open();
+  ASSERT_EQ(1u, checkpoint->entries().size());
+  const ContainerCheckpoint::Entry& reloaded =
+      checkpoint->entries().at(containerId("container_1"));
+  EXPECT_EQ("{\"user\":\"app_user\"}", *reloaded.input);
+  EXPECT_EQ(string("\n\x01\0", 3), *reloaded.protobufInput);
+  // The stale records are dropped when the log is opened.
+  EXPECT_EQ(1u, checkpoint->records());
+}
+
+TEST_F(ContainerCheckpointTest, should_ignore_a_record_cut_short) {
+  {
+    process::Owned<ContainerCheckpoint> checkpoint = open();
+    checkpoint->add(containerId("container_1"), entry("app_user"));
+  }
+  Try<string> content = os::read(path);
+  ASSERT_SOME(content);
+  ASSERT_SOME(os::write(path, content.get() + "P 13 40 3\n\n\x0b"));
+
+  process::Owned<ContainerCheckpoint> checkpoint = open();
+  EXPECT_EQ(1u, checkpoint->entries().size());
+  EXPECT_SOME_EQ(content.get(), os::read(path));
+}
+
+TEST_F(ContainerCheckpointTest, should_forget_the_containers_not_retained) {
+  process::Owned<ContainerCheckpoint> checkpoint = open();
+  checkpoint->add(containerId("container_1"), entry("app_user"));
+  checkpoint->add(containerId("container_2"), entry("other"));
+
+  hashset<ContainerID> retained;
+  retained.insert(containerId("container_2"));
+  checkpoint->retain(retained);
+  EXPECT_EQ(1u, checkpoint->records());
+
+  checkpoint->flush();
+  checkpoint = open();
+  ASSERT_EQ(1u, checkpoint->entries().size());
+  EXPECT_TRUE(checkpoint->entries().contains(containerId("container_2")));
+}
+
+TEST_F(ContainerCheckpointTest, should_compact_the_log_once_mostly_stale) {
+  process::Owned<ContainerCheckpoint> checkpoint = open();
+  for (int i = 0; i < 200; ++i) {
+    checkpoint->add(containerId("container"), entry("app_user"));
+    checkpoint->remove(containerId("container"));
+  }
+  EXPECT_LT(checkpoint->records(), 256u);
+  EXPECT_TRUE(checkpoint->entries().empty());
+
+  checkpoint->flush();
+  Try<string> content = os::read(path);
+  ASSERT_SOME(content);
+  EXPECT_LT(content->size(), 256u * 30);
+}
+
+TEST_F(ContainerCheckpointTest, should_be_readable_by_its_owner_only) {
+  open()->add(containerId("container_1"), entry("app_user"));
+
+  struct stat status;
+  ASSERT_EQ(0, ::stat(path.c_str(), &status));
+  EXPECT_EQ(0600u, status.st_mode & 0777);
+}
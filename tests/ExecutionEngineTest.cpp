@@ -0,0 +1,56 @@
+#include "ExecutionEngine.hpp"
+
+#include <gtest/gtest.h>
+
+using std::string;
+
+using namespace criteo::mesos;
+
+class ExecutionEngineTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    containerId.set_value("engine_container");
+    containerConfig.set_user("app_user");
+  }
+
+  void TearDown() { engine.forgetContainer(containerId); }
+
+  ExecutionEngine engine;
+  ::mesos::ContainerID containerId;
+  ::mesos::slave::ContainerConfig containerConfig;
+};
+
+TEST_F(ExecutionEngineTest, should_share_the_input_of_a_container) {
+  std::shared_ptr<const string> input =
+      engine.containerInput(CommandFormat::JSON, containerId, containerConfig);
+  std::shared_ptr<const string> other =
+      engine.containerInput(CommandFormat::JSON, containerId, containerConfig);
+
+  EXPECT_EQ(input.get(), other.get());
+  EXPECT_NE(string::npos, input->find("app_user"));
+}
+
+TEST_F(ExecutionEngineTest, should_serialize_each_format_separately) {
+  std::shared_ptr<const string> json =
+      engine.containerInput(CommandFormat::JSON, containerId, containerConfig);
+  std::shared_ptr<const string> protobuf = engine.containerInput(
+      CommandFormat::PROTOBUF, containerId, containerConfig);
+
+  EXPECT_NE(*json, *protobuf);
+  EXPECT_EQ('\x0a', (*protobuf)[0]);
+}
+
+TEST_F(ExecutionEngineTest, should_serialize_again_once_forgotten) {
+  std::shared_ptr<const string> input =
+      engine.containerInput(CommandFormat::JSON, containerId, containerConfig);
+
+  // A new container with the same id gets its own input, even while the
+  // previous one is still used, e.g., by its cleanup.
+  engine.forgetContainer(containerId);
+  EXPECT_EQ(0u, engine.size());
+  containerConfig.set_user("other_user");
+  std::shared_ptr<const string> other =
+      engine.containerInput(CommandFormat::JSON, containerId, containerConfig);
+  EXPECT_NE(string::npos, other->find("other_user"));
+  EXPECT_NE(string::npos, input->find("app_user"));
+}
@@ -0,0 +1,85 @@
+#include "Helpers.hpp"
+#include "JsonDecoder.hpp"
+#include "gtest_helpers.hpp"
+
+#include <gtest/gtest.h>
+#include <stout/gtest.hpp>
+
+using std::string;
+
+using namespace criteo::mesos;
+using ::mesos::ResourceStatistics;
+using ::mesos::slave::ContainerLimitation;
+
+// Decode with the generic parser, which is the reference behavior.
+template <class Proto>
+static Try<Proto> genericDecode(const string& json) {
+  Try<JSON::Object> object = JSON::parse<JSON::Object>(json);
+  if (object.isError()) return Error(object.error());
+  return ::protobuf::parse<Proto>(object.get());
+}
+
+template <class Proto>
+static void expectSameAsGeneric(const string& json) {
+  Try<Proto> expected = genericDecode<Proto>(json);
+  ASSERT_SOME(expected);
+
+  Proto proto;
+  ASSERT_TRUE(decodeJson(json, &proto)) << json;
+  EXPECT_EQ(expected->SerializeAsString(), proto.SerializeAsString()) << json;
+}
+
+TEST(JsonDecoderTest, should_decode_resource_statistics) {
+  expectSameAsGeneric<ResourceStatistics>(
+      "{\"timestamp\": 12345.5, \"cpus_user_time_secs\": 0.25, "
+      "\"cpus_limit\": 2, \"mem_rss_bytes\": 1073741824, "
+      "\"net_snmp_statistics\": {\"tcp_stats\": {\"CurrEstab\": 5}}}");
+}
+
+TEST(JsonDecoderTest, should_decode_container_limitation) {
+  expectSameAsGeneric<ContainerLimitation>(
+      "{\"resources\":[{\"name\":\"mem\",\"type\":\"SCALAR\","
+      "\"scalar\":{\"value\":1}},{\"name\":\"cpus\",\"type\":\"SCALAR\","
+      "\"scalar\":{\"value\":0.5}}],\"message\":\"too much toto\","
+      "\"reason\":\"REASON_CONTAINER_LIMITATION\"}");
+}
+
+TEST(JsonDecoderTest, should_ignore_unknown_fields) {
+  expectSameAsGeneric<ResourceStatistics>(
+      "{\"unknown\": {\"nested\": [1, {\"a\": [true]}]}, \"timestamp\": 1, "
+      "\"other\": \"value\"}");
+}
+
+TEST(JsonDecoderTest, should_reject_what_the_generic_parser_handles) {
+  ResourceStatistics statistics;
+  // Missing required timestamp.
+  EXPECT_FALSE(decodeJson("{\"cpus_limit\": 2}", &statistics));
+  statistics.Clear();
+  EXPECT_FALSE(decodeJson("MALFORMED", &statistics));
+  statistics.Clear();
+  EXPECT_FALSE(decodeJson("\"not an object\"", &statistics));
+  statistics.Clear();
+  EXPECT_FALSE(decodeJson("{\"timestamp\": null}", &statistics));
+  statistics.Clear();
+  EXPECT_FALSE(decodeJson("{\"timestamp\": \"1\"}", &statistics));
+  statistics.Clear();
+  EXPECT_FALSE(decodeJson("{\"timestamp\": 1, \"timestamp\": 2}", &statistics));
+  statistics.Clear();
+  EXPECT_FALSE(decodeJson("{\"timestamp\": [1]}", &statistics));
+  statistics.Clear();
+  EXPECT_FALSE(decodeJson("{\"timestamp\": 1, \"mem_rss_bytes\": 1.5}",
+                          &statistics));
+
+  ContainerLimitation limitation;
+  EXPECT_FALSE(decodeJson("{\"reason\": \"NOT_A_REASON\"}", &limitation));
+}
+
+TEST(JsonDecoderTest, should_keep_generic_errors_in_json_to_protobuf) {
+  EXPECT_ERROR(jsonToProtobuf<ResourceStatistics>("MALFORMED"));
+  EXPECT_ERROR(jsonToProtobuf<ResourceStatistics>("{\"cpus_limit\": 2}"));
+
+  Result<ResourceStatistics> statistics =
+      jsonToProtobuf<ResourceStatistics>("{\"timestamp\": 1}");
+  ASSERT_SOME(statistics);
+  EXPECT_EQ(1, statistics->timestamp());
+}
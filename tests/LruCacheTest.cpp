@@ -0,0 +1,58 @@
+#include "LruCache.hpp"
+
+#include <gtest/gtest.h>
+
+#include <process/clock.hpp>
+
+using namespace criteo::mesos;
+using process::Clock;
+
+TEST(LruCacheTest, should_return_the_value_put) {
+  LruCache<int> cache(2, None());
+  cache.put("a", 1);
+
+  EXPECT_EQ(Option<int>(1), cache.get("a"));
+  EXPECT_TRUE(cache.get("b").isNone());
+}
+
+TEST(LruCacheTest, should_replace_the_value_of_a_key) {
+  LruCache<int> cache(2, None());
+  cache.put("a", 1);
+  cache.put("a", 2);
+
+  EXPECT_EQ(Option<int>(2), cache.get("a"));
+  EXPECT_EQ(1u, cache.size());
+}
+
+TEST(LruCacheTest, should_evict_the_least_recently_used_entry) {
+  LruCache<int> cache(2, None());
+  cache.put("a", 1);
+  cache.put("b", 2);
+  cache.get("a");
+  cache.put("c", 3);
+
+  EXPECT_EQ(Option<int>(1), cache.get("a"));
+  EXPECT_TRUE(cache.get("b").isNone());
+  EXPECT_EQ(Option<int>(3), cache.get("c"));
+}
+
+TEST(LruCacheTest, should_keep_nothing_without_capacity) {
+  LruCache<int> cache(0, None());
+  cache.put("a", 1);
+
+  EXPECT_TRUE(cache.get("a").isNone());
+}
+
+TEST(LruCacheTest, should_expire_entries_after_the_ttl) {
+  Clock::pause();
+  LruCache<int> cache(2, Seconds(10));
+  cache.put("a", 1);
+
+  Clock::advance(Seconds(5));
+  EXPECT_EQ(Option<int>(1), cache.get("a"));
+
+  Clock::advance(Seconds(5));
+  EXPECT_TRUE(cache.get("a").isNone());
+  EXPECT_EQ(0u, cache.size());
+  Clock::resume();
+}
@@ -0,0 +1,77 @@
+#include "CommandRunner.hpp"
+#include "Metrics.hpp"
+#include "gtest_helpers.hpp"
+
+#include <gtest/gtest.h>
+#include <process/gtest.hpp>
+#include <process/metrics/metrics.hpp>
+
+using std::string;
+
+using namespace criteo::mesos;
+using process::Future;
+
+extern string g_resourcesPath;
+
+class MetricsTest : public ::testing::Test {
+ protected:
+  static double value(const string& name) {
+    Future<hashmap<string, double>> snapshot =
+        process::metrics::snapshot(None());
+    AWAIT_EXPECT_READY(snapshot);
+    return snapshot->get(name).getOrElse(-1);
+  }
+
+  logging::Metadata metadata = {"ABC-DEF-GHI", "method"};
+};
+
+TEST_F(MetricsTest, should_count_calls_and_failures) {
+  CommandMetrics& metrics = CommandMetrics::get("metrics_test", "counts");
+  CommandRunner runner(false, metadata, &metrics);
+
+  EXPECT_SOME(runner.run(Command(g_resourcesPath + "ok.sh", 10), ""));
+  EXPECT_ERROR(runner.run(Command(g_resourcesPath + "throw.sh", 10), ""));
+  EXPECT_ERROR(runner.runSynchronously(
+      Command(g_resourcesPath + "throw.sh", 10), ""));
+
+  EXPECT_EQ(3, value("command_modules/metrics_test/counts/calls"));
+  EXPECT_EQ(2, value("command_modules/metrics_test/counts/failures"));
+  EXPECT_EQ(0, value("command_modules/metrics_test/counts/timeouts"));
+  EXPECT_EQ(3,
+            value("command_modules/metrics_test/counts/spawn_latency_ms/count"));
+  EXPECT_EQ(3, value("command_modules/metrics_test/counts/run_time_ms/count"));
+}
+
+TEST_F(MetricsTest, should_count_timeouts_and_sigkills) {
+  CommandMetrics& metrics = CommandMetrics::get("metrics_test", "timeouts");
+  CommandRunner runner(false, metadata, &metrics);
+
+  EXPECT_ERROR(
+      runner.run(Command(g_resourcesPath + "infinite_loop.sh", 1), ""));
+  EXPECT_ERROR(runner.run(Command(g_resourcesPath + "force_kill.sh", 1), ""));
+
+  EXPECT_EQ(2, value("command_modules/metrics_test/timeouts/timeouts"));
+  EXPECT_EQ(1, value("command_modules/metrics_test/timeouts/sigkills"));
+}
+
+TEST_F(MetricsTest, should_measure_parse_time) {
+  CommandMetrics& metrics = CommandMetrics::get("metrics_test", "parse");
+  EXPECT_EQ(42, timed(metrics.parseTime, []() { return 42; }));
+  EXPECT_EQ(1, value("command_modules/metrics_test/parse/parse_time_ms/count"));
+}
+
+TEST_F(MetricsTest, should_share_metrics_of_the_same_method) {
+  EXPECT_EQ(&CommandMetrics::get("metrics_test", "shared"),
+            &CommandMetrics::get("metrics_test", "shared"));
+  EXPECT_EQ(nullptr, commandMetrics(Option<Command>::none(), "metrics_test",
+                                    "none"));
+}
+
+TEST_F(MetricsTest, should_name_each_unnamed_instance_differently) {
+  EXPECT_EQ("metrics_instance", CommandMetrics::instanceName(
+                                    None(), "metrics_instance"));
+  EXPECT_EQ("metrics_instance_2", CommandMetrics::instanceName(
+                                      None(), "metrics_instance"));
+  EXPECT_EQ("named", CommandMetrics::instanceName(string("named"),
+                                                  "metrics_instance"));
+}
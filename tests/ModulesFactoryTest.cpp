@@ -1,5 +1,8 @@
 #include "ModulesFactory.hpp"
 #include <gtest/gtest.h>
+#include <stout/gtest.hpp>
+#include <stout/os/rm.hpp>
+#include <stout/os/write.hpp>
 #include "CommandHook.hpp"
 #include "CommandIsolator.hpp"
 
@@ -80,3 +83,23 @@ TEST(ModulesFactoryTest, should_create_isolator_with_empty_parameters) {
   ASSERT_EQ(isolator->prepareCommand().get(), Command("command_prepare", 30));
   ASSERT_TRUE(isolator->cleanupCommand().isNone());
 }
+
+TEST(ModulesFactoryTest, should_create_isolator_with_config_file) {
+  const std::string path = "/tmp/modules_factory_test.json";
+  ASSERT_SOME(os::write(path, "{\"isolator_prepare_command\": \"other\"}"));
+
+  ::mesos::Parameters parameters;
+  auto var = parameters.add_parameter();
+  var->set_key("isolator_prepare_command");
+  var->set_value("command_prepare");
+
+  var = parameters.add_parameter();
+  var->set_key("config_file");
+  var->set_value(path);
+
+  std::unique_ptr<CommandIsolator> isolator(
+      dynamic_cast<CommandIsolator*>(createIsolator(parameters)));
+
+  ASSERT_EQ(isolator->prepareCommand().get(), Command("other", 30));
+  os::rm(path);
+}
@@ -0,0 +1,297 @@
+#include "Serialization.hpp"
+#include "gtest_helpers.hpp"
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+#include <stout/gtest.hpp>
+
+using std::string;
+
+using namespace criteo::mesos;
+using ::mesos::ContainerID;
+using ::mesos::ResourceStatistics;
+using ::mesos::slave::ContainerLimitation;
+
+// Encode a length-delimited field whose payload is shorter than 128 bytes.
+static string field(int number, const string& payload) {
+  return string(1, static_cast<char>(number << 3 | 2)) +
+         string(1, static_cast<char>(payload.size())) + payload;
+}
+
+// Encode the next_check_in field of WatchHint, a little-endian double.
+static string nextCheckIn(double seconds) {
+  uint64_t bits;
+  memcpy(&bits, &seconds, sizeof(bits));
+  string hint("\xa1\x06", 2);
+  for (int i = 0; i < 8; ++i) hint += static_cast<char>(bits >> (8 * i));
+  return hint;
+}
+
+class SerializationTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    containerId.set_value("container_id");
+    limitation.set_message("too much toto");
+    limitation.set_reason(::mesos::TaskStatus::REASON_CONTAINER_LIMITATION);
+  }
+
+  ContainerID containerId;
+  ContainerLimitation limitation;
+};
+
+TEST_F(SerializationTest, should_build_json_input) {
+  string input = InputBuilder(CommandFormat::JSON)
+                     .add(InputField::CONTAINER_ID, containerId)
+                     .str();
+  EXPECT_EQ("{\"container_id\":{\"value\":\"container_id\"}}", input);
+}
+
+TEST_F(SerializationTest, should_build_protobuf_input) {
+  string input = InputBuilder(CommandFormat::PROTOBUF)
+                     .add(InputField::CONTAINER_ID, containerId)
+                     .str();
+  EXPECT_EQ(field(1, containerId.SerializeAsString()), input);
+}
+
+TEST_F(SerializationTest, should_join_protobuf_inputs) {
+  string first = field(1, "first");
+  string second = field(1, "second");
+  EXPECT_EQ(field(1, first) + field(1, second),
+            joinInputs(CommandFormat::PROTOBUF, {&first, &second}));
+  EXPECT_EQ("[" + first + "," + second + "]",
+            joinInputs(CommandFormat::JSON, {&first, &second}));
+}
+
+TEST_F(SerializationTest, should_parse_protobuf_output) {
+  Command command("command");
+  command.setFormat(CommandFormat::PROTOBUF);
+
+  Result<ContainerLimitation> parsed = parseOutput<ContainerLimitation>(
+      command, limitation.SerializeAsString());
+  ASSERT_SOME(parsed);
+  EXPECT_EQ("too much toto", parsed->message());
+
+  EXPECT_ERROR(parseOutput<ContainerLimitation>(command, ""));
+  EXPECT_ERROR(parseOutput<ContainerLimitation>(command, "\xff\xff"));
+
+  // The timestamp of the statistics is required.
+  ResourceStatistics statistics;
+  statistics.set_processes(1);
+  EXPECT_ERROR(parseOutput<ResourceStatistics>(
+      command, statistics.SerializePartialAsString()));
+}
+
+TEST_F(SerializationTest, should_parse_json_watch_output) {
+  Command command("command");
+
+  Try<WatchOutput<ContainerLimitation>> parsed =
+      parseWatchOutput<ContainerLimitation>(command, "");
+  ASSERT_SOME(parsed);
+  EXPECT_TRUE(parsed->limitation.isNone());
+  EXPECT_TRUE(parsed->nextCheckIn.isNone());
+
+  parsed = parseWatchOutput<ContainerLimitation>(
+      command, "{\"next_check_in\": 1.5}");
+  ASSERT_SOME(parsed);
+  EXPECT_TRUE(parsed->limitation.isNone());
+  EXPECT_EQ(Milliseconds(1500), parsed->nextCheckIn.get());
+
+  parsed = parseWatchOutput<ContainerLimitation>(
+      command, "{\"message\": \"too much toto\", \"next_check_in\": 2}");
+  ASSERT_SOME(parsed);
+  EXPECT_EQ("too much toto", parsed->limitation->message());
+  EXPECT_EQ(Seconds(2), parsed->nextCheckIn.get());
+
+  EXPECT_ERROR(parseWatchOutput<ContainerLimitation>(
+      command, "{\"next_check_in\": \"soon\"}"));
+  EXPECT_ERROR(parseWatchOutput<ContainerLimitation>(
+      command, "{\"next_check_in\": -1}"));
+}
+
+TEST_F(SerializationTest, should_parse_protobuf_watch_output) {
+  Command command("command");
+  command.setFormat(CommandFormat::PROTOBUF);
+
+  Try<WatchOutput<ContainerLimitation>> parsed =
+      parseWatchOutput<ContainerLimitation>(command, nextCheckIn(0.25));
+  ASSERT_SOME(parsed);
+  EXPECT_TRUE(parsed->limitation.isNone());
+  EXPECT_EQ(Milliseconds(250), parsed->nextCheckIn.get());
+
+  parsed = parseWatchOutput<ContainerLimitation>(
+      command, limitation.SerializeAsString() + nextCheckIn(3));
+  ASSERT_SOME(parsed);
+  EXPECT_EQ("too much toto", parsed->limitation->message());
+  EXPECT_EQ(Seconds(3), parsed->nextCheckIn.get());
+
+  parsed = parseWatchOutput<ContainerLimitation>(
+      command, limitation.SerializeAsString());
+  ASSERT_SOME(parsed);
+  EXPECT_EQ("too much toto", parsed->limitation->message());
+  EXPECT_TRUE(parsed->nextCheckIn.isNone());
+
+  // Truncated hint.
+  EXPECT_ERROR(parseWatchOutput<ContainerLimitation>(
+      command, nextCheckIn(3).substr(0, 5)));
+}
+
+TEST_F(SerializationTest, should_parse_protobuf_batch_output) {
+  Command command("command");
+  command.setFormat(CommandFormat::PROTOBUF);
+
+  string output = field(
+      1, field(1, "limited") + field(2, limitation.SerializeAsString()));
+  Try<hashmap<string, ContainerLimitation>> parsed =
+      parseOutputMap<ContainerLimitation>(command, output);
+  ASSERT_SOME(parsed);
+  ASSERT_EQ(1u, parsed->size());
+  EXPECT_EQ("too much toto", parsed->at("limited").message());
+
+  // A malformed entry does not fail the others.
+  Try<hashmap<string, ContainerLimitation>> partial =
+      parseOutputMap<ContainerLimitation>(
+          command, output + field(1, field(1, "other") + field(2, "\x0a")));
+  ASSERT_SOME(partial);
+  EXPECT_EQ(1u, partial->size());
+  EXPECT_TRUE(partial->contains("limited"));
+
+  // Entries must name their container.
+  EXPECT_ERROR(parseOutputMap<ContainerLimitation>(
+      command, field(1, field(2, limitation.SerializeAsString()))));
+  EXPECT_ERROR(parseOutputMap<ContainerLimitation>(command, output + "\x0a"));
+}
+
+TEST_F(SerializationTest, should_skip_the_malformed_entries_of_a_batch) {
+  Command command("command");
+  Try<hashmap<string, ContainerLimitation>> parsed =
+      parseOutputMap<ContainerLimitation>(
+          command,
+          "{\"limited\": {\"message\": \"too much toto\"},"
+          " \"other\": \"oops\", \"another\": {\"message\": 42}}");
+  ASSERT_SOME(parsed);
+  ASSERT_EQ(1u, parsed->size());
+  EXPECT_EQ("too much toto", parsed->at("limited").message());
+
+  EXPECT_ERROR(parseOutputMap<ContainerLimitation>(command, "{\"limited\""));
+}
+
+TEST_F(SerializationTest, should_join_delta_inputs) {
+  string first = field(1, "first");
+  EXPECT_EQ(string("\x10\x2a", 2) + field(1, first),
+            joinDeltaInputs(CommandFormat::PROTOBUF, 42, {&first}));
+  EXPECT_EQ("{\"sequence\":42,\"inputs\":[" + first + "]}",
+            joinDeltaInputs(CommandFormat::JSON, 42, {&first}));
+}
+
+TEST_F(SerializationTest, should_parse_json_delta_output) {
+  Command command("command");
+  Try<DeltaOutput<ResourceStatistics>> delta =
+      parseDeltaOutput<ResourceStatistics>(
+          command,
+          "{\"sequence\": 42, \"full\": true, \"entries\": "
+          "{\"container_1\": {\"timestamp\": 1, \"processes\": 3}}}");
+  ASSERT_SOME(delta);
+  EXPECT_EQ(42u, delta->header.sequence);
+  EXPECT_TRUE(delta->header.full);
+  ASSERT_EQ(1u, delta->entries.size());
+  EXPECT_EQ(3u, delta->entries.at("container_1").processes());
+
+  // Nothing changed.
+  delta = parseDeltaOutput<ResourceStatistics>(command, "{\"sequence\": 43}");
+  ASSERT_SOME(delta);
+  EXPECT_FALSE(delta->header.full);
+  EXPECT_TRUE(delta->entries.empty());
+
+  EXPECT_ERROR(parseDeltaOutput<ResourceStatistics>(command, "{}"));
+}
+
+TEST_F(SerializationTest, should_parse_protobuf_delta_output) {
+  Command command("command");
+  command.setFormat(CommandFormat::PROTOBUF);
+
+  ResourceStatistics statistics;
+  statistics.set_timestamp(1);
+  statistics.set_processes(3);
+  string output = string("\x10\x2a\x18\x01", 4) +
+                  field(1, field(1, "container_1") +
+                               field(2, statistics.SerializeAsString()));
+  Try<DeltaOutput<ResourceStatistics>> delta =
+      parseDeltaOutput<ResourceStatistics>(command, output);
+  ASSERT_SOME(delta);
+  EXPECT_EQ(42u, delta->header.sequence);
+  EXPECT_TRUE(delta->header.full);
+  EXPECT_EQ(3u, delta->entries.at("container_1").processes());
+}
+
+TEST_F(SerializationTest, should_replace_repeated_fields_when_merging_delta) {
+  ResourceStatistics statistics;
+  statistics.set_timestamp(1);
+  statistics.set_threads(7);
+  statistics.mutable_net_snmp_statistics()->mutable_tcp_stats()->set_currestab(
+      2);
+  statistics.add_net_traffic_control_statistics()->set_id("eth0");
+  statistics.add_net_traffic_control_statistics()->set_id("eth1");
+
+  ResourceStatistics delta;
+  delta.set_timestamp(2);
+  delta.mutable_net_snmp_statistics()->mutable_tcp_stats()->set_activeopens(5);
+  delta.add_net_traffic_control_statistics()->set_id("eth2");
+
+  mergeDelta(delta, &statistics);
+  EXPECT_EQ(2.0, statistics.timestamp());
+  EXPECT_EQ(7u, statistics.threads());
+  EXPECT_EQ(2, statistics.net_snmp_statistics().tcp_stats().currestab());
+  EXPECT_EQ(5, statistics.net_snmp_statistics().tcp_stats().activeopens());
+  ASSERT_EQ(1, statistics.net_traffic_control_statistics_size());
+  EXPECT_EQ("eth2", statistics.net_traffic_control_statistics(0).id());
+}
+
+TEST_F(SerializationTest, should_merge_json_outputs) {
+  Try<string> merged = mergeOutputs(
+      CommandFormat::JSON,
+      {"{\"labels\": [{\"key\": \"k1\", \"value\": \"v1\"}]}", "",
+       "{\"labels\": [{\"key\": \"k2\", \"value\": \"v2\"}]}"});
+  ASSERT_SOME(merged);
+
+  Result<::mesos::Labels> labels =
+      parseOutput<::mesos::Labels>(Command("command"), merged.get());
+  ASSERT_SOME(labels);
+  ASSERT_EQ(2, labels->labels_size());
+  EXPECT_EQ("k1", labels->labels(0).key());
+  EXPECT_EQ("k2", labels->labels(1).key());
+}
+
+TEST_F(SerializationTest, should_merge_json_objects_recursively) {
+  Try<string> merged = mergeOutputs(
+      CommandFormat::JSON, {"{\"a\": {\"b\": 1, \"c\": 2}, \"d\": null}",
+                            "{\"a\": {\"c\": 3}, \"d\": 4}"});
+  ASSERT_SOME(merged);
+  EXPECT_EQ(JSON::parse("{\"a\": {\"b\": 1, \"c\": 3}, \"d\": 4}").get(),
+            JSON::parse(merged.get()).get());
+}
+
+TEST_F(SerializationTest, should_merge_protobuf_outputs) {
+  ContainerLimitation other;
+  ::mesos::Resource* memory = other.add_resources();
+  memory->set_name("mem");
+  memory->set_type(::mesos::Value::SCALAR);
+  memory->mutable_scalar()->set_value(1024);
+
+  Command command("command");
+  command.setFormat(CommandFormat::PROTOBUF);
+  Try<string> merged =
+      mergeOutputs(CommandFormat::PROTOBUF,
+                   {limitation.SerializeAsString(), other.SerializeAsString()});
+  ASSERT_SOME(merged);
+
+  Result<ContainerLimitation> parsed =
+      parseOutput<ContainerLimitation>(command, merged.get());
+  ASSERT_SOME(parsed);
+  EXPECT_EQ("too much toto", parsed->message());
+  EXPECT_EQ("mem", parsed->resources(0).name());
+}
+
+TEST_F(SerializationTest, should_fail_to_merge_malformed_json_outputs) {
+  EXPECT_ERROR(mergeOutputs(CommandFormat::JSON, {"{}", "{"}));
+}
@@ -0,0 +1,126 @@
+#include "CommandRunner.hpp"
+#include "Span.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <stout/gtest.hpp>
+#include <stout/json.hpp>
+#include <stout/os/read.hpp>
+#include <stout/os/rm.hpp>
+#include <stout/strings.hpp>
+
+using std::string;
+using std::vector;
+
+using namespace criteo::mesos;
+
+extern string g_resourcesPath;
+
+class SpanTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    os::rm(path);
+    configure(1);
+  }
+
+  // The exporter is shared, so the other tests are not sampled.
+  void TearDown() {
+    configure(0);
+    os::rm(path);
+  }
+
+  void configure(double sampleRate) {
+    SpanOptions options;
+    options.file = path;
+    options.sampleRate = sampleRate;
+    ASSERT_SOME(SpanExporter::instance().configure(options));
+  }
+
+  // The spans recorded so far, in the order they ended.
+  vector<JSON::Object> spans() {
+    vector<JSON::Object> spans;
+    Try<string> content = os::read(path);
+    if (content.isError()) return spans;
+    for (const string& line : strings::tokenize(content.get(), "\n")) {
+      Try<JSON::Object> request = JSON::parse<JSON::Object>(line);
+      EXPECT_SOME(request);
+      Result<JSON::Object> span = request->find<JSON::Object>(
+          "resourceSpans[0].scopeSpans[0].spans[0]");
+      EXPECT_SOME(span);
+      if (span.isSome()) spans.push_back(span.get());
+    }
+    return spans;
+  }
+
+  static string field(const JSON::Object& span, const string& name) {
+    Result<JSON::String> value = span.find<JSON::String>(name);
+    return value.isSome() ? value->value : "";
+  }
+
+  const string path = "/tmp/mesos_command_modules_spans.json";
+};
+
+TEST_F(SpanTest, should_record_the_children_in_the_trace_of_the_call) {
+  Span call = Span::trace("prepare", {"container_1", "prepare"});
+  ASSERT_FALSE(call.metadata().traceId.empty());
+
+  Span child("spawn", call.metadata());
+  child.set("command", "/bin/true");
+  child.fail("exited with status 1");
+  child.end();
+  // Only the first end counts.
+  child.end();
+  call.end();
+
+  vector<JSON::Object> recorded = spans();
+  ASSERT_EQ(2u, recorded.size());
+  const JSON::Object& spawn = recorded[0];
+  const JSON::Object& prepare = recorded[1];
+
+  EXPECT_EQ("prepare", field(prepare, "name"));
+  EXPECT_EQ(call.metadata().traceId, field(prepare, "traceId"));
+  EXPECT_EQ(call.metadata().spanId, field(prepare, "spanId"));
+  EXPECT_TRUE(prepare.find<JSON::String>("parentSpanId").isNone());
+  EXPECT_EQ("container_1", field(prepare, "attributes[0].value.stringValue"));
+
+  EXPECT_EQ("spawn", field(spawn, "name"));
+  EXPECT_EQ(call.metadata().traceId, field(spawn, "traceId"));
+  EXPECT_EQ(call.metadata().spanId, field(spawn, "parentSpanId"));
+  EXPECT_EQ("command", field(spawn, "attributes[2].key"));
+  EXPECT_EQ("exited with status 1", field(spawn, "status.message"));
+  EXPECT_LE(std::stoull(field(spawn, "startTimeUnixNano")),
+            std::stoull(field(spawn, "endTimeUnixNano")));
+}
+
+TEST_F(SpanTest, should_not_record_the_calls_which_are_not_sampled) {
+  configure(0);
+  Span call = Span::trace("prepare", {"container_1", "prepare"});
+  EXPECT_TRUE(call.metadata().traceId.empty());
+  Span("spawn", call.metadata()).end();
+  call.end();
+
+  EXPECT_TRUE(spans().empty());
+}
+
+TEST_F(SpanTest, should_record_the_steps_of_a_command) {
+  Span call = Span::trace("prepare", {"container_1", "prepare"});
+  Try<string> output =
+      CommandRunner(false, call.metadata())
+          .run(Command(g_resourcesPath + "pipe_input.sh", 10), "HELLO");
+  EXPECT_SOME_EQ("HELLO > output", output);
+  call.end();
+
+  vector<string> names;
+  for (const JSON::Object& span : spans()) {
+    EXPECT_EQ(call.metadata().traceId, field(span, "traceId"));
+    names.push_back(field(span, "name"));
+  }
+  // The run span ends on a libprocess thread.
+  std::sort(names.begin(), names.end());
+  EXPECT_EQ((vector<string>{"prepare", "queue", "read_output", "run", "setup",
+                            "spawn"}),
+            names);
+}
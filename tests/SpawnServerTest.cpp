@@ -0,0 +1,85 @@
+#include "SpawnServer.hpp"
+#include "gtest_helpers.hpp"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include <gtest/gtest.h>
+#include <process/gtest.hpp>
+#include <stout/gtest.hpp>
+
+using namespace criteo::mesos;
+using process::Future;
+
+class SpawnServerTest : public ::testing::Test {
+ protected:
+  void SetUp() { ASSERT_SOME(server.start(SPAWN_SERVER_PATH)); }
+
+  // Wait status of a command run by the spawn server.
+  Option<int> run(const std::vector<std::string>& argv, int stdinFd = -1) {
+    Try<Future<SpawnServer::Child>> child = server.spawn(argv, stdinFd);
+    EXPECT_SOME(child);
+    if (child.isError()) return None();
+    AWAIT_EXPECT_READY(child.get());
+    if (!child->isReady()) return None();
+    Future<Option<int>> status = child->get().status;
+    AWAIT_EXPECT_READY(status);
+    return status.isReady() ? status.get() : None();
+  }
+
+  SpawnServer server;
+};
+
+TEST(SpawnServerDisabledTest, should_not_spawn_if_not_started) {
+  SpawnServer server;
+  EXPECT_FALSE(server.isEnabled());
+  EXPECT_ERROR(server.spawn({"/bin/true"}, -1));
+}
+
+TEST_F(SpawnServerTest, should_report_exit_status) {
+  EXPECT_TRUE(server.isEnabled());
+  Option<int> status = run({"/bin/sh", "-c", "exit 3"});
+  ASSERT_SOME(status);
+  EXPECT_TRUE(WIFEXITED(status.get()));
+  EXPECT_EQ(3, WEXITSTATUS(status.get()));
+}
+
+TEST_F(SpawnServerTest, should_pass_standard_input) {
+  char path[] = "/tmp/spawn_server_test_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_NE(-1, fd);
+  ASSERT_SOME(os::write(fd, "hello\n"));
+  os::close(fd);
+
+  Try<int> input = os::open(path, O_RDONLY | O_CLOEXEC);
+  ASSERT_SOME(input);
+  Option<int> status =
+      run({"sh", "-c", "read line && test \"$line\" = hello"}, input.get());
+  os::close(input.get());
+  os::rm(path);
+
+  EXPECT_SOME_EQ(0, status);
+}
+
+TEST_F(SpawnServerTest, should_fail_to_execute_unknown_command) {
+  Option<int> status = run({"/does/not/exist"});
+  ASSERT_SOME(status);
+  EXPECT_EQ(127, WEXITSTATUS(status.get()));
+}
+
+TEST_F(SpawnServerTest, should_restart_after_a_crash) {
+  Option<pid_t> pid = server.pid();
+  ASSERT_SOME(pid);
+  ASSERT_EQ(0, kill(pid.get(), SIGKILL));
+
+  // The helper is forgotten once its socket is closed.
+  for (int i = 0; i < 100 && server.pid().isSome(); ++i) {
+    os::sleep(Milliseconds(10));
+  }
+  EXPECT_NONE(server.pid());
+
+  EXPECT_SOME_EQ(0, run({"/bin/true"}));
+  EXPECT_SOME(server.pid());
+  EXPECT_NE(pid, server.pid());
+}
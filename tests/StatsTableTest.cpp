@@ -0,0 +1,230 @@
+#include "CommandIsolator.hpp"
+#include "StatsTable.hpp"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <process/gtest.hpp>
+#include <stout/gtest.hpp>
+#include <stout/os/rm.hpp>
+
+using std::string;
+
+extern string g_resourcesPath;
+
+using namespace criteo::mesos;
+using ::mesos::ResourceStatistics;
+
+const size_t CAPACITY = 4;
+
+// Map the table as a collector would.
+class Collector {
+ public:
+  explicit Collector(const string& path) {
+    m_fd = open(path.c_str(), O_RDWR);
+    m_size = sizeof(stats::Header) + CAPACITY * sizeof(stats::Record);
+    m_data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  }
+
+  ~Collector() {
+    munmap(m_data, m_size);
+    close(m_fd);
+  }
+
+  const stats::Header& header() const {
+    return *static_cast<stats::Header*>(m_data);
+  }
+
+  // The record of a registered container, nullptr if not found, along with
+  // its generation read before the id.
+  stats::Record* find(const string& containerId,
+                      uint32_t* generation = nullptr) {
+    for (size_t i = 0; i < CAPACITY; ++i) {
+      stats::Record* record = StatsTable::recordAt(m_data, i);
+      if (__atomic_load_n(&record->state, __ATOMIC_ACQUIRE) !=
+          stats::REGISTERED) {
+        continue;
+      }
+      uint32_t read = __atomic_load_n(&record->generation, __ATOMIC_ACQUIRE);
+      if (containerId == record->containerId) {
+        if (generation != nullptr) *generation = read;
+        return record;
+      }
+    }
+    return nullptr;
+  }
+
+  // Publish the statistics of a registered container.
+  bool publish(const string& containerId,
+               const ResourceStatistics& statistics) {
+    uint32_t generation;
+    stats::Record* record = find(containerId, &generation);
+    return record != nullptr &&
+           StatsTable::publish(record, generation, statistics);
+  }
+
+ private:
+  int m_fd;
+  void* m_data;
+  size_t m_size;
+};
+
+class StatsTableTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    os::rm(path);
+    statistics.set_timestamp(12345);
+    statistics.set_processes(3);
+    statistics.set_cpus_user_time_secs(0.5);
+    statistics.set_mem_rss_bytes(1024);
+  }
+
+  void TearDown() { os::rm(path); }
+
+  const string path = "/tmp/mesos_command_modules_stats";
+  ResourceStatistics statistics;
+};
+
+TEST_F(StatsTableTest, should_initialize_the_header) {
+  Try<process::Owned<StatsTable>> table = StatsTable::create(path, CAPACITY);
+  ASSERT_SOME(table);
+
+  Collector collector(path);
+  EXPECT_EQ(stats::MAGIC, collector.header().magic);
+  EXPECT_EQ(stats::VERSION, collector.header().version);
+  EXPECT_EQ(CAPACITY, collector.header().capacity);
+  EXPECT_EQ(sizeof(stats::Record), collector.header().recordSize);
+}
+
+TEST_F(StatsTableTest, should_read_the_statistics_published) {
+  process::Owned<StatsTable> table = StatsTable::create(path, CAPACITY).get();
+  ASSERT_SOME(table->add("container_1"));
+  EXPECT_NONE(table->read("container_1"));
+
+  Collector collector(path);
+  stats::Record* record = collector.find("container_1");
+  ASSERT_NE(nullptr, record);
+  EXPECT_TRUE(collector.publish("container_1", statistics));
+  EXPECT_EQ(2u, record->sequence);
+
+  Option<ResourceStatistics> read = table->read("container_1");
+  ASSERT_SOME(read);
+  EXPECT_EQ(12345, read->timestamp());
+  EXPECT_EQ(3u, read->processes());
+  EXPECT_EQ(0.5, read->cpus_user_time_secs());
+  EXPECT_EQ(1024u, read->mem_rss_bytes());
+  EXPECT_FALSE(read->has_threads());
+}
+
+TEST_F(StatsTableTest, should_not_read_a_record_being_written) {
+  process::Owned<StatsTable> table = StatsTable::create(path, CAPACITY).get();
+  table->add("container_1");
+
+  Collector collector(path);
+  stats::Record* record = collector.find("container_1");
+  EXPECT_TRUE(collector.publish("container_1", statistics));
+  ++record->sequence;
+
+  EXPECT_NONE(table->read("container_1"));
+}
+
+TEST_F(StatsTableTest, should_not_read_the_statistics_of_a_previous_container) {
+  process::Owned<StatsTable> table = StatsTable::create(path, 1).get();
+  table->add("container_1");
+
+  Collector collector(path);
+  EXPECT_TRUE(collector.publish("container_1", statistics));
+
+  table->remove("container_1");
+  EXPECT_EQ(nullptr, collector.find("container_1"));
+  ASSERT_SOME(table->add("container_2"));
+  EXPECT_NONE(table->read("container_2"));
+  EXPECT_NONE(table->read("container_1"));
+}
+
+TEST_F(StatsTableTest, should_not_publish_once_the_record_is_reused) {
+  process::Owned<StatsTable> table = StatsTable::create(path, 1).get();
+  table->add("container_1");
+
+  // The collector read the record of the first container before its reuse.
+  Collector collector(path);
+  uint32_t generation;
+  stats::Record* record = collector.find("container_1", &generation);
+  ASSERT_NE(nullptr, record);
+  table->remove("container_1");
+  ASSERT_SOME(table->add("container_2"));
+
+  EXPECT_FALSE(StatsTable::publish(record, generation, statistics));
+  EXPECT_NONE(table->read("container_2"));
+  EXPECT_TRUE(collector.publish("container_2", statistics));
+  EXPECT_SOME(table->read("container_2"));
+}
+
+TEST_F(StatsTableTest, should_fail_to_add_a_container_once_full) {
+  process::Owned<StatsTable> table = StatsTable::create(path, 1).get();
+  ASSERT_SOME(table->add("container_1"));
+  EXPECT_ERROR(table->add("container_2"));
+  EXPECT_ERROR(table->add(string(stats::MAX_CONTAINER_ID_SIZE, 'x')));
+}
+
+TEST_F(StatsTableTest, should_refuse_a_path_already_used) {
+  Try<process::Owned<StatsTable>> table = StatsTable::create(path, CAPACITY);
+  ASSERT_SOME(table);
+  ASSERT_SOME(table.get()->add("container_1"));
+
+  EXPECT_ERROR(StatsTable::create(path, CAPACITY));
+  Collector collector(path);
+  EXPECT_NE(nullptr, collector.find("container_1"));
+
+  table.get().reset();
+  EXPECT_SOME(StatsTable::create(path, CAPACITY));
+}
+
+TEST_F(StatsTableTest, should_serve_the_usage_of_the_isolator) {
+  IsolatorOptions options;
+  options.usageStatsTable = path;
+  options.usageStatsTableCapacity = CAPACITY;
+  CommandIsolator isolator(None(), None(), None(), None(), false, options);
+
+  ::mesos::ContainerID containerId;
+  containerId.set_value("container_1");
+  AWAIT_READY(isolator.prepare(containerId, ::mesos::slave::ContainerConfig()));
+
+  Collector collector(path);
+  ASSERT_TRUE(collector.publish("container_1", statistics));
+
+  process::Future<ResourceStatistics> usage = isolator.usage(containerId);
+  AWAIT_READY(usage);
+  EXPECT_EQ(3u, usage->processes());
+
+  AWAIT_READY(isolator.cleanup(containerId));
+  EXPECT_EQ(nullptr, collector.find("container_1"));
+}
+
+TEST_F(StatsTableTest, should_run_the_usage_command_once_the_table_is_full) {
+  IsolatorOptions options;
+  options.usageStatsTable = path;
+  options.usageStatsTableCapacity = 1;
+  CommandIsolator isolator(None(), None(), None(),
+                           Command(g_resourcesPath + "usage.sh"), false,
+                           options);
+
+  ::mesos::ContainerID registered;
+  registered.set_value("container_1");
+  AWAIT_READY(isolator.prepare(registered, ::mesos::slave::ContainerConfig()));
+  ::mesos::ContainerID unregistered;
+  unregistered.set_value("container_2");
+  AWAIT_READY(
+      isolator.prepare(unregistered, ::mesos::slave::ContainerConfig()));
+
+  process::Future<ResourceStatistics> usage = isolator.usage(unregistered);
+  AWAIT_READY(usage);
+  EXPECT_EQ(5, usage->net_snmp_statistics().tcp_stats().currestab());
+
+  AWAIT_READY(isolator.cleanup(registered));
+  AWAIT_READY(isolator.cleanup(unregistered));
+}
@@ -0,0 +1,108 @@
+#include "CommandIsolator.hpp"
+#include "TraceRecorder.hpp"
+
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+
+#include <process/gtest.hpp>
+#include <stout/foreach.hpp>
+#include <stout/gtest.hpp>
+#include <stout/json.hpp>
+#include <stout/os/read.hpp>
+#include <stout/os/rm.hpp>
+#include <stout/os/write.hpp>
+#include <stout/strings.hpp>
+
+using std::string;
+
+using namespace criteo::mesos;
+
+// Value of a string field of an event, empty if missing.
+static string field(const JSON::Object& event, const string& path) {
+  Result<JSON::String> value = event.find<JSON::String>(path);
+  return value.isSome() ? value->value : "";
+}
+
+class TraceRecorderTest : public ::testing::Test {
+ protected:
+  void SetUp() { os::rm(path); }
+  void TearDown() { os::rm(path); }
+
+  // Events of the trace, one JSON object per line.
+  std::vector<JSON::Object> events() {
+    std::vector<JSON::Object> events;
+    Try<string> content = os::read(path);
+    EXPECT_SOME(content);
+    if (content.isError()) return events;
+    foreach (const string& line, strings::tokenize(content.get(), "\n")) {
+      Try<JSON::Object> event = JSON::parse<JSON::Object>(line);
+      EXPECT_SOME(event);
+      if (event.isSome()) events.push_back(event.get());
+    }
+    return events;
+  }
+
+  const string path = "/tmp/mesos_command_modules_trace.jsonl";
+};
+
+TEST_F(TraceRecorderTest, should_append_one_line_per_event) {
+  Try<std::shared_ptr<TraceRecorder>> recorder = TraceRecorder::open(path);
+  ASSERT_SOME(recorder);
+
+  JSON::Object input;
+  input.values["container_id"] = JSON::Object();
+  recorder.get()->record("usage", input);
+  recorder.get()->record("cleanup", "{}");
+
+  std::vector<JSON::Object> recorded = events();
+  ASSERT_EQ(2u, recorded.size());
+  EXPECT_EQ("usage", field(recorded[0], "method"));
+  EXPECT_SOME(recorded[0].find<JSON::Object>("input.container_id"));
+  EXPECT_SOME(recorded[0].find<JSON::Number>("timestamp"));
+  EXPECT_EQ("cleanup", field(recorded[1], "method"));
+}
+
+TEST_F(TraceRecorderTest, should_keep_the_events_already_recorded) {
+  TraceRecorder::open(path).get()->record("usage", "{}");
+  TraceRecorder::open(path).get()->record("cleanup", "{}");
+
+  EXPECT_EQ(2u, events().size());
+}
+
+TEST_F(TraceRecorderTest, should_be_readable_by_its_owner_only) {
+  ASSERT_SOME(os::write(path, ""));
+  ASSERT_EQ(0, ::chmod(path.c_str(), 0644));
+  ASSERT_SOME(TraceRecorder::open(path));
+
+  struct stat status;
+  ASSERT_EQ(0, ::stat(path.c_str(), &status));
+  EXPECT_EQ(0600u, status.st_mode & 0777);
+}
+
+TEST_F(TraceRecorderTest, should_fail_to_open_a_file_in_a_missing_directory) {
+  EXPECT_ERROR(TraceRecorder::open("/nonexistent/trace.jsonl"));
+}
+
+TEST_F(TraceRecorderTest, should_record_the_events_of_the_isolator) {
+  IsolatorOptions options;
+  options.traceFile = path;
+  CommandIsolator isolator(None(), None(), None(), None(), false, options);
+
+  ::mesos::ContainerID containerId;
+  containerId.set_value("traced_container");
+  ::mesos::slave::ContainerConfig containerConfig;
+  containerConfig.set_user("app_user");
+
+  AWAIT_READY(isolator.prepare(containerId, containerConfig));
+  AWAIT_READY(isolator.usage(containerId));
+  AWAIT_READY(isolator.cleanup(containerId));
+
+  std::vector<JSON::Object> recorded = events();
+  ASSERT_EQ(3u, recorded.size());
+  EXPECT_EQ("prepare", field(recorded[0], "method"));
+  EXPECT_EQ("app_user", field(recorded[0], "input.container_config.user"));
+  EXPECT_EQ("usage", field(recorded[1], "method"));
+  EXPECT_EQ("traced_container",
+            field(recorded[2], "input.container_id.value"));
+}
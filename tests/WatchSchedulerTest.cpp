@@ -0,0 +1,138 @@
+#include "WatchScheduler.hpp"
+#include "gtest_helpers.hpp"
+
+#include <atomic>
+#include <memory>
+
+#include <gtest/gtest.h>
+#include <stout/os.hpp>
+#include <stout/stopwatch.hpp>
+
+using namespace criteo::mesos;
+
+TEST(WatchSchedulerTest, should_run_job_until_it_is_over) {
+  WatchScheduler scheduler(2, Milliseconds(10));
+  std::atomic<int> runs(0);
+
+  scheduler.add("job", Milliseconds(20), [&runs]() { return ++runs == 3; });
+  EXPECT_EQ(1u, scheduler.size());
+
+  os::sleep(Milliseconds(500));
+  EXPECT_EQ(3, runs.load());
+  EXPECT_EQ(0u, scheduler.size());
+}
+
+TEST(WatchSchedulerTest, should_run_adaptive_job_after_its_delay) {
+  WatchScheduler scheduler(2, Milliseconds(10));
+  std::atomic<int> runs(0);
+
+  WatchScheduler::AdaptiveJob job = [&runs](Duration* delay) {
+    ++runs;
+    *delay = Seconds(10);
+    return false;
+  };
+  scheduler.add("job", Milliseconds(20), job);
+
+  os::sleep(Milliseconds(300));
+  EXPECT_EQ(1, runs.load());
+  scheduler.remove("job");
+}
+
+TEST(WatchSchedulerTest, should_stop_running_removed_job) {
+  WatchScheduler scheduler(2, Milliseconds(10));
+  std::atomic<int> runs(0);
+
+  scheduler.add("job", Milliseconds(20), [&runs]() {
+    ++runs;
+    return false;
+  });
+  os::sleep(Milliseconds(200));
+  scheduler.remove("job");
+  EXPECT_EQ(0u, scheduler.size());
+
+  // Leave time for a run in progress to return.
+  os::sleep(Milliseconds(50));
+  int removedAt = runs.load();
+  EXPECT_GT(removedAt, 0);
+
+  os::sleep(Milliseconds(200));
+  EXPECT_EQ(removedAt, runs.load());
+}
+
+TEST(WatchSchedulerTest, should_replace_job_with_same_key) {
+  WatchScheduler scheduler(2, Milliseconds(10));
+  std::atomic<int> first(0);
+  std::atomic<int> second(0);
+
+  scheduler.add("job", Milliseconds(20), [&first]() {
+    ++first;
+    return false;
+  });
+  scheduler.add("job", Milliseconds(20), [&second]() {
+    ++second;
+    return false;
+  });
+  EXPECT_EQ(1u, scheduler.size());
+
+  os::sleep(Milliseconds(200));
+  EXPECT_EQ(0, first.load());
+  EXPECT_GT(second.load(), 0);
+  scheduler.remove("job");
+}
+
+TEST(WatchSchedulerTest, should_not_run_more_jobs_than_threads) {
+  WatchScheduler scheduler(2, Milliseconds(10));
+  std::atomic<int> running(0);
+  std::atomic<int> maxRunning(0);
+  std::atomic<int> runs(0);
+
+  for (int i = 0; i < 8; ++i) {
+    scheduler.add("job" + std::to_string(i), Milliseconds(10),
+                  [&running, &maxRunning, &runs]() {
+                    int current = ++running;
+                    int max = maxRunning.load();
+                    while (current > max &&
+                           !maxRunning.compare_exchange_weak(max, current)) {
+                    }
+                    os::sleep(Milliseconds(20));
+                    --running;
+                    ++runs;
+                    return true;
+                  });
+  }
+
+  os::sleep(Milliseconds(500));
+  EXPECT_EQ(8, runs.load());
+  EXPECT_EQ(2, maxRunning.load());
+}
+
+TEST(WatchSchedulerTest, should_run_first_job_within_a_tenth_of_its_period) {
+  WatchScheduler scheduler(2, Milliseconds(10));
+  std::atomic<int> runs(0);
+
+  scheduler.add("job", Seconds(2), [&runs]() {
+    ++runs;
+    return true;
+  });
+
+  os::sleep(Milliseconds(400));
+  EXPECT_EQ(1, runs.load());
+}
+
+TEST(WatchSchedulerTest, should_not_wait_for_running_jobs_when_destroyed) {
+  std::shared_ptr<std::atomic<bool>> started =
+      std::make_shared<std::atomic<bool>>(false);
+  Stopwatch stopwatch;
+  {
+    WatchScheduler scheduler(1, Milliseconds(10));
+    scheduler.add("job", Milliseconds(10), [started]() {
+      *started = true;
+      os::sleep(Seconds(2));
+      return true;
+    });
+    while (!*started) os::sleep(Milliseconds(10));
+    stopwatch.start();
+  }
+  stopwatch.stop();
+  EXPECT_LT(stopwatch.elapsed(), Seconds(1));
+}
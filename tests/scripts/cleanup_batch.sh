@@ -0,0 +1,4 @@
+#!/bin/bash
+
+# Record the number of containers cleaned up by each call.
+jq length $1 >> /tmp/cleanup_batches
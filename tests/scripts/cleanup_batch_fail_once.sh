@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# Fail on the first call, then record the number of containers cleaned up.
+MARKER_FILE=/tmp/cleanup_batch_fail_once
+if [ ! -f $MARKER_FILE ]; then
+  touch $MARKER_FILE
+  exit 1
+fi
+
+jq length $1 >> /tmp/cleanup_batches
@@ -0,0 +1,3 @@
+#!/bin/sh
+
+echo -n "$1" > $2
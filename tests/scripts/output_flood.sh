@@ -0,0 +1,9 @@
+#!/bin/bash
+
+echo $$ > /tmp/output_flood.pid
+
+# Keep writing to the output until killed.
+while true; do
+  echo "0123456789" >> $2
+  sleep 0.01
+done
@@ -0,0 +1,12 @@
+#!/bin/bash
+
+# Lengths are in bytes.
+export LC_ALL=C
+
+echo $$ > /tmp/persistent_hang.pid
+
+# Read frames but never answer them.
+while read -r LENGTH; do
+  read -r -N "$LENGTH" INPUT
+  sleep 1000
+done
@@ -0,0 +1,11 @@
+#!/bin/bash
+
+# Lengths are in bytes.
+export LC_ALL=C
+
+# Answer each framed input with "<input> > output" until stdin is closed.
+while read -r LENGTH; do
+  read -r -N "$LENGTH" INPUT
+  OUTPUT="$INPUT > output"
+  printf '%d\n%s' "${#OUTPUT}" "$OUTPUT"
+done
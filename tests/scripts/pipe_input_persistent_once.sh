@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# Lengths are in bytes.
+export LC_ALL=C
+
+# Answer only one framed input and exit so that the module must restart it.
+read -r LENGTH
+read -r -N "$LENGTH" INPUT
+OUTPUT="$INPUT > output"
+printf '%d\n%s' "${#OUTPUT}" "$OUTPUT"
@@ -0,0 +1,5 @@
+#!/bin/bash
+
+sleep 1
+
+echo '{"rootfs": "/isolated_fs", "user": "app_user"}' > $2
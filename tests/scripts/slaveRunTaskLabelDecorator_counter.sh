@@ -0,0 +1,8 @@
+#!/bin/bash
+
+# Report the number of times this script has been called as a label.
+COUNTER_FILE=/tmp/hook_counter
+COUNT=$(( $(cat $COUNTER_FILE 2>/dev/null || echo 0) + 1 ))
+echo $COUNT > $COUNTER_FILE
+
+echo "{\"labels\": [{\"key\": \"COUNT\", \"value\": \"$COUNT\"}]}" > $2
@@ -0,0 +1,4 @@
+#!/bin/bash
+
+sleep 1
+echo '{"labels": [{"key": "LABEL_1", "value": "test1"}]}' > $2
@@ -0,0 +1,9 @@
+#!/bin/bash
+
+# Report the size of the batch as the number of established connections of
+# each container.
+jq -c 'length as $count
+       | map({(.container_id.value): {
+           "timestamp": 1,
+           "net_snmp_statistics": {"tcp_stats": {"CurrEstab": $count}}}})
+       | add' $1 > $2
@@ -0,0 +1,11 @@
+#!/bin/bash
+
+# Report the number of times this script has been called as the number of
+# established connections.
+COUNTER_FILE=/tmp/usage_counter
+COUNT=$(( $(cat $COUNTER_FILE 2>/dev/null || echo 0) + 1 ))
+echo $COUNT > $COUNTER_FILE
+
+echo "{\"timestamp\": 1, \"net_snmp_statistics\": {
+\"tcp_stats\": {\"CurrEstab\": $COUNT}
+}}" > $2
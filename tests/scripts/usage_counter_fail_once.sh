@@ -0,0 +1,13 @@
+#!/bin/bash
+
+# Fail on the first call, then behave like usage_counter.sh.
+COUNTER_FILE=/tmp/usage_counter
+COUNT=$(( $(cat $COUNTER_FILE 2>/dev/null || echo 0) + 1 ))
+echo $COUNT > $COUNTER_FILE
+if [ $COUNT -eq 1 ]; then
+  exit 1
+fi
+
+echo "{\"timestamp\": 1, \"net_snmp_statistics\": {
+\"tcp_stats\": {\"CurrEstab\": $COUNT}
+}}" > $2
@@ -0,0 +1,15 @@
+#!/bin/bash
+
+# Report every container on the first call, then only other_container_id
+# with one more process on each call.
+jq -c 'if .sequence == 0 then
+         {"sequence": 1, "full": true,
+          "entries": (.inputs
+                      | map({(.container_id.value): {
+                          "timestamp": 1, "processes": 1, "threads": 7}})
+                      | add)}
+       else
+         {"sequence": (.sequence + 1),
+          "entries": {"other_container_id": {
+            "timestamp": 2, "processes": (.sequence + 1)}}}
+       end' $1 > $2
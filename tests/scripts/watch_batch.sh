@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# Report a limitation for the containers whose id starts with "limited", with
+# the size of the batch in the message.
+jq -c 'length as $count
+       | map(select(.container_id.value | startswith("limited"))
+             | {(.container_id.value): {
+                 "message": "batch of \($count)",
+                 "reason": "REASON_CONTAINER_LIMITATION"}})
+       | add // {}' $1 > $2
@@ -0,0 +1,11 @@
+#!/bin/bash
+
+# Hang on the first call so that it gets killed by the timeout, then report a
+# limitation.
+MARKER_FILE=/tmp/watch_hang_once
+if [ ! -f $MARKER_FILE ]; then
+  touch $MARKER_FILE
+  sleep 10
+fi
+
+echo '{"resources":[{"name":"toto","type":"SCALAR","scalar":{"value":1}}],"message":"too much toto","reason":"REASON_CONTAINER_LIMITATION"}' >$2
@@ -0,0 +1,5 @@
+#!/bin/bash
+
+# Count the runs and ask to be run again in 30 seconds.
+printf x >> /tmp/watch_next_check_in
+echo '{"next_check_in": 30}' > $2
@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# Report a limitation in protobuf if the input is in protobuf too, i.e., it
+# starts with the container_id field of CommandInput.
+if [ "$(head -c 1 $1 | od -An -tx1 | tr -d ' ')" != "0a" ]; then
+  exit 1
+fi
+
+# ContainerLimitation with message (field 2) "protobuf input".
+printf '\022\016protobuf input' > $2